@@ -0,0 +1,194 @@
+#include "graphbenchmarks.h"
+
+#include "analysis.h"
+#include "data.hpp"
+#include "densebayesrkernel.h"
+#include "limitsequencegraph.hpp"
+#include "markercache.h"
+#include "parallelgraph.h"
+#include "sequential.h"
+#include "syntheticdata.h"
+
+#include "tbb/task_arena.h"
+
+#include <mutex>
+#include <numeric>
+#include <shared_mutex>
+
+namespace {
+
+// Drives the graphs with the work of a dense BayesR column update. Beta is
+// set to its ridge estimate instead of being sampled, so the work per marker
+// is fixed and the runs are comparable.
+class SyntheticAnalysis : public Analysis
+{
+public:
+    SyntheticAnalysis(const SyntheticGenotypes &genotypes, const Options *options)
+        : Analysis(nullptr, options)
+        , m_numInds(genotypes.numInds())
+        , m_beta(VectorXd::Zero(genotypes.numSnps()))
+    {
+        // Keep every marker compressed in one buffer, like a preprocessed file
+        std::vector<CompressedMarker> markers;
+        unsigned long pos = 0;
+        for (unsigned int snp = 0; snp < genotypes.numSnps(); ++snp) {
+            markers.push_back(genotypes.buildMarker(PreprocessDataType::Dense, snp)->compress());
+            markers.back().index.pos = pos;
+            pos += markers.back().index.compressedSize;
+        }
+
+        m_compressed.resize(pos);
+        for (const auto &marker : markers) {
+            std::copy_n(marker.buffer.get(), marker.index.compressedSize,
+                        m_compressed.begin() + static_cast<std::ptrdiff_t>(marker.index.pos));
+            m_index.push_back(marker.index);
+        }
+
+        reset();
+    }
+
+    void reset()
+    {
+        m_epsilon = syntheticResiduals(m_numInds);
+        m_beta.setZero();
+    }
+
+    std::unique_ptr<Kernel> kernelForMarker(const ConstMarkerPtr &marker) const override
+    {
+        return std::make_unique<DenseRKernel>(std::dynamic_pointer_cast<const DenseMarker>(marker));
+    }
+
+    MarkerBuilder *markerBuilder() const override { return builderForType(PreprocessDataType::Dense); }
+    IndexEntry indexEntry(unsigned int i) const override { return m_index[i]; }
+    bool compressed() const override { return true; }
+    unsigned char *compressedData() const override { return m_compressed.data(); }
+
+    int runGibbs(AnalysisGraph *) override { return 0; }
+
+    void processColumn(const KernelPtr &kernel) override
+    {
+        auto *denseKernel = dynamic_cast<DenseRKernel*>(kernel.get());
+        const auto i = kernel->marker->i;
+
+        const double betaOld = m_beta[i];
+        const double beta = betaFor(denseKernel->computeNum(m_epsilon, betaOld));
+        m_epsilon += *denseKernel->calculateEpsilonChange(betaOld, beta);
+        m_beta[i] = beta;
+    }
+
+    std::unique_ptr<AsyncResult> processColumnAsync(const KernelPtr &kernel) override
+    {
+        auto *denseKernel = dynamic_cast<DenseRKernel*>(kernel.get());
+        const auto i = kernel->marker->i;
+
+        auto result = std::make_unique<AsyncResult>();
+        result->betaOld = m_beta[i];
+        {
+            std::shared_lock lock(m_mutex);
+            result->beta = betaFor(denseKernel->computeNum(m_epsilon, result->betaOld));
+        }
+        result->deltaEpsilon = denseKernel->calculateEpsilonChange(result->betaOld, result->beta);
+        result->v = std::make_unique<VectorXd>(VectorXd::Zero(1));
+        m_beta[i] = result->beta;
+        return result;
+    }
+
+    void doThreadSafeUpdates(const ConstAsyncResultPtr &) override {}
+
+    void updateGlobal(const KernelPtr &, const ConstAsyncResultPtr &result) override
+    {
+        std::unique_lock lock(m_mutex);
+        m_epsilon += *result->deltaEpsilon;
+    }
+
+private:
+    unsigned int m_numInds = 0;
+    mutable std::vector<unsigned char> m_compressed;
+    std::vector<IndexEntry> m_index;
+
+    VectorXd m_epsilon;
+    VectorXd m_beta;
+    std::shared_mutex m_mutex;
+
+    double betaFor(double num) const
+    {
+        return num / (2.0 * static_cast<double>(m_numInds));
+    }
+};
+
+// Sequential reads the markers from the marker cache, so fill it from the
+// compressed markers the way the runner does with --marker-cache
+void populateMarkerCache(const SyntheticAnalysis &analysis, const SyntheticGenotypes &genotypes)
+{
+    Data data;
+    data.numInds = genotypes.numInds();
+    data.numSnps = genotypes.numSnps();
+    for (unsigned int snp = 0; snp < data.numSnps; ++snp)
+        data.ppbedIndex.push_back(analysis.indexEntry(snp));
+    data.ppBedMap = reinterpret_cast<double *>(analysis.compressedData());
+
+    Options options;
+    options.compress = true;
+    markerCache()->populate(&data, &options);
+}
+
+void runGraph(benchmark::State &state, AnalysisGraph *graph, bool useMarkerCache = false)
+{
+    const SyntheticGenotypes genotypes(static_cast<unsigned int>(state.range(0)),
+                                       static_cast<unsigned int>(state.range(1)),
+                                       0.01, static_cast<double>(state.range(2)) / 100.0);
+    const Options options;
+    SyntheticAnalysis analysis(genotypes, &options);
+
+    std::vector<unsigned int> markerIndices(genotypes.numSnps());
+    std::iota(markerIndices.begin(), markerIndices.end(), 0);
+
+    if (useMarkerCache)
+        populateMarkerCache(analysis, genotypes);
+
+    for (auto _ : state) {
+        analysis.reset();
+        graph->exec(&analysis, genotypes.numInds(), genotypes.numSnps(), markerIndices);
+    }
+
+    if (useMarkerCache)
+        markerCache()->clear();
+
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+void BM_Sequential(benchmark::State &state)
+{
+    ::Sequential graph; // Differentiate from Eigen::Sequential
+    runGraph(state, &graph, true);
+}
+
+void BM_LimitSequenceGraph(benchmark::State &state)
+{
+    LimitSequenceGraph graph(static_cast<size_t>(tbb::this_task_arena::max_concurrency()));
+    runGraph(state, &graph);
+}
+
+void BM_ParallelGraph(benchmark::State &state, bool deterministic)
+{
+    ParallelGraph graph(40, 20, false, deterministic);
+    runGraph(state, &graph);
+}
+
+}
+
+void registerGraphBenchmarks(const std::vector<std::vector<int64_t>> &shapes)
+{
+    std::vector<benchmark::internal::Benchmark *> benchmarks {
+        benchmark::RegisterBenchmark("BM_Sequential", BM_Sequential),
+        benchmark::RegisterBenchmark("BM_LimitSequenceGraph", BM_LimitSequenceGraph),
+        benchmark::RegisterBenchmark("BM_ParallelGraph", BM_ParallelGraph, false),
+        benchmark::RegisterBenchmark("BM_ParallelGraph/deterministic", BM_ParallelGraph, true),
+    };
+
+    for (auto *b : benchmarks) {
+        b->ArgNames({"N", "M", "maxMaf"})->Unit(benchmark::kMillisecond)->UseRealTime();
+        for (const auto &shape : shapes)
+            b->Args(shape);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef GRAPHBENCHMARKS_H
+#define GRAPHBENCHMARKS_H
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+// Registers one exec of each AnalysisGraph for every {N, M, maximum MAF in
+// percent} shape of synthetic genotypes
+void registerGraphBenchmarks(const std::vector<std::vector<int64_t>> &shapes);
+
+#endif // GRAPHBENCHMARKS_H
@@ -0,0 +1,202 @@
+#include <benchmark/benchmark.h>
+
+#include "BayesW_arms.h"
+#include "densebayesrkernel.h"
+#include "densebayeswkernel.h"
+#include "eigenbayesrkernel.h"
+#include "raggedbayesrkernel.h"
+#include "syntheticdata.h"
+
+#include <cmath>
+#include <type_traits>
+
+namespace {
+
+constexpr double EuMasc = 0.577215664901532;
+
+// Arguments: number of individuals, maximum MAF in percent
+void kernelArguments(benchmark::internal::Benchmark *b)
+{
+    for (int n : {10000, 100000})
+        for (int maf : {5, 50})
+            b->Args({n, maf});
+}
+
+SyntheticGenotypes genotypesFor(const benchmark::State &state)
+{
+    return SyntheticGenotypes(static_cast<unsigned int>(state.range(0)), 1,
+                              0.01, static_cast<double>(state.range(1)) / 100.0);
+}
+
+// The marker and kernel of each preprocessed format
+struct DenseFormat {
+    using Kernel = DenseRKernel;
+    using Marker = DenseMarker;
+    static constexpr auto type = PreprocessDataType::Dense;
+};
+
+struct RaggedFormat {
+    using Kernel = RaggedBayesRKernel;
+    using Marker = RaggedSparseMarker;
+    static constexpr auto type = PreprocessDataType::SparseRagged;
+};
+
+struct EigenFormat {
+    using Kernel = EigenBayesRKernel;
+    using Marker = EigenSparseMarker;
+    static constexpr auto type = PreprocessDataType::SparseEigen;
+};
+
+template<typename Format>
+void BM_ComputeNum(benchmark::State &state)
+{
+    using Kernel = typename Format::Kernel;
+
+    const auto genotypes = genotypesFor(state);
+    const auto epsilon = syntheticResiduals(genotypes.numInds());
+    const VectorXd ones = VectorXd::Ones(genotypes.numInds());
+
+    Kernel kernel(buildMarker<typename Format::Marker>(genotypes, Format::type, 0));
+    if constexpr (std::is_same_v<Kernel, EigenBayesRKernel>)
+        kernel.ones = &ones;
+    if constexpr (std::is_base_of_v<SparseBayesRKernel, Kernel>)
+        kernel.epsilonSum = epsilon.sum();
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(kernel.computeNum(epsilon, 0.01));
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_ComputeNum, DenseFormat)->Apply(kernelArguments);
+BENCHMARK_TEMPLATE(BM_ComputeNum, RaggedFormat)->Apply(kernelArguments);
+BENCHMARK_TEMPLATE(BM_ComputeNum, EigenFormat)->Apply(kernelArguments);
+
+template<typename Format>
+void BM_CalculateEpsilonChange(benchmark::State &state)
+{
+    using Kernel = typename Format::Kernel;
+
+    const auto genotypes = genotypesFor(state);
+    const VectorXd ones = VectorXd::Ones(genotypes.numInds());
+
+    Kernel kernel(buildMarker<typename Format::Marker>(genotypes, Format::type, 0));
+    if constexpr (std::is_same_v<Kernel, EigenBayesRKernel>)
+        kernel.ones = &ones;
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(kernel.calculateEpsilonChange(0.01, 0.02));
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_CalculateEpsilonChange, DenseFormat)->Apply(kernelArguments);
+BENCHMARK_TEMPLATE(BM_CalculateEpsilonChange, RaggedFormat)->Apply(kernelArguments);
+BENCHMARK_TEMPLATE(BM_CalculateEpsilonChange, EigenFormat)->Apply(kernelArguments);
+
+// BayesW state for one dense marker, as BayesWBase sets it up
+struct DenseBayesWFixture {
+    explicit DenseBayesWFixture(const benchmark::State &state)
+        : genotypes(genotypesFor(state))
+        , epsilon(std::make_shared<VectorXd>(syntheticResiduals(genotypes.numInds())))
+        , marker(buildMarker<DenseMarker>(genotypes, PreprocessDataType::Dense, 0))
+        , kernel(marker)
+    {
+        kernel.setVi(std::make_shared<VectorXd>((alpha * epsilon->array() - EuMasc).exp()));
+        kernel.calculateSumFailure(VectorXd::Ones(genotypes.numInds()));
+    }
+
+    const double alpha = 1.0;
+    const double sigmaB = 1e-4;
+
+    SyntheticGenotypes genotypes;
+    std::shared_ptr<const VectorXd> epsilon;
+    std::shared_ptr<const DenseMarker> marker;
+    DenseBayesWKernel kernel;
+};
+
+void BM_BayesWIntegrand(benchmark::State &state)
+{
+    DenseBayesWFixture fixture(state);
+    const double sqrt2CkSigmaB = std::sqrt(2 * 0.001 * fixture.sigmaB);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(fixture.kernel.integrand_adaptive(0.5, fixture.alpha, sqrt2CkSigmaB));
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BayesWIntegrand)->Apply(kernelArguments);
+
+// All the nodes of a 7 point rule for three mixture classes in one pass
+void BM_BayesWIntegrandBatched(benchmark::State &state)
+{
+    DenseBayesWFixture fixture(state);
+
+    const Index nodes = 3 * 2 * 7;
+    const VectorXd s = VectorXd::LinSpaced(nodes, -2.0, 2.0);
+    VectorXd sqrt2CkSigmaB(nodes);
+    for (Index i = 0; i < nodes; ++i)
+        sqrt2CkSigmaB[i] = std::sqrt(2 * std::pow(10.0, -3.0 + static_cast<double>(i / 14)) * fixture.sigmaB);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(fixture.kernel.integrand_adaptive(s, fixture.alpha, sqrt2CkSigmaB));
+
+    state.SetItemsProcessed(state.iterations() * state.range(0) * nodes);
+}
+BENCHMARK(BM_BayesWIntegrandBatched)->Apply(kernelArguments);
+
+struct BetaDensityParams {
+    double alpha = 0;
+    double sigmaB = 0;
+    double sumFailure = 0;
+    double usedMixture = 0;
+    const VectorXd *epsilon = nullptr;
+    const Map<VectorXd> *cx = nullptr;
+};
+
+// The log density DenseBayesW samples beta from
+double betaDensity(double x, void *data)
+{
+    const auto *p = static_cast<const BetaDensityParams *>(data);
+    return -p->alpha * x * p->sumFailure
+            - (((*p->epsilon - *p->cx * x) * p->alpha).array() - EuMasc).exp().sum()
+            - x * x / (2 * p->usedMixture * p->sigmaB);
+}
+
+void BM_BayesWArs(benchmark::State &state)
+{
+    DenseBayesWFixture fixture(state);
+
+    BetaDensityParams params;
+    params.alpha = fixture.alpha;
+    params.sigmaB = fixture.sigmaB;
+    params.sumFailure = fixture.kernel.sum_failure;
+    params.usedMixture = 0.001;
+    params.epsilon = fixture.epsilon.get();
+    params.cx = fixture.marker->Cx.get();
+
+    const double safeLimit = 2 * std::sqrt(params.sigmaB * params.usedMixture);
+
+    for (auto _ : state) {
+        // The ARS parameters used by BayesWBase::processColumn
+        int ninit = 4, npoint = 100, nsamp = 1, ncent = 4;
+        int neval = 0;
+        double xsamp[1], xcent[10], qcent[10] = {5., 30., 70., 95.};
+        double convex = 1.0;
+        double xprev = 0.0;
+        double xl = -safeLimit;
+        double xr = safeLimit;
+        double xinit[4] = {-safeLimit / 2, -safeLimit / 6, safeLimit / 6, safeLimit / 2};
+
+        const int err = arms(xinit, ninit, &xl, &xr, betaDensity, &params, &convex,
+                             npoint, 0, &xprev, xsamp, nsamp, qcent, xcent, ncent, &neval);
+        if (err != 0) {
+            state.SkipWithError("arms failed");
+            break;
+        }
+        benchmark::DoNotOptimize(xsamp[0]);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BayesWArs)->Apply(kernelArguments);
+
+}
@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+
+#include "graphbenchmarks.h"
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// Runs the benchmarks. Besides the usual --benchmark_* flags, each
+// --graph_shape=N,M,MAF replaces the default shapes of the synthetic data
+// given to the graph benchmarks; MAF is the largest minor allele frequency
+// in percent. Use --benchmark_out=<file> --benchmark_out_format=json to keep
+// the results.
+int main(int argc, char **argv)
+{
+    std::vector<std::vector<int64_t>> shapes;
+
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        const char *flag = "--graph_shape=";
+        if (strncmp(argv[i], flag, strlen(flag)) != 0) {
+            argv[kept++] = argv[i];
+            continue;
+        }
+
+        std::vector<int64_t> shape;
+        std::istringstream values(argv[i] + strlen(flag));
+        std::string value;
+        while (std::getline(values, value, ','))
+            shape.push_back(std::stoll(value));
+
+        if (shape.size() != 3) {
+            std::cerr << "--graph_shape expects N,M,MAF, e.g. --graph_shape=10000,2000,50" << std::endl;
+            return 1;
+        }
+        shapes.push_back(shape);
+    }
+    argc = kept;
+
+    if (shapes.empty())
+        shapes = {{2000, 1000, 50}, {10000, 1000, 5}, {10000, 1000, 50}};
+
+    registerGraphBenchmarks(shapes);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <benchmark/benchmark.h>
+
+#include "compression.h"
+#include "syntheticdata.h"
+
+#include <vector>
+
+namespace {
+
+// Arguments: number of individuals, maximum MAF in percent
+void markerArguments(benchmark::internal::Benchmark *b)
+{
+    for (int n : {10000, 100000})
+        for (int maf : {5, 50})
+            b->Args({n, maf});
+}
+
+SyntheticGenotypes genotypesFor(const benchmark::State &state)
+{
+    return SyntheticGenotypes(static_cast<unsigned int>(state.range(0)), 1,
+                              0.01, static_cast<double>(state.range(1)) / 100.0);
+}
+
+// Decoding a BED column into a marker, as PreprocessGraph does
+void BM_BuildMarker(benchmark::State &state, PreprocessDataType type)
+{
+    const auto genotypes = genotypesFor(state);
+    const auto column = genotypes.column(0);
+
+    std::unique_ptr<MarkerBuilder> builder {builderForType(type)};
+    for (auto _ : state) {
+        builder->initialise(0, genotypes.numInds());
+        builder->processColumn(column);
+        builder->endColumn();
+        benchmark::DoNotOptimize(builder->build());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_BuildMarker, Dense, PreprocessDataType::Dense)->Apply(markerArguments);
+BENCHMARK_CAPTURE(BM_BuildMarker, SparseEigen, PreprocessDataType::SparseEigen)->Apply(markerArguments);
+BENCHMARK_CAPTURE(BM_BuildMarker, SparseRagged, PreprocessDataType::SparseRagged)->Apply(markerArguments);
+BENCHMARK_CAPTURE(BM_BuildMarker, Packed, PreprocessDataType::Packed)->Apply(markerArguments);
+
+// Rebuilding a marker from its compressed form, as the analysis graphs do
+void BM_DecompressMarker(benchmark::State &state, PreprocessDataType type)
+{
+    const auto genotypes = genotypesFor(state);
+    const auto compressed = genotypes.buildMarker(type, 0)->compress();
+
+    std::unique_ptr<MarkerBuilder> builder {builderForType(type)};
+    for (auto _ : state) {
+        builder->initialise(0, genotypes.numInds());
+        builder->decompress(compressed.buffer.get(), compressed.index);
+        benchmark::DoNotOptimize(builder->build());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["compressed_bytes"] = static_cast<double>(compressed.index.compressedSize);
+}
+BENCHMARK_CAPTURE(BM_DecompressMarker, Dense, PreprocessDataType::Dense)->Apply(markerArguments);
+BENCHMARK_CAPTURE(BM_DecompressMarker, SparseEigen, PreprocessDataType::SparseEigen)->Apply(markerArguments);
+BENCHMARK_CAPTURE(BM_DecompressMarker, SparseRagged, PreprocessDataType::SparseRagged)->Apply(markerArguments);
+BENCHMARK_CAPTURE(BM_DecompressMarker, Packed, PreprocessDataType::Packed)->Apply(markerArguments);
+
+void BM_ExtractData(benchmark::State &state)
+{
+    const auto genotypes = genotypesFor(state);
+    const auto compressed = genotypes.buildMarker(PreprocessDataType::Dense, 0)->compress();
+
+    std::vector<unsigned char> output(compressed.index.originalSize);
+    for (auto _ : state) {
+        extractData(compressed.buffer.get(),
+                    static_cast<unsigned int>(compressed.index.compressedSize),
+                    output.data(),
+                    static_cast<unsigned int>(output.size()));
+        benchmark::DoNotOptimize(output.data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(output.size()));
+}
+BENCHMARK(BM_ExtractData)->Apply(markerArguments);
+
+}
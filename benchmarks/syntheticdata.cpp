@@ -0,0 +1,60 @@
+#include "syntheticdata.h"
+
+#include <numeric>
+#include <random>
+
+SyntheticGenotypes::SyntheticGenotypes(unsigned int numInds,
+                                       unsigned int numSnps,
+                                       double minMaf,
+                                       double maxMaf,
+                                       double missingRate,
+                                       unsigned int seed)
+    : m_numInds(numInds)
+    , m_numSnps(numSnps)
+    , m_codes(static_cast<size_t>(numInds) * numSnps)
+    , m_individuals(numInds)
+{
+    std::iota(m_individuals.begin(), m_individuals.end(), 0);
+
+    std::mt19937_64 engine(seed);
+    std::uniform_real_distribution<double> mafDistribution(minMaf, maxMaf);
+    std::bernoulli_distribution missing(missingRate);
+
+    for (unsigned int snp = 0; snp < numSnps; ++snp) {
+        // Hardy-Weinberg genotypes for this SNP's allele frequency
+        std::binomial_distribution<int> alleleCount(2, mafDistribution(engine));
+
+        auto *codes = &m_codes[static_cast<size_t>(snp) * numInds];
+        for (unsigned int i = 0; i < numInds; ++i) {
+            codes[i] = missing(engine) ? MarkerBuilder::kMissingGenotype
+                                       : static_cast<unsigned char>(alleleCount(engine));
+        }
+    }
+}
+
+GenotypeColumn SyntheticGenotypes::column(unsigned int snp) const
+{
+    return {&m_codes[static_cast<size_t>(snp) * m_numInds], m_individuals.data(), m_numInds};
+}
+
+std::unique_ptr<Marker> SyntheticGenotypes::buildMarker(PreprocessDataType type, unsigned int snp) const
+{
+    std::unique_ptr<MarkerBuilder> builder {builderForType(type)};
+    builder->initialise(snp, m_numInds);
+    builder->processColumn(column(snp));
+    builder->endColumn();
+    return builder->build();
+}
+
+Eigen::VectorXd syntheticResiduals(unsigned int numInds, unsigned int seed)
+{
+    std::mt19937_64 engine(seed);
+    std::normal_distribution<double> normal;
+
+    Eigen::VectorXd epsilon(numInds);
+    for (unsigned int i = 0; i < numInds; ++i)
+        epsilon[i] = normal(engine);
+
+    epsilon.array() -= epsilon.mean();
+    return epsilon;
+}
@@ -0,0 +1,51 @@
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include "common.h"
+#include "marker.h"
+#include "markerbuilder.h"
+
+#include <memory>
+#include <vector>
+
+// A random genotype matrix for the benchmarks. Each SNP has its own minor
+// allele frequency, drawn uniformly from [minMaf, maxMaf], so the density
+// of the sparse formats can be varied through the MAF spectrum.
+class SyntheticGenotypes
+{
+public:
+    SyntheticGenotypes(unsigned int numInds,
+                       unsigned int numSnps,
+                       double minMaf,
+                       double maxMaf,
+                       double missingRate = 0.01,
+                       unsigned int seed = 1);
+
+    unsigned int numInds() const { return m_numInds; }
+    unsigned int numSnps() const { return m_numSnps; }
+
+    GenotypeColumn column(unsigned int snp) const;
+
+    std::unique_ptr<Marker> buildMarker(PreprocessDataType type, unsigned int snp) const;
+
+private:
+    unsigned int m_numInds = 0;
+    unsigned int m_numSnps = 0;
+    std::vector<unsigned char> m_codes; // SNP major
+    std::vector<unsigned int> m_individuals;
+};
+
+// Builds the marker and casts it to the type the kernels take
+template<typename T>
+std::shared_ptr<const T> buildMarker(const SyntheticGenotypes &genotypes,
+                                     PreprocessDataType type,
+                                     unsigned int snp)
+{
+    std::shared_ptr<const Marker> marker = genotypes.buildMarker(type, snp);
+    return std::dynamic_pointer_cast<const T>(marker);
+}
+
+// Centred residuals of unit variance, as the samplers keep them
+Eigen::VectorXd syntheticResiduals(unsigned int numInds, unsigned int seed = 2);
+
+#endif // SYNTHETICDATA_H
@@ -8,11 +8,21 @@
 #include "BayesRBase.hpp"
 #include "bayesrkernel.h"
 #include "samplewriter.h"
+#include "asyncwriter.h"
+#include "posteriorsummary.h"
+#include "checkpoint.h"
 #include "analysisgraph.hpp"
 #include "marker.h"
 #include "logwriter.h"
+#include "tracer.h"
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_reduce.h"
 
 #include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <limits>
 #include <mutex>
 
 BayesRBase::BayesRBase(const Data *data, const Options *opt)
@@ -23,6 +33,7 @@ BayesRBase::BayesRBase(const Data *data, const Options *opt)
     , m_maxIterations(opt->chainLength)
     , m_burnIn(opt->burnin)
     , m_thinning(opt->thin)
+    , m_residualResyncInterval(opt->residualResyncInterval)
     , m_cva(opt->S)
     , m_dist(opt->seed)
     , m_showDebug(opt->iterLog)
@@ -32,6 +43,7 @@ BayesRBase::BayesRBase(const Data *data, const Options *opt)
     , m_s02E(opt->s02E)
     , m_v0G(opt->v0G)
     , m_s02G(opt->s02G)
+    , m_rng(opt->seed)
 {
     assert(m_data);
 }
@@ -48,6 +60,8 @@ void BayesRBase::init(int K, unsigned int markerCount, unsigned int individualCo
     }
 
     m_pi = m_priorPi;                       // mixture probabilities
+    m_piAlpha = VectorXd(K);                // Dirichlet parameters of a row of m_pi
+    m_piDraw = VectorXd(K);                 // sampled row of m_pi
     m_cVa = VectorXd(K);                    // component-specific variance
     m_muk = VectorXd (K);                   // mean of k-th component marker effect size
     m_denom = VectorXd(K - 1);              // temporal variable for computing the inflation of the effect variance for a given non-zero componnet
@@ -58,9 +72,7 @@ void BayesRBase::init(int K, unsigned int markerCount, unsigned int individualCo
     // Mean and residual variables
     m_mu = 0.0;       // mean or intercept
     m_sigmaG.resize(groupCount);
-    std::generate(m_sigmaG.begin(), m_sigmaG.end(), [&dist = m_dist]() {
-        return dist.unif_rng();
-    });
+    m_dist.fill_uniform(m_sigmaG);
 
     m_sigmaE = 0.0;   // residuals variance
 
@@ -89,8 +101,6 @@ void BayesRBase::init(int K, unsigned int markerCount, unsigned int individualCo
     m_sigmaE = m_epsilon.squaredNorm() / individualCount * 0.5;
     m_epsilonSum=m_epsilon.sum();
 
-    m_randomNumbers.resize(markerCount);
-
     if(m_colLog)
     {
         m_colWriter.setFileName(m_colLogFile);
@@ -98,15 +108,11 @@ void BayesRBase::init(int K, unsigned int markerCount, unsigned int individualCo
     }
 }
 
-void BayesRBase::prepareForAnylsis()
+void BayesRBase::prepareForAnylsis(unsigned int iteration)
 {
-    // Generate the random numbers required for this iteration. The random
-    // number engine is not thread safe, so generate them up front to avoid
-    // having to use a mutex.
-    std::generate(m_randomNumbers.begin(), m_randomNumbers.end(), [&dist = m_dist]()
-                  -> std::array<double, RandomNumberColumns> {
-        return {dist.unif_rng(), dist.norm_rng(0, 1)};
-    });
+    // Kernels draw their random numbers from m_rng on demand, keyed by the
+    // iteration and marker, so nothing needs to be generated up front.
+    m_iteration = iteration;
 }
 
 void BayesRBase::prepare(BayesRKernel *kernel)
@@ -143,47 +149,86 @@ int BayesRBase::runGibbs(AnalysisGraph *analysis)
     const unsigned int nF(m_opt->fixedEffectNumber);
 
     init(K, M, N);
+    if (m_residualResyncInterval > 0)
+        openIndividualMajor();
+
+    // Sampler variables
+    VectorXd sample(3*M+3+nGroups+nF+N); // varible containg a sambple of all variables in the model, M marker effects, M component assigned to markers, M acum values, sigmaE, sigmaG, mu, iteration number and Explained variance
+    std::vector<unsigned int> markerI(M);
+    std::iota(markerI.begin(), markerI.end(), 0);
+
+    //fixed effects vector & iterator
+    m_gamma = VectorXd(nF);
+    m_gamma.setZero();
+    std::vector<unsigned int> xI(nF);
+    std::iota(xI.begin(), xI.end(), 0);
+
+    m_components = VectorXd::Zero(M);
+
+    // Summaries use every iteration after burn in, not just the thinned samples
+    std::unique_ptr<PosteriorSummary> summary;
+    VectorXd summaryParameters(2 + nGroups);
+    if (!m_opt->summaryFile.empty()) {
+        std::vector<std::string> names = {"mu", "sigmaE"};
+        for (unsigned int i = 0; i < nGroups; ++i)
+            names.push_back("sigmaG[" + std::to_string(i + 1) + "]");
+        summary = std::make_unique<PosteriorSummary>(names, M);
+    }
+
+    // Continue from the last checkpoint
+    ChainCheckpoint checkpoints(m_opt,
+                                [this, &xI](Checkpoint &checkpoint) {
+        checkpoint.set("xI", xI);
+        saveState(checkpoint);
+    },
+                                [this, &xI, nF](const Checkpoint &checkpoint) {
+        return checkpoint.get("xI", xI) && xI.size() == nF && restoreState(checkpoint);
+    });
+    checkpoints.addOutputFile(m_outputFile);
+    if (m_showDebug)
+        checkpoints.addOutputFile(m_iterLogFile);
+
+    unsigned int startIteration = 0;
+    if (!checkpoints.resume(startIteration, markerI, summary.get()))
+        return 1;
 
     SampleWriter writer;
     writer.setFileName(m_outputFile);
     writer.setMarkerCount(M);
     writer.setIndividualCount(N);
     writer.setFixedCount(nF);
+    writer.setFormat(m_opt->sampleFormat);
+    writer.setCompressed(m_opt->sampleCompress);
+    writer.setFields(m_opt->outputFields);
+    writer.setSparse(m_opt->sparseSamples);
+    writer.setAppend(m_opt->resume);
     writer.openGroups(nGroups);
+    AsyncWriter sampleWriter(&writer, m_opt->sampleQueueSize);
 
     LogWriter iterLogger;
-    VectorXd  iterLog(10);
+    VectorXd  iterLog(11);
 
     if(m_showDebug)
     {
 
       iterLogger.setFileName(m_iterLogFile);
+      iterLogger.setAppend(m_opt->resume);
       iterLogger.open();
     }
 
-    // Sampler variables
-    VectorXd sample(3*M+3+nGroups+nF+N); // varible containg a sambple of all variables in the model, M marker effects, M component assigned to markers, M acum values, sigmaE, sigmaG, mu, iteration number and Explained variance
-    std::vector<unsigned int> markerI(M);
-    std::iota(markerI.begin(), markerI.end(), 0);
-
-    //fixed effects vector & iterator
-    m_gamma = VectorXd(nF);
-    m_gamma.setZero();
-    std::vector<unsigned int> xI(nF);
-    std::iota(xI.begin(), xI.end(), 0);
-    
     std::cout << "Number of groups: " << nGroups << std::endl
               << "Running Gibbs sampling" << endl;
 
     const auto t1 = std::chrono::high_resolution_clock::now();
 
-    // This for MUST NOT BE PARALLELIZED, IT IS THE MARKOV CHAIN
-    m_components = VectorXd::Zero(M);
-
     long meanIterationTime = 0;
     long meanFlowGraphIterationTime = 0;
 
-    for (unsigned int iteration = 0; iteration < m_maxIterations; iteration++) {
+    // This for MUST NOT BE PARALLELIZED, IT IS THE MARKOV CHAIN
+    for (unsigned int iteration = startIteration; iteration < m_maxIterations; iteration++) {
+        tracer().setIteration(iteration);
+        TraceSpan iterationSpan("iteration");
+
         // Output progress
         const auto startTime = std::chrono::high_resolution_clock::now();
         //if (iteration > 0 && iteration % unsigned(std::ceil(max_iterations / 10)) == 0)
@@ -191,11 +236,14 @@ int BayesRBase::runGibbs(AnalysisGraph *analysis)
         double old_mu=m_mu;
 
     // we delegate the Mu update to the descendents
-        updateMu(old_mu,(double)N);
+        {
+            TraceSpan span("updateMu");
+            updateMu(old_mu,(double)N);
+        }
         const auto muTime = std::chrono::high_resolution_clock::now();
-        prepareForAnylsis();
+        prepareForAnylsis(iteration);
 
-        std::random_shuffle(markerI.begin(), markerI.end());
+        m_dist.shuffle(markerI);
 
         m_m0 = 0;
         m_v = MatrixXd::Zero(nGroups, K);
@@ -206,14 +254,17 @@ int BayesRBase::runGibbs(AnalysisGraph *analysis)
         // in turn. HOwever, within each column we make use of Intel TBB's parallel_for to parallelise the operations on the large vectors
         // of data.
         const auto flowGraphStartTime = std::chrono::high_resolution_clock::now();
-        analysis->exec(this, N, M, markerI);
+        {
+            TraceSpan span("flowGraph");
+            analysis->exec(this, N, M, markerI);
+        }
         const auto flowGraphEndTime = std::chrono::high_resolution_clock::now();
 	
         // Fixed effects estimation
         // ---------------------
         double dNm1 = (double)(N - 1);
         if (nF>0) {
-                std::random_shuffle(xI.begin(), xI.end());
+                m_dist.shuffle(xI);
                 double gamma_old, num_f, denom_f;
                 double sigE_sigF = m_sigmaE / m_sigmaF;
 
@@ -234,22 +285,39 @@ int BayesRBase::runGibbs(AnalysisGraph *analysis)
                 m_sigmaF = s02F;
         }	
 
+        // Periodically discard the rounding error accumulated by the incremental updates
+        double epsilonDrift = std::numeric_limits<double>::quiet_NaN();
+        if (m_residualResyncInterval > 0 && (iteration + 1) % m_residualResyncInterval == 0)
+            epsilonDrift = resyncResiduals();
+
     const auto sEstartTime = std::chrono::high_resolution_clock::now();
+        TraceSpan sigmaESpan("sampleSigmaE");
         const double epsilonSqNorm = m_epsilon.squaredNorm();
         m_sigmaE = m_dist.inv_scaled_chisq_rng(m_v0E + N, (epsilonSqNorm + m_v0E * m_s02E) / (m_v0E + N));
+        sigmaESpan.end();
     const auto sEendTime = std::chrono::high_resolution_clock::now();
 
         const auto sGstartTime = std::chrono::high_resolution_clock::now();
+        TraceSpan sigmaGSpan("sampleSigmaG");
         for (int i = 0; i < nGroups; i++) {
             m_m0 = m_v.row(i).sum() - m_v.row(i)(0);
             m_sigmaG[i] = m_dist.inv_scaled_chisq_rng(m_v0G + m_m0, (m_betasqnG(i) * m_m0 + m_v0G * m_s02G) / (m_v0G + m_m0));
-            m_pi.row(i) = m_dist.dirichlet_rng(m_v.row(i).array() + 1.0);
+            m_piAlpha = m_v.row(i).transpose().array() + 1.0;
+            m_dist.dirichlet_rng(m_piAlpha, m_piDraw);
+            m_pi.row(i) = m_piDraw.transpose();
         }
+        sigmaGSpan.end();
         const auto sGendTime = std::chrono::high_resolution_clock::now();
 
     if (iteration >= m_burnIn && iteration % m_thinning == 0) {
+            TraceSpan span("sampleWrite");
             sample << iteration, m_mu, m_beta, m_sigmaE, m_sigmaG, m_gamma, m_components, m_acum, m_epsilon;
-            writer.write(sample);
+            sampleWriter.write(sample);
+        }
+
+        if (summary && iteration >= m_burnIn) {
+            summaryParameters << m_mu, m_sigmaE, m_sigmaG;
+            summary->update(m_beta, summaryParameters);
         }
 
         const auto endTime = std::chrono::high_resolution_clock::now();
@@ -268,11 +336,23 @@ int BayesRBase::runGibbs(AnalysisGraph *analysis)
         ,static_cast<double>(sigmaGDuration)
         ,static_cast<double>(sigmaEDuration)
         ,static_cast<double>(flowGraphDuration)
-        ,static_cast<double>(iterationDuration);
+        ,static_cast<double>(iterationDuration)
+        ,epsilonDrift;
       iterLogger.write(iterLog);
     }
+
+        // After the iteration log, so that its line for this iteration is kept on resume
+        if (checkpoints.isDue(iteration)) {
+            sampleWriter.flush();
+            checkpoints.save(iteration, markerI, summary.get());
+        }
     }
 
+    sampleWriter.close();
+    checkpoints.wait();
+    if (summary)
+        summary->write(m_opt->summaryFile);
+
     const auto t2 = std::chrono::high_resolution_clock::now();
     const auto duration = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
     std::cout << "duration: " << duration << "s" << std::endl;
@@ -284,6 +364,79 @@ int BayesRBase::runGibbs(AnalysisGraph *analysis)
     return 0;
 }
 
+void BayesRBase::openIndividualMajor()
+{
+    m_individualMajor.close();
+
+    // The shards of a data set each have their own file
+    if (!m_opt->datasetFile.empty() || m_data->bimIndices.size() != m_data->numSnps)
+        return;
+
+    const auto file = individualMajorFile(preprocessedFile());
+    if (!std::filesystem::exists(file) || !m_individualMajor.open(file))
+        return;
+
+    const auto &layout = m_individualMajor.layout();
+    if (layout.numInds != m_data->numInds ||
+            (!m_data->bimIndices.empty() && m_data->bimIndices.back() >= layout.numSnps)) {
+        std::cerr << "Ignoring the individual-major file " << file
+                  << " as it does not match the data" << std::endl;
+        m_individualMajor.close();
+        return;
+    }
+
+    std::cout << "Residual resyncs use the individual-major file " << file << std::endl;
+}
+
+VectorXd BayesRBase::geneticValues()
+{
+    // Each block of individuals is read once instead of every active marker
+    if (m_individualMajor.isOpen())
+        return m_individualMajor.multiply(m_beta, m_data->bimIndices);
+
+    const auto N = m_data->numInds;
+
+    std::vector<unsigned int> active;
+    for (Index i = 0; i < m_beta.size(); ++i) {
+        if (m_beta(i) != 0)
+            active.push_back(static_cast<unsigned int>(i));
+    }
+
+    // Each marker's contribution is its epsilon change when beta drops to zero.
+    // The deterministic reduce keeps the result reproducible.
+    return tbb::parallel_deterministic_reduce(
+                tbb::blocked_range<size_t>(0, active.size(), 16),
+                VectorXd(VectorXd::Zero(N)),
+                [&](const tbb::blocked_range<size_t> &r, VectorXd partial) -> VectorXd {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const auto marker = active[i];
+            auto kernel = kernelForMarker(loadMarker(marker));
+            auto *bayesKernel = dynamic_cast<BayesRKernel*>(kernel.get());
+            assert(bayesKernel);
+            prepare(bayesKernel);
+            partial += *bayesKernel->calculateEpsilonChange(m_beta(marker), 0);
+        }
+        return partial;
+    },
+    [](VectorXd a, const VectorXd &b) -> VectorXd {
+        a += b;
+        return a;
+    });
+}
+
+double BayesRBase::resyncResiduals()
+{
+    VectorXd exact = m_y - geneticValues();
+    exact.array() -= m_mu;
+    if (m_gamma.size() > 0)
+        exact -= m_data->X.cast<double>() * m_gamma;
+
+    const double drift = (m_epsilon - exact).norm();
+    m_epsilon = std::move(exact);
+    m_epsilonSum = m_epsilon.sum();
+    return drift;
+}
+
 void BayesRBase::processColumn(const KernelPtr &kernel)
 {
     auto * bayesKernel = dynamic_cast<BayesRKernel*>(kernel.get());
@@ -316,11 +469,15 @@ void BayesRBase::processColumn(const KernelPtr &kernel)
     const double sigmaEOverSigmaG = m_sigmaE / sigmaG;
     m_denom = NM1 + sigmaEOverSigmaG * m_cVaI.segment(1, km1).array();
 
+    const int marker = static_cast<int>(bayesKernel->marker->i);
     const auto num_begin = std::chrono::high_resolution_clock::now();
+    TraceSpan numSpan("computeNum", marker);
     const double num = bayesKernel->computeNum(m_epsilon, beta_old);
+    numSpan.end();
     const auto num_end = std::chrono::high_resolution_clock::now();
     //The rest of the algorithm remains the same
      const auto beta_begin = std::chrono::high_resolution_clock::now();
+    TraceSpan betaSpan("sampleBeta", marker);
     // muk for the other components is computed according to equaitons
     m_muk.segment(1, km1) = num / m_denom.array();
 
@@ -340,8 +497,9 @@ void BayesRBase::processColumn(const KernelPtr &kernel)
 
     m_acum(bayesKernel->marker->i) = acum;
     
-    const double p = m_randomNumbers.at(kernel->marker->i).at(PIndex);
-    const double randomNorm = m_randomNumbers.at(kernel->marker->i).at(RandomNormIndex);
+    auto random = m_rng.stream(m_iteration, kernel->marker->i);
+    const double p = random.unif();
+    const double randomNorm = random.norm();
 
     for (int k = 0; k < K; k++) {
         if (p <= acum) {
@@ -364,6 +522,7 @@ void BayesRBase::processColumn(const KernelPtr &kernel)
             }
         }
     }
+    betaSpan.end();
     const auto beta_end = std::chrono::high_resolution_clock::now();
     const double beta_new = m_beta(bayesKernel->marker->i);
 
@@ -373,6 +532,7 @@ void BayesRBase::processColumn(const KernelPtr &kernel)
 
     const auto eps_begin = std::chrono::high_resolution_clock::now();
     if (!skipUpdate) {
+        TraceSpan span("updateEpsilon", marker);
         m_epsilon += *bayesKernel->calculateEpsilonChange(beta_old, beta_new);
         writeWithUniqueLock(bayesKernel);
     }
@@ -412,11 +572,15 @@ std::unique_ptr<AsyncResult> BayesRBase::processColumnAsync(const KernelPtr &ker
     double num = 0;
     {
         // Use a shared lock to allow multiple threads to read updates
-        std::shared_lock lock(m_mutex);
+        std::shared_lock lock(m_mutex, std::defer_lock);
+        lockTimed(lock, m_graphStats, m_sharedLockStat);
         readWithSharedLock(bayesKernel);//here we are reading the column and also epsilonsum
+        TraceSpan span("computeNum", static_cast<int>(bayesKernel->marker->i));
         num = bayesKernel->computeNum(m_epsilon, result->betaOld);
     }
 
+    TraceSpan betaSpan("sampleBeta", static_cast<int>(bayesKernel->marker->i));
+
     // We compute the denominator in the variance expression to save computations
     const double sigmaEOverSigmaG = m_sigmaE / sigmaG;
 
@@ -453,8 +617,9 @@ std::unique_ptr<AsyncResult> BayesRBase::processColumnAsync(const KernelPtr &ker
         acum = 1.0 / ((logL.array() - logL[0]).exp().sum());
     }
 
-    const double p = m_randomNumbers.at(kernel->marker->i).at(PIndex);
-    const double randomNorm = m_randomNumbers.at(kernel->marker->i).at(RandomNormIndex);
+    auto random = m_rng.stream(m_iteration, kernel->marker->i);
+    const double p = random.unif();
+    const double randomNorm = random.norm();
 
     result->v = std::make_unique<VectorXd>(VectorXd::Zero(K));
     for (int k = 0; k < K; k++) {
@@ -478,11 +643,14 @@ std::unique_ptr<AsyncResult> BayesRBase::processColumnAsync(const KernelPtr &ker
         }
     }
 
+    betaSpan.end();
+
     // Only update m_epsilon if required
     const bool skipUpdate = result->betaOld == 0.0 && result->beta == 0.0;
 
     // Update our local copy of epsilon to minimise the amount of time we need to hold the unique lock for.
     if (!skipUpdate) {
+        TraceSpan span("updateEpsilon", static_cast<int>(bayesKernel->marker->i));
           // this  also updates epsilonSum!
         result->deltaEpsilon = bayesKernel->calculateEpsilonChange(result->betaOld, result->beta);
         // now marker->epsilonSum now contains only delta_epsilonSum
@@ -517,7 +685,9 @@ void BayesRBase::updateGlobal(const KernelPtr& kernel,
     assert(kernel);
     assert(result);
 
-    std::unique_lock lock(m_mutex);
+    TraceSpan span("globalUpdate", static_cast<int>(kernel->marker->i));
+    std::unique_lock lock(m_mutex, std::defer_lock);
+    lockTimed(lock, m_graphStats, m_exclusiveLockStat);
     m_epsilon += *result->deltaEpsilon;
     m_betasqnG[m_data->G[kernel->marker->i]] += pow(result->beta, 2);
 }
@@ -545,3 +715,52 @@ void BayesRBase::printGlobalDebugInfo()const
 }
 */
 
+
+void BayesRBase::saveState(Checkpoint &checkpoint) const
+{
+    checkpoint.set("mu", m_mu);
+    checkpoint.set("sigmaE", m_sigmaE);
+    checkpoint.set("sigmaG", m_sigmaG);
+    checkpoint.set("sigmaF", m_sigmaF);
+    checkpoint.set("pi", m_pi);
+    checkpoint.set("v", m_v);
+    checkpoint.set("m0", static_cast<double>(m_m0));
+    checkpoint.set("beta", m_beta);
+    checkpoint.set("betasqnG", m_betasqnG);
+    checkpoint.set("components", m_components);
+    checkpoint.set("acum", m_acum);
+    checkpoint.set("epsilon", m_epsilon);
+    checkpoint.set("epsilonSum", m_epsilonSum);
+    checkpoint.set("gamma", m_gamma);
+    checkpoint.set("rng", m_dist.state());
+}
+
+bool BayesRBase::restoreState(const Checkpoint &checkpoint)
+{
+    double m0 = 0;
+    std::string rng;
+    VectorXd beta, epsilon, sigmaG;
+    if (!checkpoint.get("mu", m_mu)
+            || !checkpoint.get("sigmaE", m_sigmaE)
+            || !checkpoint.get("sigmaG", sigmaG) || sigmaG.size() != m_sigmaG.size()
+            || !checkpoint.get("sigmaF", m_sigmaF)
+            || !checkpoint.get("pi", m_pi)
+            || !checkpoint.get("v", m_v)
+            || !checkpoint.get("m0", m0)
+            || !checkpoint.get("beta", beta) || beta.size() != m_beta.size()
+            || !checkpoint.get("betasqnG", m_betasqnG)
+            || !checkpoint.get("components", m_components)
+            || !checkpoint.get("acum", m_acum)
+            || !checkpoint.get("epsilon", epsilon) || epsilon.size() != m_epsilon.size()
+            || !checkpoint.get("epsilonSum", m_epsilonSum)
+            || !checkpoint.get("gamma", m_gamma)
+            || !checkpoint.get("rng", rng))
+        return false;
+
+    m_m0 = static_cast<int>(m0);
+    m_sigmaG = sigmaG;
+    m_beta = beta;
+    m_epsilon = epsilon;
+    m_dist.setState(rng);
+    return true;
+}
@@ -12,13 +12,16 @@
 #include "data.hpp"
 #include "options.hpp"
 #include "distributions_boost.hpp"
+#include "counterrng.h"
 #include "colwriter.h"
+#include "individualmajor.h"
 
 #include <Eigen/Eigen>
 #include <memory>
 #include <shared_mutex>
 
 class AnalysisGraph;
+class Checkpoint;
 
 struct BayesRKernel;
 
@@ -47,6 +50,7 @@ protected:
     const unsigned int  m_maxIterations;
     const unsigned int  m_burnIn;
     const unsigned int  m_thinning;
+    const unsigned int  m_residualResyncInterval;
     const double        m_sigma0=0.0001;
     const double        m_v0E;
     const double        m_s02E;
@@ -63,6 +67,8 @@ protected:
   // Component variables
     MatrixXd m_priorPi;   // prior probabilities for each component
     MatrixXd m_pi;        // mixture probabilities
+    VectorXd m_piAlpha;   // Dirichlet parameters of a row of m_pi
+    VectorXd m_piDraw;    // sampled row of m_pi
     VectorXd m_cVa;       // component-specific variance
     VectorXd m_muk;       // mean of k-th component marker effect size
     VectorXd m_denom;     // temporal variable for computing the inflation of the effect variance for a given non-zero componnet
@@ -90,25 +96,42 @@ protected:
     const double       s02F    = 1.0;
     double m_sigmaF;      // covariates variance if using ridge;
 
-    static const std::size_t PIndex = 0;
-    static const std::size_t RandomNormIndex = 1;
-    constexpr static const std::size_t RandomNumberColumns = 2; // p, randomNorm
-    std::vector<std::array<double, RandomNumberColumns>> m_randomNumbers;
+    // Per marker random numbers, keyed by (seed, iteration, marker)
+    CounterRng m_rng;
+    unsigned int m_iteration = 0;
 
     bool m_isAsync = false;
 
+    // Individual-major copy of the genotypes, opened for residual resyncs
+    // when preprocessing wrote one
+    IndividualMajorFile m_individualMajor;
+
     mutable std::shared_mutex m_mutex;
 
     void setAsynchronous(bool async) { m_isAsync = async; }
 
     virtual void init(int K, unsigned int markerCount, unsigned int individualCount);
 
-    virtual void prepareForAnylsis();
+    // The chain state which is not derived from the data or options
+    void saveState(Checkpoint &checkpoint) const;
+    bool restoreState(const Checkpoint &checkpoint);
+
+    virtual void prepareForAnylsis(unsigned int iteration);
 
     virtual void prepare(BayesRKernel *kernel);
     virtual void readWithSharedLock(BayesRKernel *kernel);
     virtual void writeWithUniqueLock(BayesRKernel *kernel);
 
+    void openIndividualMajor();
+
+    // X * beta over the individual-major file if open, otherwise over the
+    // current marker source, summed in parallel
+    VectorXd geneticValues();
+
+    // Replaces the incrementally updated m_epsilon with y - mu - X*beta - Xf*gamma
+    // and returns the norm of the difference
+    double resyncResiduals();
+
     void printDebugInfo() const;
 };
 
@@ -115,6 +115,10 @@ int BayesRRm::runGibbs()
     writer.setFileName(outputFile);
     writer.setMarkerCount(M);
     writer.setIndividualCount(N);
+    writer.setFormat(opt.sampleFormat);
+    writer.setCompressed(opt.sampleCompress);
+    writer.setFields(opt.outputFields);
+    writer.setSparse(opt.sparseSamples);
     writer.open();
 
     // Sampler variables
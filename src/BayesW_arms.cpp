@@ -907,10 +907,23 @@ void display(FILE *f, ENVELOPE *env)
 
 /* *********************************************************************** */
 
+static thread_local double (*arms_uniform)(void *state) = NULL;
+static thread_local void *arms_uniform_state = NULL;
+
+void arms_set_uniform(double (*uniform)(void *state), void *state)
+{
+   arms_uniform = uniform;
+   arms_uniform_state = state;
+}
+
+/* *********************************************************************** */
+
 double u_random()
 
 /* to return a standard uniform random number */
 {
+   if (arms_uniform)
+      return arms_uniform(arms_uniform_state);
    return ((double)rand() + 0.5)/((double)RAND_MAX + 1.0);
 }
 
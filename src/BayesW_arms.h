@@ -12,5 +12,9 @@ int arms (double *xinit, int ninit, double *xl, double *xr,
 
 double expshift(double y, double y0);
 
+/* Sets the source of the uniform random numbers used by arms() on the
+   calling thread. With no source, rand() is used. */
+void arms_set_uniform(double (*uniform)(void *state), void *state);
+
 #define YCEIL 50.                /* maximum y avoiding overflow in exp(y) */
 
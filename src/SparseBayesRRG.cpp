@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "eigenbayesrkernel.h"
+#include "packedbayesrkernel.h"
 #include "raggedbayesrkernel.h"
 #include "sparsemarker.h"
 
@@ -32,6 +33,13 @@ std::unique_ptr<Kernel> SparseBayesRRG::kernelForMarker(const ConstMarkerPtr &ma
         return std::make_unique<RaggedBayesRKernel>(raggedSparseMarker);
     }
 
+    case PreprocessDataType::Packed:
+    {
+        const auto packedMarker = dynamic_pointer_cast<const PackedMarker>(marker);
+        assert(packedMarker);
+        return std::make_unique<PackedBayesRKernel>(packedMarker);
+    }
+
     default:
         std::cerr << "SparseBayesRRG::kernelForMarker - unsupported type: "
                   << m_opt->preprocessDataType
@@ -47,6 +55,8 @@ MarkerBuilder *SparseBayesRRG::markerBuilder() const
     case PreprocessDataType::SparseEigen:
         // Fall through
     case PreprocessDataType::SparseRagged:
+        // Fall through
+    case PreprocessDataType::Packed:
         return builderForType(m_opt->preprocessDataType);
 
     default:
@@ -98,7 +108,8 @@ void SparseBayesRRG::updateGlobal(const KernelPtr& kernel, const ConstAsyncResul
     auto* sparseKernel = dynamic_cast<SparseBayesRKernel*>(kernel.get());
     assert(sparseKernel);
 
-    std::unique_lock lock(m_mutex);
+    std::unique_lock lock(m_mutex, std::defer_lock);
+    lockTimed(lock, m_graphStats, m_exclusiveLockStat);
     m_epsilonSum += sparseKernel->epsilonSum; // now epsilonSum contains only deltaEpsilonSum
 }
 
@@ -1,5 +1,8 @@
 #include "analysis.h"
 
+#include "markerbuilder.h"
+#include "markercache.h"
+
 
 Analysis::Analysis(const Data *data, const Options *opt)
     : m_data(data)
@@ -35,3 +38,27 @@ std::string Analysis::preprocessedFile() const
 {
     return ppFileForType(m_opt->preprocessDataType, m_opt->dataFile);
 }
+
+ConstMarkerPtr Analysis::loadMarker(unsigned int snp) const
+{
+    if (m_opt->useMarkerCache)
+        return markerCache()->marker(snp);
+
+    std::unique_ptr<MarkerBuilder> builder{markerBuilder()};
+    builder->initialise(snp, m_data->numInds);
+    const auto index = indexEntry(snp);
+    if (compressed())
+        builder->decompress(compressedData(), index);
+    else
+        builder->read(preprocessedFile(), index);
+    return builder->build();
+}
+
+void Analysis::setGraphStats(GraphStats *stats)
+{
+    m_graphStats = stats;
+    if (m_graphStats) {
+        m_sharedLockStat = m_graphStats->addWait("m_mutex shared");
+        m_exclusiveLockStat = m_graphStats->addWait("m_mutex exclusive");
+    }
+}
@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "data.hpp"
+#include "graphstats.h"
 #include "options.hpp"
 
 #include <Eigen/Eigen>
@@ -35,6 +36,9 @@ public:
     virtual unsigned char* compressedData() const;
     virtual std::string preprocessedFile() const;
 
+    // Reads marker snp from the marker cache or the preprocessed data
+    ConstMarkerPtr loadMarker(unsigned int snp) const;
+
     virtual int runGibbs(AnalysisGraph* analysis) = 0;
 
     // LimitSeqeunceGraph
@@ -46,9 +50,16 @@ public:
     virtual void updateGlobal(const KernelPtr& kernel,
                               const ConstAsyncResultPtr& result) = 0;
 
+    // Record the time spent waiting for m_mutex, set by the graph while it runs
+    void setGraphStats(GraphStats *stats);
+
 protected:
     const Data *m_data = nullptr; // data matrices
     const Options *m_opt;
+
+    GraphStats *m_graphStats = nullptr;
+    GraphStats::Id m_sharedLockStat = 0;
+    GraphStats::Id m_exclusiveLockStat = 0;
 };
 
 #endif // ANALYSIS_H
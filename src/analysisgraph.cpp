@@ -10,3 +10,10 @@ AnalysisGraph::~AnalysisGraph()
 {
 
 }
+
+void AnalysisGraph::setStats(GraphStats *stats)
+{
+    m_stats = stats;
+    if (m_stats)
+        registerStats();
+}
@@ -5,6 +5,7 @@
 #include <vector>
 
 class Analysis;
+class GraphStats;
 
 class AnalysisGraph
 {
@@ -20,9 +21,18 @@ public:
                       unsigned int numSnps,
                       const std::vector<unsigned int> &markerIndices) = 0;
 
+    // Instrument the nodes of the graph; each exec is recorded as one
+    // iteration. Pass nullptr to turn the instrumentation off.
+    void setStats(GraphStats *stats);
+    GraphStats *stats() const { return m_stats; }
+
 protected:
     Analysis *m_analysis = nullptr;
+    GraphStats *m_stats = nullptr;
     size_t m_maxParallel = 0; // Default to tbb::flow::unlimited
+
+    // Registers the metrics of the graph with m_stats
+    virtual void registerStats() {}
 };
 
 #endif // ANALYSISGRAPH_H
@@ -6,22 +6,49 @@
 #include "data.hpp"
 #include "DenseBayesRRmz.hpp"
 #include "densebayesw.h"
+#include "graphstats.h"
 #include "limitsequencegraph.hpp"
 #include "markercache.h"
+#include "markerqc.h"
 #include "options.hpp"
 #include "parallelgraph.h"
 #include "preprocessgraph.h"
 #include "SparseBayesRRG.hpp"
 #include "sequential.h"
 #include "sparsebayesw.h"
+#include "tracer.h"
+
+#include <filesystem>
 
 using namespace std;
 
+// The shards of a data set hold different SNPs for the same individuals, so
+// every FAM file must list the individuals of the first in the same order
+void readShardFamFiles(Data &data, const std::vector<std::string> &shards) {
+    const auto firstFamFile = fileWithSuffix(shards.front(), ".fam");
+    data.readFamFile(firstFamFile);
+    for (size_t i = 1; i < shards.size(); ++i) {
+        const auto famFile = fileWithSuffix(shards[i], ".fam");
+        if (!data.matchesFamFile(famFile))
+            throw ("Error: the individuals in [" + famFile + "] do not match those in [" + firstFamFile +
+                   "]. All shards of a data set must list the same individuals in the same order.");
+    }
+}
+
 void readMetaData(Data &data, const Options &options) {
     switch (options.inputType) {
     case InputType::BED:
-        data.readFamFile(fileWithSuffix(options.dataFile, ".fam"));
-        data.readBimFile(fileWithSuffix(options.dataFile, ".bim"));
+        if (options.datasetFile.empty()) {
+            data.readFamFile(fileWithSuffix(options.dataFile, ".fam"));
+            data.readBimFile(fileWithSuffix(options.dataFile, ".bim"));
+        } else {
+            const auto shards = readDatasetManifest(options.datasetFile);
+            std::vector<std::string> bimFiles;
+            for (const auto &shard : shards)
+                bimFiles.push_back(fileWithSuffix(shard, ".bim"));
+            readShardFamFiles(data, shards);
+            data.readBimFiles(bimFiles);
+        }
         data.readPhenotypeFile(options.phenotypeFile);
         break;
 
@@ -48,6 +75,22 @@ bool preprocessBed(const Options &options) {
     assert(options.analysisType == AnalysisType::Preprocess);
     assert(options.inputType == InputType::BED);
 
+    // Each shard of a data set is preprocessed into its own files
+    if (!options.datasetFile.empty()) {
+        const auto shards = readDatasetManifest(options.datasetFile);
+        Data individuals;
+        readShardFamFiles(individuals, shards);
+
+        for (const auto &shard : shards) {
+            Options shardOptions = options;
+            shardOptions.dataFile = shard;
+            shardOptions.datasetFile.clear();
+            if (!preprocessBed(shardOptions))
+                return false;
+        }
+        return true;
+    }
+
     cout << "Start preprocessing " << options.dataFile << endl
          << "Preprocessing with " << options.numThread << " threads ("
          << (options.numThreadSpawned > 0 ? std::to_string(options.numThreadSpawned) : "auto") << " spawned) and "
@@ -63,12 +106,31 @@ bool preprocessBed(const Options &options) {
     Data data;
     readMetaData(data, options);
 
+    QcThresholds thresholds;
+    thresholds.minMaf = options.qcMinMaf;
+    thresholds.maxMissingRate = options.qcMaxMissingRate;
+    thresholds.minHwePValue = options.qcMinHwePValue;
+
+    GraphStats stats("PreprocessGraph");
+
     PreprocessGraph graph(options.numThread);
-    graph.preprocessBedFile(options.dataFile,
-                            options.preprocessDataType,
-                            options.compress,
-                            &data,
-                            options.preprocessChunks);
+    graph.setQcThresholds(thresholds);
+    graph.setWriteIndividualMajor(options.preprocessIndividualMajor);
+    if (!options.graphStatsFile.empty())
+        graph.setStats(&stats);
+    const bool preprocessed = graph.preprocessBedFile(options.dataFile,
+                                                      options.preprocessDataType,
+                                                      options.compress,
+                                                      &data,
+                                                      options.preprocessChunks,
+                                                      options.preprocessResume,
+                                                      options.preprocessAppendTo);
+
+    if (!options.graphStatsFile.empty())
+        stats.write(options.graphStatsFile);
+
+    if (!preprocessed)
+        return false;
 
     clock_t end = clock();
     printf("Finished preprocessing the bed file in %.3f sec.\n\n",
@@ -88,18 +150,34 @@ bool preprocessCsv(const Options &options) {
 
     cout << "Start preprocessing " << options.dataFile << endl;
 
-    clock_t start_bed = clock();
+    clock_t start_csv = clock();
 
     Data data;
     readMetaData(data, options);
 
-    const auto ppFile = ppFileForType(options.preprocessDataType, options.dataFile);
-    const auto ppIndexFile = ppIndexFileForType(options.preprocessDataType, options.dataFile);
-    data.preprocessCSVFile(options.dataFile, ppFile, ppIndexFile, options.compress);
+    std::unique_ptr<tbb::task_scheduler_init> taskScheduler { nullptr };
+    if (options.numThreadSpawned > 0)
+        taskScheduler = std::make_unique<tbb::task_scheduler_init>(options.numThreadSpawned);
+
+    GraphStats stats("PreprocessGraph");
+
+    PreprocessGraph graph(options.numThread);
+    if (!options.graphStatsFile.empty())
+        graph.setStats(&stats);
+    const bool preprocessed = graph.preprocessCsvFile(options.dataFile,
+                                                      options.compress,
+                                                      &data,
+                                                      options.preprocessChunks);
+
+    if (!options.graphStatsFile.empty())
+        stats.write(options.graphStatsFile);
+
+    if (!preprocessed)
+        return false;
 
     clock_t end = clock();
-    printf("Finished preprocessing the bed file in %.3f sec.\n\n",
-           double(end - start_bed) / double(CLOCKS_PER_SEC));
+    printf("Finished preprocessing the csv file in %.3f sec.\n\n",
+           double(end - start_csv) / double(CLOCKS_PER_SEC));
 
     return true;
 }
@@ -129,16 +207,20 @@ switch (options->preprocessDataType) {
     case PreprocessDataType::Dense:
     {
         DenseBayesRRmz analysis(data, options);
-        analysis.runGibbs(graph);
+        if (analysis.runGibbs(graph) != 0)
+            return false;
         break;
     }
 
     case PreprocessDataType::SparseEigen:
         // Fall through
     case PreprocessDataType::SparseRagged:
+        // Fall through
+    case PreprocessDataType::Packed:
     {
         SparseBayesRRG analysis(data, options);
-        analysis.runGibbs(graph);
+        if (analysis.runGibbs(graph) != 0)
+            return false;
         break;
     }
 
@@ -164,14 +246,20 @@ bool runBayesWAnalysis(const Options *options, Data *data, AnalysisGraph *graph)
     case PreprocessDataType::Dense:
     {
         DenseBayesW analysis(data, options, sysconf(_SC_PAGE_SIZE));
-        analysis.runGibbs(graph);
+        if (analysis.runGibbs(graph) != 0)
+            return false;
         break;
     }
 
+    case PreprocessDataType::SparseEigen:
+        // Fall through
     case PreprocessDataType::SparseRagged:
+        // Fall through
+    case PreprocessDataType::Packed:
     {
         SparseBayesW analysis(data, options, sysconf(_SC_PAGE_SIZE));
-        analysis.runGibbs(graph);
+        if (analysis.runGibbs(graph) != 0)
+            return false;
         break;
     }
 
@@ -188,12 +276,53 @@ bool runBayesAnalysis(const Options &options) {
     Data data;
     readMetaData(data, options);
 
-    const auto ppFile = ppFileForType(options.preprocessDataType, options.dataFile);
-    const auto ppIndexFile = ppIndexFileForType(options.preprocessDataType, options.dataFile);
+    std::vector<std::string> ppFiles;
+    std::vector<std::string> ppIndexFiles;
+    if (options.datasetFile.empty()) {
+        ppFiles.push_back(ppFileForType(options.preprocessDataType, options.dataFile));
+        ppIndexFiles.push_back(ppIndexFileForType(options.preprocessDataType, options.dataFile));
+    } else {
+        // Uncompressed markers are read back from a single named file
+        if (!options.compress) {
+            cerr << "--dataset requires shards preprocessed with --compress" << endl;
+            return false;
+        }
+
+        for (const auto &shard : readDatasetManifest(options.datasetFile)) {
+            ppFiles.push_back(ppFileForType(options.preprocessDataType, shard));
+            ppIndexFiles.push_back(ppIndexFileForType(options.preprocessDataType, shard));
+        }
+    }
 
-    cout << "Start reading preprocessed bed file: " << ppFile << endl;
+    // Drop the SNPs which failed QC, or were otherwise not written, during preprocessing.
+    // Only BED input has statistics; CSV input is preprocessed as is.
+    std::vector<unsigned char> keptSnps;
+    for (size_t shard = 0; shard < data.bimSnpCounts.size() && shard < ppFiles.size(); ++shard) {
+        const auto statsFile = qcFile(ppFiles[shard]);
+        const auto bimCount = data.bimSnpCounts[shard];
+        if (!std::filesystem::exists(statsFile)) {
+            keptSnps.insert(keptSnps.end(), bimCount, 1);
+            continue;
+        }
+
+        std::vector<MarkerStats> stats;
+        if (!readMarkerStats(statsFile, stats))
+            return false;
+        if (stats.size() != bimCount) {
+            cerr << "Marker statistics in " << statsFile << " cover " << stats.size()
+                 << " SNPs but the BIM file has " << bimCount << endl;
+            return false;
+        }
+        for (const auto &record : stats)
+            keptSnps.push_back(record.kept);
+    }
+    if (keptSnps.size() == data.snpInfoVec.size())
+        data.excludeSnps(keptSnps);
+
+    for (const auto &ppFile : ppFiles)
+        cout << "Start reading preprocessed bed file: " << ppFile << endl;
     clock_t start_bed = clock();
-    data.mapCompressedPreprocessBedFile(ppFile, ppIndexFile);
+    data.mapCompressedPreprocessedShards(ppFiles, ppIndexFiles);
     clock_t end = clock();
     printf("Finished reading preprocessed bed file in %.3f sec.\n", double(end - start_bed) / double(CLOCKS_PER_SEC));
     cout << endl;
@@ -212,8 +341,26 @@ bool runBayesAnalysis(const Options &options) {
 
     auto graph = AnalysisRunner::makeAnalysisGraph(options);
 
-    auto cleanup = [&data]() {
+    std::unique_ptr<GraphStats> stats;
+    if (graph && !options.graphStatsFile.empty()) {
+        const bool async = graph->isAsynchronous();
+        stats = std::make_unique<GraphStats>(async ? "ParallelGraph"
+                                                   : options.useMarkerCache ? "Sequential"
+                                                                            : "LimitSequenceGraph");
+        graph->setStats(stats.get());
+    }
+
+    if (options.traceFirstIteration >= 0 && options.traceLastIteration >= options.traceFirstIteration) {
+        tracer().configure(static_cast<unsigned int>(options.traceFirstIteration),
+                           static_cast<unsigned int>(options.traceLastIteration),
+                           options.traceFile);
+    }
+
+    auto cleanup = [&data, &stats, &options]() {
         data.unmapCompressedPreprocessedBedFile();
+        if (stats)
+            stats->write(options.graphStatsFile);
+        tracer().finish();
     };
 
     bool result = false;
@@ -262,7 +409,8 @@ std::unique_ptr<AnalysisGraph> makeAnalysisGraph(const Options &options)
     {
         auto parallelGraph = std::make_unique<ParallelGraph>(options.decompressionTokens,
                                                              options.analysisTokens,
-                                                             options.useMarkerCache);
+                                                             options.useMarkerCache,
+                                                             options.deterministicAsync);
         parallelGraph->setDecompressionNodeConcurrency(options.decompressionNodeConcurrency);
         parallelGraph->setAnalysisNodeConcurrency(options.analysisNodeConcurrency);
         return std::move(parallelGraph);
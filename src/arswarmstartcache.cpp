@@ -0,0 +1,87 @@
+#include "arswarmstartcache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+void ArsWarmStartCache::reset(unsigned int markerCount, size_t maxBytes)
+{
+    const size_t maxSlots = maxBytes / sizeof(Slot);
+    const size_t slots = std::min(static_cast<size_t>(markerCount), maxSlots);
+
+    m_slots.clear();
+    m_slots.shrink_to_fit();
+    m_slots.resize(slots);
+
+    if (slots > 0 && slots < markerCount) {
+        std::cout << "ARS warm start cache holds " << slots << " of "
+                  << markerCount << " markers" << std::endl;
+    }
+}
+
+void ArsWarmStartCache::clear()
+{
+    std::for_each(m_slots.begin(), m_slots.end(), [](Slot &slot) {
+        slot.marker = kEmpty;
+    });
+}
+
+bool ArsWarmStartCache::fetch(unsigned int marker, double xl, double xr, double *xinit) const
+{
+    if (m_slots.empty())
+        return false;
+
+    const size_t index = marker % m_slots.size();
+    std::array<double, PointCount> x;
+    {
+        tbb::spin_mutex::scoped_lock lock(m_locks[index % kLockCount]);
+        const Slot &slot = m_slots[index];
+        if (slot.marker != marker)
+            return false;
+        x = slot.x;
+    }
+
+    // arms() rejects initial points which are not ordered or touch the bounds
+    double previous = xl;
+    for (const double value : x) {
+        if (!std::isfinite(value) || value <= previous)
+            return false;
+        previous = value;
+    }
+    if (previous >= xr)
+        return false;
+
+    std::copy(x.cbegin(), x.cend(), xinit);
+    return true;
+}
+
+void ArsWarmStartCache::store(unsigned int marker, const double *xcent)
+{
+    if (m_slots.empty())
+        return;
+
+    const size_t index = marker % m_slots.size();
+    tbb::spin_mutex::scoped_lock lock(m_locks[index % kLockCount]);
+    Slot &slot = m_slots[index];
+    slot.marker = marker;
+    std::copy(xcent, xcent + PointCount, slot.x.begin());
+}
+
+std::string ArsWarmStartCache::state() const
+{
+    std::string bytes(m_slots.size() * sizeof(Slot), '\0');
+    if (!m_slots.empty())
+        std::memcpy(&bytes[0], m_slots.data(), bytes.size());
+    return bytes;
+}
+
+bool ArsWarmStartCache::setState(const std::string &state)
+{
+    if (state.size() != m_slots.size() * sizeof(Slot))
+        return false;
+
+    if (!m_slots.empty())
+        std::memcpy(m_slots.data(), state.data(), state.size());
+    return true;
+}
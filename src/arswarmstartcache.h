@@ -0,0 +1,58 @@
+#ifndef ARSWARMSTARTCACHE_H
+#define ARSWARMSTARTCACHE_H
+
+#include "tbb/spin_mutex.h"
+
+#include <array>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Remembers the envelope centiles returned by arms() for each marker so that
+// the next iteration can seed its initial abscissae with them rather than
+// with fixed offsets around beta_old. The centiles of the previous envelope
+// bracket the mode of the conditional posterior, which means fewer envelope
+// refinements (and therefore fewer O(N) density evaluations) are needed.
+//
+// Storage is bounded: when there are more markers than slots, markers share
+// slots (marker % slotCount) and a miss simply falls back to a cold start.
+class ArsWarmStartCache
+{
+public:
+    static constexpr int PointCount = 4;
+
+    void reset(unsigned int markerCount, size_t maxBytes);
+    void clear();
+
+    bool enabled() const { return !m_slots.empty(); }
+    size_t slotCount() const { return m_slots.size(); }
+
+    // Copies the cached abscissae for marker into xinit if they are strictly
+    // increasing and lie strictly within (xl, xr). Returns false otherwise.
+    bool fetch(unsigned int marker, double xl, double xr, double *xinit) const;
+
+    // Stores the centiles calculated by arms() for marker
+    void store(unsigned int marker, const double *xcent);
+
+    // Cache contents, for checkpoints. setState fails if the slot count
+    // differs from the one in the state.
+    std::string state() const;
+    bool setState(const std::string &state);
+
+private:
+    static constexpr unsigned int kEmpty = std::numeric_limits<unsigned int>::max();
+    static constexpr size_t kLockCount = 64;
+
+    struct Slot {
+        unsigned int marker = kEmpty;
+        std::array<double, PointCount> x;
+    };
+
+    std::vector<Slot> m_slots;
+
+    // Slots can be shared between markers sampled concurrently by the
+    // ParallelGraph, so guard them with a small set of striped locks.
+    mutable std::array<tbb::spin_mutex, kLockCount> m_locks;
+};
+
+#endif // ARSWARMSTARTCACHE_H
@@ -0,0 +1,107 @@
+#include "asyncwriter.h"
+
+AsyncWriter::AsyncWriter(Writer *writer, size_t capacity)
+    : m_writer(writer)
+{
+    if (capacity == 0)
+        return;
+
+    m_pending.set_capacity(static_cast<std::ptrdiff_t>(capacity));
+    m_free.set_capacity(static_cast<std::ptrdiff_t>(capacity) + 1);
+    m_thread = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    // A destructor must not throw; errors are reported by close()
+    stop();
+}
+
+void AsyncWriter::write(Eigen::VectorXd &sample)
+{
+    if (!m_thread.joinable()) {
+        m_writer->write(sample);
+        return;
+    }
+
+    rethrowError();
+
+    Eigen::VectorXd buffer;
+    if (!m_free.try_pop(buffer) || buffer.size() != sample.size())
+        buffer.resize(sample.size());
+
+    std::swap(buffer, sample);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_queuedCount;
+    }
+    m_pending.push(std::move(buffer));
+}
+
+void AsyncWriter::flush()
+{
+    if (m_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_written.wait(lock, [this] { return m_writtenCount == m_queuedCount; });
+        }
+        rethrowError();
+    }
+    m_writer->flush();
+}
+
+void AsyncWriter::close()
+{
+    stop();
+    rethrowError();
+}
+
+void AsyncWriter::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    // An empty vector tells the writer thread to stop
+    m_pending.push(Eigen::VectorXd());
+    m_thread.join();
+}
+
+void AsyncWriter::rethrowError()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_error)
+        std::rethrow_exception(m_error);
+}
+
+void AsyncWriter::run()
+{
+    Eigen::VectorXd sample;
+    for (;;) {
+        m_pending.pop(sample);
+        if (sample.size() == 0)
+            break;
+
+        // After a failure the queue is still drained, so that write() and
+        // flush() never wait on a thread that has stopped
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            failed = static_cast<bool>(m_error);
+        }
+        if (!failed) {
+            try {
+                m_writer->write(sample);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_error = std::current_exception();
+            }
+        }
+        m_free.try_push(std::move(sample));
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_writtenCount;
+        }
+        m_written.notify_all();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include "writer.h"
+
+#include "tbb/concurrent_queue.h"
+
+#include <Eigen/Eigen>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// Writes samples on a background thread so that formatting and I/O overlap
+// with the next iteration. At most capacity samples are queued; write()
+// blocks while the queue is full. With a capacity of 0 samples are written
+// inline on the calling thread.
+//
+// If the writer throws on the background thread, the remaining samples are
+// dropped and the exception is rethrown by every later call to write(),
+// flush() or close() on the calling thread.
+class AsyncWriter
+{
+public:
+    AsyncWriter(Writer *writer, size_t capacity);
+    ~AsyncWriter();
+
+    // Queues sample for writing. The vector is moved into the queue and
+    // replaced by a recycled buffer of the same size, so the caller can fill
+    // it again without allocating.
+    void write(Eigen::VectorXd &sample);
+
+    // Waits for all queued samples to be written and flushed, leaving the
+    // writer thread running
+    void flush();
+
+    // Waits for all queued samples to be written
+    void close();
+
+private:
+    Writer *m_writer = nullptr;
+    tbb::concurrent_bounded_queue<Eigen::VectorXd> m_pending;
+    tbb::concurrent_bounded_queue<Eigen::VectorXd> m_free;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_written;
+    size_t m_queuedCount = 0;
+    size_t m_writtenCount = 0;
+    std::exception_ptr m_error;
+
+    void run();
+    void stop();
+    void rethrowError();
+};
+
+#endif // ASYNCWRITER_H
@@ -0,0 +1,50 @@
+#include "atomicfile.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Flushes a file, or the entries of a directory, to the disk
+bool syncPath(const std::string &path, int flags)
+{
+    const int fd = ::open(path.c_str(), flags);
+    if (fd < 0)
+        return false;
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+}
+
+bool writeFileAtomically(const std::string &fileName,
+                         const std::function<void(std::ostream &)> &write,
+                         std::ios::openmode mode)
+{
+    const std::string tmpFile = fileName + ".tmp";
+    std::ofstream out(tmpFile, mode | std::ios::out | std::ios::trunc);
+    if (!out)
+        return false;
+
+    write(out);
+
+    // The data must be on disk before the rename replaces the previous
+    // file, or a crash could leave neither
+    out.close();
+    if (!out || !syncPath(tmpFile, O_RDONLY) || std::rename(tmpFile.c_str(), fileName.c_str()) != 0) {
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+
+    // Makes the rename itself durable
+    auto directory = std::filesystem::path(fileName).parent_path().string();
+    if (directory.empty())
+        directory = ".";
+    syncPath(directory, O_RDONLY | O_DIRECTORY);
+    return true;
+}
@@ -0,0 +1,15 @@
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+
+// Writes fileName with write() through a temporary next to it, which is
+// flushed to the disk before it is renamed over fileName. A crash leaves
+// either the previous file or the new one. Returns false if any step fails.
+bool writeFileAtomically(const std::string &fileName,
+                         const std::function<void(std::ostream &)> &write,
+                         std::ios::openmode mode = std::ios::out);
+
+#endif // ATOMICFILE_H
@@ -16,11 +16,57 @@
 #include "BayesW_arms.h"
 #include "markerbuilder.h"
 #include "samplewriter.h"
+#include "asyncwriter.h"
+#include "posteriorsummary.h"
+#include "checkpoint.h"
+#include "tracer.h"
 
+#include <algorithm>
 #include <chrono>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <numeric>
 #include <random>
 
+namespace {
+
+// Streams of the counter based generator used by arms(), one per purpose
+enum ArmsStreamPurpose : uint32_t {
+    BetaStream = 1,
+    MuStream,
+    ThetaStream,
+    AlphaStream
+};
+
+// Makes arms() draw from a counter based stream on this thread while in scope
+class ArmsStream
+{
+public:
+    explicit ArmsStream(const CounterRng::Stream &stream) : m_stream(stream)
+    {
+        arms_set_uniform(&ArmsStream::uniform, &m_stream);
+    }
+
+    ~ArmsStream() { arms_set_uniform(nullptr, nullptr); }
+
+private:
+    CounterRng::Stream m_stream;
+
+    // arms() expects values in (0, 1)
+    static double uniform(void *state)
+    {
+        auto *stream = static_cast<CounterRng::Stream *>(state);
+        double u = 0;
+        while (u == 0)
+            u = stream->unif();
+        return u;
+    }
+};
+
+}
+
 /* Pre-calculate used constants */
 #define PI 3.14159
 #define PI2 6.283185
@@ -39,12 +85,22 @@ BayesWBase::BayesWBase(const Data *data, const Options *opt, const long memPageS
 , m_dist(opt->seed)
 , m_quad_points(opt->quad_points)
 , m_K(opt->S.size() + 1)
+, m_rng(opt->seed)
 {
 
 }
 
 BayesWBase::~BayesWBase() = default;
 
+// Positive Gauss-Hermite nodes with their adjusted weights. The rules are
+// symmetric, so each node is also evaluated at -x, and the weight of the node
+// at zero is kept separately.
+struct GaussHermiteRule {
+    std::vector<double> x;
+    std::vector<double> w;
+    double w0 = 0;
+};
+
 namespace  {
 
 /* Function to check if ARS resulted with error*/
@@ -58,7 +114,7 @@ inline void errorCheck(int err){
 struct mu_params {
     double alpha = 0;
     double d = 0;
-    VectorXd epsilon;
+    double log_exp_sum = 0; // log(sum(exp(alpha * (epsilon + mu) - EuMasc)))
     double sigma_mu = 0;
 };
 
@@ -66,14 +122,11 @@ struct mu_params {
 inline double mu_dens(double x, void *norm_data)
 /* We are sampling mu (denoted by x here) */
 {
-	double y;
-
 	/* In C++ we need to do a static cast for the void data */
-    mu_params p = *(static_cast<mu_params *>(norm_data));
+    const mu_params &p = *(static_cast<const mu_params *>(norm_data));
 
-	/* cast voided pointer into pointer to struct norm_parm */
-    y = - p.alpha * x * p.d - (( p.epsilon.array()  - x) * p.alpha - EuMasc).exp().sum() - x*x/(2*p.sigma_mu);
-	return y;
+    // sum(exp((epsilon - x) * alpha - EuMasc)) = exp(-alpha * x) * sum(exp(epsilon * alpha - EuMasc))
+    return - p.alpha * x * p.d - exp(p.log_exp_sum - p.alpha * x) - x*x/(2*p.sigma_mu);
 };
 
 struct theta_params {
@@ -100,8 +153,8 @@ inline double theta_dens(double x, void *norm_data)
 struct alpha_params {
     double alpha_0 = 0;
     double d = 0;
-    VectorXd epsilon;
-    VectorXd failure_vector;
+    const VectorXd *epsilon = nullptr;
+    double epsilon_failure_sum = 0; // sum(epsilon * failure_vector)
     double kappa_0 = 0;
 };
 
@@ -109,361 +162,125 @@ struct alpha_params {
 inline double alpha_dens(double x, void *norm_data)
 /* We are sampling alpha (denoted by x here) */
 {
-	double y;
-
 	/* In C++ we need to do a static cast for the void data */
-    alpha_params p = *(static_cast<alpha_params *>(norm_data));
-	y = (p.alpha_0 + p.d - 1) * log(x) + x * ((p.epsilon.array() * p.failure_vector.array()).sum() - p.kappa_0) -
-			((p.epsilon * x).array() - EuMasc).exp().sum() ;
-	return y;
+    const alpha_params &p = *(static_cast<const alpha_params *>(norm_data));
+    return (p.alpha_0 + p.d - 1) * log(x) + x * (p.epsilon_failure_sum - p.kappa_0) -
+            (p.epsilon->array() * x - EuMasc).exp().sum();
 };
 
+const GaussHermiteRule *gaussHermiteRule(const string &n)
+{
+    static const std::map<string, GaussHermiteRule> rules = {
+        {"3", {{1.2247448713916},
+               {1.3239311752136},
+               1.1816359006037}},
+        {"5", {{2.0201828704561, 0.95857246461382},
+               {1.181488625536, 0.98658099675143},
+               0.94530872048294}},
+        {"7", {{2.6519613568352, 1.6735516287675, 0.81628788285897},
+               {1.1013307296103, 0.8971846002252, 0.8286873032836},
+               0.81026461755681}},
+        {"9", {{3.1909932017815, 2.2665805845318, 1.4685532892167, 0.72355101875284},
+               {1.0470035809767, 0.84175270147867, 0.7646081250946, 0.73030245274509},
+               0.72023521560605}},
+        {"11", {{3.6684708465596, 2.7832900997817, 2.0259480158258, 1.3265570844949, 0.6568095668821},
+                {1.0065267861724, 0.802516868851, 0.721953624728, 0.6812118810667, 0.66096041944096},
+                0.65475928691459}},
+        {"13", {{4.1013375961786, 3.2466089783724, 2.5197356856782, 1.8531076516015, 1.2200550365908, 0.60576387917106},
+                {0.97458039564, 0.7725808233517, 0.6906180348378, 0.6467594633158, 0.6217160552868, 0.60852958370332},
+                0.60439318792116}},
+        {"15", {{4.4999907073094, 3.6699503734045, 2.9671669279056, 2.3257324861739, 1.7199925751865, 1.1361155852109, 0.5650695832556},
+                {0.94836897082761, 0.7486073660169, 0.666166005109, 0.620662603527, 0.5930274497642, 0.5761933502835, 0.5670211534466},
+                0.56410030872642}},
+    };
+
+    const auto it = rules.find(n);
+    return it == rules.end() ? nullptr : &it->second;
+}
+
 }
 
 
 //Calculate the value of the integral using Adaptive Gauss-Hermite quadrature
 //Let's assume that mu is always 0 for speed
-double BayesWBase::gauss_hermite_adaptive_integral(int k, double sigma, string n, const BayesWKernel *kernel){
+double BayesWBase::gauss_hermite_adaptive_integral(int k, double sigma, const BayesWKernel *kernel){
     assert(kernel);
+    assert(m_quadRule);
 
-    double temp = 0;
-    double sqrt_2ck_sigma = sqrt(2*m_mixture_classes(k)*m_sigma_b);
+    const GaussHermiteRule *rule = m_quadRule;
 
-    if(n == "3"){
-        double x1,x2;
-        double w1,w2,w3;
+    const double sqrt_2ck_sigma = sqrt(2*m_mixture_classes(k)*m_sigma_b);
 
-        x1 = 1.2247448713916;
-        x2 = -x1;
+    // The node at zero always evaluates to 1, so only its weight is added
+    double temp = rule->w0;
+    for (size_t j = 0; j < rule->x.size(); ++j) {
+        const double x = sigma * rule->x[j];
+        temp += rule->w[j] * (kernel->integrand_adaptive(x,m_alpha,sqrt_2ck_sigma) +
+                              kernel->integrand_adaptive(-x,m_alpha,sqrt_2ck_sigma));
+    }
 
-        w1 = 1.3239311752136;
-        w2 = w1;
+    return sigma*temp;
+}
+
+void BayesWBase::marginalLikelihoods(const BayesWKernel *kernel, bool batched, VectorXd &marginal_likelihoods)
+{
+    assert(kernel);
 
-        w3 = 1.1816359006037;
+    // First element for the marginal likelihoods is always is pi_0 *sqrt(pi) for
+    marginal_likelihoods(0) = m_pi_L(0) * sqrtPI;
 
-        x1 = sigma*x1;
-        x2 = sigma*x2;
+    const double exp_sum = kernel->exponent_sum();
+    const Index classCount = m_mixture_classes.size();
 
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3;
+    //Calculate the sigma for the adaptive G-H
+    VectorXd sigma(classCount);
+    for(int i=0; i < classCount; i++){
+        sigma(i) = 1.0/sqrt(1 + m_alpha * m_alpha * m_sigma_b * m_mixture_classes(i) * exp_sum);
     }
-    // n=5
-    else if(n == "5"){
-        double x1,x2,x3,x4;//x5;
-        double w1,w2,w3,w4,w5; //These are adjusted weights
-
-        x1 = 2.0201828704561;
-        x2 = -x1;
-        w1 = 1.181488625536;
-        w2 = w1;
-
-        x3 = 0.95857246461382;
-        x4 = -x3;
-        w3 = 0.98658099675143;
-        w4 = w3;
-
-        //	x5 = 0.0;
-        w5 = 0.94530872048294;
-
-        x1 = sigma*x1;
-        x2 = sigma*x2;
-        x3 = sigma*x3;
-        x4 = sigma*x4;
-        //x5 = sigma*x5;
-
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3 * kernel->integrand_adaptive(x3,m_alpha,sqrt_2ck_sigma) +
-                w4 * kernel->integrand_adaptive(x4,m_alpha,sqrt_2ck_sigma) +
-                w5;
-    }else if(n == "7"){
-        double x1,x2,x3,x4,x5,x6;
-        double w1,w2,w3,w4,w5,w6,w7; //These are adjusted weights
-
-        x1 = 2.6519613568352;
-        x2 = -x1;
-        w1 = 1.1013307296103;
-        w2 = w1;
-
-        x3 = 1.6735516287675;
-        x4 = -x3;
-        w3 = 0.8971846002252;
-        w4 = w3;
-
-        x5 = 0.81628788285897;
-        x6 = -x5;
-        w5 = 0.8286873032836;
-        w6 = w5;
-
-        w7 = 0.81026461755681;
-
-        x1 = sigma*x1;
-        x2 = sigma*x2;
-        x3 = sigma*x3;
-        x4 = sigma*x4;
-        x5 = sigma*x5;
-        x6 = sigma*x6;
-
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3 * kernel->integrand_adaptive(x3,m_alpha,sqrt_2ck_sigma) +
-                w4 * kernel->integrand_adaptive(x4,m_alpha,sqrt_2ck_sigma) +
-                w5 * kernel->integrand_adaptive(x5,m_alpha,sqrt_2ck_sigma) +
-                w6 * kernel->integrand_adaptive(x6,m_alpha,sqrt_2ck_sigma) +
-                w7;
-    }else if(n == "9"){
-        double x1,x2,x3,x4,x5,x6,x7,x8;//x9;
-        double w1,w2,w3,w4,w5,w6,w7,w8,w9; //These are adjusted weights
-
-        x1 = 3.1909932017815;
-        x2 = -x1;
-        w1 = 1.0470035809767;
-        w2 = w1;
-
-        x3 = 2.2665805845318;
-        x4 = -x3;
-        w3 = 0.84175270147867;
-        w4 = w3;
-
-        x5 = 1.4685532892167;
-        x6 = -x3;
-        w5 = 0.7646081250946;
-        w6 = w5;
-
-        x7 = 0.72355101875284;
-        x8 = -x7;
-        w7 = 0.73030245274509;
-        w8 = w7;
-
-        //x9 = 0.0;
-        w9 = 0.72023521560605;
-
-        x1 = sigma*x1;
-        x2 = sigma*x2;
-        x3 = sigma*x3;
-        x4 = sigma*x4;
-        x5 = sigma*x5;
-        x6 = sigma*x6;
-        x7 = sigma*x7;
-        x8 = sigma*x8;
-
-
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3 * kernel->integrand_adaptive(x3,m_alpha,sqrt_2ck_sigma) +
-                w4 * kernel->integrand_adaptive(x4,m_alpha,sqrt_2ck_sigma) +
-                w5 * kernel->integrand_adaptive(x5,m_alpha,sqrt_2ck_sigma) +
-                w6 * kernel->integrand_adaptive(x6,m_alpha,sqrt_2ck_sigma) +
-                w7 * kernel->integrand_adaptive(x7,m_alpha,sqrt_2ck_sigma) +
-                w8 * kernel->integrand_adaptive(x8,m_alpha,sqrt_2ck_sigma) +
-                w9;
-    }else if(n == "11"){
-        double x1,x2,x3,x4,x5,x6,x7,x8,x9,x10;//,x11;
-        double w1,w2,w3,w4,w5,w6,w7,w8,w9,w10,w11; //These are adjusted weights
-
-        x1 = 3.6684708465596;
-        x2 = -x1;
-        w1 = 1.0065267861724;
-        w2 = w1;
-
-        x3 = 2.7832900997817;
-        x4 = -x3;
-        w3 = 0.802516868851;
-        w4 = w3;
-
-        x5 = 2.0259480158258;
-        x6 = -x3;
-        w5 = 0.721953624728;
-        w6 = w5;
-
-        x7 = 1.3265570844949;
-        x8 = -x7;
-        w7 = 0.6812118810667;
-        w8 = w7;
-
-        x9 = 0.6568095668821;
-        x10 = -x9;
-        w9 = 0.66096041944096;
-        w10 = w9;
-
-        //x11 = 0.0;
-        w11 = 0.65475928691459;
-
-        x1 = sigma*x1;
-        x2 = sigma*x2;
-        x3 = sigma*x3;
-        x4 = sigma*x4;
-        x5 = sigma*x5;
-        x6 = sigma*x6;
-        x7 = sigma*x7;
-        x8 = sigma*x8;
-        x9 = sigma*x9;
-        x10 = sigma*x10;
-        //	x11 = sigma*x11;
-
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3 * kernel->integrand_adaptive(x3,m_alpha,sqrt_2ck_sigma) +
-                w4 * kernel->integrand_adaptive(x4,m_alpha,sqrt_2ck_sigma) +
-                w5 * kernel->integrand_adaptive(x5,m_alpha,sqrt_2ck_sigma) +
-                w6 * kernel->integrand_adaptive(x6,m_alpha,sqrt_2ck_sigma) +
-                w7 * kernel->integrand_adaptive(x7,m_alpha,sqrt_2ck_sigma) +
-                w8 * kernel->integrand_adaptive(x8,m_alpha,sqrt_2ck_sigma) +
-                w9 * kernel->integrand_adaptive(x9,m_alpha,sqrt_2ck_sigma) +
-                w10 * kernel->integrand_adaptive(x10,m_alpha,sqrt_2ck_sigma) +
-                w11;
-    }else if(n == "13"){
-        double x1,x2,x3,x4,x5,x6,x7,x8,x9,x10,x11,x12;
-        double w1,w2,w3,w4,w5,w6,w7,w8,w9,w10,w11,w12,w13; //These are adjusted weights
-
-        x1 = 4.1013375961786;
-        x2 = -x1;
-        w1 = 0.97458039564;
-        w2 = w1;
-
-        x3 = 3.2466089783724;
-        x4 = -x3;
-        w3 = 0.7725808233517;
-        w4 = w3;
-
-        x5 = 2.5197356856782;
-        x6 = -x3;
-        w5 = 0.6906180348378;
-        w6 = w5;
-
-        x7 = 1.8531076516015;
-        x8 = -x7;
-        w7 = 0.6467594633158;
-        w8 = w7;
-
-        x9 = 1.2200550365908;
-        x10 = -x9;
-        w9 = 0.6217160552868;
-        w10 = w9;
-
-        x11 = 0.60576387917106;
-        x12 = -x11;
-        w11 = 0.60852958370332;
-        w12 = w11;
-
-        //x13 = 0.0;
-        w13 = 0.60439318792116;
-
-        x1 = sigma*x1;
-        x2 = sigma*x2;
-        x3 = sigma*x3;
-        x4 = sigma*x4;
-        x5 = sigma*x5;
-        x6 = sigma*x6;
-        x7 = sigma*x7;
-        x8 = sigma*x8;
-        x9 = sigma*x9;
-        x10 = sigma*x10;
-        x11 = sigma*x11;
-        x12 = sigma*x12;
-
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3 * kernel->integrand_adaptive(x3,m_alpha,sqrt_2ck_sigma) +
-                w4 * kernel->integrand_adaptive(x4,m_alpha,sqrt_2ck_sigma) +
-                w5 * kernel->integrand_adaptive(x5,m_alpha,sqrt_2ck_sigma) +
-                w6 * kernel->integrand_adaptive(x6,m_alpha,sqrt_2ck_sigma) +
-                w7 * kernel->integrand_adaptive(x7,m_alpha,sqrt_2ck_sigma) +
-                w8 * kernel->integrand_adaptive(x8,m_alpha,sqrt_2ck_sigma) +
-                w9 * kernel->integrand_adaptive(x9,m_alpha,sqrt_2ck_sigma) +
-                w10 * kernel->integrand_adaptive(x10,m_alpha,sqrt_2ck_sigma) +
-                w11 * kernel->integrand_adaptive(x11,m_alpha,sqrt_2ck_sigma) +
-                w12 * kernel->integrand_adaptive(x12,m_alpha,sqrt_2ck_sigma) +
-                w13;
-    }else if(n == "15"){
-        double x1,x2,x3,x4,x5,x6,x7,x8,x9,x10,x11,x12,x13,x14;//,x11;
-        double w1,w2,w3,w4,w5,w6,w7,w8,w9,w10,w11,w12,w13,w14,w15; //These are adjusted weights
-
-        x1 = 4.4999907073094;
-        x2 = -x1;
-        w1 = 0.94836897082761;
-        w2 = w1;
-
-        x3 = 3.6699503734045;
-        x4 = -x3;
-        w3 = 0.7486073660169;
-        w4 = w3;
-
-        x5 = 2.9671669279056;
-        x6 = -x3;
-        w5 = 0.666166005109;
-        w6 = w5;
-
-        x7 = 2.3257324861739;
-        x8 = -x7;
-        w7 = 0.620662603527;
-        w8 = w7;
-
-        x9 = 1.7199925751865;
-        x10 = -x9;
-        w9 = 0.5930274497642;
-        w10 = w9;
-
-        x11 = 1.1361155852109;
-        x12 = -x11;
-        w11 = 0.5761933502835;
-        w12 = w11;
-
-        x13 = 0.5650695832556;
-        x14 = -x13;
-        w13 = 0.5670211534466;
-        w14 = w13;
-
-        //x15 = 0.0;
-        w15 = 0.56410030872642;
-
-        x1 = sigma*x1;
-        x2 = sigma*x2;
-        x3 = sigma*x3;
-        x4 = sigma*x4;
-        x5 = sigma*x5;
-        x6 = sigma*x6;
-        x7 = sigma*x7;
-        x8 = sigma*x8;
-        x9 = sigma*x9;
-        x10 = sigma*x10;
-        x11 = sigma*x11;
-        x12 = sigma*x12;
-        x13 = sigma*x13;
-        x14 = sigma*x14;
-
-        temp = w1 * kernel->integrand_adaptive(x1,m_alpha,sqrt_2ck_sigma) +
-                w2 * kernel->integrand_adaptive(x2,m_alpha,sqrt_2ck_sigma) +
-                w3 * kernel->integrand_adaptive(x3,m_alpha,sqrt_2ck_sigma) +
-                w4 * kernel->integrand_adaptive(x4,m_alpha,sqrt_2ck_sigma) +
-                w5 * kernel->integrand_adaptive(x5,m_alpha,sqrt_2ck_sigma) +
-                w6 * kernel->integrand_adaptive(x6,m_alpha,sqrt_2ck_sigma) +
-                w7 * kernel->integrand_adaptive(x7,m_alpha,sqrt_2ck_sigma) +
-                w8 * kernel->integrand_adaptive(x8,m_alpha,sqrt_2ck_sigma) +
-                w9 * kernel->integrand_adaptive(x9,m_alpha,sqrt_2ck_sigma) +
-                w10 * kernel->integrand_adaptive(x10,m_alpha,sqrt_2ck_sigma) +
-                w11 * kernel->integrand_adaptive(x11,m_alpha,sqrt_2ck_sigma) +
-                w12 * kernel->integrand_adaptive(x12,m_alpha,sqrt_2ck_sigma) +
-                w13 * kernel->integrand_adaptive(x13,m_alpha,sqrt_2ck_sigma) +
-                w14 * kernel->integrand_adaptive(x14,m_alpha,sqrt_2ck_sigma) +
-                w15;
-    }else{
-        cout << "Possible number of quad_points = 3,5,7,9,11,13,15" << endl;
-        exit(1);
+
+    if (!batched) {
+        for(int i=0; i < classCount; i++){
+            marginal_likelihoods(i+1) = m_pi_L(i+1) * gauss_hermite_adaptive_integral(i, sigma(i), kernel);
+        }
+        return;
     }
 
-    return sigma*temp;
+    assert(m_quadRule);
+    const GaussHermiteRule *rule = m_quadRule;
+
+    // Lay out every (mixture class, node) pair so that the kernel can
+    // evaluate all of them in a single pass over the individuals
+    const Index pairCount = static_cast<Index>(rule->x.size());
+    VectorXd s(classCount * 2 * pairCount);
+    VectorXd sqrt_2ck_sigma(s.size());
+    for (Index i = 0; i < classCount; ++i) {
+        const double c = sqrt(2*m_mixture_classes(i)*m_sigma_b);
+        for (Index j = 0; j < pairCount; ++j) {
+            const Index p = 2 * (i * pairCount + j);
+            s(p) = sigma(i) * rule->x[j];
+            s(p + 1) = -s(p);
+            sqrt_2ck_sigma(p) = c;
+            sqrt_2ck_sigma(p + 1) = c;
+        }
+    }
+
+    const VectorXd integrand = kernel->integrand_adaptive(s, m_alpha, sqrt_2ck_sigma);
+
+    for (Index i = 0; i < classCount; ++i) {
+        double temp = rule->w0;
+        for (Index j = 0; j < pairCount; ++j) {
+            const Index p = 2 * (i * pairCount + j);
+            temp += rule->w[j] * (integrand(p) + integrand(p + 1));
+        }
+        marginal_likelihoods(i+1) = m_pi_L(i+1) * sigma(i) * temp;
+    }
 }
 
-void BayesWBase::prepareForAnalysis()
+void BayesWBase::prepareForAnalysis(unsigned int iteration)
 {
-    // Generate the random numbers required for this iteration. The random
-    // number engine is not thread safe, so generate them up front to avoid
-    // having to use a mutex.
-    std::generate(m_randomNumbers.begin(), m_randomNumbers.end(), [&dist = m_dist]() {
-        return dist.unif_rng();
-    });
+    // Kernels draw their random numbers from m_rng on demand, keyed by the
+    // iteration and marker, so nothing needs to be generated up front.
+    m_iteration = iteration;
 }
 
 void BayesWBase::init(unsigned int markerCount, unsigned int individualCount, unsigned int fixedCount)
@@ -536,7 +353,72 @@ void BayesWBase::init(unsigned int markerCount, unsigned int individualCount, un
 		}
 	}
 
-    m_randomNumbers.resize(markerCount);
+    // Markers sharing a slot would make a warm start depend on the order in
+    // which a deterministic window was analysed, so give each its own slot
+    size_t arsCacheBytes = 0;
+    if (m_opt->arsWarmStart) {
+        arsCacheBytes = m_opt->deterministicAsync ? std::numeric_limits<size_t>::max()
+                                                  : m_opt->arsCacheSize * 1024 * 1024;
+    }
+    m_arsCache.reset(markerCount, arsCacheBytes);
+}
+
+void BayesWBase::saveState(Checkpoint &checkpoint) const
+{
+    checkpoint.set("mu", m_mu);
+    checkpoint.set("alpha", m_alpha);
+    checkpoint.set("sigma_b", m_sigma_b);
+    checkpoint.set("theta", m_theta);
+    checkpoint.set("beta", m_beta);
+    checkpoint.set("components", m_components);
+    checkpoint.set("pi", m_pi_L);
+    checkpoint.set("v", m_v);
+    checkpoint.set("epsilon", *m_epsilon);
+    checkpoint.set("vi", *m_vi);
+    checkpoint.set("arsCache", m_arsCache.state());
+    checkpoint.set("rng", m_dist.state());
+}
+
+bool BayesWBase::restoreState(const Checkpoint &checkpoint)
+{
+    std::string arsCache;
+    std::string rng;
+    VectorXd theta, beta, epsilon, vi;
+    VectorXi components;
+    if (!checkpoint.get("mu", m_mu)
+            || !checkpoint.get("alpha", m_alpha)
+            || !checkpoint.get("sigma_b", m_sigma_b)
+            || !checkpoint.get("theta", theta) || theta.size() != m_theta.size()
+            || !checkpoint.get("beta", beta) || beta.size() != m_beta.size()
+            || !checkpoint.get("components", components) || components.size() != m_components.size()
+            || !checkpoint.get("pi", m_pi_L)
+            || !checkpoint.get("v", m_v)
+            || !checkpoint.get("epsilon", epsilon) || epsilon.size() != m_epsilon->size()
+            || !checkpoint.get("vi", vi) || vi.size() != m_vi->size()
+            || !checkpoint.get("arsCache", arsCache) || !m_arsCache.setState(arsCache)
+            || !checkpoint.get("rng", rng))
+        return false;
+
+    m_theta = theta;
+    m_beta = beta;
+    m_components = components;
+    *m_epsilon = epsilon;
+    *m_vi = vi;
+    m_dist.setState(rng);
+    return true;
+}
+
+void BayesWBase::initialBetaAbscissae(unsigned int marker, double beta_old, double safe_limit,
+                                      double xl, double xr, double *xinit) const
+{
+    // Reuse the centiles of last iteration's envelope if we have them
+    if (m_arsCache.fetch(marker, xl, xr, xinit))
+        return;
+
+    xinit[0] = beta_old - safe_limit/10;
+    xinit[1] = beta_old;
+    xinit[2] = beta_old + safe_limit/20;
+    xinit[3] = beta_old + safe_limit/10;
 }
 // Function for sampling intercept (mu)
 void BayesWBase::sampleMu(){
@@ -553,19 +435,26 @@ void BayesWBase::sampleMu(){
 	double xl = 2;
 	double xr = 5;   //xl and xr and the maximum and minimum values between which we sample
 
+    // Reduce epsilon =Y+mu-X*beta once; shift by the largest term so the sum
+    // cannot overflow before the log is taken
+    const double maxExponent = m_alpha * (m_epsilon->maxCoeff() + m_mu) - EuMasc;
+    const double expSum = ((m_epsilon->array() + m_mu) * m_alpha - EuMasc - maxExponent).exp().sum();
+
     mu_params params;
     params.alpha = m_alpha;
     params.d = d;
-    params.epsilon = m_epsilon->array() + m_mu; // we add to epsilon =Y+mu-X*beta
+    params.log_exp_sum = maxExponent + log(expSum);
     params.sigma_mu = m_sigma_mu;
 
 	// Use ARS to sample mu (with density mu_dens, using parameters from used_data)
+    ArmsStream armsStream(m_rng.stream(m_iteration, 0, MuStream));
     err = arms(xinit,ninit,&xl,&xr,mu_dens,&params,&convex,
 			npoint,dometrop,&xprev,xsamp,nsamp,qcent,xcent,ncent,&neval);
 
 	errorCheck(err); // If there is error, stop the program
+    const double mu_old = m_mu;
     m_mu = xsamp[0];   // Save the sampled value
-    *m_epsilon = params.epsilon.array() - m_mu;// we substract again now epsilon =Y-mu-X*beta
+    m_epsilon->array() += mu_old - m_mu; // epsilon =Y-mu-X*beta with the new mu
 }
 
 // Function for sampling fixed effect (theta_i)
@@ -592,6 +481,7 @@ void BayesWBase::sampleTheta(int fix_i){
 
 
 	// Sample using ARS
+    ArmsStream armsStream(m_rng.stream(m_iteration, static_cast<uint32_t>(fix_i), ThetaStream));
     err = arms(xinit,ninit,&xl,&xr,theta_dens,&params,&convex,
 			npoint,dometrop,&xprev,xsamp,nsamp,qcent,xcent,ncent,&neval);
 	errorCheck(err);
@@ -607,9 +497,11 @@ void BayesWBase::processColumn(const KernelPtr &kernel)
     assert(gaussKernel);
 
     const double beta_old = m_beta(gaussKernel->marker->i);
+    const int marker = static_cast<int>(gaussKernel->marker->i);
 
 	//Change the residual vector only if the previous beta was non-zero
     if(beta_old != 0.0){
+        TraceSpan span("updateEpsilon", marker);
         *m_epsilon += *gaussKernel->calculateResidualUpdate(beta_old);
         //Also find the transformed residuals
         *m_vi = (m_alpha*m_epsilon->array()-EuMasc).exp();
@@ -619,24 +511,18 @@ void BayesWBase::processColumn(const KernelPtr &kernel)
     gaussKernel->calculateSumFailure(m_failure_vector);
 
     /* Calculate the mixture probability */
-    const double p = m_randomNumbers.at(kernel->marker->i);
+    const double p = m_rng.stream(m_iteration, kernel->marker->i).unif();
 
     // Calculate the (ratios of) marginal likelihoods
     VectorXd marginal_likelihoods {m_K}; // likelihood for each mixture component
-    // First element for the marginal likelihoods is always is pi_0 *sqrt(pi) for
-    marginal_likelihoods(0) = m_pi_L(0) * sqrtPI;
-    {
-        const double exp_sum = gaussKernel->exponent_sum();
-
-        for(int i=0; i < m_mixture_classes.size(); i++){
-            //Calculate the sigma for the adaptive G-H
-            double sigma = 1.0/sqrt(1 + m_alpha * m_alpha * m_sigma_b * m_mixture_classes(i) * exp_sum);
-            marginal_likelihoods(i+1) = m_pi_L(i+1) * gauss_hermite_adaptive_integral(i, sigma, m_quad_points, gaussKernel);
-        }
-    }
+    TraceSpan likelihoodSpan("marginalLikelihoods", marker);
+    marginalLikelihoods(gaussKernel, m_opt->intraColumnParallel, marginal_likelihoods);
+    likelihoodSpan.end();
 	// Calculate the probability that marker is 0
     double acum = marginal_likelihoods(0)/marginal_likelihoods.sum();
 
+    TraceSpan betaSpan("sampleBeta", marker);
+
     VectorXd localV = VectorXd::Zero(m_K);
     int component = 0;
     double beta_new = beta_old;
@@ -664,16 +550,18 @@ void BayesWBase::processColumn(const KernelPtr &kernel)
                 double convex = 1.0;
                 int dometrop = 0;
                 double xprev = 0.0;
-                double xinit[4] = {beta_old - safe_limit/10 , beta_old,  beta_old + safe_limit/20, beta_old + safe_limit/10};     // Initial abscissae
-                double *p_xinit = xinit;
-
                 double xl = beta_old - safe_limit  ; //Construct the hull around previous beta value
                 double xr = beta_old + safe_limit;
 
+                double xinit[4];     // Initial abscissae
+                initialBetaAbscissae(gaussKernel->marker->i, beta_old, safe_limit, xl, xr, xinit);
+
                 // Sample using ARS
+                ArmsStream armsStream(m_rng.stream(m_iteration, gaussKernel->marker->i, BetaStream));
                 err = estimateBeta(gaussKernel,m_epsilon,xinit,ninit,&xl,&xr, params, &convex,
                         npoint,dometrop,&xprev,xsamp,nsamp,qcent,xcent,ncent,&neval);
 				errorCheck(err);
+                m_arsCache.store(gaussKernel->marker->i, xcent);
 
                 beta_new = xsamp[0]; // Save the new result
 			}
@@ -690,9 +578,12 @@ void BayesWBase::processColumn(const KernelPtr &kernel)
 		}
 	}
 
+    betaSpan.end();
+
     // Only update m_epsilon if required
     const bool skipUpdate = beta_old == 0.0 && beta_new == 0.0;
     if (!skipUpdate) {
+        TraceSpan span("updateEpsilon", marker);
         //Re-update the residual vector
         *m_epsilon -= *gaussKernel->calculateResidualUpdate(beta_new);
         *m_vi = (m_alpha*m_epsilon->array()-EuMasc).exp();
@@ -722,11 +613,12 @@ void BayesWBase::sampleAlpha(){
     alpha_params params;
     params.alpha_0 = m_alpha_0;
     params.d = d;
-    params.epsilon = *m_epsilon;
-    params.failure_vector = m_failure_vector;
+    params.epsilon = m_epsilon.get();
+    params.epsilon_failure_sum = m_epsilon->dot(m_failure_vector);
     params.kappa_0 = m_kappa_0;
 
 	//Sample using ARS
+    ArmsStream armsStream(m_rng.stream(m_iteration, 0, AlphaStream));
     err = arms(xinit,ninit,&xl,&xr,alpha_dens,&params,&convex,
 			npoint,dometrop,&xprev,xsamp,nsamp,qcent,xcent,ncent,&neval);
 	errorCheck(err);
@@ -741,6 +633,13 @@ int BayesWBase::runGibbs(AnalysisGraph* analysis)
         return 1;
     }
 
+    m_quadRule = gaussHermiteRule(m_quad_points);
+    if (!m_quadRule) {
+        std::cerr << "Invalid number of quad_points " << m_quad_points
+                  << ", possible values are 3,5,7,9,11,13,15" << std::endl;
+        return 1;
+    }
+
     const unsigned int M(m_data->numSnps);
     const unsigned int N(m_data->numInds);
     const unsigned int numFixedEffects(m_data->numFixedEffects);
@@ -749,10 +648,37 @@ int BayesWBase::runGibbs(AnalysisGraph* analysis)
 	init(M, N, numFixedEffects);
 	int marker; //Marker index
 
+	// Sampler variables
+	std::vector<unsigned int> markerI(M);
+	std::iota(markerI.begin(), markerI.end(), 0);
+
+	// Summaries use every iteration after burn in, not just the thinned samples
+	std::unique_ptr<PosteriorSummary> summary;
+	VectorXd summaryParameters(3);
+	if (!m_opt->summaryFile.empty())
+		summary = std::make_unique<PosteriorSummary>(std::vector<std::string>{"alpha", "mu", "sigma_b"}, M);
+
+	// Continue from the last checkpoint. saveState adds the BayesW state,
+	// such as alpha, sigma_b, theta, vi and the ARS cache.
+	ChainCheckpoint checkpoints(m_opt,
+	                            [this](Checkpoint &checkpoint) { saveState(checkpoint); },
+	                            [this](const Checkpoint &checkpoint) { return restoreState(checkpoint); });
+	checkpoints.addOutputFile(m_outputFile);
+
+	unsigned int resumeIteration = 0;
+	if (!checkpoints.resume(resumeIteration, markerI, summary.get()))
+		return 1;
+	const int startIteration = static_cast<int>(resumeIteration);
+
 	SampleWriter writer;
     writer.setFileName(m_outputFile);
 	writer.setMarkerCount(M);
 	writer.setIndividualCount(N);
+	writer.setFormat(m_opt->sampleFormat);
+	writer.setCompressed(m_opt->sampleCompress);
+	writer.setFields(m_opt->outputFields);
+	writer.setSparse(m_opt->sparseSamples);
+	writer.setAppend(m_opt->resume);
 
 	VectorXd sample(2*M+4); // variable containing a sample of all variables in the model: M marker effects, M mixture assignments, shape (alpha), mu, iteration number and sigma_b(sigma_g)
 
@@ -765,23 +691,26 @@ int BayesWBase::runGibbs(AnalysisGraph* analysis)
 	}else{
 		writer.open_bayesW();
 	}
-
-	// Sampler variables
-	std::vector<unsigned int> markerI(M);
-	std::iota(markerI.begin(), markerI.end(), 0);
+	AsyncWriter sampleWriter(&writer, m_opt->sampleQueueSize);
 
 	std::cout<< "Running Gibbs sampling" << endl;
 	std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
 
 	// This for MUST NOT BE PARALLELIZED, IT IS THE MARKOV CHAIN
-	srand(2);
-    for (int iteration = 0; iteration < m_max_iterations; iteration++) {
+    for (int iteration = startIteration; iteration < m_max_iterations; iteration++) {
+        prepareForAnalysis(iteration);
+        tracer().setIteration(iteration);
+        TraceSpan iterationSpan("iteration");
 
 		/* 1. Intercept (mu) */
-		sampleMu();
+		{
+			TraceSpan span("sampleMu");
+			sampleMu();
+		}
 
 		/* 1a. Fixed effects (thetas) */
 		if(numFixedEffects > 0){
+			TraceSpan span("sampleTheta");
 			for(int fix_i = 0; fix_i < numFixedEffects; fix_i++){
 				sampleTheta(fix_i);
 			}
@@ -789,39 +718,62 @@ int BayesWBase::runGibbs(AnalysisGraph* analysis)
 		// Calculate the vector of exponent of the adjusted residuals
         *m_vi = (m_alpha*m_epsilon->array()-EuMasc).exp();
 
-		std::random_shuffle(markerI.begin(), markerI.end());
+		m_dist.shuffle(markerI);
 		// This for should not be parallelized, resulting chain would not be ergodic, still, some times it may converge to the correct solution
 		// 2. Sample beta parameters
 
 		// Set counter for each mixture to be 1 ( (1,...,1) prior)
         m_v.setOnes();
-        prepareForAnalysis();
-        analysis->exec(this, N, M, markerI);
+        {
+            TraceSpan span("flowGraph");
+            analysis->exec(this, N, M, markerI);
+        }
 
 		// 3. Sample alpha parameter
-		sampleAlpha();
+		{
+			TraceSpan span("sampleAlpha");
+			sampleAlpha();
+		}
 
 		// 4. Sample sigma_b
+        TraceSpan sigmaSpan("sampleSigma");
         m_sigma_b = m_dist.inv_gamma_rng((double) (m_alpha_sigma + 0.5 * (M - m_v[0]+1)),
                 (double)(m_beta_sigma + 0.5 * (M - m_v[0]+1) * m_beta.squaredNorm()));
 
 		// 5. Sample prior mixture component probability from Dirichlet distribution
-        m_pi_L = m_dist.dirichlet_rng(m_v.array());
+        m_dist.dirichlet_rng(m_v, m_pi_L);
+        sigmaSpan.end();
 
 		// Write the result to file
         if (iteration >= m_burn_in && iteration % m_thinning == 0) {
+			TraceSpan span("sampleWrite");
 			if(numFixedEffects > 0){
                 sample << iteration, m_alpha, m_mu, m_theta, m_beta,m_components.cast<double>(), m_sigma_b ;
 			}else{
                 sample << iteration, m_alpha, m_mu, m_beta,m_components.cast<double>(), m_sigma_b ;
 			}
-			writer.write(sample);
+			sampleWriter.write(sample);
+		}
+
+		if (summary && iteration >= m_burn_in) {
+			summaryParameters << m_alpha, m_mu, m_sigma_b;
+			summary->update(m_beta, summaryParameters);
+		}
+
+		if (checkpoints.isDue(static_cast<unsigned int>(iteration))) {
+			sampleWriter.flush();
+			checkpoints.save(static_cast<unsigned int>(iteration), markerI, summary.get());
 		}
 
 		//Print results
         cout << iteration << ". " << M - m_v[0] +1 <<"; "<<m_v[1]-1 << "; "<<m_v[2]-1 << "; " << m_v[3]-1  <<"; " << m_alpha << "; " << m_sigma_b << endl;
 	}
 
+	sampleWriter.close();
+	checkpoints.wait();
+	if (summary)
+		summary->write(m_opt->summaryFile);
+
 	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
 	auto duration = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
 	std::cout << "duration: "<<duration << "s\n";
@@ -834,13 +786,15 @@ std::unique_ptr<AsyncResult> BayesWBase::processColumnAsync(const KernelPtr &ker
     auto * gaussKernel = dynamic_cast<BayesWKernel*>(kernel.get());
     assert(gaussKernel);
 
-    // Local copies required to sample beta
-    std::shared_ptr<VectorXd> epsilon;
-    std::shared_ptr<VectorXd> vi;
+    // Pin the current residual epoch. updateGlobal never writes to a published
+    // epoch, so it can be read without copying.
+    std::shared_ptr<const VectorXd> epsilon;
+    std::shared_ptr<const VectorXd> vi;
     {
-        std::shared_lock lock(m_mutex);
-        epsilon = std::make_shared<VectorXd>(*m_epsilon);
-        vi = std::make_shared<VectorXd>(*m_vi);
+        std::shared_lock lock(m_mutex, std::defer_lock);
+        lockTimed(lock, m_graphStats, m_sharedLockStat);
+        epsilon = m_epsilon;
+        vi = m_vi;
     }
 
     // No shared mutex for reading because no other thread writes to the values
@@ -852,35 +806,25 @@ std::unique_ptr<AsyncResult> BayesWBase::processColumnAsync(const KernelPtr &ker
     result->betaOld = beta_old;
     result->beta = beta_old;
 
-    //Change the residual vector only if the previous beta was non-zero
-    if(beta_old != 0.0){
-        *epsilon += *gaussKernel->calculateResidualUpdate(beta_old);
-        //Also find the transformed residuals
-        *vi = (m_alpha*epsilon->array()-EuMasc).exp();
-    }
-
-    gaussKernel->setVi(vi);
+    // The epoch still includes beta_old, which the kernel removes from vi
+    gaussKernel->setViExcluding(vi, m_alpha, beta_old, m_viScratch.local());
     gaussKernel->calculateSumFailure(m_failure_vector);
 
     /* Calculate the mixture probability */
-    const double p = m_randomNumbers.at(kernel->marker->i);
+    const double p = m_rng.stream(m_iteration, kernel->marker->i).unif();
 
     // Calculate the (ratios of) marginal likelihoods
     VectorXd marginal_likelihoods {m_K}; // likelihood for each mixture component
-    // First element for the marginal likelihoods is always is pi_0 *sqrt(pi) for
-    marginal_likelihoods(0) = m_pi_L(0) * sqrtPI;
-    {
-        const double exp_sum = gaussKernel->exponent_sum();
-
-        for(int i=0; i < m_mixture_classes.size(); i++){
-            //Calculate the sigma for the adaptive G-H
-            double sigma = 1.0/sqrt(1 + m_alpha * m_alpha * m_sigma_b * m_mixture_classes(i) * exp_sum);
-            marginal_likelihoods(i+1) = m_pi_L(i+1) * gauss_hermite_adaptive_integral(i, sigma, m_quad_points, gaussKernel);
-        }
-    }
+    // The flow graph already keeps every core busy, so do not nest parallelism here
+    const int marker = static_cast<int>(gaussKernel->marker->i);
+    TraceSpan likelihoodSpan("marginalLikelihoods", marker);
+    marginalLikelihoods(gaussKernel, false, marginal_likelihoods);
+    likelihoodSpan.end();
     // Calculate the probability that marker is 0
     double acum = marginal_likelihoods(0)/marginal_likelihoods.sum();
 
+    TraceSpan betaSpan("sampleBeta", marker);
+
     result->v = std::make_unique<VectorXd>(VectorXd::Zero(m_K));
     int component = 0;
     //Loop through the possible mixture classes
@@ -897,6 +841,7 @@ std::unique_ptr<AsyncResult> BayesWBase::processColumnAsync(const KernelPtr &ker
                 params.sigma_b = m_sigma_b;
                 params.sum_failure = gaussKernel->sum_failure;
                 params.used_mixture = m_mixture_classes(k-1);
+                params.residual_beta = beta_old;
 
                 double safe_limit = 2 * sqrt(m_sigma_b * m_mixture_classes(k-1));
 
@@ -907,16 +852,18 @@ std::unique_ptr<AsyncResult> BayesWBase::processColumnAsync(const KernelPtr &ker
                 double convex = 1.0;
                 int dometrop = 0;
                 double xprev = 0.0;
-                double xinit[4] = {beta_old - safe_limit/10 , beta_old,  beta_old + safe_limit/20, beta_old + safe_limit/10};     // Initial abscissae
-                double *p_xinit = xinit;
-
                 double xl = beta_old - safe_limit  ; //Construct the hull around previous beta value
                 double xr = beta_old + safe_limit;
 
+                double xinit[4];     // Initial abscissae
+                initialBetaAbscissae(gaussKernel->marker->i, beta_old, safe_limit, xl, xr, xinit);
+
                 // Sample using ARS
+                ArmsStream armsStream(m_rng.stream(m_iteration, gaussKernel->marker->i, BetaStream));
                 err = estimateBeta(gaussKernel,epsilon,xinit,ninit,&xl,&xr, params, &convex,
                         npoint,dometrop,&xprev,xsamp,nsamp,qcent,xcent,ncent,&neval);
                 errorCheck(err);
+                m_arsCache.store(gaussKernel->marker->i, xcent);
 
                 result->beta = xsamp[0]; // Save the new result
             }
@@ -933,12 +880,18 @@ std::unique_ptr<AsyncResult> BayesWBase::processColumnAsync(const KernelPtr &ker
         }
     }
 
+    betaSpan.end();
+
     // Only update m_epsilon if required
     const bool skipUpdate = result->betaOld == 0.0 && result->beta == 0.0;
     if (!skipUpdate) {
+        TraceSpan span("updateEpsilon", marker);
         result->deltaEpsilon = gaussKernel->calculateEpsilonChange(result->betaOld, result->beta);
     }
 
+    // The kernel lives on in the graph, but its vi is no longer needed
+    gaussKernel->releaseVi();
+
     m_components(gaussKernel->marker->i) = component;
     m_beta(gaussKernel->marker->i) = result->beta;
 
@@ -960,10 +913,27 @@ void BayesWBase::updateGlobal(const KernelPtr& kernel,
 {
     assert(kernel);
     assert(result);
-    (void) kernel; // Unused
 
-    std::unique_lock lock(m_mutex);
+    TraceSpan span("globalUpdate", static_cast<int>(kernel->marker->i));
+
+    // Write the next epoch into a spare which no worker has pinned. Only this
+    // serial node swaps epochs, so the published pair can be read without the
+    // lock, and a spare cannot be pinned again until it is published.
+    auto spare = std::find_if(m_spareEpochs.begin(), m_spareEpochs.end(), [](const ResidualEpoch &epoch) {
+        return epoch.epsilon.use_count() == 1 && epoch.vi.use_count() == 1;
+    });
+    if (spare == m_spareEpochs.end()) {
+        m_spareEpochs.push_back({std::make_shared<VectorXd>(m_epsilon->size()),
+                                 std::make_shared<VectorXd>(m_vi->size())});
+        spare = std::prev(m_spareEpochs.end());
+    }
+
+    *spare->epsilon = *m_epsilon + *result->deltaEpsilon;
+    *spare->vi = (m_alpha*spare->epsilon->array()-EuMasc).exp();
 
-    *m_epsilon += *result->deltaEpsilon;
-    *m_vi = (m_alpha*m_epsilon->array()-EuMasc).exp();
+    // Publish the new epoch
+    std::unique_lock lock(m_mutex, std::defer_lock);
+    lockTimed(lock, m_graphStats, m_exclusiveLockStat);
+    m_epsilon.swap(spare->epsilon);
+    m_vi.swap(spare->vi);
 }
@@ -9,19 +9,27 @@
 #define BAYESWBASE_H_
 
 #include "analysis.h"
+#include "arswarmstartcache.h"
 #include "common.h"
+#include "counterrng.h"
 #include "distributions_boost.hpp"
 
+#include "tbb/enumerable_thread_specific.h"
+
 #include <Eigen/Eigen>
 #include <shared_mutex>
+#include <vector>
 
 struct BayesWKernel;
+struct GaussHermiteRule;
+class Checkpoint;
 
 struct beta_params {
     double alpha = 0;
     double sigma_b = 0;
     double sum_failure = 0;
     double used_mixture = 0;
+    double residual_beta = 0; // Effect of the marker still included in epsilon
 };
 
 class BayesWBase : public Analysis
@@ -40,6 +48,7 @@ protected:
     const double    m_alpha_sigma  = 1;
     const double    m_beta_sigma   = 0.0001;
     const string 	m_quad_points; // Number of Gaussian quadrature points
+    const GaussHermiteRule *m_quadRule = nullptr; // The rule for m_quad_points, set by runGibbs
     const int 		m_K; //number of mixtures + 0 class
 
     Distributions_boost m_dist;
@@ -62,11 +71,28 @@ protected:
     VectorXd m_sum_failure_fix;
 
     std::shared_ptr<VectorXd> m_epsilon = nullptr; //Vector for residuals
+
+    // Buffers for the next residual epoch written by updateGlobal. Workers
+    // pin the published m_epsilon/m_vi pair instead of copying it, so an
+    // epoch is recycled once no worker holds it. The pool only grows while
+    // more epochs are pinned at once than it holds.
+    struct ResidualEpoch {
+        std::shared_ptr<VectorXd> epsilon;
+        std::shared_ptr<VectorXd> vi;
+    };
+    std::vector<ResidualEpoch> m_spareEpochs;
+
+    // vi of the marker each worker is analysing, with beta_old removed
+    tbb::enumerable_thread_specific<std::shared_ptr<VectorXd>> m_viScratch;
     double m_alpha = 0;
     double m_mu = 0;
     double m_sigma_b = 0;
 
-    std::vector<double> m_randomNumbers;
+    // Per marker random numbers, keyed by (seed, iteration, marker)
+    CounterRng m_rng;
+    unsigned int m_iteration = 0;
+
+    ArsWarmStartCache m_arsCache; // previous envelope centiles per marker
 
     mutable std::shared_mutex m_mutex;
 
@@ -88,11 +114,23 @@ protected:
     void sampleTheta(int fix_i);
 	void sampleAlpha();
 
-    double gauss_hermite_adaptive_integral(int k, double sigma, string n, const BayesWKernel *kernel);
+    double gauss_hermite_adaptive_integral(int k, double sigma, const BayesWKernel *kernel);
+
+    // Fills marginal_likelihoods with the likelihood of each mixture component.
+    // When batched, all classes and quadrature nodes are evaluated by the kernel
+    // in one (parallel) sweep over the individuals.
+    void marginalLikelihoods(const BayesWKernel *kernel, bool batched, VectorXd &marginal_likelihoods);
+
+    virtual void prepareForAnalysis(unsigned int iteration);
+
+    // The chain state which is not derived from the data or options
+    void saveState(Checkpoint &checkpoint) const;
+    bool restoreState(const Checkpoint &checkpoint);
 
-    virtual void prepareForAnalysis();
+    void initialBetaAbscissae(unsigned int marker, double beta_old, double safe_limit,
+                              double xl, double xr, double *xinit) const;
 
-    virtual int estimateBeta (const BayesWKernel *kernel, const std::shared_ptr<VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params,
+    virtual int estimateBeta (const BayesWKernel *kernel, const std::shared_ptr<const VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params,
                           double *convex, int npoint, int dometrop, double *xprev, double *xsamp,
                           int nsamp, double *qcent, double *xcent,
                           int ncent, int *neval) = 0;
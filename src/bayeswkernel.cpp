@@ -1,3 +1,31 @@
 #include "bayeswkernel.h"
 
 BayesWKernel::~BayesWKernel() = default;
+
+void BayesWKernel::setViExcluding(const std::shared_ptr<const VectorXd> &vi, double alpha, double beta_old,
+                                  std::shared_ptr<VectorXd> &scratch)
+{
+    if (beta_old == 0.0) {
+        setVi(vi);
+        return;
+    }
+
+    if (!scratch || scratch.use_count() > 1 || scratch->size() != vi->size())
+        scratch = std::make_shared<VectorXd>(vi->size());
+
+    // exp(alpha * (epsilon + delta) - EuMasc) = vi * exp(alpha * delta)
+    const auto delta = calculateResidualUpdate(beta_old);
+    scratch->array() = vi->array() * (alpha * delta->array()).exp();
+    setVi(scratch);
+}
+
+VectorXd BayesWKernel::integrand_adaptive(const VectorXd &s, double alpha, const VectorXd &sqrt_2Ck_sigmab) const
+{
+    assert(s.size() == sqrt_2Ck_sigmab.size());
+
+    VectorXd result(s.size());
+    for (Index i = 0; i < s.size(); ++i)
+        result(i) = integrand_adaptive(s(i), alpha, sqrt_2Ck_sigmab(i));
+
+    return result;
+}
@@ -15,7 +15,15 @@ struct BayesWKernel : public Kernel
 
     double sum_failure = 0;
 
-    virtual void setVi(const std::shared_ptr<VectorXd>& vi) = 0;
+    virtual void setVi(const std::shared_ptr<const VectorXd>& vi) = 0;
+    // As setVi, but vi was calculated from residuals which still include this
+    // marker's beta_old; the kernel removes that effect itself. Kernels which
+    // keep a copy of vi write it into scratch, which is reallocated only when
+    // another kernel still holds it.
+    virtual void setViExcluding(const std::shared_ptr<const VectorXd>& vi, double alpha, double beta_old,
+                                std::shared_ptr<VectorXd> &scratch);
+    // Drops any reference to vi once the marker has been analysed
+    virtual void releaseVi() {}
     // Should really be done as part of the preprocess step
     virtual void calculateSumFailure(const VectorXd &failure_vector) = 0;
 
@@ -25,6 +33,9 @@ struct BayesWKernel : public Kernel
     virtual double exponent_sum() const = 0;
     virtual double integrand_adaptive(double s, double alpha, double sqrt_2Ck_sigmab) const = 0;
 
+    // Evaluates the integrand at every (s[i], sqrt_2Ck_sigmab[i]) pair
+    virtual VectorXd integrand_adaptive(const VectorXd &s, double alpha, const VectorXd &sqrt_2Ck_sigmab) const;
+
 protected:
 };
 
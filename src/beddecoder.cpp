@@ -0,0 +1,72 @@
+#include "beddecoder.h"
+
+#include "data.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+using ByteCodes = std::array<unsigned char, 4>;
+
+// BED stores each genotype as 2 bits, lowest bits first:
+// 00 homozygous first allele, 01 missing, 10 heterozygous, 11 homozygous second allele.
+// The MarkerBuilders count the first allele, as (!b[k]) + (!b[k+1]) did.
+constexpr std::array<unsigned char, 4> kBedCodeToCount = {2, MarkerBuilder::kMissingGenotype, 1, 0};
+
+std::array<ByteCodes, 256> makeByteTable()
+{
+    std::array<ByteCodes, 256> table {};
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        for (unsigned int k = 0; k < 4; ++k)
+            table[byte][k] = kBedCodeToCount[(byte >> (2 * k)) & 3];
+    }
+    return table;
+}
+
+const std::array<ByteCodes, 256> kByteTable = makeByteTable();
+
+}
+
+std::shared_ptr<const BedDecoder::IndividualList> BedDecoder::keptIndividuals(const Data *data)
+{
+    assert(data);
+
+    auto kept = std::make_shared<IndividualList>();
+    kept->reserve(data->numInds);
+    for (unsigned int i = 0; i < data->numInds; ++i) {
+        if (data->indInfoVec[i]->kept)
+            kept->push_back(i);
+    }
+
+    return kept;
+}
+
+BedDecoder::BedDecoder(unsigned int numInds, const std::shared_ptr<const IndividualList> &kept)
+    : m_numInds(numInds)
+    , m_kept(kept)
+    , m_allKept(kept->size() == numInds)
+    , m_codes(columnSize(numInds) * 4)
+    , m_compacted(m_allKept ? 0 : kept->size())
+{
+    assert(m_kept);
+}
+
+GenotypeColumn BedDecoder::decode(const unsigned char *column)
+{
+    const size_t bytes = columnSize(m_numInds);
+    unsigned char *codes = m_codes.data();
+    for (size_t byte = 0; byte < bytes; ++byte)
+        std::memcpy(codes + 4 * byte, kByteTable[column[byte]].data(), 4);
+
+    if (m_allKept)
+        return {codes, m_kept->data(), m_numInds};
+
+    const auto &kept = *m_kept;
+    for (size_t k = 0; k < kept.size(); ++k)
+        m_compacted[k] = codes[kept[k]];
+
+    return {m_compacted.data(), kept.data(), kept.size()};
+}
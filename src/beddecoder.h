@@ -0,0 +1,42 @@
+#ifndef BEDDECODER_H
+#define BEDDECODER_H
+
+#include "markerbuilder.h"
+
+#include <memory>
+#include <vector>
+
+class Data;
+
+// Decodes SNP-major PLINK BED columns (2 bits per individual) into the allele
+// counts expected by MarkerBuilder::processColumn. Each byte is decoded with a
+// lookup table into four codes at once, and individuals which are not kept are
+// dropped using a precomputed compaction list.
+//
+// A decoder owns its output buffers, so use one per thread.
+class BedDecoder
+{
+public:
+    using IndividualList = std::vector<unsigned int>;
+
+    // Indices of the individuals in data which are kept for analysis
+    static std::shared_ptr<const IndividualList> keptIndividuals(const Data *data);
+
+    BedDecoder(unsigned int numInds, const std::shared_ptr<const IndividualList> &kept);
+
+    // Number of bytes used by one SNP in the BED file
+    static size_t columnSize(unsigned int numInds) { return (numInds + 3) >> 2; }
+
+    // The returned column is valid until the next call to decode
+    GenotypeColumn decode(const unsigned char *column);
+
+private:
+    const unsigned int m_numInds = 0;
+    const std::shared_ptr<const IndividualList> m_kept;
+    const bool m_allKept = true;
+
+    std::vector<unsigned char> m_codes;
+    std::vector<unsigned char> m_compacted;
+};
+
+#endif // BEDDECODER_H
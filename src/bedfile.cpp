@@ -0,0 +1,73 @@
+#include "bedfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+BedFile::BedFile(const std::string &file)
+{
+    const int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Error: can not open the file [" + file + "] to read." << std::endl;
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size <= 0) {
+        std::cerr << "Error: can not read the size of [" + file + "]." << std::endl;
+        close(fd);
+        return;
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Failed to mmap bed file [" + file + "]." << std::endl;
+        m_size = 0;
+        return;
+    }
+
+    // Columns are mostly read front to back, so ask for aggressive read-ahead
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const unsigned char *>(data);
+}
+
+BedFile::~BedFile()
+{
+    if (m_data)
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+}
+
+bool BedFile::hasValidHeader() const
+{
+    return m_size >= kHeaderSize && m_data[0] == 0x6c && m_data[1] == 0x1b && m_data[2] == 0x01;
+}
+
+bool BedFile::hasColumns(size_t snpCount, size_t columnSize) const
+{
+    return m_data && m_size >= kHeaderSize + snpCount * columnSize;
+}
+
+void BedFile::willNeed(size_t snp, size_t snpCount, size_t columnSize) const
+{
+    if (!m_data || snpCount == 0)
+        return;
+
+    // madvise needs a page aligned start address
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+    const size_t begin = kHeaderSize + snp * columnSize;
+    const size_t alignedBegin = begin - (begin % pageSize);
+    const size_t end = std::min(m_size, begin + snpCount * columnSize);
+    if (end <= alignedBegin)
+        return;
+
+    madvise(const_cast<unsigned char *>(m_data) + alignedBegin, end - alignedBegin, MADV_WILLNEED);
+}
@@ -0,0 +1,39 @@
+#ifndef BEDFILE_H
+#define BEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory map of a SNP-major PLINK BED file. A single instance can be
+// shared by any number of threads; columns are handed out as pointers into the
+// mapping, so readers decode straight from the page cache without copying.
+class BedFile
+{
+public:
+    static constexpr size_t kHeaderSize = 3;
+
+    explicit BedFile(const std::string &file);
+    ~BedFile();
+
+    BedFile(const BedFile &) = delete;
+    BedFile &operator=(const BedFile &) = delete;
+
+    bool isMapped() const { return m_data != nullptr; }
+    bool hasValidHeader() const;
+
+    // True if the file holds snpCount columns of columnSize bytes
+    bool hasColumns(size_t snpCount, size_t columnSize) const;
+
+    const unsigned char *column(size_t snp, size_t columnSize) const {
+        return m_data + kHeaderSize + snp * columnSize;
+    }
+
+    // Hints that snpCount columns starting at snp will be read soon
+    void willNeed(size_t snp, size_t snpCount, size_t columnSize) const;
+
+private:
+    const unsigned char *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif // BEDFILE_H
@@ -0,0 +1,307 @@
+#include "checkpoint.h"
+#include "atomicfile.h"
+#include "options.hpp"
+#include "posteriorsummary.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char kMagic[4] = {'B', 'C', 'K', 'P'};
+constexpr uint32_t kVersion = 1;
+
+template<typename T>
+void writeValue(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream &in, T &value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+// Records holding arrays start with their dimensions
+template<typename Scalar>
+std::string encode(const Scalar *data, int64_t rows, int64_t cols)
+{
+    std::string bytes(2 * sizeof(int64_t) + static_cast<size_t>(rows * cols) * sizeof(Scalar), '\0');
+    std::memcpy(&bytes[0], &rows, sizeof(rows));
+    std::memcpy(&bytes[sizeof(rows)], &cols, sizeof(cols));
+    if (rows * cols > 0)
+        std::memcpy(&bytes[2 * sizeof(int64_t)], data, static_cast<size_t>(rows * cols) * sizeof(Scalar));
+    return bytes;
+}
+
+template<typename Scalar>
+bool decodeSize(const std::string &bytes, int64_t &rows, int64_t &cols)
+{
+    if (bytes.size() < 2 * sizeof(int64_t))
+        return false;
+    std::memcpy(&rows, bytes.data(), sizeof(rows));
+    std::memcpy(&cols, bytes.data() + sizeof(rows), sizeof(cols));
+    return rows >= 0 && cols >= 0
+            && bytes.size() == 2 * sizeof(int64_t) + static_cast<size_t>(rows * cols) * sizeof(Scalar);
+}
+
+template<typename Scalar>
+void decodeData(const std::string &bytes, Scalar *data, int64_t count)
+{
+    if (count > 0)
+        std::memcpy(data, bytes.data() + 2 * sizeof(int64_t), static_cast<size_t>(count) * sizeof(Scalar));
+}
+
+}
+
+void Checkpoint::set(const std::string &name, const std::string &bytes)
+{
+    m_records[name] = bytes;
+}
+
+void Checkpoint::set(const std::string &name, double value)
+{
+    set(name, encode(&value, 1, 1));
+}
+
+void Checkpoint::set(const std::string &name, const Eigen::MatrixXd &matrix)
+{
+    set(name, encode(matrix.data(), matrix.rows(), matrix.cols()));
+}
+
+void Checkpoint::set(const std::string &name, const Eigen::VectorXd &vector)
+{
+    set(name, encode(vector.data(), vector.size(), 1));
+}
+
+void Checkpoint::set(const std::string &name, const Eigen::VectorXi &vector)
+{
+    set(name, encode(vector.data(), vector.size(), 1));
+}
+
+void Checkpoint::set(const std::string &name, const std::vector<unsigned int> &vector)
+{
+    set(name, encode(vector.data(), static_cast<int64_t>(vector.size()), 1));
+}
+
+bool Checkpoint::get(const std::string &name, std::string &bytes) const
+{
+    const auto it = m_records.find(name);
+    if (it == m_records.cend())
+        return false;
+    bytes = it->second;
+    return true;
+}
+
+bool Checkpoint::get(const std::string &name, double &value) const
+{
+    std::string bytes;
+    int64_t rows, cols;
+    if (!get(name, bytes) || !decodeSize<double>(bytes, rows, cols) || rows * cols != 1)
+        return false;
+    decodeData(bytes, &value, 1);
+    return true;
+}
+
+bool Checkpoint::get(const std::string &name, Eigen::MatrixXd &matrix) const
+{
+    std::string bytes;
+    int64_t rows, cols;
+    if (!get(name, bytes) || !decodeSize<double>(bytes, rows, cols))
+        return false;
+    matrix.resize(rows, cols);
+    decodeData(bytes, matrix.data(), rows * cols);
+    return true;
+}
+
+bool Checkpoint::get(const std::string &name, Eigen::VectorXd &vector) const
+{
+    std::string bytes;
+    int64_t rows, cols;
+    if (!get(name, bytes) || !decodeSize<double>(bytes, rows, cols) || cols != 1)
+        return false;
+    vector.resize(rows);
+    decodeData(bytes, vector.data(), rows);
+    return true;
+}
+
+bool Checkpoint::get(const std::string &name, Eigen::VectorXi &vector) const
+{
+    std::string bytes;
+    int64_t rows, cols;
+    if (!get(name, bytes) || !decodeSize<int>(bytes, rows, cols) || cols != 1)
+        return false;
+    vector.resize(rows);
+    decodeData(bytes, vector.data(), rows);
+    return true;
+}
+
+bool Checkpoint::get(const std::string &name, std::vector<unsigned int> &vector) const
+{
+    std::string bytes;
+    int64_t rows, cols;
+    if (!get(name, bytes) || !decodeSize<unsigned int>(bytes, rows, cols) || cols != 1)
+        return false;
+    vector.resize(static_cast<size_t>(rows));
+    decodeData(bytes, vector.data(), rows);
+    return true;
+}
+
+bool Checkpoint::write(const std::string &fileName) const
+{
+    const bool written = writeFileAtomically(fileName, [this] (std::ostream &out) {
+        out.write(kMagic, sizeof(kMagic));
+        writeValue(out, kVersion);
+        writeValue(out, static_cast<uint64_t>(m_records.size()));
+        for (const auto &record : m_records) {
+            writeValue(out, static_cast<uint64_t>(record.first.size()));
+            out.write(record.first.data(), static_cast<std::streamsize>(record.first.size()));
+            writeValue(out, static_cast<uint64_t>(record.second.size()));
+            out.write(record.second.data(), static_cast<std::streamsize>(record.second.size()));
+        }
+    }, std::ios::binary);
+
+    if (!written)
+        std::cerr << "Could not write checkpoint to " << fileName << std::endl;
+    return written;
+}
+
+bool Checkpoint::read(const std::string &fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in) {
+        std::cerr << "Could not open checkpoint " << fileName << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0
+            || !readValue(in, version) || version != kVersion || !readValue(in, count)) {
+        std::cerr << "Not a checkpoint file: " << fileName << std::endl;
+        return false;
+    }
+
+    m_records.clear();
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t nameSize = 0;
+        uint64_t size = 0;
+        std::string name;
+        std::string bytes;
+        if (!readValue(in, nameSize))
+            break;
+        name.resize(nameSize);
+        if (!in.read(&name[0], static_cast<std::streamsize>(nameSize)) || !readValue(in, size))
+            break;
+        bytes.resize(size);
+        if (!in.read(&bytes[0], static_cast<std::streamsize>(size)))
+            break;
+        m_records.emplace(std::move(name), std::move(bytes));
+    }
+
+    if (m_records.size() != count) {
+        std::cerr << "Truncated checkpoint file: " << fileName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    wait();
+}
+
+void CheckpointWriter::write(Checkpoint &&checkpoint, const std::string &fileName)
+{
+    wait();
+    m_pending = std::async(std::launch::async, [checkpoint = std::move(checkpoint), fileName]() {
+        return checkpoint.write(fileName);
+    });
+}
+
+bool CheckpointWriter::wait()
+{
+    if (!m_pending.valid())
+        return true;
+    return m_pending.get();
+}
+
+ChainCheckpoint::ChainCheckpoint(const Options *opt, SaveHook save, RestoreHook restore)
+    : m_opt(opt)
+    , m_save(std::move(save))
+    , m_restore(std::move(restore))
+{
+}
+
+void ChainCheckpoint::addOutputFile(const std::string &fileName)
+{
+    m_outputFiles.push_back(fileName);
+}
+
+bool ChainCheckpoint::resume(unsigned int &startIteration, std::vector<unsigned int> &markerI,
+                             PosteriorSummary *summary)
+{
+    startIteration = 0;
+    if (!m_opt->resume)
+        return true;
+
+    Checkpoint checkpoint;
+    double iteration = 0;
+    Eigen::VectorXd fileSizes;
+    const auto markerCount = markerI.size();
+    if (!checkpoint.read(m_opt->checkpointFile)
+            || !checkpoint.get("iteration", iteration)
+            || !checkpoint.get("outputFileSizes", fileSizes)
+            || fileSizes.size() != static_cast<Eigen::Index>(m_outputFiles.size())
+            || !checkpoint.get("markerI", markerI) || markerI.size() != markerCount
+            || !m_restore(checkpoint)
+            || (summary && !summary->restore(checkpoint))) {
+        std::cerr << "Could not resume from checkpoint " << m_opt->checkpointFile << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < m_outputFiles.size(); ++i) {
+        std::error_code error;
+        std::filesystem::resize_file(m_outputFiles[i],
+                                     static_cast<std::uintmax_t>(fileSizes[static_cast<Eigen::Index>(i)]),
+                                     error);
+        if (error) {
+            std::cerr << "Could not truncate " << m_outputFiles[i] << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+
+    startIteration = static_cast<unsigned int>(iteration);
+    std::cout << "Resuming from iteration " << startIteration << std::endl;
+    return true;
+}
+
+bool ChainCheckpoint::isDue(unsigned int iteration) const
+{
+    return !m_opt->checkpointFile.empty() && m_opt->checkpointInterval > 0
+            && (iteration + 1) % m_opt->checkpointInterval == 0;
+}
+
+void ChainCheckpoint::save(unsigned int iteration, const std::vector<unsigned int> &markerI,
+                           const PosteriorSummary *summary)
+{
+    Eigen::VectorXd fileSizes(static_cast<Eigen::Index>(m_outputFiles.size()));
+    for (size_t i = 0; i < m_outputFiles.size(); ++i)
+        fileSizes[static_cast<Eigen::Index>(i)] = static_cast<double>(std::filesystem::file_size(m_outputFiles[i]));
+
+    Checkpoint checkpoint;
+    checkpoint.set("iteration", static_cast<double>(iteration + 1));
+    checkpoint.set("outputFileSizes", fileSizes);
+    checkpoint.set("markerI", markerI);
+    m_save(checkpoint);
+    if (summary) {
+        summary->save(checkpoint);
+        summary->write(m_opt->summaryFile);
+    }
+    m_writer.write(std::move(checkpoint), m_opt->checkpointFile);
+}
@@ -0,0 +1,98 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Eigen/Eigen>
+
+#include <functional>
+#include <future>
+#include <map>
+#include <string>
+#include <vector>
+
+class Options;
+class PosteriorSummary;
+
+// The state of a chain as a set of named records, so that a run can be
+// resumed where it stopped.
+class Checkpoint
+{
+public:
+    void set(const std::string &name, const std::string &bytes);
+    void set(const std::string &name, double value);
+    void set(const std::string &name, const Eigen::MatrixXd &matrix);
+    void set(const std::string &name, const Eigen::VectorXd &vector);
+    void set(const std::string &name, const Eigen::VectorXi &vector);
+    void set(const std::string &name, const std::vector<unsigned int> &vector);
+
+    // Each returns false if the record is missing or has the wrong size
+    bool get(const std::string &name, std::string &bytes) const;
+    bool get(const std::string &name, double &value) const;
+    bool get(const std::string &name, Eigen::MatrixXd &matrix) const;
+    bool get(const std::string &name, Eigen::VectorXd &vector) const;
+    bool get(const std::string &name, Eigen::VectorXi &vector) const;
+    bool get(const std::string &name, std::vector<unsigned int> &vector) const;
+
+    bool write(const std::string &fileName) const;
+    bool read(const std::string &fileName);
+
+private:
+    std::map<std::string, std::string> m_records;
+};
+
+// Writes checkpoints on a background thread. At most one write is in flight;
+// write() waits for the previous one first.
+class CheckpointWriter
+{
+public:
+    ~CheckpointWriter();
+
+    void write(Checkpoint &&checkpoint, const std::string &fileName);
+
+    // Returns false if the last write failed
+    bool wait();
+
+private:
+    std::future<bool> m_pending;
+};
+
+// The checkpoint handling shared by the analyses. Besides the state added by
+// the analysis hooks, a checkpoint holds the iteration, the marker order, the
+// posterior summary and the length of each output file. Resuming truncates
+// the output files to those lengths, so that the output matches an
+// uninterrupted run.
+class ChainCheckpoint
+{
+public:
+    using SaveHook = std::function<void(Checkpoint &)>;
+    using RestoreHook = std::function<bool(const Checkpoint &)>;
+
+    ChainCheckpoint(const Options *opt, SaveHook save, RestoreHook restore);
+
+    // Files whose length is recorded, such as the samples and the iteration log
+    void addOutputFile(const std::string &fileName);
+
+    // With --resume, restores the chain and sets startIteration to the first
+    // iteration not yet run. Returns false if it could not be restored.
+    bool resume(unsigned int &startIteration, std::vector<unsigned int> &markerI,
+                PosteriorSummary *summary);
+
+    // Whether a checkpoint is due once iteration has finished
+    bool isDue(unsigned int iteration) const;
+
+    // Writes the checkpoint taken after iteration on a background thread.
+    // The output files must be flushed first.
+    void save(unsigned int iteration, const std::vector<unsigned int> &markerI,
+              const PosteriorSummary *summary);
+
+    // Returns false if the last write failed
+    bool wait() { return m_writer.wait(); }
+
+private:
+    const Options *m_opt;
+    SaveHook m_save;
+    RestoreHook m_restore;
+    std::vector<std::string> m_outputFiles;
+    CheckpointWriter m_writer;
+};
+
+#endif // CHECKPOINT_H
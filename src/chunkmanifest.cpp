@@ -0,0 +1,237 @@
+#include "chunkmanifest.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'P', 'C', 'M'};
+constexpr unsigned int kVersion = 1;
+
+template<typename T>
+void writeValue(std::ostream &stream, const T &value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream &stream, T &value)
+{
+    stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return static_cast<bool>(stream);
+}
+
+// Writes all of bytes and syncs them to the disk
+bool writeSynced(int fd, const std::string &bytes)
+{
+    size_t done = 0;
+    while (done < bytes.size()) {
+        const auto written = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        done += static_cast<size_t>(written);
+    }
+    return ::fsync(fd) == 0;
+}
+
+bool operator==(const ChunkManifest::Header &a, const ChunkManifest::Header &b)
+{
+    return a.type == b.type &&
+            a.compress == b.compress &&
+            a.numSnps == b.numSnps &&
+            a.numInds == b.numInds &&
+            a.chunkSize == b.chunkSize &&
+            a.basePosition == b.basePosition &&
+            a.baseIndexCount == b.baseIndexCount;
+}
+
+}
+
+ChunkManifest::ChunkManifest(const std::string &file)
+    : m_file(file)
+{
+
+}
+
+ChunkManifest::~ChunkManifest()
+{
+    if (m_fd != -1) {
+        sync();
+        ::close(m_fd);
+    }
+}
+
+bool ChunkManifest::load(const Header &expected,
+                         std::set<size_t> &completedChunks,
+                         std::vector<Entry> &entries)
+{
+    std::ifstream input(m_file.c_str(), std::ios::binary);
+    if (!input)
+        return false;
+
+    char magic[4];
+    unsigned int version = 0;
+    Header header;
+    input.read(magic, sizeof(magic));
+    if (!input || std::memcmp(magic, kMagic, sizeof(magic)) != 0 ||
+            !readValue(input, version) || version != kVersion) {
+        std::cerr << "Ignoring unreadable preprocessing manifest: " << m_file << std::endl;
+        return false;
+    }
+
+    if (!readValue(input, header.type) ||
+            !readValue(input, header.compress) ||
+            !readValue(input, header.numSnps) ||
+            !readValue(input, header.numInds) ||
+            !readValue(input, header.chunkSize) ||
+            !readValue(input, header.basePosition) ||
+            !readValue(input, header.baseIndexCount) ||
+            !(header == expected)) {
+        std::cerr << "Preprocessing manifest " << m_file
+                  << " was written with different settings and cannot be resumed" << std::endl;
+        return false;
+    }
+
+    // Read whole records only; a partial trailing record is from an interrupted write
+    m_loadedSize = input.tellg();
+    for (;;) {
+        unsigned long chunk = 0;
+        unsigned long count = 0;
+        if (!readValue(input, chunk) || !readValue(input, count))
+            break;
+
+        std::vector<Entry> chunkEntries(count);
+        bool complete = true;
+        for (auto &entry : chunkEntries) {
+            complete = readValue(input, entry.snp) &&
+                    readValue(input, entry.index.pos) &&
+                    readValue(input, entry.index.compressedSize) &&
+                    readValue(input, entry.index.originalSize);
+            if (!complete)
+                break;
+        }
+
+        if (!complete)
+            break;
+
+        completedChunks.insert(chunk);
+        entries.insert(entries.end(), chunkEntries.cbegin(), chunkEntries.cend());
+        m_loadedSize = input.tellg();
+    }
+
+    return true;
+}
+
+bool ChunkManifest::create(const Header &header)
+{
+    m_fd = ::open(m_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (m_fd == -1) {
+        std::cerr << "Error: Unable to open the preprocessing manifest [" + m_file + "] for writing." << std::endl;
+        return false;
+    }
+
+    std::ostringstream output;
+    output.write(kMagic, sizeof(kMagic));
+    writeValue(output, kVersion);
+    writeValue(output, header.type);
+    writeValue(output, header.compress);
+    writeValue(output, header.numSnps);
+    writeValue(output, header.numInds);
+    writeValue(output, header.chunkSize);
+    writeValue(output, header.basePosition);
+    writeValue(output, header.baseIndexCount);
+
+    if (!writeSynced(m_fd, output.str())) {
+        std::cerr << "Error: Unable to write the preprocessing manifest [" + m_file + "]." << std::endl;
+        return false;
+    }
+    m_lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool ChunkManifest::reopen()
+{
+    std::error_code ec;
+    fs::resize_file(m_file, static_cast<std::uintmax_t>(m_loadedSize), ec);
+    if (ec) {
+        std::cerr << "Error: Unable to truncate the preprocessing manifest [" + m_file + "]: "
+                  << ec.message() << std::endl;
+        return false;
+    }
+
+    m_fd = ::open(m_file.c_str(), O_WRONLY | O_APPEND);
+    if (m_fd == -1) {
+        std::cerr << "Error: Unable to open the preprocessing manifest [" + m_file + "] for writing." << std::endl;
+        return false;
+    }
+
+    m_lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool ChunkManifest::record(size_t chunk, const std::vector<Entry> &entries)
+{
+    std::ostringstream output;
+    writeValue(output, static_cast<unsigned long>(chunk));
+    writeValue(output, static_cast<unsigned long>(entries.size()));
+    for (const auto &entry : entries) {
+        writeValue(output, entry.snp);
+        writeValue(output, entry.index.pos);
+        writeValue(output, entry.index.compressedSize);
+        writeValue(output, entry.index.originalSize);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd == -1)
+        return false;
+
+    m_pending += output.str();
+    if (std::chrono::steady_clock::now() - m_lastSync < kSyncInterval)
+        return true;
+    return syncPending();
+}
+
+bool ChunkManifest::sync()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fd != -1 && syncPending();
+}
+
+bool ChunkManifest::syncPending()
+{
+    m_lastSync = std::chrono::steady_clock::now();
+    if (m_pending.empty())
+        return true;
+
+    // The data must be on disk before the records that point at it
+    if (m_dataFd != -1 && ::fdatasync(m_dataFd) != 0)
+        return false;
+    if (!writeSynced(m_fd, m_pending))
+        return false;
+
+    m_pending.clear();
+    return true;
+}
+
+void ChunkManifest::remove()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_pending.clear();
+    std::remove(m_file.c_str());
+}
@@ -0,0 +1,83 @@
+#ifndef CHUNKMANIFEST_H
+#define CHUNKMANIFEST_H
+
+#include "common.h"
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Sidecar file recording which chunks of a preprocessing run have been
+// written, together with their index entries. A run that dies part way can be
+// resumed from it; only chunks that are missing are processed again.
+//
+// Records are made durable in groups, at most once per kSyncInterval: the
+// preprocessed file is synced first, then the records are appended and the
+// manifest is synced. A record therefore never points at data lost in a
+// crash, and a crash loses at most the chunks of the last interval. A record
+// cut short by a crash is ignored on load.
+class ChunkManifest
+{
+public:
+    struct Header {
+        unsigned int type = 0;
+        unsigned int compress = 0;
+        unsigned long numSnps = 0;
+        unsigned long numInds = 0;
+        unsigned long chunkSize = 0;
+        unsigned long basePosition = 0;   // where this run started writing data
+        unsigned long baseIndexCount = 0; // index entries that existed before this run
+    };
+
+    struct Entry {
+        unsigned long snp = 0;
+        IndexEntry index;
+    };
+
+    static constexpr std::chrono::seconds kSyncInterval {1};
+
+    explicit ChunkManifest(const std::string &file);
+    ~ChunkManifest();
+
+    const std::string &file() const { return m_file; }
+
+    // Reads a previous run. Returns false if there is no manifest or it was
+    // written for a different run.
+    bool load(const Header &expected,
+              std::set<size_t> &completedChunks,
+              std::vector<Entry> &entries);
+
+    // Starts a new manifest, or continues the one that was loaded after
+    // dropping any partial record at its end
+    bool create(const Header &header);
+    bool reopen();
+
+    // The preprocessed file the records point into, synced before each group
+    // of records. -1 when there is none.
+    void setDataFile(int fd) { m_dataFd = fd; }
+
+    // Thread safe. The record is on disk once the interval has passed or
+    // after the next sync().
+    bool record(size_t chunk, const std::vector<Entry> &entries);
+
+    // Makes all records so far durable. Also done on destruction.
+    bool sync();
+
+    // Deletes the manifest, dropping any records not yet synced
+    void remove();
+
+private:
+    const std::string m_file;
+    int m_fd = -1;
+    int m_dataFd = -1;
+    std::string m_pending; // records waiting for the next sync
+    std::chrono::steady_clock::time_point m_lastSync;
+    std::streamoff m_loadedSize = 0; // bytes up to the last complete record
+    std::mutex m_mutex;
+
+    bool syncPending();
+};
+
+#endif // CHUNKMANIFEST_H
@@ -2,6 +2,7 @@
 
 #include "densemarkerbuilder.h"
 #include "eigensparsemarkerbuilder.h"
+#include "packedmarkerbuilder.h"
 #include "raggedsparsemarkerbuilder.h"
 
 #include <cassert>
@@ -45,6 +46,9 @@ MarkerBuilder *builderForType(const PreprocessDataType type)
     case PreprocessDataType::SparseRagged:
         return new RaggedSparseMarkerBuilder;
 
+    case PreprocessDataType::Packed:
+        return new PackedMarkerBuilder;
+
     case PreprocessDataType::None:
         // Fall through
     default:
@@ -83,6 +87,9 @@ std::string ppFileForType(PreprocessDataType type, const std::string &dataFile)
     case PreprocessDataType::SparseRagged:
         return fileName +  ".ragged.sparsebed";
 
+    case PreprocessDataType::Packed:
+        return fileName +  ".packed.ppbed";
+
     default:
         std::cerr << "ppFileForType - unsupported DataType: "
              << type
@@ -106,6 +113,9 @@ std::string ppIndexFileForType(PreprocessDataType type, const std::string &dataF
     case PreprocessDataType::SparseRagged:
         return fileName + ".ragged.sparsebedindex";
 
+    case PreprocessDataType::Packed:
+        return fileName + ".packed.ppbedindex";
+
     default:
         std::cerr << "ppIndexFileForType - unsupported DataType: "
              << type
@@ -115,6 +125,35 @@ std::string ppIndexFileForType(PreprocessDataType type, const std::string &dataF
     }
 }
 
+std::vector<std::string> readDatasetManifest(const std::string &manifestFile)
+{
+    std::ifstream in(manifestFile.c_str());
+    if (!in)
+        throw ("Error: can not open the data set manifest [" + manifestFile + "] to read.");
+
+    const auto slash = manifestFile.find_last_of('/');
+    const std::string directory = slash == std::string::npos ? "" : manifestFile.substr(0, slash + 1);
+
+    std::vector<std::string> shards;
+    std::string line;
+    while (std::getline(in, line)) {
+        const auto begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+
+        const auto end = line.find_last_not_of(" \t\r");
+        auto shard = line.substr(begin, end - begin + 1);
+        if (shard[0] != '/')
+            shard = directory + shard;
+        shards.push_back(shard);
+    }
+
+    if (shards.empty())
+        throw ("Error: the data set manifest [" + manifestFile + "] does not list any shards.");
+
+    return shards;
+}
+
 InputType getInputType(const std::string &dataFile)
 {
     auto endsWith = [](std::string const & value, std::string const & ending)
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 enum class AnalysisType : unsigned int {
     Unknown = 0,
@@ -28,11 +29,18 @@ enum class PreprocessDataType : unsigned int {
     None = 0,
     Dense,
     SparseEigen,
-    SparseRagged
+    SparseRagged,
+    Packed
 };
 
 std::ostream &operator<<(std::ostream &os, const PreprocessDataType &obj);
 
+enum class SampleFormat : unsigned int {
+    Csv = 0,
+    Binary,     // float64
+    BinaryFloat // float32
+};
+
 struct Marker;
 using MarkerPtr = std::shared_ptr<Marker>;
 using ConstMarkerPtr = std::shared_ptr<const Marker>;
@@ -53,6 +61,10 @@ std::string ppIndexFileForType(PreprocessDataType type, const std::string &dataF
 
 InputType getInputType(const std::string &dataFile);
 
+// Reads the BED files of the shards listed in a data set manifest, one per line.
+// Relative paths are resolved against the directory of the manifest.
+std::vector<std::string> readDatasetManifest(const std::string &manifestFile);
+
 // An entry for the index to the compressed preprocessed bed file
 struct IndexEntry {
     unsigned long pos = 0;
@@ -98,10 +98,10 @@ unsigned long compressData(char *inputBuffer,
     return compressData(strm, outputSize);
 }
 
-void extractData(unsigned char *compressedData,
-                 unsigned int compressedDataSize,
-                 unsigned char *outputBuffer,
-                 unsigned int outputBufferSize)
+unsigned long extractData(unsigned char *compressedData,
+                          unsigned int compressedDataSize,
+                          unsigned char *outputBuffer,
+                          unsigned int outputBufferSize)
 {
     z_stream strm;
     strm.zalloc = nullptr;
@@ -119,10 +119,12 @@ void extractData(unsigned char *compressedData,
     strm.avail_in = compressedDataSize;
     const int flush = Z_FINISH;
     ret = inflate(&strm, flush);
+    const unsigned long extractedSize = strm.total_out;
+    (void) inflateEnd(&strm);
     if (ret != Z_STREAM_END)
         throw("Failed to verify compressed data");
 
-    (void) inflateEnd(&strm);
+    return extractedSize;
 }
 
 void writeUncompressedDataWithIndex(const unsigned char *data,
@@ -83,9 +83,10 @@ void compressAndWriteWithIndex(const VectorXd &data,
         unsigned char *compressedBuffer,
         const unsigned long maxCompressedOutputSize);
 
-void extractData(unsigned char *compressedData,
-                 unsigned int compressedDataSize,
-                 unsigned char *outputBuffer,
-                 unsigned int outputBufferSize);
+// Returns the number of bytes written to outputBuffer
+unsigned long extractData(unsigned char *compressedData,
+                          unsigned int compressedDataSize,
+                          unsigned char *outputBuffer,
+                          unsigned int outputBufferSize);
 
 #endif // COMPRESSION_H
@@ -0,0 +1,71 @@
+#include "counterrng.h"
+
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t kMultiplier0 = 0xD2511F53;
+constexpr uint32_t kMultiplier1 = 0xCD9E8D57;
+constexpr uint32_t kWeyl0 = 0x9E3779B9;
+constexpr uint32_t kWeyl1 = 0xBB67AE85;
+constexpr int kRounds = 10;
+
+constexpr double kTwoPi = 6.283185307179586476925286766559;
+
+inline void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo)
+{
+    const uint64_t product = static_cast<uint64_t>(a) * b;
+    hi = static_cast<uint32_t>(product >> 32);
+    lo = static_cast<uint32_t>(product);
+}
+
+}
+
+CounterRng::CounterRng(uint64_t seed)
+    : m_key({static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)})
+{
+}
+
+CounterRng::Block CounterRng::philox(Block counter, Key key)
+{
+    for (int round = 0; round < kRounds; ++round) {
+        uint32_t hi0, lo0, hi1, lo1;
+        mulhilo(kMultiplier0, counter[0], hi0, lo0);
+        mulhilo(kMultiplier1, counter[2], hi1, lo1);
+        counter = {hi1 ^ counter[1] ^ key[0], lo1, hi0 ^ counter[3] ^ key[1], lo0};
+        key[0] += kWeyl0;
+        key[1] += kWeyl1;
+    }
+    return counter;
+}
+
+CounterRng::Stream::Stream(const Key &key, uint32_t iteration, uint32_t marker, uint32_t purpose)
+    : m_key(key)
+    , m_counter({marker, iteration, 0, purpose})
+{
+}
+
+uint32_t CounterRng::Stream::next()
+{
+    if (m_used == 4) {
+        m_block = philox(m_counter, m_key);
+        ++m_counter[2];
+        m_used = 0;
+    }
+    return m_block[m_used++];
+}
+
+double CounterRng::Stream::unif()
+{
+    const uint64_t a = next() >> 5;
+    const uint64_t b = next() >> 6;
+    return static_cast<double>((a << 26) | b) * 0x1.0p-53;
+}
+
+double CounterRng::Stream::norm()
+{
+    // 1 - unif() lies in (0, 1], so the log is finite
+    const double u1 = 1.0 - unif();
+    const double u2 = unif();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(kTwoPi * u2);
+}
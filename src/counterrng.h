@@ -0,0 +1,52 @@
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+#include <array>
+#include <cstdint>
+
+// Counter based random numbers (Philox4x32-10, Salmon et al. 2011).
+//
+// Every draw is a pure function of (seed, iteration, marker, purpose, draw
+// index), so kernels can generate their own numbers on any thread without
+// locking and the values do not depend on the order in which markers are
+// processed. purpose separates independent streams used for the same marker.
+class CounterRng
+{
+public:
+    using Block = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    class Stream
+    {
+    public:
+        Stream(const Key &key, uint32_t iteration, uint32_t marker, uint32_t purpose);
+
+        // Uniform on [0, 1) with 53 bits of precision
+        double unif();
+
+        // Standard normal via Box-Muller
+        double norm();
+
+    private:
+        Key m_key;
+        Block m_counter;
+        Block m_block;
+        int m_used = 4;
+
+        uint32_t next();
+    };
+
+    explicit CounterRng(uint64_t seed = 0);
+
+    Stream stream(uint32_t iteration, uint32_t marker, uint32_t purpose = 0) const
+    {
+        return Stream(m_key, iteration, marker, purpose);
+    }
+
+    static Block philox(Block counter, Key key);
+
+private:
+    Key m_key;
+};
+
+#endif // COUNTERRNG_H
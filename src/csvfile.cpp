@@ -0,0 +1,151 @@
+#include "csvfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Parses one number, leaving begin just past it
+bool parseValue(const char *&begin, const char *end, double &value)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        ++begin;
+    if (begin < end && *begin == '+')
+        ++begin;
+
+#if defined(__cpp_lib_to_chars)
+    const auto result = std::from_chars(begin, end, value);
+    if (result.ec != std::errc() || result.ptr == begin)
+        return false;
+    begin = result.ptr;
+#else
+    // strtod needs a terminated string, which the mapping does not provide
+    char buffer[64];
+    const auto length = std::min<size_t>(sizeof(buffer) - 1, static_cast<size_t>(end - begin));
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char *parsed = nullptr;
+    value = std::strtod(buffer, &parsed);
+    if (parsed == buffer)
+        return false;
+    begin += parsed - buffer;
+#endif
+
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        ++begin;
+    return true;
+}
+
+}
+
+CsvFile::CsvFile(const std::string &file)
+{
+    const int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Error: can not open the file [" + file + "] to read." << std::endl;
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size <= 0) {
+        std::cerr << "Error: can not read the size of [" + file + "]." << std::endl;
+        close(fd);
+        return;
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Failed to mmap csv file [" + file + "]." << std::endl;
+        m_size = 0;
+        return;
+    }
+
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char *>(data);
+}
+
+CsvFile::~CsvFile()
+{
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+}
+
+std::vector<size_t> CsvFile::lineOffsets() const
+{
+    std::vector<size_t> offsets;
+    const char *const end = m_data + m_size;
+    const char *line = m_data;
+    while (line && line < end) {
+        const auto *newline = static_cast<const char *>(std::memchr(line, '\n', static_cast<size_t>(end - line)));
+        const char *lineEnd = newline ? newline : end;
+        if (lineEnd > line && !(lineEnd - line == 1 && *line == '\r'))
+            offsets.push_back(static_cast<size_t>(line - m_data));
+        line = newline ? newline + 1 : nullptr;
+    }
+    return offsets;
+}
+
+size_t CsvFile::columnCount() const
+{
+    if (!m_data)
+        return 0;
+
+    const auto *newline = static_cast<const char *>(std::memchr(m_data, '\n', m_size));
+    const char *end = newline ? newline : m_data + m_size;
+    if (end > m_data && *(end - 1) == '\r')
+        --end;
+    if (end == m_data)
+        return 0;
+    return static_cast<size_t>(std::count(m_data, end, ',')) + 1;
+}
+
+bool CsvFile::parseLine(size_t offset, double *values, size_t count) const
+{
+    if (!m_data || offset >= m_size)
+        return false;
+
+    const char *begin = m_data + offset;
+    const auto *newline = static_cast<const char *>(std::memchr(begin, '\n', m_size - offset));
+    const char *end = newline ? newline : m_data + m_size;
+    if (end > begin && *(end - 1) == '\r')
+        --end;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!parseValue(begin, end, values[i]))
+            return false;
+
+        // Cells are separated by commas and the last one ends the line
+        if (i + 1 < count) {
+            if (begin == end || *begin != ',')
+                return false;
+            ++begin;
+        }
+    }
+
+    return begin == end;
+}
+
+void CsvFile::willNeed(size_t begin, size_t end) const
+{
+    if (!m_data || end <= begin)
+        return;
+
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+    const size_t alignedBegin = begin - (begin % pageSize);
+    end = std::min(end, m_size);
+    if (end <= alignedBegin)
+        return;
+
+    madvise(const_cast<char *>(m_data) + alignedBegin, end - alignedBegin, MADV_WILLNEED);
+}
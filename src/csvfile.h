@@ -0,0 +1,40 @@
+#ifndef CSVFILE_H
+#define CSVFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only memory map of a numeric CSV file with one marker per line and one
+// individual per column. Like BedFile, one instance is shared by all threads;
+// lines are parsed straight from the mapping.
+class CsvFile
+{
+public:
+    explicit CsvFile(const std::string &file);
+    ~CsvFile();
+
+    CsvFile(const CsvFile &) = delete;
+    CsvFile &operator=(const CsvFile &) = delete;
+
+    bool isMapped() const { return m_data != nullptr; }
+
+    // Offset of the first character of each non-empty line
+    std::vector<size_t> lineOffsets() const;
+
+    // Number of cells on the first line
+    size_t columnCount() const;
+
+    // Parses the line starting at offset into count values. Returns false if
+    // a cell is empty or not a number, or the line has a different length.
+    bool parseLine(size_t offset, double *values, size_t count) const;
+
+    // Hints that the bytes in [begin, end) will be read soon
+    void willNeed(size_t begin, size_t end) const;
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif // CSVFILE_H
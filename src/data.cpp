@@ -3,13 +3,33 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
 #include <iterator>
+#include <numeric>
 #include "compression.h"
+#include "beddecoder.h"
+#include "bedfile.h"
+#include "csvfile.h"
 
 
 #define handle_error(msg)                               \
 		do { perror(msg); exit(EXIT_FAILURE); } while (0)
 
+namespace {
+
+// Chunks of the preprocessed file may be written in any order, so the last
+// index entry is not necessarily at the end of the file.
+size_t mappedSize(const PpBedIndex &index)
+{
+	size_t size = 0;
+	for (const auto &entry : index)
+		size = std::max(size, size_t(entry.pos + entry.compressedSize));
+	return size;
+}
+
+}
+
 Data::Data()
 : ppBedFd(-1)
 , ppBedMap(nullptr)
@@ -52,33 +72,80 @@ void Data::unmapPreprocessedBedFile()
 void Data::mapCompressedPreprocessBedFile(const string &preprocessedBedFile,
 		const string &indexFile)
 {
-	// Load the index to the compressed preprocessed bed file
-	ppbedIndex.resize(numSnps);
-	ifstream indexStream(indexFile, std::ifstream::binary);
-	if (!indexStream)
-		throw("Error: Failed to open compressed preprocessed bed file index");
-	indexStream.read(reinterpret_cast<char *>(ppbedIndex.data()),
-			numSnps * 3 * sizeof(unsigned long));
+	mapCompressedPreprocessedShards({preprocessedBedFile}, {indexFile});
+}
 
-	// Calculate the expected file sizes - cast to size_t so that we don't overflow the unsigned int's
-	// that we would otherwise get as intermediate variables!
-	const size_t ppBedSize = size_t(ppbedIndex.back().pos + ppbedIndex.back().compressedSize);
+void Data::mapCompressedPreprocessedShards(const vector<string> &preprocessedBedFiles,
+		const vector<string> &indexFiles)
+{
+	assert(preprocessedBedFiles.size() == indexFiles.size());
 
-	// Open and mmap the preprocessed bed file
-	ppBedFd = open(preprocessedBedFile.c_str(), O_RDONLY);
-	if (ppBedFd == -1)
-		throw("Error: Failed to open preprocessed bed file [" + preprocessedBedFile + "]");
+	// Load the index of each shard. The shards are laid out one after the other,
+	// page aligned, so the combined index addresses every marker relative to ppBedMap.
+	const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+	vector<size_t> shardOffsets;
+	vector<size_t> shardSizes;
+	size_t totalSize = 0;
 
-	ppBedMap = reinterpret_cast<double *>(mmap(nullptr, ppBedSize, PROT_READ, MAP_SHARED, ppBedFd, 0));
-	if (ppBedMap == MAP_FAILED)
-		throw("Error: Failed to mmap preprocessed bed file");
+	ppbedIndex.clear();
+	ppbedIndex.reserve(numSnps);
+	for (size_t shard = 0; shard < indexFiles.size(); ++shard) {
+		struct stat indexInfo;
+		if (stat(indexFiles[shard].c_str(), &indexInfo) == -1)
+			throw("Error: Failed to open compressed preprocessed bed file index [" + indexFiles[shard] + "]");
+
+		PpBedIndex shardIndex(size_t(indexInfo.st_size) / sizeof(IndexEntry));
+		ifstream indexStream(indexFiles[shard], std::ifstream::binary);
+		indexStream.read(reinterpret_cast<char *>(shardIndex.data()),
+				shardIndex.size() * sizeof(IndexEntry));
+		if (!indexStream)
+			throw("Error: Failed to read compressed preprocessed bed file index [" + indexFiles[shard] + "]");
+
+		for (auto entry : shardIndex) {
+			entry.pos += totalSize;
+			ppbedIndex.push_back(entry);
+		}
+
+		const size_t shardSize = mappedSize(shardIndex);
+		shardOffsets.push_back(totalSize);
+		shardSizes.push_back(shardSize);
+		totalSize += (shardSize + pageSize - 1) / pageSize * pageSize;
+	}
+
+	if (ppbedIndex.size() != numSnps)
+		throw("Error: The preprocessed bed file index has " + to_string(ppbedIndex.size())
+				+ " SNPs but " + to_string(numSnps) + " were read from the BIM file(s)");
+
+	// Reserve a single address range and map each shard into its place
+	ppBedMapSize = std::max(totalSize, pageSize);
+	void *base = mmap(nullptr, ppBedMapSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		throw("Error: Failed to reserve address space for the preprocessed bed file");
+	ppBedMap = reinterpret_cast<double *>(base);
+
+	for (size_t shard = 0; shard < preprocessedBedFiles.size(); ++shard) {
+		const int fd = open(preprocessedBedFiles[shard].c_str(), O_RDONLY);
+		if (fd == -1)
+			throw("Error: Failed to open preprocessed bed file [" + preprocessedBedFiles[shard] + "]");
+		ppShardFds.push_back(fd);
+
+		if (shardSizes[shard] == 0)
+			continue;
+
+		void *target = reinterpret_cast<unsigned char *>(base) + shardOffsets[shard];
+		if (mmap(target, shardSizes[shard], PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+			throw("Error: Failed to mmap preprocessed bed file [" + preprocessedBedFiles[shard] + "]");
+	}
 }
 
 void Data::unmapCompressedPreprocessedBedFile()
 {
-	const size_t ppBedSize = size_t(ppbedIndex.back().pos + ppbedIndex.back().compressedSize);
-	munmap(ppBedMap, ppBedSize);
-	close(ppBedFd);
+	munmap(ppBedMap, ppBedMapSize);
+	for (const int fd : ppShardFds)
+		close(fd);
+	ppShardFds.clear();
+	ppBedMap = nullptr;
+	ppBedMapSize = 0;
 	ppbedIndex.clear();
 }
 
@@ -106,35 +173,98 @@ void Data::readFamFile(const string &famFile){
 	cout << numInds << " individuals to be included from [" + famFile + "]." << endl;
 }
 
+bool Data::matchesFamFile(const string &famFile) const {
+	ifstream in(famFile.c_str());
+	if (!in) {
+		cerr << "Error: can not open the file [" + famFile + "] to read." << endl;
+		return false;
+	}
+
+	string fid, pid, dad, mom, sex, phen;
+	unsigned idx = 0;
+	while (in >> fid >> pid >> dad >> mom >> sex >> phen) {
+		if (idx >= indInfoVec.size() || indInfoVec[idx]->catID != fid + ":" + pid)
+			return false;
+		++idx;
+	}
+	return idx == indInfoVec.size();
+}
+
 void Data::readBimFile(const string &bimFile) {
-    // Read bim file: recombination rate is defined between SNP i and SNP i-1
-    ifstream in(bimFile.c_str());
-    if (!in) throw ("Error: can not open the file [" + bimFile + "] to read.");
+    readBimFiles({bimFile});
+}
 
-    cout << "Reading PLINK BIM file from [" + bimFile + "]." << endl;
+void Data::readBimFiles(const vector<string> &bimFiles) {
+    // Read bim file: recombination rate is defined between SNP i and SNP i-1
     snpInfoVec.clear();
     snpInfoMap.clear();
+    bimSnpCounts.clear();
     string id, allele1, allele2;
     unsigned chr, physPos;
     float genPos;
     unsigned idx = 0;
-    while (in >> chr >> id >> genPos >> physPos >> allele1 >> allele2) {
-        SnpInfo *snp = new SnpInfo(idx++, id, allele1, allele2, chr, genPos, physPos);
-        snpInfoVec.push_back(snp);
-        if (snpInfoMap.insert(pair<string, SnpInfo*>(id, snp)).second == false) {
-            throw ("Error: Duplicate SNP ID found: \"" + id + "\".");
+    for (const auto &bimFile : bimFiles) {
+        ifstream in(bimFile.c_str());
+        if (!in) throw ("Error: can not open the file [" + bimFile + "] to read.");
+
+        cout << "Reading PLINK BIM file from [" + bimFile + "]." << endl;
+        const unsigned firstIdx = idx;
+        while (in >> chr >> id >> genPos >> physPos >> allele1 >> allele2) {
+            SnpInfo *snp = new SnpInfo(idx++, id, allele1, allele2, chr, genPos, physPos);
+            snpInfoVec.push_back(snp);
+            if (snpInfoMap.insert(pair<string, SnpInfo*>(id, snp)).second == false) {
+                throw ("Error: Duplicate SNP ID found: \"" + id + "\".");
+            }
         }
+        in.close();
+        bimSnpCounts.push_back(idx - firstIdx);
+        cout << idx - firstIdx << " SNPs to be included from [" + bimFile + "]." << endl;
     }
-    in.close();
     numSnps = (unsigned) snpInfoVec.size();
     G = vector<int>(numSnps, 0);
+    bimIndices.resize(numSnps);
+    std::iota(bimIndices.begin(), bimIndices.end(), 0u);
 
-    cout << numSnps << " SNPs to be included from [" + bimFile + "]." << endl;
+    if (bimFiles.size() > 1)
+        cout << numSnps << " SNPs to be included from " << bimFiles.size() << " BIM files." << endl;
 }
 
 
+void Data::excludeSnps(const vector<unsigned char> &keptSnps) {
+    assert(keptSnps.size() == snpInfoVec.size());
+
+    // Excluded SNPs stay in snpInfoMap, flagged as not included
+    vector<SnpInfo*> includedSnps;
+    vector<int> groups;
+    vector<unsigned> indices;
+    for (size_t i = 0; i < snpInfoVec.size(); ++i) {
+        SnpInfo *snp = snpInfoVec[i];
+        if (!keptSnps[i]) {
+            snp->included = false;
+            continue;
+        }
+
+        snp->index = (int) includedSnps.size();
+        includedSnps.push_back(snp);
+        if (i < G.size())
+            groups.push_back(G[i]);
+        if (i < bimIndices.size())
+            indices.push_back(bimIndices[i]);
+    }
+
+    if (includedSnps.size() == snpInfoVec.size())
+        return;
+
+    cout << snpInfoVec.size() - includedSnps.size() << " SNPs excluded by QC, "
+         << includedSnps.size() << " SNPs remain." << endl;
+    snpInfoVec.swap(includedSnps);
+    numSnps = (unsigned) snpInfoVec.size();
+    G.swap(groups);
+    bimIndices.swap(indices);
+}
+
 void Data::readBedFile_noMPI(const string &bedFile){
-	unsigned i = 0, j = 0, k = 0;
+	unsigned i = 0, j = 0;
 
 	if (numSnps == 0) throw ("Error: No SNP is retained for analysis.");
 	if (numInds == 0) throw ("Error: No individual is retained for analysis.");
@@ -144,13 +274,12 @@ void Data::readBedFile_noMPI(const string &bedFile){
 	snp2pq.resize(numSnps);
 
 	// Read bed file
-	char ch[1];
-	bitset<8> b;
-	unsigned allele1=0, allele2=0;
-	ifstream BIT(bedFile.c_str(), ios::binary);
-	if (!BIT) throw ("Error: can not open the file [" + bedFile + "] to read.");
+	const BedFile bed(bedFile);
+	if (!bed.isMapped()) throw ("Error: can not open the file [" + bedFile + "] to read.");
+	const size_t columnSize = BedDecoder::columnSize(numInds);
+	if (!bed.hasColumns(numSnps, columnSize)) throw ("Error: problem with the BED file ... has the FAM/BIM file been changed?");
 	cout << "Reading PLINK BED file from [" + bedFile + "] in SNP-major format ..." << endl;
-	for (i = 0; i < 3; i++) BIT.read(ch, 1); // skip the first three bytes
+	BedDecoder decoder(numInds, BedDecoder::keptIndividuals(this));
 	SnpInfo *snpInfo = NULL;
 	unsigned snp = 0, ind = 0;
 	unsigned nmiss = 0;
@@ -160,28 +289,15 @@ void Data::readBedFile_noMPI(const string &bedFile){
 		snpInfo = snpInfoVec[j];
 		mean = 0.0;
 		nmiss = 0;
-		if (!snpInfo->included) {
-			for (i = 0; i < numInds; i += 4) BIT.read(ch, 1);
-			continue;
-		}
-		for (i = 0, ind = 0; i < numInds;) {
-			BIT.read(ch, 1);
-			if (!BIT) throw ("Error: problem with the BED file ... has the FAM/BIM file been changed?");
-			b = ch[0];
-			k = 0;
-			while (k < 7 && i < numInds) {
-				if (!indInfoVec[i]->kept) k += 2;
-				else {
-					allele1 = (!b[k++]);
-					allele2 = (!b[k++]);
-					if (allele1 == 0 && allele2 == 1) {  // missing genotype
-						Z(ind++, snp) = -9;
-						++nmiss;
-					} else {
-						mean += Z(ind++, snp) = allele1 + allele2;
-					}
-				}
-				i++;
+		if (!snpInfo->included) continue;
+
+		const GenotypeColumn column = decoder.decode(bed.column(j, columnSize));
+		for (ind = 0; ind < column.size; ++ind) {
+			if (column.codes[ind] == MarkerBuilder::kMissingGenotype) {  // missing genotype
+				Z(ind, snp) = -9;
+				++nmiss;
+			} else {
+				mean += Z(ind, snp) = column.codes[ind];
 			}
 		}
 		// fill missing values with the mean
@@ -215,8 +331,6 @@ void Data::readBedFile_noMPI(const string &bedFile){
 
 		if (++snp == numSnps) break;
 	}
-	BIT.clear();
-	BIT.close();
 	// standardize genotypes
 	for (i=0; i<numSnps; ++i) {
 		Z.col(i).array() -= Z.col(i).mean();
@@ -226,7 +340,7 @@ void Data::readBedFile_noMPI(const string &bedFile){
 }
 
 void Data::readBedFile_noMPI_unstandardised(const string &bedFile){
-	unsigned i = 0, j = 0, k = 0;
+	unsigned j = 0;
 
 	if (numSnps == 0) throw ("Error: No SNP is retained for analysis.");
 	if (numInds == 0) throw ("Error: No individual is retained for analysis.");
@@ -242,13 +356,12 @@ void Data::readBedFile_noMPI_unstandardised(const string &bedFile){
 	snp2pq.resize(numSnps);
 
 	// Read bed file
-	char ch[1];
-	bitset<8> b;
-	unsigned allele1=0, allele2=0;
-	ifstream BIT(bedFile.c_str(), ios::binary);
-	if (!BIT) throw ("Error: can not open the file [" + bedFile + "] to read.");
+	const BedFile bed(bedFile);
+	if (!bed.isMapped()) throw ("Error: can not open the file [" + bedFile + "] to read.");
+	const size_t columnSize = BedDecoder::columnSize(numInds);
+	if (!bed.hasColumns(numSnps, columnSize)) throw ("Error: problem with the BED file ... has the FAM/BIM file been changed?");
 	cout << "Reading PLINK BED file from [" + bedFile + "] in SNP-major format ..." << endl;
-	for (i = 0; i < 3; i++) BIT.read(ch, 1); // skip the first three bytes
+	BedDecoder decoder(numInds, BedDecoder::keptIndividuals(this));
 	SnpInfo *snpInfo = NULL;
 	unsigned snp = 0, ind = 0;
 	unsigned nmiss = 0;
@@ -260,44 +373,24 @@ void Data::readBedFile_noMPI_unstandardised(const string &bedFile){
 		mean = 0.0;
 		sqn = 0.0;
 		nmiss = 0;
-		if (!snpInfo->included) {
-			for (i = 0; i < numInds; i += 4) BIT.read(ch, 1);
-			continue;
-		}
-		for (i = 0, ind = 0; i < numInds;) {
-			BIT.read(ch, 1);
-			if (!BIT) throw ("Error: problem with the BED file ... has the FAM/BIM file been changed?");
-			b = ch[0];
-			k = 0;
-			while (k < 7 && i < numInds) {
-				if (!indInfoVec[i]->kept) k += 2;
-				else {
-					allele1 = (!b[k++]);
-					allele2 = (!b[k++]);
-					//Assume no missing genotypes
-					//if (allele1 == 0 && allele2 == 1) {  // missing genotype
-					//	Z(ind++, snp) = -9;
-					//++nmiss;
-					//	} else {
-					int all_sum = allele1 + allele2;
-					if(all_sum == 1 ){
-						Zones[j].push_back(ind++); //Save the index of the individual to the vector of ones
-					}else if(all_sum == 2){
-						Ztwos[j].push_back(ind++);
-					}else{
-						ind++;
-					}
-
-					if (allele1 == 0 && allele2 == 1) {  // missing genotype
-						cout << "MISSING " << endl;
-					}
-
-					mean += all_sum;
-					sqn += all_sum*all_sum;
-					//	}
-				}
-				i++;
+		if (!snpInfo->included) continue;
+
+		const GenotypeColumn column = decoder.decode(bed.column(j, columnSize));
+		for (ind = 0; ind < column.size; ++ind) {
+			//Assume no missing genotypes. A missing genotype still counts as
+			//a single allele, as the alleles (0, 1) used to.
+			int all_sum = column.codes[ind];
+			if (column.codes[ind] == MarkerBuilder::kMissingGenotype)  // missing genotype
+				all_sum = 1;
+
+			if(all_sum == 1 ){
+				Zones[j].push_back(ind); //Save the index of the individual to the vector of ones
+			}else if(all_sum == 2){
+				Ztwos[j].push_back(ind);
 			}
+
+			mean += all_sum;
+			sqn += all_sum*all_sum;
 		}
 		// fill missing values with the mean
 		mean /= float(numInds-nmiss);
@@ -324,8 +417,6 @@ void Data::readBedFile_noMPI_unstandardised(const string &bedFile){
 
 		if (++snp == numSnps) break;
 	}
-	BIT.clear();
-	BIT.close();
 
 	cout << "Genotype data for " << numInds << " individuals and " << numSnps << " SNPs are included from [" + bedFile + "]." << endl;
 }
@@ -452,92 +543,16 @@ void Data::readGroupFile(const string& groupFile) {
     cout << "Groups read from file: " << numGroups << endl;
 }
 
-void Data::preprocessCSVFile(const string&csvFile,const string &preprocessedCSVFile, const string &preprocessedCSVIndexFile, bool compress)
-{
-  cout << "Preprocessing csv file:" << csvFile << ", Compress data =" << (compress ? "yes" : "no") << endl;
-
-  VectorXd snpData(numInds);
-  snpData.setZero();
-  
-  std::ifstream indata;
-  indata.open(csvFile);
-  std::string line;
-  std::vector<double> values;
-  uint rows = 0;
-  uint cols =0;
-  ofstream ppCSVOutput(preprocessedCSVFile.c_str(), ios::binary);
-    if (!ppCSVOutput)
-        throw("Error: Unable to open the preprocessed bed file [" + preprocessedCSVFile + "] for writing.");
-  ofstream ppCSVIndexOutput(preprocessedCSVIndexFile.c_str(), ios::binary);
-    if (!ppCSVIndexOutput)
-        throw("Error: Unable to open the preprocessed bed index file [" + preprocessedCSVIndexFile + "] for writing.");
-
-  // How much space do we need to compress the data (if requested)
-  const auto maxCompressedOutputSize = compress ? maxCompressedDataSize<double>(numInds) : 0;
-  unsigned char *compressedBuffer = nullptr;
-  unsigned long pos = 0;
-  if (compress)
-    compressedBuffer = new unsigned char[maxCompressedOutputSize];
-  while (std::getline(indata, line))
-    {
-      std::stringstream lineStream(line);
-      std::string cell;
-      cols=0;
-      
-      while (std::getline(lineStream, cell, ','))
-	{
-	  if (!cell.empty())
-	    snpData[++cols]=std::stod(cell);
-	  else
-	    throw("Error, there are missing values in the file");
-	}
-      
-      if (!compress)
-    {
-      writeUncompressedDataWithIndex(reinterpret_cast<unsigned char *>(&snpData[0]), numInds * sizeof(double), ppCSVOutput, ppCSVIndexOutput, pos);
-	}
-      else
-	{
-	  compressAndWriteWithIndex(snpData, ppCSVOutput, ppCSVIndexOutput, pos, compressedBuffer, maxCompressedOutputSize);
-	}
-      ++rows;
-    }
-  if (compress)
-    delete[] compressedBuffer;
-  indata.clear();
-  indata.close();
-
-  cout << "csv file for" << numInds << " individuals and " << numSnps << " Variables are included from [" +  csvFile + "]." << endl;
-}
-
 //We asume the csv is well formed and individuals are columns and  markers are rows
 void Data::readCSVFile( const string &csvFile)
 {
-   std::ifstream indata;
-   indata.open(csvFile);
-   if (!indata)
+   const CsvFile file(csvFile);
+   if (!file.isMapped())
        throw("Error: Unable to open the CSV data file [" + csvFile + "] for reading.");
-   std::string line;
-   uint rows = 0;
-   uint cols = 0; 
-   while (std::getline(indata, line))
-    {
-      if(rows == 0){
-        std::stringstream lineStream(line);
-        std::string cell;
-      
-        while (std::getline(lineStream, cell, ','))
-	{
-	  ++cols;
-	}
-      }
-      ++rows;
-    }
-   numInds = cols;
-   numSnps = rows;
+
+   numInds = (unsigned) file.columnCount();
+   numSnps = (unsigned) file.lineOffsets().size();
    G = vector<int>(numSnps, 0);
-    indata.clear();
-    indata.close();
    cout << numInds << " individuals to be included from [" + csvFile + "]." << endl;
    cout << numSnps << " markers to be included from [" + csvFile + "]." << endl;
 }
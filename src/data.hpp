@@ -82,6 +82,8 @@ public:
     // mmap related data
     int ppBedFd;
     double *ppBedMap;
+    size_t ppBedMapSize = 0;
+    vector<int> ppShardFds;
     Map<MatrixXd> mappedZ;
     PpBedIndex ppbedIndex;
 
@@ -115,6 +117,8 @@ public:
     VectorXf n;              // sample size for each SNP in GWAS
 
     vector<SnpInfo*> snpInfoVec;
+    vector<unsigned> bimSnpCounts; // SNPs read from each BIM file
+    vector<unsigned> bimIndices;   // position in the BIM file(s) of each SNP in snpInfoVec
     vector<IndInfo*> indInfoVec;
 
     map<string, SnpInfo*> snpInfoMap;
@@ -136,17 +140,20 @@ public:
 
     unsigned numGroups = 1; // number of groups
 
-    void preprocessCSVFile(const string &csvFile, const string &preprocessedCSVFile, const string &preprovessedCSVIndexFile, bool compress);
     void mapPreprocessBedFile(const string &preprocessedBedFile);
     void unmapPreprocessedBedFile();
 
     void mapCompressedPreprocessBedFile(const string &preprocessedBedFile, const string &indexFile);
+    void mapCompressedPreprocessedShards(const vector<string> &preprocessedBedFiles, const vector<string> &indexFiles);
     void unmapCompressedPreprocessedBedFile();
 
     void readCSV(const string &filename, int cols);
 
     void readFamFile(const string &famFile);
+    bool matchesFamFile(const string &famFile) const; // same individuals in the same order
     void readBimFile(const string &bimFile);
+    void readBimFiles(const vector<string> &bimFiles);
+    void excludeSnps(const vector<unsigned char> &keptSnps);
     void readBedFile_noMPI(const string &bedFile);
     void readBedFile_noMPI_unstandardised(const string &bedFile);
 
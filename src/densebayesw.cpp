@@ -17,7 +17,7 @@ namespace  {
 
 struct dense_beta_params : public beta_params {
     dense_beta_params(const beta_params &params) : beta_params(params) {}
-    std::shared_ptr<VectorXd> epsilon = nullptr;
+    std::shared_ptr<const VectorXd> epsilon = nullptr;
     std::shared_ptr<Map<VectorXd>> Cx = nullptr;
 };
 
@@ -28,7 +28,7 @@ inline double beta_dens(double x, void *norm_data)
     /* In C++ we need to do a static cast for the void data */
     dense_beta_params p = *(static_cast<dense_beta_params *>(norm_data));
 
-    return -p.alpha * x * p.sum_failure - (((*p.epsilon - *p.Cx * x) * p.alpha).array() - EuMasc).exp().sum() -
+    return -p.alpha * x * p.sum_failure - (((*p.epsilon - *p.Cx * (x - p.residual_beta)) * p.alpha).array() - EuMasc).exp().sum() -
             x * x / (2 * p.used_mixture * p.sigma_b) ;
 };
 
@@ -52,7 +52,7 @@ MarkerBuilder *DenseBayesW::markerBuilder() const
     return builderForType(PreprocessDataType::Dense);
 }
 
-int DenseBayesW::estimateBeta(const BayesWKernel *kernel, const std::shared_ptr<VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params, double *convex, int npoint,
+int DenseBayesW::estimateBeta(const BayesWKernel *kernel, const std::shared_ptr<const VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params, double *convex, int npoint,
                               int dometrop, double *xprev, double *xsamp, int nsamp, double *qcent,
                               double *xcent, int ncent, int *neval)
 {
@@ -19,7 +19,7 @@ public:
     MarkerBuilder *markerBuilder() const override;
 
 protected:
-    int estimateBeta(const BayesWKernel *kernel, const std::shared_ptr<VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params,
+    int estimateBeta(const BayesWKernel *kernel, const std::shared_ptr<const VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params,
                       double *convex, int npoint, int dometrop, double *xprev, double *xsamp,
                       int nsamp, double *qcent, double *xcent,
                       int ncent, int *neval) override;
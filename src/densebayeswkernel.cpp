@@ -1,5 +1,14 @@
 #include "densebayeswkernel.h"
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_reduce.h"
+
+namespace {
+// Number of individuals per block. Small enough for a block of vi and Cx to
+// stay in cache whilst every quadrature node is accumulated over it.
+constexpr Index kIntegrandGrainSize = 4096;
+}
+
 DenseBayesWKernel::DenseBayesWKernel(const std::shared_ptr<const DenseMarker> &marker)
     : BayesWKernel(marker)
     , dm(marker.get())
@@ -7,11 +16,32 @@ DenseBayesWKernel::DenseBayesWKernel(const std::shared_ptr<const DenseMarker> &m
     assert(dm);
 }
 
-void DenseBayesWKernel::setVi(const std::shared_ptr<VectorXd> &vi)
+void DenseBayesWKernel::setVi(const std::shared_ptr<const VectorXd> &vi)
 {
     m_vi = vi;
 }
 
+void DenseBayesWKernel::setViExcluding(const std::shared_ptr<const VectorXd> &vi, double alpha, double beta_old,
+                                       std::shared_ptr<VectorXd> &scratch)
+{
+    if (beta_old == 0.0) {
+        setVi(vi);
+        return;
+    }
+
+    if (!scratch || scratch.use_count() > 1 || scratch->size() != vi->size())
+        scratch = std::make_shared<VectorXd>(vi->size());
+
+    // The residual update of beta_old is Cx * beta_old
+    scratch->array() = vi->array() * (alpha * beta_old * dm->Cx->array()).exp();
+    m_vi = scratch;
+}
+
+void DenseBayesWKernel::releaseVi()
+{
+    m_vi.reset();
+}
+
 void DenseBayesWKernel::calculateSumFailure(const VectorXd &failure_vector)
 {
     sum_failure = (dm->Cx->array() * failure_vector.array()).sum();
@@ -40,3 +70,32 @@ double DenseBayesWKernel::integrand_adaptive(double s, double alpha, double sqrt
     double temp = -alpha *s*sum_failure*sqrt_2Ck_sigmab + (m_vi->array()* (1 - (-dm->Cx->array()*s*sqrt_2Ck_sigmab*alpha).exp() )).sum() -pow(s,2);
     return exp(temp);
 }
+
+VectorXd DenseBayesWKernel::integrand_adaptive(const VectorXd &s, double alpha, const VectorXd &sqrt_2Ck_sigmab) const
+{
+    assert(m_vi);
+    assert(s.size() == sqrt_2Ck_sigmab.size());
+
+    const VectorXd t = alpha * s.cwiseProduct(sqrt_2Ck_sigmab);
+    const auto &vi = *m_vi;
+    const auto &cx = *dm->Cx;
+
+    // sum(vi * (1 - exp(-Cx * t))) for every node, in one sweep over the individuals.
+    // The deterministic reduction keeps the result independent of the thread count.
+    const VectorXd sums = tbb::parallel_deterministic_reduce(
+                tbb::blocked_range<Index>(0, cx.size(), kIntegrandGrainSize),
+                VectorXd(VectorXd::Zero(t.size())),
+                [&](const tbb::blocked_range<Index> &r, VectorXd partial) -> VectorXd {
+        const Index n = r.end() - r.begin();
+        const auto viBlock = vi.segment(r.begin(), n).array();
+        const auto cxBlock = cx.segment(r.begin(), n).array();
+        for (Index p = 0; p < t.size(); ++p)
+            partial(p) += (viBlock * (1 - (-cxBlock * t(p)).exp())).sum();
+        return partial;
+    },
+    [](const VectorXd &a, const VectorXd &b) -> VectorXd {
+        return a + b;
+    });
+
+    return (-sum_failure * t.array() + sums.array() - s.array().square()).exp();
+}
@@ -8,18 +8,23 @@ struct DenseBayesWKernel : public BayesWKernel
 {
     explicit DenseBayesWKernel(const std::shared_ptr<const DenseMarker> &marker);
 
-    void setVi(const std::shared_ptr<VectorXd> &vi) override;
+    void setVi(const std::shared_ptr<const VectorXd> &vi) override;
+    void setViExcluding(const std::shared_ptr<const VectorXd> &vi, double alpha, double beta_old,
+                        std::shared_ptr<VectorXd> &scratch) override;
+    void releaseVi() override;
     void calculateSumFailure(const VectorXd &failure_vector);
 
     VectorXdPtr calculateResidualUpdate(const double beta) override;
     VectorXdPtr calculateEpsilonChange(const double beta_old, const double beta) override;
 
     double exponent_sum() const override;
+    using BayesWKernel::integrand_adaptive;
     double integrand_adaptive(double s, double alpha, double sqrt_2Ck_sigmab) const override;
+    VectorXd integrand_adaptive(const VectorXd &s, double alpha, const VectorXd &sqrt_2Ck_sigmab) const override;
 
 protected:
     const DenseMarker *dm = nullptr;
-    std::shared_ptr<VectorXd> m_vi = nullptr;
+    std::shared_ptr<const VectorXd> m_vi = nullptr;
 };
 
 #endif // DENSEBAYESWKERNEL_H
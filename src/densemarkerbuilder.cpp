@@ -40,6 +40,33 @@ void DenseMarkerBuilder::processAllele(unsigned int individual,
     }
 }
 
+void DenseMarkerBuilder::processColumn(const GenotypeColumn &column)
+{
+    auto* denseMarker = dynamic_cast<DenseMarker*>(m_marker.get());
+    assert(denseMarker);
+
+    auto& snpData = *denseMarker->Cx;
+    for (size_t k = 0; k < column.size; ++k) {
+        const auto code = column.codes[k];
+        if (code == kMissingGenotype) {
+            m_missingIndices.push_back(column.individuals[k]);
+        } else {
+            snpData[column.individuals[k]] = code;
+            m_sum += code;
+        }
+    }
+}
+
+void DenseMarkerBuilder::processValues(const double *values)
+{
+    auto* denseMarker = dynamic_cast<DenseMarker*>(m_marker.get());
+    assert(denseMarker);
+
+    auto& snpData = *denseMarker->Cx;
+    snpData = Map<const VectorXd>(values, snpData.size());
+    m_sum += snpData.sum();
+}
+
 void DenseMarkerBuilder::endColumn()
 {
     auto* denseMarker = dynamic_cast<DenseMarker*>(m_marker.get());
@@ -15,6 +15,11 @@ public:
                        unsigned int allele1,
                        unsigned int allele2) override;
 
+    void processColumn(const GenotypeColumn &column) override;
+
+    // Real valued data, e.g. a line of a CSV file, with one value per individual
+    void processValues(const double *values);
+
     void endColumn() override;
 };
 
@@ -6,6 +6,8 @@
  */
 #include <Eigen/Eigen>
 #include <math.h>
+#include <cassert>
+#include <sstream>
 #include "distributions_boost.hpp"
 #include <boost/random/gamma_distribution.hpp>
 #include "boost/random.hpp"
@@ -20,28 +22,49 @@ Distributions_boost::~Distributions_boost(){
 }
 
 double Distributions_boost::rgamma(double shape, double scale){
-    boost::random::gamma_distribution<double> myGamma(shape, scale);
-    boost::random::variate_generator<boost::mt19937&, boost::random::gamma_distribution<> > rand_gamma(rng, myGamma);
-    return rand_gamma();
+    return m_gamma(rng, boost::random::gamma_distribution<double>::param_type(shape, scale));
 }
 
 double Distributions_boost::unif_rng(){
-    boost::random::uniform_real_distribution<double> myU(0,1);
-    boost::random::variate_generator<boost::mt19937&, boost::random::uniform_real_distribution<> > real_variate_generator(rng, myU);
-    return real_variate_generator();
+    return m_uniform(rng);
+}
 
+void Distributions_boost::fill_uniform(Eigen::Ref<Eigen::VectorXd> out){
+    for (Eigen::Index i = 0; i < out.size(); ++i)
+        out[i] = m_uniform(rng);
 }
 
-Eigen::VectorXd Distributions_boost::dirichlet_rng(Eigen::VectorXd alpha) {
-    int len;
-    len=alpha.size();
-    Eigen::VectorXd result(len);
-    for(int i=0;i<len;i++)
-        result[i]=rgamma(alpha[i],(double)1.0);
-    result/=result.sum();
+Eigen::VectorXd Distributions_boost::dirichlet_rng(const Eigen::Ref<const Eigen::VectorXd> &alpha) {
+    Eigen::VectorXd result(alpha.size());
+    dirichlet_rng(alpha, result);
     return result;
 }
 
+void Distributions_boost::dirichlet_rng(const Eigen::Ref<const Eigen::VectorXd> &alpha, Eigen::Ref<Eigen::VectorXd> out) {
+    assert(out.size() == alpha.size());
+    for (Eigen::Index i = 0; i < alpha.size(); ++i)
+        out[i] = rgamma(alpha[i], 1.0);
+    out /= out.sum();
+}
+
+void Distributions_boost::shuffle(std::vector<unsigned int> &values) {
+    for (size_t i = values.size(); i > 1; --i) {
+        boost::random::uniform_int_distribution<size_t> pick(0, i - 1);
+        std::swap(values[i - 1], values[pick(rng)]);
+    }
+}
+
+std::string Distributions_boost::state() const {
+    std::ostringstream stream;
+    stream << rng;
+    return stream.str();
+}
+
+void Distributions_boost::setState(const std::string &state) {
+    std::istringstream stream(state);
+    stream >> rng;
+}
+
 double Distributions_boost::inv_gamma_rng(double shape,double scale){
     return ((double)1.0 / rgamma(shape, 1.0/scale));
 }
@@ -59,9 +82,7 @@ double Distributions_boost::inv_scaled_chisq_rng(double dof,double scale){
     return inv_gamma_rng((double)0.5*dof, (double)0.5*dof*scale);
 }
 double Distributions_boost::norm_rng(double mean,double sigma2){
-    boost::normal_distribution<double> nd(mean, std::sqrt((double)sigma2));
-    boost::variate_generator<boost::mt19937&,boost::normal_distribution<> > var_nor(rng, nd);
-    return var_nor();
+    return mean + std::sqrt(sigma2) * m_normal(rng);
 }
 
 inline double runif(unsigned int seed){
@@ -11,17 +11,25 @@
 
 
 #include <random>
+#include <string>
+#include <vector>
 #include <Eigen/Eigen>
 #include "boost/random.hpp"
 #include "boost/generator_iterator.hpp"
 class Distributions_boost{
     boost::mt19937 rng;
     unsigned int seed;
+
+    // Kept between calls rather than rebuilt for every draw
+    boost::random::uniform_real_distribution<double> m_uniform {0, 1};
+    boost::random::normal_distribution<double> m_normal {0, 1};
+    boost::random::gamma_distribution<double> m_gamma;
 public:
     Distributions_boost(unsigned int seed);
     virtual ~Distributions_boost();
     double rgamma(double shape, double scale);
-    Eigen::VectorXd dirichlet_rng(Eigen::VectorXd alpha);
+    Eigen::VectorXd dirichlet_rng(const Eigen::Ref<const Eigen::VectorXd> &alpha);
+    void dirichlet_rng(const Eigen::Ref<const Eigen::VectorXd> &alpha, Eigen::Ref<Eigen::VectorXd> out);
     double inv_gamma_rng(double shape,double scale);
     double gamma_rng(double shape,double scale);
     double inv_gamma_rate_rng(double shape,double rate);
@@ -32,6 +40,16 @@ public:
     double categorical(Eigen::VectorXd probs);
     double exp_rng(double a);
     double unif_rng();
+
+    // Bulk draw, equivalent to calling unif_rng() out.size() times
+    void fill_uniform(Eigen::Ref<Eigen::VectorXd> out);
+
+    // Fisher-Yates shuffle driven by the engine, unlike std::random_shuffle
+    void shuffle(std::vector<unsigned int> &values);
+
+    // Engine state, for checkpoints
+    std::string state() const;
+    void setState(const std::string &state);
 };
 
 
@@ -0,0 +1,45 @@
+#include "eigenbayeswkernel.h"
+
+EigenBayesWKernel::EigenBayesWKernel(const std::shared_ptr<const EigenSparseMarker> &marker)
+    : SparseBayesWKernel(marker)
+    , esm(marker.get())
+{
+    assert(esm);
+}
+
+void EigenBayesWKernel::setVi(const std::shared_ptr<const VectorXd> &vi)
+{
+    vi_sum = vi->sum();
+    vi_1 = 0;
+    vi_2 = 0;
+    vi_missing = 0;
+
+    // Missing genotypes were imputed with the mean, so they standardise to 0
+    for (SparseVector<EigenSparseMarker::UnitDataType>::InnerIterator it(esm->Zg); it; ++it) {
+        if (it.value() == 1)
+            vi_1 += (*vi)(it.index());
+        else if (it.value() == 2)
+            vi_2 += (*vi)(it.index());
+        else
+            vi_missing += (*vi)(it.index());
+    }
+
+    vi_0 = vi_sum - vi_1 - vi_2 - vi_missing;
+}
+
+void EigenBayesWKernel::calculateSumFailure(const VectorXd &failure_vector)
+{
+    sum_failure = (esm->Zg.dot(failure_vector) - esm->mean * failure_vector.sum()) / esm->sd;
+}
+
+VectorXdPtr EigenBayesWKernel::calculateResidualUpdate(const double beta)
+{
+    auto delta = std::make_unique<VectorXd>(VectorXd::Constant(esm->numInds, -beta * esm->mean / esm->sd));
+    *delta += esm->Zg * (beta / esm->sd);
+    return delta;
+}
+
+VectorXdPtr EigenBayesWKernel::calculateEpsilonChange(const double beta_old, const double beta)
+{
+    return calculateResidualUpdate(beta_old - beta);
+}
@@ -0,0 +1,21 @@
+#ifndef EIGENBAYESWKERNEL_H
+#define EIGENBAYESWKERNEL_H
+
+#include "sparsebayeswkernel.h"
+#include "eigensparsemarker.h"
+
+struct EigenBayesWKernel : public SparseBayesWKernel
+{
+    explicit EigenBayesWKernel(const std::shared_ptr<const EigenSparseMarker> &marker);
+
+    void setVi(const std::shared_ptr<const VectorXd> &vi) override;
+    void calculateSumFailure(const VectorXd &failure_vector) override;
+
+    VectorXdPtr calculateResidualUpdate(const double beta) override;
+    VectorXdPtr calculateEpsilonChange(const double beta_old, const double beta) override;
+
+protected:
+    const EigenSparseMarker *esm = nullptr;
+};
+
+#endif // EIGENBAYESWKERNEL_H
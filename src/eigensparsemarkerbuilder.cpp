@@ -37,6 +37,30 @@ void EigenSparseMarkerBuilder::processAllele(unsigned int individual,
     }
 }
 
+void EigenSparseMarkerBuilder::processColumn(const GenotypeColumn &column)
+{
+    auto* eigenMarker = dynamic_cast<EigenSparseMarker*>(m_marker.get());
+    assert(eigenMarker);
+
+    double oneCount = 0;
+    double twoCount = 0;
+    for (size_t k = 0; k < column.size; ++k) {
+        const auto code = column.codes[k];
+        if (code == kMissingGenotype) {
+            m_tuples->emplace_back(column.individuals[k], kMissing);
+            ++m_missingGenotypeCount;
+        } else if (code > 0) {
+            m_tuples->emplace_back(column.individuals[k], static_cast<UnitDataType>(code));
+            if (code == 1)
+                ++oneCount;
+            else
+                ++twoCount;
+        }
+    }
+
+    eigenMarker->addGenotypeCounts(oneCount, twoCount);
+}
+
 void EigenSparseMarkerBuilder::endColumn()
 {
     auto* eigenMarker = dynamic_cast<EigenSparseMarker*>(m_marker.get());
@@ -17,6 +17,8 @@ public:
                        unsigned int allele1,
                        unsigned int allele2) override;
 
+    void processColumn(const GenotypeColumn &column) override;
+
     void endColumn() override;
 
 protected:
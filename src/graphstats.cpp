@@ -0,0 +1,222 @@
+#include "graphstats.h"
+#include "atomicfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *kindName(GraphStats::Kind kind)
+{
+    switch (kind) {
+    case GraphStats::Kind::Node:
+        return "node";
+    case GraphStats::Kind::Queue:
+        return "queue";
+    case GraphStats::Kind::Wait:
+        return "wait";
+    }
+    return "";
+}
+
+}
+
+GraphStats::GraphStats(const std::string &graph)
+    : m_graph(graph)
+    , m_calibrationTicks(ticks())
+    , m_calibrationNs(steadyNs())
+{
+
+}
+
+uint64_t GraphStats::ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(steadyNs());
+#endif
+}
+
+GraphStats::Id GraphStats::add(const std::string &name, Kind kind)
+{
+    const auto it = std::find(m_names.cbegin(), m_names.cend(), name);
+    if (it != m_names.cend())
+        return static_cast<Id>(it - m_names.cbegin());
+
+    m_names.push_back(name);
+    m_kinds.push_back(kind);
+    m_depths.emplace_back(0);
+    return m_names.size() - 1;
+}
+
+GraphStats::Counter &GraphStats::local(Id id)
+{
+    auto &counters = m_local.local();
+    if (counters.size() < m_names.size())
+        counters.resize(m_names.size());
+    return counters[id];
+}
+
+void GraphStats::record(Id id, uint64_t ticks)
+{
+    auto &counter = local(id);
+    ++counter.count;
+    counter.total += ticks;
+    counter.max = std::max(counter.max, ticks);
+}
+
+void GraphStats::push(Id queue)
+{
+    const auto pushed = m_depths[queue].fetch_add(1, std::memory_order_relaxed) + 1;
+    const auto depth = static_cast<uint64_t>(std::max<int64_t>(pushed, 0));
+    auto &counter = local(queue);
+    ++counter.count;
+    counter.total += depth;
+    counter.max = std::max(counter.max, depth);
+}
+
+void GraphStats::pop(Id queue)
+{
+    m_depths[queue].fetch_sub(1, std::memory_order_relaxed);
+}
+
+void GraphStats::beginIteration()
+{
+    for (auto &depth : m_depths)
+        depth = 0;
+    m_iterationStart = ticks();
+}
+
+void GraphStats::endIteration()
+{
+    Iteration iteration;
+    iteration.wallTicks = ticks() - m_iterationStart;
+    iteration.counters.resize(m_names.size());
+
+    for (auto &counters : m_local) {
+        for (size_t i = 0; i < counters.size(); ++i) {
+            auto &total = iteration.counters[i];
+            total.count += counters[i].count;
+            total.total += counters[i].total;
+            total.max = std::max(total.max, counters[i].max);
+            counters[i] = {};
+        }
+    }
+
+    m_iterations.push_back(std::move(iteration));
+}
+
+double GraphStats::ticksPerSecond() const
+{
+    const auto elapsedNs = steadyNs() - m_calibrationNs;
+    const auto elapsedTicks = ticks() - m_calibrationTicks;
+    if (elapsedNs <= 0 || elapsedTicks == 0)
+        return 1e9;
+    return static_cast<double>(elapsedTicks) * 1e9 / static_cast<double>(elapsedNs);
+}
+
+bool GraphStats::write(const std::string &fileName) const
+{
+    const bool written = writeFileAtomically(fileName, [this] (std::ostream &out) {
+        const double msPerTick = 1e3 / ticksPerSecond();
+        auto ms = [msPerTick] (uint64_t ticks) { return static_cast<double>(ticks) * msPerTick; };
+
+        auto writeArray = [&out] (const char *name, const std::vector<double> &values) {
+            out << "\"" << name << "\": [";
+            for (size_t i = 0; i < values.size(); ++i)
+                out << (i ? ", " : "") << values[i];
+            out << "]";
+        };
+
+        uint64_t wallTicks = 0;
+        std::vector<double> iterationWall;
+        for (const auto &iteration : m_iterations) {
+            wallTicks += iteration.wallTicks;
+            iterationWall.push_back(ms(iteration.wallTicks));
+        }
+
+        out << "{\n";
+        out << "  \"graph\": \"" << m_graph << "\",\n";
+        out << "  \"iterations\": " << m_iterations.size() << ",\n";
+        out << "  \"wall_ms\": " << ms(wallTicks) << ",\n";
+        out << "  ";
+        writeArray("iteration_wall_ms", iterationWall);
+        out << ",\n";
+        out << "  \"metrics\": [";
+
+        for (size_t id = 0; id < m_names.size(); ++id) {
+            Counter total;
+            std::vector<double> counts, values, maxima;
+            for (const auto &iteration : m_iterations) {
+                // Metrics registered part way through the run start at zero
+                const auto counter = id < iteration.counters.size() ? iteration.counters[id] : Counter();
+                total.count += counter.count;
+                total.total += counter.total;
+                total.max = std::max(total.max, counter.max);
+
+                counts.push_back(static_cast<double>(counter.count));
+                if (m_kinds[id] == Kind::Queue) {
+                    values.push_back(counter.count ? static_cast<double>(counter.total) / counter.count : 0.0);
+                    maxima.push_back(static_cast<double>(counter.max));
+                } else {
+                    values.push_back(ms(counter.total));
+                    maxima.push_back(ms(counter.max));
+                }
+            }
+
+            out << (id ? ",\n" : "\n");
+            out << "    {\"name\": \"" << m_names[id] << "\", \"kind\": \"" << kindName(m_kinds[id]) << "\", ";
+
+            switch (m_kinds[id]) {
+            case Kind::Node:
+                // Idle time is only meaningful for serial nodes; a busy time
+                // above the wall time is the mean concurrency of the node.
+                out << "\"calls\": " << total.count
+                    << ", \"busy_ms\": " << ms(total.total)
+                    << ", \"idle_ms\": " << ms(wallTicks > total.total ? wallTicks - total.total : 0)
+                    << ", \"max_ms\": " << ms(total.max) << ",\n      \"per_iteration\": {";
+                writeArray("calls", counts);
+                out << ", ";
+                writeArray("busy_ms", values);
+                break;
+
+            case Kind::Queue:
+                out << "\"samples\": " << total.count
+                    << ", \"mean_depth\": " << (total.count ? static_cast<double>(total.total) / total.count : 0.0)
+                    << ", \"max_depth\": " << total.max << ",\n      \"per_iteration\": {";
+                writeArray("mean_depth", values);
+                out << ", ";
+                writeArray("max_depth", maxima);
+                break;
+
+            case Kind::Wait:
+                out << "\"count\": " << total.count
+                    << ", \"wait_ms\": " << ms(total.total)
+                    << ", \"max_ms\": " << ms(total.max) << ",\n      \"per_iteration\": {";
+                writeArray("count", counts);
+                out << ", ";
+                writeArray("wait_ms", values);
+                break;
+            }
+            out << "}}";
+        }
+
+        out << "\n  ]\n}\n";
+    });
+
+    if (!written)
+        std::cerr << "Could not write graph statistics to " << fileName << std::endl;
+    return written;
+}
@@ -0,0 +1,126 @@
+#ifndef GRAPHSTATS_H
+#define GRAPHSTATS_H
+
+#include "tbb/enumerable_thread_specific.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Low overhead instrumentation of the flow graphs. Each metric is
+// registered once by name and then updated through thread-local counters
+// read from the time stamp counter, so the hot path never takes a lock.
+// The counters are combined once per iteration.
+//
+// There are three kinds of metric:
+//  - Node:  calls and busy time of a node body
+//  - Queue: depth of the messages waiting in front of a node, sampled on push.
+//           Messages are usually pushed and popped on different threads, so
+//           the depth is one shared atomic per queue: each push and pop is an
+//           atomic increment on a cache line shared between the threads.
+//  - Wait:  time spent blocked on a lock or waiting for tokens
+class GraphStats
+{
+public:
+    using Id = size_t;
+
+    enum class Kind {
+        Node,
+        Queue,
+        Wait
+    };
+
+    explicit GraphStats(const std::string &graph);
+
+    // Registering a name twice returns the existing id. Metrics must be
+    // registered before the graph runs.
+    Id addNode(const std::string &name) { return add(name, Kind::Node); }
+    Id addQueue(const std::string &name) { return add(name, Kind::Queue); }
+    Id addWait(const std::string &name) { return add(name, Kind::Wait); }
+
+    // Raw ticks, see ticksPerSecond()
+    static uint64_t ticks();
+
+    // Adds the ticks spent in a Node or Wait metric
+    void record(Id id, uint64_t ticks);
+
+    // Each is one relaxed atomic increment or decrement of the queue depth
+    void push(Id queue);
+    void pop(Id queue);
+
+    void beginIteration();
+    void endIteration();
+
+    size_t iterationCount() const { return m_iterations.size(); }
+    double ticksPerSecond() const;
+
+    // Writes the totals and the per-iteration values as JSON
+    bool write(const std::string &fileName) const;
+
+    // Records the ticks from construction to destruction under id. Does
+    // nothing when stats is null.
+    class Timer
+    {
+    public:
+        Timer(GraphStats *stats, Id id)
+            : m_stats(stats)
+            , m_id(id)
+            , m_start(stats ? ticks() : 0)
+        {}
+
+        ~Timer()
+        {
+            if (m_stats)
+                m_stats->record(m_id, ticks() - m_start);
+        }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        GraphStats *m_stats;
+        Id m_id;
+        uint64_t m_start;
+    };
+
+private:
+    struct Counter {
+        uint64_t count = 0;
+        uint64_t total = 0; // ticks, or the sum of the sampled depths for a Queue
+        uint64_t max = 0;
+    };
+    using Counters = std::vector<Counter>;
+
+    struct Iteration {
+        uint64_t wallTicks = 0;
+        Counters counters;
+    };
+
+    std::string m_graph;
+    std::vector<std::string> m_names;
+    std::vector<Kind> m_kinds;
+    std::deque<std::atomic<int64_t>> m_depths;
+
+    tbb::enumerable_thread_specific<Counters> m_local;
+
+    uint64_t m_iterationStart = 0;
+    std::vector<Iteration> m_iterations;
+
+    uint64_t m_calibrationTicks = 0;
+    int64_t m_calibrationNs = 0;
+
+    Id add(const std::string &name, Kind kind);
+    Counter &local(Id id);
+};
+
+// Locks lock, recording the time spent waiting for it under id
+template<typename Lock>
+void lockTimed(Lock &lock, GraphStats *stats, GraphStats::Id id)
+{
+    GraphStats::Timer timer(stats, id);
+    lock.lock();
+}
+
+#endif // GRAPHSTATS_H
@@ -0,0 +1,340 @@
+#include "individualmajor.h"
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'P', 'I', 'M'};
+constexpr unsigned int kVersion = 1;
+constexpr size_t kDataAlignment = 64;
+
+struct Header {
+    char magic[4];
+    unsigned int version;
+    unsigned int numInds;
+    unsigned int numSnps;
+    unsigned int blockSize;
+};
+static_assert(sizeof(Header) <= IndividualMajorLayout::kHeaderSize, "Header does not fit");
+
+bool readHeader(const unsigned char *data, size_t size, IndividualMajorLayout &layout)
+{
+    if (size < IndividualMajorLayout::kHeaderSize)
+        return false;
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+            header.blockSize == 0)
+        return false;
+
+    layout.numInds = header.numInds;
+    layout.numSnps = header.numSnps;
+    layout.blockSize = header.blockSize;
+    return size >= layout.fileSize();
+}
+
+}
+
+unsigned int IndividualMajorLayout::blockInds(size_t block) const
+{
+    const size_t first = block * blockSize;
+    return first >= numInds ? 0 : static_cast<unsigned int>(std::min<size_t>(blockSize, numInds - first));
+}
+
+size_t IndividualMajorLayout::dataOffset() const
+{
+    const size_t end = statisticsOffset() + 2 * sizeof(double) * numSnps;
+    return (end + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+}
+
+size_t IndividualMajorLayout::blockOffset(size_t block) const
+{
+    // All blocks but the last are full
+    const size_t fullBlocks = numInds / blockSize;
+    const size_t fullBlockBytes = (blockSize + 3) / 4;
+
+    size_t offset = dataOffset() + std::min(block, fullBlocks) * numSnps * fullBlockBytes;
+    if (block > fullBlocks)
+        offset += numSnps * blockBytes(fullBlocks);
+    return offset;
+}
+
+IndividualMajorWriter::~IndividualMajorWriter()
+{
+    close();
+}
+
+bool IndividualMajorWriter::map(const std::string &file, int flags)
+{
+    const int fd = open(file.c_str(), flags, 0644);
+    if (fd == -1) {
+        std::cerr << "Error: Unable to open the individual-major file [" + file + "] for writing." << std::endl;
+        return false;
+    }
+
+    const auto size = m_layout.fileSize();
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+        std::cerr << "Error: Unable to resize the individual-major file [" + file + "]." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Failed to mmap the individual-major file [" + file + "]." << std::endl;
+        return false;
+    }
+
+    m_data = static_cast<unsigned char *>(data);
+    return true;
+}
+
+bool IndividualMajorWriter::create(const std::string &file,
+                                   const IndividualMajorLayout &layout,
+                                   bool fillMissing,
+                                   PreprocessDataType type)
+{
+    close();
+    m_layout = layout;
+    m_type = type;
+    if (!map(file, O_RDWR | O_CREAT | O_TRUNC))
+        return false;
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.numInds = layout.numInds;
+    header.numSnps = layout.numSnps;
+    header.blockSize = layout.blockSize;
+    std::memcpy(m_data, &header, sizeof(header));
+
+    if (fillMissing) {
+        const auto begin = layout.dataOffset();
+        std::memset(m_data + begin, 0xFF, layout.fileSize() - begin);
+    }
+
+    return true;
+}
+
+bool IndividualMajorWriter::reopen(const std::string &file,
+                                   const IndividualMajorLayout &layout,
+                                   PreprocessDataType type)
+{
+    close();
+
+    struct stat info;
+    if (stat(file.c_str(), &info) == -1)
+        return false;
+
+    m_layout = layout;
+    m_type = type;
+    if (!map(file, O_RDWR))
+        return false;
+
+    IndividualMajorLayout existing;
+    if (!readHeader(m_data, m_layout.fileSize(), existing) ||
+            existing.numInds != layout.numInds ||
+            existing.numSnps != layout.numSnps ||
+            existing.blockSize != layout.blockSize) {
+        std::cerr << "Individual-major file [" + file + "] does not match this run" << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void IndividualMajorWriter::writeColumn(size_t snp, const GenotypeColumn &column)
+{
+    if (!m_data)
+        return;
+
+    std::array<double, 4> counts = {0, 0, 0, 0};
+    for (size_t k = 0; k < column.size; ++k)
+        ++counts[column.codes[k]];
+
+    // Use the same standardisation as the SNP-major markers
+    const double n = m_layout.numInds;
+    const double sum = counts[1] + 2 * counts[2];
+    double mean = 0;
+    double sd = 0;
+    if (m_type == PreprocessDataType::Dense) {
+        const double called = counts[0] + counts[1] + counts[2];
+        mean = called > 0 ? sum / called : 0;
+        const double sumSquares = counts[0] * mean * mean +
+                counts[1] * (1 - mean) * (1 - mean) +
+                counts[2] * (2 - mean) * (2 - mean);
+        sd = std::sqrt(sumSquares / (n - 1));
+    } else {
+        // Only the eigen builder imputes missing genotypes with the mean before taking the sd
+        const double missing = m_type == PreprocessDataType::SparseEigen ? counts[MarkerBuilder::kMissingGenotype] : 0;
+        mean = sum / n;
+        const double sqrdZ = counts[1] + 4 * counts[2] + mean * mean * missing;
+        const double zSum = sum + mean * missing;
+        sd = std::sqrt((sqrdZ - 2 * mean * zSum + n * mean * mean) / (n - 1));
+    }
+
+    if (!std::isfinite(sd) || sd <= 0)
+        return;
+
+    double *statistics = reinterpret_cast<double *>(m_data + m_layout.statisticsOffset()) + 2 * snp;
+    statistics[0] = mean;
+    statistics[1] = sd;
+
+    // Individuals are in increasing order, so the block only changes a few times
+    size_t block = m_layout.blockCount();
+    unsigned char *codes = nullptr;
+    for (size_t k = 0; k < column.size; ++k) {
+        const auto individual = column.individuals[k];
+        const size_t individualBlock = individual / m_layout.blockSize;
+        if (individualBlock != block) {
+            block = individualBlock;
+            codes = m_data + m_layout.blockOffset(block) + snp * m_layout.blockBytes(block);
+        }
+
+        const auto row = individual % m_layout.blockSize;
+        const auto shift = 2 * (row % 4);
+        unsigned char &byte = codes[row / 4];
+        byte = static_cast<unsigned char>((byte & ~(3u << shift)) | (column.codes[k] << shift));
+    }
+}
+
+bool IndividualMajorWriter::close()
+{
+    if (!m_data)
+        return true;
+
+    const auto size = m_layout.fileSize();
+    const bool synced = msync(m_data, size, MS_SYNC) == 0;
+    munmap(m_data, size);
+    m_data = nullptr;
+    return synced;
+}
+
+IndividualMajorFile::~IndividualMajorFile()
+{
+    close();
+}
+
+bool IndividualMajorFile::open(const std::string &file)
+{
+    close();
+
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Failed to mmap the individual-major file [" + file + "]." << std::endl;
+        m_size = 0;
+        return false;
+    }
+
+    m_data = static_cast<const unsigned char *>(data);
+    if (!readHeader(m_data, m_size, m_layout)) {
+        std::cerr << "Error: Invalid individual-major file [" + file + "]." << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void IndividualMajorFile::close()
+{
+    if (m_data)
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+Eigen::VectorXd IndividualMajorFile::multiply(const Eigen::VectorXd &beta,
+                                              const std::vector<unsigned int> &snps) const
+{
+    Eigen::VectorXd result = Eigen::VectorXd::Zero(m_layout.numInds);
+    if (!m_data || static_cast<size_t>(beta.size()) != snps.size()) {
+        std::cerr << "IndividualMajorFile::multiply - expected " << snps.size()
+                  << " effects, got " << beta.size() << std::endl;
+        return result;
+    }
+
+    // Contribution of each genotype code for the SNPs with an effect
+    struct Effect {
+        size_t snp;
+        std::array<double, 4> value;
+    };
+    std::vector<Effect> effects;
+    const double *statistics = reinterpret_cast<const double *>(m_data + m_layout.statisticsOffset());
+    for (size_t k = 0; k < snps.size(); ++k) {
+        const size_t snp = snps[k];
+        if (snp >= m_layout.numSnps) {
+            std::cerr << "IndividualMajorFile::multiply - SNP " << snp << " is not in the file, which has "
+                      << m_layout.numSnps << " SNPs" << std::endl;
+            return Eigen::VectorXd::Zero(m_layout.numInds);
+        }
+
+        const double mean = statistics[2 * snp];
+        const double sd = statistics[2 * snp + 1];
+        if (beta[static_cast<Eigen::Index>(k)] == 0 || sd <= 0)
+            continue;
+
+        const double scale = beta[static_cast<Eigen::Index>(k)] / sd;
+        effects.push_back({snp, {-mean * scale, (1 - mean) * scale, (2 - mean) * scale, 0}});
+    }
+
+    // Each block owns its slice of the result, so no reduction is needed
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_layout.blockCount(), 1),
+                      [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t block = range.begin(); block != range.end(); ++block) {
+            const unsigned int inds = m_layout.blockInds(block);
+            const size_t bytes = m_layout.blockBytes(block);
+            const unsigned char *base = m_data + m_layout.blockOffset(block);
+            double *out = result.data() + block * m_layout.blockSize;
+
+            for (const auto &effect : effects) {
+                const unsigned char *codes = base + effect.snp * bytes;
+                const auto &value = effect.value;
+                const size_t fullBytes = inds / 4;
+                for (size_t i = 0; i < fullBytes; ++i) {
+                    const unsigned char c = codes[i];
+                    out[4 * i] += value[c & 3];
+                    out[4 * i + 1] += value[(c >> 2) & 3];
+                    out[4 * i + 2] += value[(c >> 4) & 3];
+                    out[4 * i + 3] += value[c >> 6];
+                }
+                for (unsigned int row = 4 * fullBytes; row < inds; ++row)
+                    out[row] += value[(codes[row / 4] >> (2 * (row % 4))) & 3];
+            }
+        }
+    });
+
+    return result;
+}
+
+std::string individualMajorFile(const std::string &ppFile)
+{
+    return ppFile + ".indmajor";
+}
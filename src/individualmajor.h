@@ -0,0 +1,98 @@
+#ifndef INDIVIDUALMAJOR_H
+#define INDIVIDUALMAJOR_H
+
+#include "markerbuilder.h"
+
+#include <Eigen/Eigen>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Individual-major copy of the genotypes, written alongside the SNP-major
+// preprocessed file for passes which produce one value per individual, such
+// as X * beta.
+//
+// Individuals are split into blocks. A block holds, for every SNP in turn, the
+// 2-bit allele counts of its individuals (MarkerBuilder::kMissingGenotype for
+// missing), so each block is one contiguous region containing everything
+// needed for its rows. The header stores the mean and sd of each SNP; a SNP
+// with sd 0 was not written (e.g. it failed QC) and is ignored.
+struct IndividualMajorLayout {
+    static constexpr unsigned int kDefaultBlockSize = 4096;
+    static constexpr size_t kHeaderSize = 32;
+
+    unsigned int numInds = 0;
+    unsigned int numSnps = 0;
+    unsigned int blockSize = kDefaultBlockSize;
+
+    size_t blockCount() const { return (numInds + blockSize - 1) / blockSize; }
+    unsigned int blockInds(size_t block) const;
+    size_t blockBytes(size_t block) const { return (blockInds(block) + 3) / 4; }
+
+    size_t statisticsOffset() const { return kHeaderSize; }
+    size_t dataOffset() const;
+    size_t blockOffset(size_t block) const;
+    size_t fileSize() const { return blockOffset(blockCount()); }
+};
+
+class IndividualMajorWriter
+{
+public:
+    ~IndividualMajorWriter();
+
+    // fillMissing initialises every genotype as missing, needed when not all
+    // individuals are kept. The SNPs are standardised the way the builder of
+    // type standardises its markers: Dense with the mean of the called
+    // genotypes, the other types with the mean over all individuals.
+    bool create(const std::string &file,
+                const IndividualMajorLayout &layout,
+                bool fillMissing,
+                PreprocessDataType type);
+
+    // Continues a file created by an interrupted run with the same layout
+    bool reopen(const std::string &file,
+                const IndividualMajorLayout &layout,
+                PreprocessDataType type);
+
+    // Thread safe as long as each SNP is written by one thread
+    void writeColumn(size_t snp, const GenotypeColumn &column);
+
+    bool close();
+
+private:
+    bool map(const std::string &file, int flags);
+
+    IndividualMajorLayout m_layout;
+    PreprocessDataType m_type = PreprocessDataType::None;
+    unsigned char *m_data = nullptr;
+};
+
+class IndividualMajorFile
+{
+public:
+    ~IndividualMajorFile();
+
+    bool open(const std::string &file);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const IndividualMajorLayout &layout() const { return m_layout; }
+
+    // Genetic values X * beta of the standardised genotypes, one per
+    // individual. beta(k) is the effect of SNP snps[k] of the file, so SNPs
+    // dropped after preprocessing (see Data::bimIndices) map to their place
+    // in the file. Blocks are processed in parallel and SNPs with a zero
+    // effect are skipped.
+    Eigen::VectorXd multiply(const Eigen::VectorXd &beta,
+                             const std::vector<unsigned int> &snps) const;
+
+private:
+    IndividualMajorLayout m_layout;
+    const unsigned char *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+std::string individualMajorFile(const std::string &ppFile);
+
+#endif // INDIVIDUALMAJOR_H
@@ -1,5 +1,5 @@
 #ifndef KERNEL_H
-#define KERNEL_K
+#define KERNEL_H
 
 #include "marker.h"
 
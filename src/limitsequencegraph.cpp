@@ -4,6 +4,7 @@
 #include "compression.h"
 #include "kernel.h"
 #include "markerbuilder.h"
+#include "tracer.h"
 
 #include <iostream>
 
@@ -13,6 +14,11 @@ LimitSequenceGraph::LimitSequenceGraph(size_t maxParallel)
 {
     // Decompress the column for this marker
     auto f = [this] (Message msg) -> Message {
+        if (m_stats)
+            m_stats->push(m_statIds.inFlight);
+        GraphStats::Timer timer(m_stats, m_statIds.decompress);
+        TraceSpan span("decompress", static_cast<int>(msg.snp));
+
         std::unique_ptr<MarkerBuilder> builder{m_analysis->markerBuilder()};
         builder->initialise(msg.snp, msg.numInds);
         const auto index = m_analysis->indexEntry(msg.snp);
@@ -22,6 +28,9 @@ LimitSequenceGraph::LimitSequenceGraph(size_t maxParallel)
             builder->read(m_analysis->preprocessedFile(), index);
         }
         msg.kernel = m_analysis->kernelForMarker(builder->build());
+
+        if (m_stats)
+            m_stats->push(m_statIds.ordering);
         return msg;
     };
     // Do the decompression work on up to maxParallel threads at once
@@ -44,8 +53,17 @@ LimitSequenceGraph::LimitSequenceGraph(size_t maxParallel)
     m_limit.reset(new limiter_node<Message>(*m_graph, limit));
 
     auto g = [this] (Message msg) -> continue_msg {
-        // Delegate the processing of this column to the algorithm class
-        m_analysis->processColumn(msg.kernel);
+        if (m_stats)
+            m_stats->pop(m_statIds.ordering);
+
+        {
+            GraphStats::Timer timer(m_stats, m_statIds.sampling);
+            // Delegate the processing of this column to the algorithm class
+            m_analysis->processColumn(msg.kernel);
+        }
+
+        if (m_stats)
+            m_stats->pop(m_statIds.inFlight);
 
         // Signal for next decompression task to continue
         return continue_msg();
@@ -88,6 +106,10 @@ void LimitSequenceGraph::exec(Analysis *analysis,
 
     // Set our Bayes for this run
     m_analysis = analysis;
+    if (m_stats) {
+        m_analysis->setGraphStats(m_stats);
+        m_stats->beginIteration();
+    }
 
     // Reset the graph from the previous iteration. This resets the sequencer node current index etc.
     m_graph->reset();
@@ -101,6 +123,19 @@ void LimitSequenceGraph::exec(Analysis *analysis,
     // Wait for the graph to complete
     m_graph->wait_for_all();
 
+    if (m_stats) {
+        m_stats->endIteration();
+        m_analysis->setGraphStats(nullptr);
+    }
+
     // Clean up
     m_analysis = nullptr;
 }
+
+void LimitSequenceGraph::registerStats()
+{
+    m_statIds.decompress = m_stats->addNode("decompress_node");
+    m_statIds.sampling = m_stats->addNode("sampling_node");
+    m_statIds.ordering = m_stats->addQueue("ordering_node");
+    m_statIds.inFlight = m_stats->addQueue("limiter_node");
+}
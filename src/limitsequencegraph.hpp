@@ -3,6 +3,7 @@
 
 #include "analysisgraph.hpp"
 #include "common.h"
+#include "graphstats.h"
 
 #include "tbb/flow_graph.h"
 #include <functional>
@@ -38,6 +39,15 @@ private:
     std::unique_ptr<sequencer_node<Message>> m_ordering;
     std::unique_ptr<sequencer_node<Message>> m_ordering2;
     std::unique_ptr<function_node<Message>> m_samplingNode;
+
+    struct StatIds {
+        GraphStats::Id decompress = 0;
+        GraphStats::Id sampling = 0;
+        GraphStats::Id ordering = 0; // decompressed markers waiting in m_ordering2
+        GraphStats::Id inFlight = 0; // markers holding a place in m_limit
+    } m_statIds;
+
+    void registerStats() override;
 };
 
 #endif // LIMITSEQUENCEGRAPH_H
@@ -6,6 +6,11 @@ using namespace Eigen;
 void LogWriter::open()
 {
     std::cout << "Opening iteration log file " << m_fileName << std::endl;
+    if (m_append) {
+        m_outFile.open(m_fileName, std::ios::app);
+        return;
+    }
+
     m_outFile.open(m_fileName);
     m_outFile << "iter,";
     m_outFile << "m_0,";
@@ -16,7 +21,8 @@ void LogWriter::open()
     m_outFile << "sigmaG_upd_microS,";
     m_outFile << "sigmaE_upd_microS,";
     m_outFile << "flowgraph_milliS,";
-    m_outFile << "iter_d_milliS";
+    m_outFile << "iter_d_milliS,";
+    m_outFile << "epsilon_drift";
     
     m_outFile << std::endl;
     m_outFile.flush();
@@ -11,6 +11,12 @@ class LogWriter : public Writer
 public:
  
    void open();
- 
+
+   // Append to an existing log, without writing the header, when resuming
+   void setAppend(bool append) { m_append = append; }
+   bool isAppend() const { return m_append; }
+
+private:
+   bool m_append = false;
 };
 #endif //LOGWRITER_H
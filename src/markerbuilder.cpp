@@ -15,6 +15,17 @@ void MarkerBuilder::initialise(const unsigned int snp,
     m_snp = snp;
 }
 
+void MarkerBuilder::processColumn(const GenotypeColumn &column)
+{
+    for (size_t k = 0; k < column.size; ++k) {
+        const auto code = column.codes[k];
+        if (code == kMissingGenotype)
+            processAllele(column.individuals[k], 0, 1);
+        else
+            processAllele(column.individuals[k], code > 0, code > 1);
+    }
+}
+
 void MarkerBuilder::read(const std::string &file, const IndexEntry &index) const
 {
     assert(m_marker);
@@ -8,9 +8,19 @@
 
 struct IndexEntry;
 
+// Genotypes of one SNP for the kept individuals. codes[k] is the allele count
+// of individual individuals[k], or MarkerBuilder::kMissingGenotype.
+struct GenotypeColumn {
+    const unsigned char *codes = nullptr;
+    const unsigned int *individuals = nullptr;
+    size_t size = 0;
+};
+
 class MarkerBuilder
 {
 public:
+    static constexpr unsigned char kMissingGenotype = 3;
+
     virtual ~MarkerBuilder();
 
     virtual void initialise(const unsigned int snp,
@@ -20,6 +30,10 @@ public:
                                unsigned int allele1,
                                unsigned int allele2) = 0;
 
+    // Processes a whole column at once. The default calls processAllele for
+    // each genotype; builders override it to avoid the per-genotype call.
+    virtual void processColumn(const GenotypeColumn &column);
+
     virtual void endColumn() = 0;
 
     virtual void read(const std::string &file, const IndexEntry &index) const;
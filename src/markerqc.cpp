@@ -0,0 +1,193 @@
+#include "markerqc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char kMagic[4] = {'P', 'P', 'Q', 'C'};
+constexpr unsigned int kVersion = 2;
+
+template<typename T>
+void writeValue(std::ostream &stream, const T &value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream &stream, T &value)
+{
+    stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return static_cast<bool>(stream);
+}
+
+void writeRecord(std::ostream &stream, const MarkerStats &stats)
+{
+    for (const auto count : stats.counts)
+        writeValue(stream, count);
+    writeValue(stream, stats.maf);
+    writeValue(stream, stats.missingRate);
+    writeValue(stream, stats.hwePValue);
+    const unsigned char flags = (stats.computed ? 1 : 0) | (stats.kept ? 2 : 0);
+    writeValue(stream, flags);
+}
+
+bool readRecord(std::istream &stream, MarkerStats &stats)
+{
+    for (auto &count : stats.counts) {
+        if (!readValue(stream, count))
+            return false;
+    }
+
+    unsigned char flags = 0;
+    if (!readValue(stream, stats.maf) ||
+            !readValue(stream, stats.missingRate) ||
+            !readValue(stream, stats.hwePValue) ||
+            !readValue(stream, flags))
+        return false;
+
+    stats.computed = flags & 1;
+    stats.kept = flags & 2;
+    return true;
+}
+
+}
+
+bool QcThresholds::passes(const MarkerStats &stats) const
+{
+    return stats.maf > 0 &&
+            stats.maf >= minMaf &&
+            stats.missingRate <= maxMissingRate &&
+            stats.hwePValue >= minHwePValue;
+}
+
+MarkerStats computeMarkerStats(const GenotypeColumn &column)
+{
+    MarkerStats stats;
+    for (size_t i = 0; i < column.size; ++i)
+        ++stats.counts[column.codes[i]];
+
+    const unsigned int called = stats.counts[0] + stats.counts[1] + stats.counts[2];
+    if (called > 0) {
+        const double alleleFrequency = (stats.counts[1] + 2.0 * stats.counts[2]) / (2.0 * called);
+        stats.maf = static_cast<float>(std::min(alleleFrequency, 1.0 - alleleFrequency));
+        stats.hwePValue = hweExactPValue(stats.counts[1], stats.counts[0], stats.counts[2]);
+    }
+    if (column.size > 0)
+        stats.missingRate = static_cast<float>(stats.counts[MarkerBuilder::kMissingGenotype]) / column.size;
+
+    stats.computed = true;
+    return stats;
+}
+
+double hweExactPValue(unsigned int hets, unsigned int hom1, unsigned int hom2)
+{
+    const unsigned long homr = std::min(hom1, hom2);
+    const unsigned long homc = std::max(hom1, hom2);
+    const unsigned long rare = 2 * homr + hets;
+    const unsigned long genotypes = hets + homr + homc;
+    if (genotypes == 0)
+        return 1;
+
+    // Start from the most likely number of heterozygotes and walk out in both
+    // directions using the recurrence between neighbouring probabilities
+    std::vector<double> probs(rare + 1, 0.0);
+    unsigned long mid = rare * (2 * genotypes - rare) / (2 * genotypes);
+    if ((rare & 1) != (mid & 1))
+        ++mid;
+
+    probs[mid] = 1;
+    double sum = 1;
+
+    double currHomr = (rare - mid) / 2;
+    double currHomc = genotypes - mid - (rare - mid) / 2;
+    for (unsigned long currHets = mid; currHets > 1; currHets -= 2) {
+        probs[currHets - 2] = probs[currHets] * currHets * (currHets - 1.0)
+                / (4.0 * (currHomr + 1.0) * (currHomc + 1.0));
+        sum += probs[currHets - 2];
+        ++currHomr;
+        ++currHomc;
+    }
+
+    currHomr = (rare - mid) / 2;
+    currHomc = genotypes - mid - (rare - mid) / 2;
+    for (unsigned long currHets = mid; currHets + 2 <= rare; currHets += 2) {
+        probs[currHets + 2] = probs[currHets] * 4.0 * currHomr * currHomc
+                / ((currHets + 2.0) * (currHets + 1.0));
+        sum += probs[currHets + 2];
+        --currHomr;
+        --currHomc;
+    }
+
+    const double observed = probs[hets];
+    double pValue = 0;
+    for (const double p : probs) {
+        if (p <= observed)
+            pValue += p;
+    }
+
+    return std::min(1.0, pValue / sum);
+}
+
+std::string qcFile(const std::string &ppFile)
+{
+    return ppFile + ".qc";
+}
+
+bool writeMarkerStats(const std::string &file,
+                      const PreprocessedFormat &format,
+                      const std::vector<MarkerStats> &stats,
+                      bool append)
+{
+    std::ofstream output(file.c_str(), append ? std::ios::binary | std::ios::app : std::ios::binary);
+    if (!output) {
+        std::cerr << "Error: Unable to open the marker statistics file [" + file + "] for writing." << std::endl;
+        return false;
+    }
+
+    if (!append) {
+        output.write(kMagic, sizeof(kMagic));
+        writeValue(output, kVersion);
+        writeValue(output, format.type);
+        writeValue(output, format.compress);
+        writeValue(output, format.numInds);
+    }
+
+    for (const auto &record : stats)
+        writeRecord(output, record);
+
+    return static_cast<bool>(output);
+}
+
+bool readMarkerStats(const std::string &file,
+                     std::vector<MarkerStats> &stats,
+                     PreprocessedFormat *format)
+{
+    std::ifstream input(file.c_str(), std::ios::binary);
+    if (!input)
+        return false;
+
+    char magic[4];
+    unsigned int version = 0;
+    PreprocessedFormat fileFormat;
+    input.read(magic, sizeof(magic));
+    if (!input || std::memcmp(magic, kMagic, sizeof(magic)) != 0 ||
+            !readValue(input, version) || version != kVersion ||
+            !readValue(input, fileFormat.type) ||
+            !readValue(input, fileFormat.compress) ||
+            !readValue(input, fileFormat.numInds)) {
+        std::cerr << "Error: Unreadable marker statistics file [" + file + "]." << std::endl;
+        return false;
+    }
+    if (format)
+        *format = fileFormat;
+
+    stats.clear();
+    MarkerStats record;
+    while (readRecord(input, record))
+        stats.push_back(record);
+
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef MARKERQC_H
+#define MARKERQC_H
+
+#include "markerbuilder.h"
+
+#include <string>
+#include <vector>
+
+// Per SNP quality control statistics, computed from the decoded genotypes
+// while preprocessing and saved next to the preprocessed file (see qcFile).
+struct MarkerStats {
+    unsigned int counts[4] = {0, 0, 0, 0}; // individuals with 0, 1, 2 alleles and missing
+    float maf = 0;
+    float missingRate = 0;
+    double hwePValue = 1;
+    bool computed = false; // false for SNPs taken from a resumed run or excluded up front
+    bool kept = false;     // the SNP was written to the preprocessed file
+};
+
+struct QcThresholds {
+    double minMaf = 0;
+    double maxMissingRate = 1;
+    double minHwePValue = 0;
+
+    // Monomorphic SNPs always fail, they carry no information and cannot be standardised
+    bool passes(const MarkerStats &stats) const;
+};
+
+MarkerStats computeMarkerStats(const GenotypeColumn &column);
+
+// Exact test for Hardy-Weinberg equilibrium, Wigginton et al. (2005)
+double hweExactPValue(unsigned int hets, unsigned int hom1, unsigned int hom2);
+
+// How a preprocessed file was written. It is recorded in the header of the
+// statistics file, so that SNPs are only appended to a file of the same kind.
+struct PreprocessedFormat {
+    unsigned int type = 0; // PreprocessDataType
+    unsigned int compress = 0;
+    unsigned int numInds = 0;
+
+    bool operator==(const PreprocessedFormat &other) const
+    {
+        return type == other.type && compress == other.compress && numInds == other.numInds;
+    }
+    bool operator!=(const PreprocessedFormat &other) const { return !(*this == other); }
+};
+
+// The statistics sidecar of a preprocessed file holds one record per SNP in the BIM file
+std::string qcFile(const std::string &ppFile);
+
+// When appending, the records are added to an existing file and format is not written again
+bool writeMarkerStats(const std::string &file,
+                      const PreprocessedFormat &format,
+                      const std::vector<MarkerStats> &stats,
+                      bool append);
+
+bool readMarkerStats(const std::string &file,
+                     std::vector<MarkerStats> &stats,
+                     PreprocessedFormat *format = nullptr);
+
+#endif // MARKERQC_H
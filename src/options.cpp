@@ -121,6 +121,11 @@ void Options::inputOptions(const int argc, const char* argv[]){
             inputType = getInputType(dataFile);
             ss << "--data-file " << argv[i] << "\n";
         }
+        else if (!strcmp(argv[i], "--dataset")) {
+            datasetFile = argv[++i];
+            inputType = InputType::BED;
+            ss << "--dataset " << argv[i] << "\n";
+        }
         else if (!strcmp(argv[i], "--pheno")) {
             phenotypeFile = argv[++i];
             ss << "--pheno " << argv[i] << "\n";
@@ -129,6 +134,79 @@ void Options::inputOptions(const int argc, const char* argv[]){
             mcmcSampleFile = argv[++i];
             ss << "--mcmc-samples " << argv[i] << "\n";
         }
+        else if (!strcmp(argv[i], "--sample-format")) {
+            const std::string format = argv[++i];
+            if (format == "binary")
+                sampleFormat = SampleFormat::Binary;
+            else if (format == "binary32")
+                sampleFormat = SampleFormat::BinaryFloat;
+            else if (format == "csv")
+                sampleFormat = SampleFormat::Csv;
+            else {
+                stringstream errmsg;
+                errmsg << "\nError: invalid --sample-format \"" << format
+                       << "\", expected csv, binary or binary32.\n";
+                throw (errmsg.str());
+            }
+
+            ss << "--sample-format " << format << "\n";
+        }
+        else if (!strcmp(argv[i], "--sample-compress")) {
+            sampleCompress = true;
+            ss << "--sample-compress\n";
+        }
+        else if (!strcmp(argv[i], "--output-fields")) {
+            std::stringstream fields(argv[++i]);
+            std::string field;
+            outputFields.clear();
+            while (std::getline(fields, field, ','))
+                if (!field.empty())
+                    outputFields.push_back(field);
+
+            ss << "--output-fields " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--sparse-samples")) {
+            sparseSamples = true;
+            ss << "--sparse-samples\n";
+        }
+        else if (!strcmp(argv[i], "--summary")) {
+            summaryFile = argv[++i];
+            ss << "--summary " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--checkpoint")) {
+            checkpointFile = argv[++i];
+            ss << "--checkpoint " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--checkpoint-interval")) {
+            checkpointInterval = atoi(argv[++i]);
+            ss << "--checkpoint-interval " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--resume")) {
+            resume = true;
+            ss << "--resume\n";
+        }
+        else if (!strcmp(argv[i], "--sample-queue")) {
+            sampleQueueSize = atoi(argv[++i]);
+            ss << "--sample-queue " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--graph-stats")) {
+            graphStatsFile = argv[++i];
+            ss << "--graph-stats " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--trace-iterations")) {
+            // A single iteration or an inclusive range, e.g. 100-102
+            const std::string range = argv[++i];
+            const auto dash = range.find('-');
+            traceFirstIteration = atoi(range.substr(0, dash).c_str());
+            traceLastIteration = dash == std::string::npos
+                    ? traceFirstIteration
+                    : atoi(range.substr(dash + 1).c_str());
+            ss << "--trace-iterations " << argv[i] << "\n";
+        }
+        else if (!strcmp(argv[i], "--trace")) {
+            traceFile = argv[++i];
+            ss << "--trace " << argv[i] << "\n";
+        }
         else if (!strcmp(argv[i], "--chain-length")) {
             chainLength = atoi(argv[++i]);
             ss << "--chain-length " << argv[i] << "\n";
@@ -193,6 +271,8 @@ void Options::inputOptions(const int argc, const char* argv[]){
                 preprocessDataType = PreprocessDataType::SparseEigen;
             else if (sparseDataType == "ragged")
                 preprocessDataType = PreprocessDataType::SparseRagged;
+            else if (sparseDataType == "packed")
+                preprocessDataType = PreprocessDataType::Packed;
             else
                 preprocessDataType = PreprocessDataType::None;
 
@@ -222,6 +302,30 @@ void Options::inputOptions(const int argc, const char* argv[]){
             preprocessChunks = atoi(argv[++i]);
             ss << "--preprocess-chunks " << argv[i] << "\n";
         }
+        else if(!strcmp(argv[i], "--preprocess-resume")) {
+            preprocessResume = true;
+            ss << "--preprocess-resume " << "\n";
+        }
+        else if(!strcmp(argv[i], "--individual-major")) {
+            preprocessIndividualMajor = true;
+            ss << "--individual-major " << "\n";
+        }
+        else if(!strcmp(argv[i], "--qc-maf")) {
+            qcMinMaf = atof(argv[++i]);
+            ss << "--qc-maf " << argv[i] << "\n";
+        }
+        else if(!strcmp(argv[i], "--qc-missing")) {
+            qcMaxMissingRate = atof(argv[++i]);
+            ss << "--qc-missing " << argv[i] << "\n";
+        }
+        else if(!strcmp(argv[i], "--qc-hwe")) {
+            qcMinHwePValue = atof(argv[++i]);
+            ss << "--qc-hwe " << argv[i] << "\n";
+        }
+        else if(!strcmp(argv[i], "--preprocess-append")) {
+            preprocessAppendTo = argv[++i];
+            ss << "--preprocess-append " << argv[i] << "\n";
+        }
 	else if (!strcmp(argv[i], "--iterLog")) {
 	    iterLog=true;
             iterLogFile = argv[++i];
@@ -236,6 +340,26 @@ void Options::inputOptions(const int argc, const char* argv[]){
             useMarkerCache = true;
             ss << "--marker-cache\n";
         }
+        else if(!strcmp(argv[i], "--deterministic-async")) {
+            deterministicAsync = true;
+            ss << "--deterministic-async\n";
+        }
+        else if(!strcmp(argv[i], "--residual-resync")) {
+            residualResyncInterval = atoi(argv[++i]);
+            ss << "--residual-resync " << argv[i] << "\n";
+        }
+        else if(!strcmp(argv[i], "--intra-column-parallel")) {
+            intraColumnParallel = true;
+            ss << "--intra-column-parallel\n";
+        }
+        else if(!strcmp(argv[i], "--ars-cold-start")) {
+            arsWarmStart = false;
+            ss << "--ars-cold-start\n";
+        }
+        else if(!strcmp(argv[i], "--ars-cache-size")) {
+            arsCacheSize = atoi(argv[++i]);
+            ss << "--ars-cache-size " << argv[i] << "\n";
+        }
         else if(!strcmp(argv[i], "--v0E")){
 	    v0E = static_cast<double>(atof(argv[++i]));
 	    ss << "--v0E" << argv[i] << "\n";
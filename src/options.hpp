@@ -31,7 +31,14 @@ public:
     size_t decompressionTokens = 40;
     size_t analysisNodeConcurrency = 0;
     size_t analysisTokens = 20;
+    bool deterministicAsync = false;
     unsigned preprocessChunks = 1;
+    bool preprocessResume = false;
+    string preprocessAppendTo;
+    bool preprocessIndividualMajor = false;
+    double qcMinMaf = 0;
+    double qcMaxMissingRate = 1;
+    double qcMinHwePValue = 0;
     unsigned thin;  // save every this th sampled value in MCMC
     Eigen::MatrixXd S;    //variance components
 
@@ -47,8 +54,22 @@ public:
     AnalysisType analysisType = AnalysisType::Unknown;
     string phenotypeFile;
     string dataFile;
+    string datasetFile; // manifest of BED shards which form one data set
     InputType inputType = InputType::Unknown;
     string mcmcSampleFile;
+    SampleFormat sampleFormat = SampleFormat::Csv;
+    bool sampleCompress = false; // zlib compress each binary sample
+    std::vector<std::string> outputFields; // empty writes every field
+    bool sparseSamples = false; // write non-zero (index, beta, comp) triplets instead of beta and comp
+    string summaryFile; // posterior summaries, written at the end of the run
+    string checkpointFile; // chain state, written every checkpointInterval iterations
+    unsigned checkpointInterval = 100;
+    bool resume = false; // continue the chain from checkpointFile
+    size_t sampleQueueSize = 2; // samples queued for the writer thread, 0 to write inline
+    string graphStatsFile; // per-node flow graph timings and queue depths, written as JSON
+    int traceFirstIteration = -1; // -1 disables tracing
+    int traceLastIteration = -1;
+    string traceFile = "trace.json"; // Chrome trace event JSON of the traced iterations
     string optionFile;
     bool compress = false;
     PreprocessDataType preprocessDataType = PreprocessDataType::Dense;
@@ -57,6 +78,10 @@ public:
     string colLogFile;
     bool colLog =false;
     bool useMarkerCache = false;
+    unsigned residualResyncInterval = 0; // recompute epsilon exactly every this many iterations, 0 to disable
+    bool arsWarmStart = true;
+    size_t arsCacheSize = 128; // MiB
+    bool intraColumnParallel = false; // batch the BayesW quadrature nodes; only dense kernels sweep individuals in parallel
 
 
     double v0E  = 0.0001;
@@ -0,0 +1,34 @@
+#include "packedbayesrkernel.h"
+
+PackedBayesRKernel::PackedBayesRKernel(const std::shared_ptr<const PackedMarker> &marker)
+    : SparseBayesRKernel(marker)
+    , pm(marker.get())
+{
+    assert(pm);
+}
+
+VectorXdPtr PackedBayesRKernel::calculateEpsilonChange(const double beta_old, const double beta)
+{
+    SparseBayesRKernel::calculateEpsilonChange(beta_old, beta);
+
+    auto z = pm->standardisedCodes();
+    const double dBeta = beta_old - beta;
+    for (auto &value : z)
+        value *= dBeta;
+
+    auto delta = std::make_unique<VectorXd>(pm->numInds);
+    for (unsigned int i = 0; i < pm->numInds; ++i)
+        (*delta)(i) = z[pm->genotype(i)];
+
+    return delta;
+}
+
+double PackedBayesRKernel::dot(const VectorXd &epsilon) const
+{
+    // Only the 1 and 2 codes contribute, as for RaggedBayesRKernel
+    std::array<double, 4> sums = {0, 0, 0, 0};
+    for (unsigned int i = 0; i < pm->numInds; ++i)
+        sums[pm->genotype(i)] += epsilon(i);
+
+    return (sums[1] + 2 * sums[2]) / pm->sd;
+}
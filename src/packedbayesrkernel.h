@@ -0,0 +1,20 @@
+#ifndef PACKEDBAYESRKERNEL_H
+#define PACKEDBAYESRKERNEL_H
+
+#include "sparsebayesrkernel.h"
+#include "packedmarker.h"
+
+struct PackedBayesRKernel : public SparseBayesRKernel
+{
+    explicit PackedBayesRKernel(const std::shared_ptr<const PackedMarker> &marker);
+
+    VectorXdPtr calculateEpsilonChange(const double beta_old,
+                                       const double beta) override;
+
+protected:
+    const PackedMarker *pm = nullptr;
+
+    double dot(const VectorXd &epsilon) const override;
+};
+
+#endif // PACKEDBAYESRKERNEL_H
@@ -0,0 +1,49 @@
+#include "packedbayeswkernel.h"
+
+PackedBayesWKernel::PackedBayesWKernel(const std::shared_ptr<const PackedMarker> &marker)
+    : SparseBayesWKernel(marker)
+    , pm(marker.get())
+{
+    assert(pm);
+}
+
+void PackedBayesWKernel::setVi(const std::shared_ptr<const VectorXd> &vi)
+{
+    // Sum vi over each genotype code
+    std::array<double, 4> sums = {0, 0, 0, 0};
+    for (unsigned int i = 0; i < pm->numInds; ++i)
+        sums[pm->genotype(i)] += (*vi)(i);
+
+    vi_0 = sums[0];
+    vi_1 = sums[1];
+    vi_2 = sums[2];
+    vi_missing = sums[PackedMarker::kMissing];
+    vi_sum = vi_0 + vi_1 + vi_2 + vi_missing;
+}
+
+void PackedBayesWKernel::calculateSumFailure(const VectorXd &failure_vector)
+{
+    const auto z = pm->standardisedCodes();
+
+    sum_failure = 0;
+    for (unsigned int i = 0; i < pm->numInds; ++i)
+        sum_failure += z[pm->genotype(i)] * failure_vector(i);
+}
+
+VectorXdPtr PackedBayesWKernel::calculateResidualUpdate(const double beta)
+{
+    auto z = pm->standardisedCodes();
+    for (auto &value : z)
+        value *= beta;
+
+    auto delta = std::make_unique<VectorXd>(pm->numInds);
+    for (unsigned int i = 0; i < pm->numInds; ++i)
+        (*delta)(i) = z[pm->genotype(i)];
+
+    return delta;
+}
+
+VectorXdPtr PackedBayesWKernel::calculateEpsilonChange(const double beta_old, const double beta)
+{
+    return calculateResidualUpdate(beta_old - beta);
+}
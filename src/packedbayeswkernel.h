@@ -0,0 +1,21 @@
+#ifndef PACKEDBAYESWKERNEL_H
+#define PACKEDBAYESWKERNEL_H
+
+#include "sparsebayeswkernel.h"
+#include "packedmarker.h"
+
+struct PackedBayesWKernel : public SparseBayesWKernel
+{
+    explicit PackedBayesWKernel(const std::shared_ptr<const PackedMarker> &marker);
+
+    void setVi(const std::shared_ptr<const VectorXd> &vi) override;
+    void calculateSumFailure(const VectorXd &failure_vector) override;
+
+    VectorXdPtr calculateResidualUpdate(const double beta) override;
+    VectorXdPtr calculateEpsilonChange(const double beta_old, const double beta) override;
+
+protected:
+    const PackedMarker *pm = nullptr;
+};
+
+#endif // PACKEDBAYESWKERNEL_H
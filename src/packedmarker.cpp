@@ -0,0 +1,63 @@
+#include "packedmarker.h"
+
+#include <iostream>
+
+std::array<double, 4> PackedMarker::standardisedCodes() const
+{
+    return {-mean / sd, (1 - mean) / sd, (2 - mean) / sd, 0};
+}
+
+std::streamsize PackedMarker::size() const
+{
+    return SparseMarker::size() +
+            static_cast<std::streamsize>(sizeof(ByteVector::size_type) + genotypes.size());
+}
+
+void PackedMarker::read(std::istream *inStream)
+{
+    if (inStream->fail()) {
+        std::cerr << "Error: unable to read PackedMarker!" << std::endl;
+        return;
+    }
+
+    SparseMarker::read(inStream);
+
+    ByteVector::size_type count = 0;
+    inStream->read(reinterpret_cast<char *>(&count),
+                   sizeof(ByteVector::size_type));
+
+    genotypes.resize(count);
+    if (count > 0)
+        inStream->read(reinterpret_cast<char *>(genotypes.data()),
+                       static_cast<std::streamsize>(count));
+}
+
+void PackedMarker::write(std::ostream *outStream) const
+{
+    if (outStream->fail()) {
+        std::cerr << "Error: unable to write PackedMarker!" << std::endl;
+        return;
+    }
+
+    SparseMarker::write(outStream);
+
+    const ByteVector::size_type count = genotypes.size();
+    outStream->write(reinterpret_cast<const char *>(&count),
+                     sizeof(ByteVector::size_type));
+
+    if (count > 0)
+        outStream->write(reinterpret_cast<const char *>(genotypes.data()),
+                         static_cast<std::streamsize>(count));
+}
+
+bool PackedMarker::isValid() const
+{
+    if (Zsum <= 0) {
+        std::cerr << "SNPs that do not vary are should be removed prior to analysis. "
+                  << "Otherwise, this message indicates a decompression error"
+                  << std::endl;
+        return false;
+    }
+
+    return genotypes.size() == byteCount(numInds);
+}
@@ -0,0 +1,36 @@
+#ifndef PACKEDMARKER_H
+#define PACKEDMARKER_H
+
+#include "sparsemarker.h"
+
+#include <array>
+#include <vector>
+
+// Genotypes stored as 2-bit codes, four individuals per byte. Unlike the BED
+// encoding the code is the allele count, with kMissing marking a missing
+// genotype.
+struct PackedMarker : public SparseMarker
+{
+    static constexpr unsigned char kMissing = 3;
+
+    using ByteVector = std::vector<unsigned char>;
+    ByteVector genotypes;
+
+    static ByteVector::size_type byteCount(unsigned int numInds) { return (numInds + 3) / 4; }
+
+    unsigned char genotype(unsigned int individual) const {
+        return (genotypes[individual / 4] >> (2 * (individual % 4))) & 3;
+    }
+
+    // Standardised value of each genotype code. Missing genotypes are imputed
+    // with the mean and therefore map to 0.
+    std::array<double, 4> standardisedCodes() const;
+
+    std::streamsize size() const override;
+    void read(std::istream *inStream) override;
+    void write(std::ostream *outStream) const override;
+
+    bool isValid() const override;
+};
+
+#endif // PACKEDMARKER_H
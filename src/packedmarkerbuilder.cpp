@@ -0,0 +1,67 @@
+#include "packedmarkerbuilder.h"
+
+#include "packedmarker.h"
+
+void PackedMarkerBuilder::initialise(const unsigned int snp,
+                                     const unsigned int numInds)
+{
+    MarkerBuilder::initialise(snp, numInds);
+
+    m_marker.reset(new PackedMarker);
+    initialiseMarker();
+
+    auto* packedMarker = dynamic_cast<PackedMarker*>(m_marker.get());
+    assert(packedMarker);
+
+    packedMarker->genotypes.assign(PackedMarker::byteCount(numInds), 0);
+}
+
+void PackedMarkerBuilder::processAllele(unsigned int individual,
+                                        unsigned int allele1,
+                                        unsigned int allele2)
+{
+    auto* packedMarker = dynamic_cast<PackedMarker*>(m_marker.get());
+    assert(packedMarker);
+
+    packedMarker->updateStatistics(allele1, allele2);
+
+    unsigned char code = static_cast<unsigned char>(allele1 + allele2);
+    if (allele1 == 0 && allele2 == 1)  // missing genotype
+        code = PackedMarker::kMissing;
+
+    packedMarker->genotypes[individual / 4] |= static_cast<unsigned char>(code << (2 * (individual % 4)));
+}
+
+void PackedMarkerBuilder::processColumn(const GenotypeColumn &column)
+{
+    auto* packedMarker = dynamic_cast<PackedMarker*>(m_marker.get());
+    assert(packedMarker);
+
+    // The decoded codes already use the packed encoding
+    static_assert(PackedMarker::kMissing == kMissingGenotype, "Packed and decoded missing codes differ");
+
+    std::array<double, 4> counts = {0, 0, 0, 0};
+    auto &genotypes = packedMarker->genotypes;
+    for (size_t k = 0; k < column.size; ++k) {
+        const auto individual = column.individuals[k];
+        const auto code = column.codes[k];
+        genotypes[individual / 4] |= static_cast<unsigned char>(code << (2 * (individual % 4)));
+        ++counts[code];
+    }
+
+    packedMarker->addGenotypeCounts(counts[1], counts[2]);
+}
+
+void PackedMarkerBuilder::endColumn()
+{
+    auto* packedMarker = dynamic_cast<PackedMarker*>(m_marker.get());
+    assert(packedMarker);
+
+    // Calculate mean
+    packedMarker->mean /= m_numInds;
+
+    // Calculate sd
+    const double mean = packedMarker->mean;
+    packedMarker->sd = std::sqrt((packedMarker->sqrdZ - 2.0 * mean * packedMarker->Zsum + m_numInds * mean * mean) /
+                                 (m_numInds - 1.0));
+}
@@ -0,0 +1,23 @@
+#ifndef PACKEDMARKERBUILDER_H
+#define PACKEDMARKERBUILDER_H
+
+#include "markerbuilder.h"
+
+class PackedMarkerBuilder : public MarkerBuilder
+{
+public:
+    explicit PackedMarkerBuilder() = default;
+
+    void initialise(const unsigned int snp,
+                    const unsigned int numInds) override;
+
+    void processAllele(unsigned int individual,
+                       unsigned int allele1,
+                       unsigned int allele2) override;
+
+    void processColumn(const GenotypeColumn &column) override;
+
+    void endColumn() override;
+};
+
+#endif // PACKEDMARKERBUILDER_H
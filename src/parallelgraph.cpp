@@ -5,21 +5,34 @@
 #include "kernel.h"
 #include "markerbuilder.h"
 #include "markercache.h"
+#include "tracer.h"
 
 #include <iostream>
 
-ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTokens, bool useMarkerCache)
+ParallelGraph::ParallelGraph(size_t maxDecompressionTokens,
+                             size_t maxAnalysisTokens,
+                             bool useMarkerCache,
+                             bool deterministic)
     : AnalysisGraph()
     , m_graph(new graph)
     , m_decompressionTokens(maxDecompressionTokens)
     , m_analysisTokens(maxAnalysisTokens)
+    , m_deterministic(deterministic)
 {
     m_decompressionJoinNode.reset(new decompression_join_node(*m_graph));
 
     if (useMarkerCache) {
         auto cacheReader = [this] (DecompressionTuple tuple) -> DecompressionTuple {
+            if (m_stats)
+                m_stats->push(m_statIds.decompressionTokens);
+            GraphStats::Timer timer(m_stats, m_statIds.decompression);
+
             auto &msg = std::get<1>(tuple);
+            TraceSpan span("decompress", static_cast<int>(msg.snp));
             msg.kernel = m_analysis->kernelForMarker(markerCache()->marker(msg.snp));
+
+            if (m_stats)
+                m_stats->push(m_statIds.analysisJoin);
             return tuple;
         };
 
@@ -28,7 +41,12 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
                                                       cacheReader));
     } else {
         auto diskReader = [this] (DecompressionTuple tuple) -> DecompressionTuple {
+            if (m_stats)
+                m_stats->push(m_statIds.decompressionTokens);
+            GraphStats::Timer timer(m_stats, m_statIds.decompression);
+
             auto &msg = std::get<1>(tuple);
+            TraceSpan span("decompress", static_cast<int>(msg.snp));
             // Read the column from disk
             std::unique_ptr<MarkerBuilder> builder{m_analysis->markerBuilder()};
             builder->initialise(msg.snp, msg.numInds);
@@ -39,6 +57,9 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
                 builder->read(m_analysis->preprocessedFile(), index);
             }
             msg.kernel = m_analysis->kernelForMarker(builder->build());
+
+            if (m_stats)
+                m_stats->push(m_statIds.analysisJoin);
             return tuple;
         };
 
@@ -51,6 +72,10 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
 
     // Sampling of the column to the async algorithm class
     auto g = [this] (AnalysisTuple tuple) -> AnalysisTuple {
+        if (m_stats)
+            m_stats->pop(m_statIds.analysisJoin);
+        GraphStats::Timer timer(m_stats, m_statIds.analysis);
+
         auto &msg = std::get<1>(std::get<1>(tuple));
         msg.result = m_analysis->processColumnAsync(msg.kernel);
         return tuple;
@@ -59,6 +84,8 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
     m_analysisNode.reset(new analysis_node(*m_graph, m_analysisNodeConcurrency, g));
 
     auto threadSafeUpdate = [this] (AnalysisTuple tuple) -> AnalysisTuple {
+        GraphStats::Timer timer(m_stats, m_statIds.threadSafeUpdate);
+
         auto &msg = std::get<1>(std::get<1>(tuple));
         m_analysis->doThreadSafeUpdates(msg.result);
         return tuple;
@@ -69,7 +96,7 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
                                                              threadSafeUpdate));
 
     // Decide whether to continue calculations or discard
-    auto h = [] (decision_node::input_type input,
+    auto h = [this] (decision_node::input_type input,
             decision_node::output_ports_type &outputPorts) {
 
         auto &decompressionTuple = std::get<1>(input);
@@ -80,6 +107,7 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
             std::get<2>(outputPorts).try_put(input);
         } else {
             // Discard
+            returnDecompressionToken();
             std::get<0>(outputPorts).try_put(std::get<0>(decompressionTuple));
             std::get<1>(outputPorts).try_put(std::get<0>(input));
         }
@@ -94,8 +122,12 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
         auto &decompressionTuple = std::get<1>(input);
         auto &msg = std::get<1>(decompressionTuple);
 
-        m_analysis->updateGlobal(msg.kernel, msg.result);
+        {
+            GraphStats::Timer timer(m_stats, m_statIds.globalUpdate);
+            m_analysis->updateGlobal(msg.kernel, msg.result);
+        }
 
+        returnDecompressionToken();
         std::get<0>(outputPorts).try_put(std::get<0>(decompressionTuple));
         std::get<1>(outputPorts).try_put(std::get<0>(input));
     };
@@ -105,9 +137,15 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
     // Force synchronisation after m_anaylsisToken analyses
     auto j = [this](AnalysisToken t) -> continue_msg {
         (void) t; // Unused
+        if (m_stats && m_analysisTokenCount == m_analysisTokens)
+            m_roundStart = GraphStats::ticks();
+
         --m_analysisTokenCount;
 
         if (m_analysisTokenCount == 0) {
+            if (m_stats)
+                m_stats->record(m_statIds.analysisTokenWait, GraphStats::ticks() - m_roundStart);
+
             // Allow the next set of analyses to take place
             queueAnalysisTokens();
         }
@@ -116,6 +154,40 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
     };
     m_analysisControlNode.reset(new analysis_control_node(*m_graph, serial, j));
 
+    if (m_deterministic) {
+        // Windows are formed from consecutive markers
+        m_orderingNode.reset(new ordering_node(*m_graph, [] (const DecompressionTuple &tuple) -> size_t {
+            return std::get<1>(tuple).id;
+        }));
+
+        // Hold each result until the whole window has been analysed. The
+        // decompression token is returned straight away so that the rest of
+        // the window can be read.
+        auto w = [this] (window_node::input_type input,
+                window_node::output_ports_type &outputPorts) {
+            GraphStats::Timer timer(m_stats, m_statIds.window);
+
+            auto &decompressionTuple = std::get<1>(input);
+            auto &msg = std::get<1>(decompressionTuple);
+
+            if (m_stats && m_windowCount == 0)
+                m_roundStart = GraphStats::ticks();
+
+            m_window.at(msg.id - m_windowStart) = msg;
+            ++m_windowCount;
+            returnDecompressionToken();
+            std::get<0>(outputPorts).try_put(std::get<0>(decompressionTuple));
+
+            const auto windowSize = std::min<size_t>(m_analysisTokens, m_numSnps - m_windowStart);
+            if (m_windowCount == windowSize) {
+                if (m_stats)
+                    m_stats->record(m_statIds.analysisTokenWait, GraphStats::ticks() - m_roundStart);
+                applyWindow();
+            }
+        };
+        m_windowNode.reset(new window_node(*m_graph, serial, w));
+    }
+
 
     // Set up the graph topology:
 #if defined(TBB_PREVIEW_FLOW_GRAPH_TRACE)
@@ -132,6 +204,21 @@ ParallelGraph::ParallelGraph(size_t maxDecompressionTokens, size_t maxAnalysisTo
     m_analysisControlNode->set_name("analysis_control_node");
 #endif
 
+    if (m_deterministic) {
+        if (useMarkerCache) {
+            make_edge(*m_decompressionJoinNode, *m_cacheReaderNode);
+            make_edge(*m_cacheReaderNode, *m_orderingNode);
+        } else {
+            make_edge(*m_decompressionJoinNode, *m_decompressionNode);
+            make_edge(*m_decompressionNode, *m_orderingNode);
+        }
+        make_edge(*m_orderingNode, input_port<1>(*m_analysisJoinNode));
+        make_edge(*m_analysisJoinNode, *m_analysisNode);
+        make_edge(*m_analysisNode, *m_windowNode);
+        make_edge(output_port<0>(*m_windowNode), input_port<0>(*m_decompressionJoinNode));
+        return;
+    }
+
     if (useMarkerCache) {
         make_edge(*m_decompressionJoinNode, *m_cacheReaderNode);
         make_edge(*m_cacheReaderNode, input_port<1>(*m_analysisJoinNode));
@@ -166,6 +253,10 @@ void ParallelGraph::exec(Analysis *analysis,
 
     // Set our Bayes for this run
     m_analysis = analysis;
+    if (m_stats) {
+        m_analysis->setGraphStats(m_stats);
+        m_stats->beginIteration();
+    }
 
     // Do not allow Eigen to parallalize during ParallelGraph execution.
     const auto eigenThreadCount = Eigen::nbThreads();
@@ -173,6 +264,11 @@ void ParallelGraph::exec(Analysis *analysis,
 
     // Reset the graph from the previous iteration.
     m_graph->reset();
+    m_numSnps = numSnps;
+    m_windowStart = 0;
+    m_windowCount = 0;
+    if (m_deterministic)
+        m_window.assign(m_analysisTokens, {});
     queueDecompressionTokens();
     queueAnalysisTokens();
 
@@ -185,6 +281,11 @@ void ParallelGraph::exec(Analysis *analysis,
     // Wait for the graph to complete
     m_graph->wait_for_all();
 
+    if (m_stats) {
+        m_stats->endIteration();
+        m_analysis->setGraphStats(nullptr);
+    }
+
     // Turn Eigen threading back on.
     Eigen::setNbThreads(eigenThreadCount);
 
@@ -245,3 +346,42 @@ void ParallelGraph::queueAnalysisTokens()
 
     m_analysisTokenCount = m_analysisTokens;
 }
+
+void ParallelGraph::applyWindow()
+{
+    // No analysis is running, so the updates are applied in marker order
+    // exactly as the sequential algorithm would, then the next window starts.
+    for (size_t i = 0; i < m_windowCount; ++i) {
+        auto &msg = m_window[i];
+        m_analysis->doThreadSafeUpdates(msg.result);
+        if (msg.result->betaOld != 0.0 || msg.result->beta != 0.0)
+            m_analysis->updateGlobal(msg.kernel, msg.result);
+        msg = {};
+    }
+
+    m_windowStart += static_cast<unsigned int>(m_windowCount);
+    m_windowCount = 0;
+    if (m_windowStart < m_numSnps)
+        queueAnalysisTokens();
+}
+
+void ParallelGraph::registerStats()
+{
+    m_statIds.decompression = m_stats->addNode(m_cacheReaderNode ? "cache_reader_node" : "decompression_node");
+    m_statIds.analysis = m_stats->addNode("analysis_node");
+    if (m_deterministic) {
+        m_statIds.window = m_stats->addNode("window_node");
+    } else {
+        m_statIds.threadSafeUpdate = m_stats->addNode("thread_safe_update_node");
+        m_statIds.globalUpdate = m_stats->addNode("global_update_node");
+    }
+    m_statIds.analysisJoin = m_stats->addQueue("analysis_join_node");
+    m_statIds.decompressionTokens = m_stats->addQueue("decompression_tokens");
+    m_statIds.analysisTokenWait = m_stats->addWait("analysis_tokens");
+}
+
+void ParallelGraph::returnDecompressionToken()
+{
+    if (m_stats)
+        m_stats->pop(m_statIds.decompressionTokens);
+}
@@ -3,6 +3,7 @@
 
 #include "analysisgraph.hpp"
 #include "common.h"
+#include "graphstats.h"
 
 #include "tbb/flow_graph.h"
 #include <functional>
@@ -21,7 +22,14 @@ using namespace tbb::flow;
 class ParallelGraph : public AnalysisGraph
 {
 public:
-    explicit ParallelGraph(size_t decompressionTokens, size_t analysisTokens, bool useMarkerCache);
+    // In deterministic mode markers are analysed in windows of analysisTokens
+    // consecutive markers. All analyses of a window read the state left by the
+    // previous window and their updates are applied in marker order once the
+    // whole window is done, so a run is reproducible for a given seed.
+    explicit ParallelGraph(size_t decompressionTokens,
+                           size_t analysisTokens,
+                           bool useMarkerCache,
+                           bool deterministic = false);
     ~ParallelGraph();
 
     bool isAsynchronous() const override { return true; }
@@ -88,6 +96,13 @@ private:
     using analysis_control_node = function_node<AnalysisToken, continue_msg, lightweight>;
     std::unique_ptr<analysis_control_node> m_analysisControlNode;
 
+    // Deterministic mode only
+    using ordering_node = sequencer_node<DecompressionTuple>;
+    std::unique_ptr<ordering_node> m_orderingNode;
+
+    using window_node = multifunction_node<AnalysisTuple, tbb::flow::tuple<DecompressionToken>>;
+    std::unique_ptr<window_node> m_windowNode;
+
     size_t m_decompressionNodeConcurrency = tbb::flow::unlimited;
     size_t m_decompressionTokens = 40;
 
@@ -97,6 +112,30 @@ private:
 
     void queueDecompressionTokens();
     void queueAnalysisTokens();
+
+    // Window of markers analysed in deterministic mode
+    bool m_deterministic = false;
+    unsigned int m_numSnps = 0;
+    unsigned int m_windowStart = 0;
+    size_t m_windowCount = 0;
+    std::vector<Message> m_window;
+
+    void applyWindow();
+
+    struct StatIds {
+        GraphStats::Id decompression = 0;
+        GraphStats::Id analysis = 0;
+        GraphStats::Id threadSafeUpdate = 0;
+        GraphStats::Id globalUpdate = 0;
+        GraphStats::Id window = 0;
+        GraphStats::Id analysisJoin = 0; // decompressed markers waiting for an analysis token
+        GraphStats::Id decompressionTokens = 0; // decompression tokens in use
+        GraphStats::Id analysisTokenWait = 0; // from the first token of a round returning until all are requeued
+    } m_statIds;
+    uint64_t m_roundStart = 0;
+
+    void registerStats() override;
+    void returnDecompressionToken();
 };
 
 #endif // DENSEPARALLELGRAPH_H
@@ -0,0 +1,121 @@
+#include "posteriorsummary.h"
+#include "atomicfile.h"
+#include "checkpoint.h"
+
+#include <cassert>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+void welford(unsigned int count, const Eigen::VectorXd &x, Eigen::VectorXd &mean, Eigen::VectorXd &m2)
+{
+    const Eigen::ArrayXd delta = x - mean;
+    mean.array() += delta / count;
+    m2.array() += delta * (x - mean).array();
+}
+
+Eigen::VectorXd standardDeviation(unsigned int count, const Eigen::VectorXd &m2)
+{
+    if (count < 2)
+        return Eigen::VectorXd::Constant(m2.size(), std::numeric_limits<double>::quiet_NaN());
+    return (m2 / (count - 1)).cwiseSqrt();
+}
+
+}
+
+PosteriorSummary::PosteriorSummary(const std::vector<std::string> &parameters, unsigned int markerCount)
+    : m_parameters(parameters)
+    , m_betaMean(Eigen::VectorXd::Zero(markerCount))
+    , m_betaM2(Eigen::VectorXd::Zero(markerCount))
+    , m_inclusions(Eigen::VectorXd::Zero(markerCount))
+    , m_parameterMean(Eigen::VectorXd::Zero(static_cast<Eigen::Index>(parameters.size())))
+    , m_parameterM2(Eigen::VectorXd::Zero(static_cast<Eigen::Index>(parameters.size())))
+{
+}
+
+void PosteriorSummary::update(const Eigen::VectorXd &beta, const Eigen::VectorXd &parameters)
+{
+    assert(beta.size() == m_betaMean.size());
+    assert(parameters.size() == m_parameterMean.size());
+
+    ++m_count;
+    welford(m_count, beta, m_betaMean, m_betaM2);
+    welford(m_count, parameters, m_parameterMean, m_parameterM2);
+    m_inclusions.array() += (beta.array() != 0).cast<double>();
+}
+
+Eigen::VectorXd PosteriorSummary::betaSd() const
+{
+    return standardDeviation(m_count, m_betaM2);
+}
+
+Eigen::VectorXd PosteriorSummary::inclusionProbability() const
+{
+    if (m_count == 0)
+        return Eigen::VectorXd::Zero(m_inclusions.size());
+    return m_inclusions / m_count;
+}
+
+Eigen::VectorXd PosteriorSummary::parameterSd() const
+{
+    return standardDeviation(m_count, m_parameterM2);
+}
+
+bool PosteriorSummary::write(const std::string &fileName) const
+{
+    const bool written = writeFileAtomically(fileName, [this] (std::ostream &out) {
+        out.precision(std::numeric_limits<double>::max_digits10);
+        out << "# samples: " << m_count << "\n";
+        out << "name,mean,sd,pip\n";
+
+        const auto parameterSds = parameterSd();
+        for (size_t i = 0; i < m_parameters.size(); ++i) {
+            const auto j = static_cast<Eigen::Index>(i);
+            out << m_parameters[i] << "," << m_parameterMean[j] << "," << parameterSds[j] << ",\n";
+        }
+
+        const auto betaSds = betaSd();
+        const auto pips = inclusionProbability();
+        for (Eigen::Index i = 0; i < m_betaMean.size(); ++i)
+            out << "beta[" << (i + 1) << "]," << m_betaMean[i] << "," << betaSds[i] << "," << pips[i] << "\n";
+    });
+
+    if (!written)
+        std::cerr << "Could not write posterior summary to " << fileName << std::endl;
+    return written;
+}
+
+void PosteriorSummary::save(Checkpoint &checkpoint) const
+{
+    checkpoint.set("summary.count", static_cast<double>(m_count));
+    checkpoint.set("summary.betaMean", m_betaMean);
+    checkpoint.set("summary.betaM2", m_betaM2);
+    checkpoint.set("summary.inclusions", m_inclusions);
+    checkpoint.set("summary.parameterMean", m_parameterMean);
+    checkpoint.set("summary.parameterM2", m_parameterM2);
+}
+
+bool PosteriorSummary::restore(const Checkpoint &checkpoint)
+{
+    double count = 0;
+    Eigen::VectorXd betaMean, betaM2, inclusions, parameterMean, parameterM2;
+    if (!checkpoint.get("summary.count", count)
+            || !checkpoint.get("summary.betaMean", betaMean)
+            || !checkpoint.get("summary.betaM2", betaM2)
+            || !checkpoint.get("summary.inclusions", inclusions)
+            || !checkpoint.get("summary.parameterMean", parameterMean)
+            || !checkpoint.get("summary.parameterM2", parameterM2))
+        return false;
+
+    if (betaMean.size() != m_betaMean.size() || parameterMean.size() != m_parameterMean.size())
+        return false;
+
+    m_count = static_cast<unsigned int>(count);
+    m_betaMean = betaMean;
+    m_betaM2 = betaM2;
+    m_inclusions = inclusions;
+    m_parameterMean = parameterMean;
+    m_parameterM2 = parameterM2;
+    return true;
+}
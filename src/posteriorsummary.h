@@ -0,0 +1,49 @@
+#ifndef POSTERIORSUMMARY_H
+#define POSTERIORSUMMARY_H
+
+#include <Eigen/Eigen>
+
+#include <string>
+#include <vector>
+
+// Running posterior summaries, so that means, standard deviations and
+// posterior inclusion probabilities are available without keeping every
+// sample. Means and variances use Welford's algorithm.
+class Checkpoint;
+
+class PosteriorSummary
+{
+public:
+    // parameters names the model scalars passed to update(), e.g. mu, sigmaE
+    PosteriorSummary(const std::vector<std::string> &parameters, unsigned int markerCount);
+
+    void update(const Eigen::VectorXd &beta, const Eigen::VectorXd &parameters);
+
+    unsigned int sampleCount() const { return m_count; }
+
+    const Eigen::VectorXd &betaMean() const { return m_betaMean; }
+    Eigen::VectorXd betaSd() const;
+    Eigen::VectorXd inclusionProbability() const;
+
+    const Eigen::VectorXd &parameterMean() const { return m_parameterMean; }
+    Eigen::VectorXd parameterSd() const;
+
+    // Writes name,mean,sd,pip rows: one per parameter, then one per marker
+    bool write(const std::string &fileName) const;
+
+    void save(Checkpoint &checkpoint) const;
+    bool restore(const Checkpoint &checkpoint);
+
+private:
+    std::vector<std::string> m_parameters;
+    unsigned int m_count = 0;
+
+    Eigen::VectorXd m_betaMean;
+    Eigen::VectorXd m_betaM2;
+    Eigen::VectorXd m_inclusions;
+
+    Eigen::VectorXd m_parameterMean;
+    Eigen::VectorXd m_parameterM2;
+};
+
+#endif // POSTERIORSUMMARY_H
@@ -1,61 +1,86 @@
 #include "preprocessgraph.h"
 
+#include "beddecoder.h"
+#include "bedfile.h"
+#include "csvfile.h"
+#include "densemarkerbuilder.h"
 #include "marker.h"
 #include "markerbuilder.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+bool writeAt(int fd, const unsigned char *data, size_t size, unsigned long offset)
+{
+    while (size > 0) {
+        const auto written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<unsigned long>(written);
+    }
+
+    return true;
+}
+
+}
+
 PreprocessGraph::PreprocessGraph(size_t maxParallel)
     : m_maxParallel(maxParallel)
     , m_graph(new graph)
 {
-    auto processAndCompress = [] (Message msg) -> Message {
-        const auto columnSize = (msg.data->numInds + 3) >> 2;
-
-        ifstream inStream(msg.bedFile.c_str(), ios::binary);
-        if (!inStream) {
-            cerr << "Error: can not open the file [" + msg.bedFile + "] to read." << endl;
-            return msg;
+    auto processAndCompress = [this] (Message msg) -> continue_msg {
+        if (m_graphStats)
+            m_graphStats->pop(m_statIds.ordering);
+        GraphStats::Timer timer(m_graphStats, m_statIds.process);
+
+        if (msg.csvFile) {
+            processCsvChunk(msg);
+            writeChunk(msg);
+            return {};
         }
 
+        const auto columnSize = BedDecoder::columnSize(msg.data->numInds);
+
         std::unique_ptr<MarkerBuilder> builder {builderForType(msg.type)};
 
-        const auto offset = 3 + (msg.startSnp * columnSize);
-        inStream.seekg(offset);
+        // Decode straight from the shared mapping of the BED file
+        const auto snpCount = std::min(msg.chunkSize,
+                                       static_cast<size_t>(msg.data->numSnps - msg.startSnp));
+        msg.bedFile->willNeed(static_cast<size_t>(msg.startSnp), snpCount, columnSize);
 
-        for (size_t j = msg.startSnp, chunk = 0; j < msg.data->numSnps && chunk < msg.chunkSize; ++j, ++chunk ) {
+        BedDecoder decoder(msg.data->numInds, msg.keptIndividuals);
+
+        for (size_t j = msg.startSnp, chunk = 0; chunk < snpCount; ++j, ++chunk ) {
             SnpInfo *snpInfo = msg.data->snpInfoVec[j];
 
-            if (!snpInfo->included) {
-                inStream.ignore(columnSize);
+            if (!snpInfo->included)
                 continue;
-            }
 
-            builder->initialise(j, static_cast<double>(msg.data->numInds));
+            // QC uses the same decoded column as the marker
+            const auto column = decoder.decode(msg.bedFile->column(j, columnSize));
+            m_stats[j] = computeMarkerStats(column);
+            if (!m_qcThresholds.passes(m_stats[j]))
+                continue;
 
-            for (unsigned int i = 0; i < msg.data->numInds;) {
-                char ch;
-                inStream.read(&ch, 1);
-                if (!inStream) {
-                    cerr << "Error: problem with the BED file ... has the FAM/BIM file been changed?" << endl;
-                    // Abort here?
-                    return msg;
-                }
-
-                bitset<8> b = ch;
-                unsigned int k = 0;
-
-                while (k < 7 && i < msg.data->numInds) {
-                    if (!msg.data->indInfoVec[i]->kept) {
-                        k += 2;
-                    } else {
-                        const unsigned int allele1 = (!b[k++]);
-                        const unsigned int allele2 = (!b[k++]);
-
-                        builder->processAllele(i, allele1, allele2);
-                    }
-                    i++;
-                }
-            }
+            if (m_individualMajor)
+                m_individualMajor->writeColumn(j, column);
 
+            builder->initialise(j, static_cast<double>(msg.data->numInds));
+            builder->processColumn(column);
             builder->endColumn();
             msg.snpData.at(chunk) = builder->build();
 
@@ -69,79 +94,36 @@ PreprocessGraph::PreprocessGraph(size_t maxParallel)
             }
         }
 
-        return msg;
+        writeChunk(msg);
+        return {};
     };
 
-    m_processAndCompressNode.reset(new function_node<Message, Message>(*m_graph, m_maxParallel, processAndCompress));
+    m_processAndCompressNode.reset(new function_node<Message>(*m_graph, m_maxParallel, processAndCompress));
 
     // The sequencer node enforces the correct ordering based upon the message id
     m_ordering.reset(new sequencer_node<Message>(*m_graph, [] (const Message& msg) -> unsigned int {
         return msg.id;
     }));
 
-    m_ordering2.reset(new sequencer_node<Message>(*m_graph, [] (const Message& msg) -> unsigned int {
-        return msg.id;
-    }));
-
     // Control the number of messages flowing through the graph
     const auto limit = m_maxParallel == unlimited
             ? static_cast<size_t>(tbb::this_task_arena::max_concurrency())
             : m_maxParallel;
     m_limit.reset(new limiter_node<Message>(*m_graph, limit));
 
-    auto writeToDisk = [this] (Message msg) -> Message {
-        // Write out the preprocessed data
-        if (!msg.compress) {
-            for (auto& dataPtr : msg.snpData) {
-                if (!dataPtr)
-                    continue;
-
-                dataPtr->write(m_output.get());
-
-                m_indexOutput->write(reinterpret_cast<char *>(&m_position),
-                                     sizeof(unsigned long));
-                const auto size = static_cast<unsigned long>(dataPtr->size());
-                m_indexOutput->write(reinterpret_cast<const char *>(&size),
-                                  sizeof(unsigned long));
-                m_indexOutput->write(reinterpret_cast<const char *>(&size),
-                                  sizeof(unsigned long));
-                m_position += size;
-            }
-        } else {
-            std::for_each(msg.compressedSnpData.cbegin(),
-                          msg.compressedSnpData.cend(),
-                          [&] (const CompressedMarker& compressed) {
-                if (!compressed.buffer)
-                    return;
-
-                writeCompressedDataWithIndex(compressed.buffer.get(),
-                                             compressed.index.compressedSize,
-                                             compressed.index.originalSize,
-                                             *m_output,
-                                             *m_indexOutput,
-                                             m_position);
-            });
-        }
-        return msg;
-    };
-
-    m_writeNode.reset(new function_node<Message>(*m_graph, serial, writeToDisk));
-
     // Set up the graph topology:
     //
-    // orderingNode -> limitNode -> processAndCompressNode (parallel) -> orderingNode -> writeNode (sequential)
-    //                      ^                                                               |
-    //                      |_______________________________________________________________|
+    // orderingNode -> limitNode -> processAndCompressNode (parallel, writes its own chunk)
+    //                      ^                      |
+    //                      |______________________|
     //
-    // This ensures that we feed the writeNode with compressed data in the correct order and signal back to
-    // the parallel processAndCompressNode to keep it constantly fed. This should be a self-balancing graph.
+    // The limiter bounds the number of chunks held in memory. Each chunk is written as soon as it
+    // is processed, so no chunk waits for the ones before it.
     make_edge(*m_ordering, *m_limit);
     make_edge(*m_limit, *m_processAndCompressNode);
-    make_edge(*m_processAndCompressNode, *m_ordering2);
-    make_edge(*m_ordering2, *m_writeNode);
 
-    // Feedback that we can now decompress another column
-    make_edge(*m_writeNode, m_limit->decrement);
+    // Feedback that we can now process another chunk
+    make_edge(*m_processAndCompressNode, m_limit->decrement);
 }
 
 PreprocessGraph::~PreprocessGraph()
@@ -149,70 +131,337 @@ PreprocessGraph::~PreprocessGraph()
     m_graph->wait_for_all();
 }
 
-void PreprocessGraph::preprocessBedFile(const std::string &dataFile,
+void PreprocessGraph::setStats(GraphStats *stats)
+{
+    m_graphStats = stats;
+    if (m_graphStats) {
+        m_statIds.process = m_graphStats->addNode("process_and_compress_node");
+        m_statIds.write = m_graphStats->addWait("write_chunk");
+        m_statIds.ordering = m_graphStats->addQueue("ordering_node");
+    }
+}
+
+void PreprocessGraph::processCsvChunk(Message &msg)
+{
+    const auto numInds = msg.data->numInds;
+    const auto rowCount = std::min(msg.chunkSize,
+                                   static_cast<size_t>(msg.data->numSnps - msg.startSnp));
+
+    const auto &offsets = *msg.lineOffsets;
+    const size_t first = static_cast<size_t>(msg.startSnp);
+    const size_t end = first + rowCount < offsets.size() ? offsets[first + rowCount] : std::string::npos;
+    msg.csvFile->willNeed(offsets[first], end);
+
+    DenseMarkerBuilder builder;
+    std::vector<double> values(numInds);
+    for (size_t j = first, chunk = 0; chunk < rowCount; ++j, ++chunk) {
+        if (!msg.csvFile->parseLine(offsets[j], values.data(), values.size())) {
+            cerr << "Error: line " << j + 1 << " of the CSV file does not hold "
+                 << numInds << " numeric values" << endl;
+            m_writeFailed = true;
+            return;
+        }
+
+        builder.initialise(static_cast<unsigned int>(j), numInds);
+        builder.processValues(values.data());
+        builder.endColumn();
+        msg.snpData.at(chunk) = builder.build();
+
+        if (msg.compress && msg.snpData.at(chunk)) {
+            msg.compressedSnpData.at(chunk) = msg.snpData.at(chunk)->compress();
+            msg.snpData.at(chunk).reset();
+        }
+    }
+}
+
+void PreprocessGraph::writeChunk(Message &msg)
+{
+    struct Extent {
+        size_t snp = 0;
+        unsigned long offset = 0; // relative to the start of the chunk
+        unsigned long size = 0;
+        unsigned long originalSize = 0;
+    };
+    std::vector<Extent> extents;
+    extents.reserve(msg.chunkSize);
+
+    // Uncompressed markers are serialised into one buffer so that the whole chunk is a single write
+    std::string uncompressed;
+    unsigned long chunkSize = 0;
+    if (!msg.compress) {
+        std::ostringstream stream;
+        for (size_t chunk = 0; chunk < msg.snpData.size(); ++chunk) {
+            const auto &dataPtr = msg.snpData[chunk];
+            if (!dataPtr)
+                continue;
+
+            dataPtr->write(&stream);
+            const auto size = static_cast<unsigned long>(dataPtr->size());
+            extents.push_back({static_cast<size_t>(msg.startSnp) + chunk, chunkSize, size, size});
+            chunkSize += size;
+        }
+        uncompressed = stream.str();
+    } else {
+        for (size_t chunk = 0; chunk < msg.compressedSnpData.size(); ++chunk) {
+            const auto &compressed = msg.compressedSnpData[chunk];
+            if (!compressed.buffer)
+                continue;
+
+            extents.push_back({static_cast<size_t>(msg.startSnp) + chunk, chunkSize,
+                               compressed.index.compressedSize, compressed.index.originalSize});
+            chunkSize += compressed.index.compressedSize;
+        }
+    }
+
+    // Reserve the extent for the whole chunk
+    const unsigned long base = m_position.fetch_add(chunkSize);
+    GraphStats::Timer timer(m_graphStats, m_statIds.write);
+
+    bool ok = true;
+    if (!msg.compress) {
+        ok = writeAt(m_outputFd, reinterpret_cast<const unsigned char *>(uncompressed.data()),
+                     uncompressed.size(), base);
+    } else {
+        for (const auto &extent : extents) {
+            const auto &compressed = msg.compressedSnpData[extent.snp - static_cast<size_t>(msg.startSnp)];
+            ok = ok && writeAt(m_outputFd, compressed.buffer.get(), extent.size, base + extent.offset);
+        }
+    }
+
+    if (!ok) {
+        cerr << "Error: failed to write chunk " << msg.id << " of the preprocessed bed file." << endl;
+        m_writeFailed = true;
+        return;
+    }
+
+    // Each SNP belongs to exactly one chunk, so the slots can be filled without locking
+    std::vector<ChunkManifest::Entry> entries;
+    entries.reserve(extents.size());
+    for (const auto &extent : extents) {
+        m_index[extent.snp] = {base + extent.offset, extent.size, extent.originalSize};
+        m_indexWritten[extent.snp] = 1;
+        entries.push_back({extent.snp, m_index[extent.snp]});
+    }
+
+    if (m_manifest && !m_manifest->record(static_cast<size_t>(msg.startSnp) / msg.chunkSize, entries))
+        cerr << "Warning: could not record chunk " << msg.id << " in " << m_manifest->file() << endl;
+}
+
+bool PreprocessGraph::writeIndex(const std::string &indexFile, bool append) const
+{
+    std::ofstream indexOutput(indexFile.c_str(), append ? ios::binary | ios::app : ios::binary);
+    if (indexOutput.fail()) {
+        cerr << "Error: Unable to open the preprocessed bed index file [" + indexFile + "] for writing." << endl;
+        return false;
+    }
+
+    // Entries stay in SNP order even though the data was written out of order
+    for (size_t snp = 0; snp < m_index.size(); ++snp) {
+        if (!m_indexWritten[snp])
+            continue;
+
+        const auto &entry = m_index[snp];
+        indexOutput.write(reinterpret_cast<const char *>(&entry.pos), sizeof(unsigned long));
+        indexOutput.write(reinterpret_cast<const char *>(&entry.compressedSize), sizeof(unsigned long));
+        indexOutput.write(reinterpret_cast<const char *>(&entry.originalSize), sizeof(unsigned long));
+    }
+
+    return !indexOutput.fail();
+}
+
+bool PreprocessGraph::preprocessBedFile(const std::string &dataFile,
                                         const PreprocessDataType type,
                                         const bool compress,
                                         const Data *data,
-                                        const size_t chunkSize)
+                                        const size_t chunkSize,
+                                        const bool resume,
+                                        const std::string &appendTo)
 {
     // Reset the graph from the previous iteration. This resets the sequencer node current index etc.
     m_graph->reset();
     m_position = 0;
+    m_writeFailed = false;
 
     // Verify prerequisites and BED file
     cout << "Preprocessing bed file: " << type << ", Compress data = " << (compress ? "yes" : "no") << endl;
     if (!data) {
         cerr << "Error: Cannot preprocess data with invalid Data*" << endl;
-        return;
+        return false;
     }
     if (chunkSize < 1) {
         cerr << "Error: chunkSize must be at least 1" << endl;
-        return;
+        return false;
     }
     if (data->numSnps == 0) {
         cerr << "Error: No SNP is retained for analysis." << endl;
-        return;
+        return false;
     }
     if (data->numInds == 0) {
         cerr << "Error: No individual is retained for analysis." << endl;
-        return;
+        return false;
     }
 
-    const auto ppFile = ppFileForType(type, dataFile);
-    const auto ppIndexFile = ppIndexFileForType(type, dataFile);
+    // When appending, the new SNPs are added to the preprocessed files of another data set
+    const bool append = !appendTo.empty();
+    const auto& outputDataFile = append ? appendTo : dataFile;
+    const auto ppFile = ppFileForType(type, outputDataFile);
+    const auto ppIndexFile = ppIndexFileForType(type, outputDataFile);
 
     if (ppFile.empty() || ppIndexFile.empty())
-        return;
+        return false;
 
-    ifstream inStream(dataFile.c_str(), ios::binary);
-    if (!inStream) {
-        cerr << "Error: can not open the file [" + dataFile + "] to read." << endl;
-        return;
-    }
+    auto bedFile = std::make_shared<const BedFile>(dataFile);
+    if (!bedFile->isMapped())
+        return false;
 
     cout << "Reading PLINK BED file from [" + dataFile + "] in SNP-major format ..." << endl;
 
-    char header[3];
-    inStream.read(header, 3);
-    if (!inStream || header[0] != 0x6c || header[1] != 0x1b || header[2] != 0x01) {
+    if (!bedFile->hasValidHeader()) {
         cerr << "Error: Incorrect first three bytes of bed file: " << type << endl;
-        return;
+        return false;
     }
 
-    m_output = std::make_unique<std::ofstream>(ppFile.c_str(), ios::binary);
-    if (m_output->fail()) {
-        cerr << "Error: Unable to open the preprocessed bed file [" + ppFile + "] for writing." << endl;
-        return;
+    if (!bedFile->hasColumns(data->numSnps, BedDecoder::columnSize(data->numInds))) {
+        cerr << "Error: problem with the BED file ... has the FAM/BIM file been changed?" << endl;
+        return false;
     }
 
-    m_indexOutput = std::make_unique<std::ofstream>(ppIndexFile.c_str(), ios::binary);
-    if (m_indexOutput->fail()) {
-        cerr << "Error: Unable to open the preprocessed bed index file [" + ppIndexFile + "] for writing." << endl;
-        return;
+    ChunkManifest::Header header;
+    header.type = static_cast<unsigned int>(type);
+    header.compress = compress ? 1 : 0;
+    header.numSnps = data->numSnps;
+    header.numInds = data->numInds;
+    header.chunkSize = chunkSize;
+
+    PreprocessedFormat format;
+    format.type = header.type;
+    format.compress = header.compress;
+    format.numInds = data->numInds;
+
+    if (append) {
+        // The target must hold the same individuals, stored the same way
+        std::vector<MarkerStats> targetStats;
+        PreprocessedFormat targetFormat;
+        if (!readMarkerStats(qcFile(ppFile), targetStats, &targetFormat)) {
+            cerr << "Error: Cannot append to [" + ppFile + "] without its marker statistics file." << endl;
+            return false;
+        }
+        if (targetFormat != format) {
+            cerr << "Error: Cannot append to [" + ppFile + "] as it was preprocessed with another data type, "
+                    "compression or number of individuals." << endl;
+            return false;
+        }
+        if (!data->matchesFamFile(fileWithSuffix(appendTo, ".fam"))) {
+            cerr << "Error: Cannot append to [" + ppFile + "] as " << fileWithSuffix(appendTo, ".fam")
+                 << " lists other individuals than " << fileWithSuffix(dataFile, ".fam") << endl;
+            return false;
+        }
+
+        // New data goes after the existing markers; the existing index is left untouched
+        struct stat indexInfo;
+        if (stat(ppIndexFile.c_str(), &indexInfo) == -1) {
+            cerr << "Error: Cannot append to [" + ppIndexFile + "] as it does not exist." << endl;
+            return false;
+        }
+
+        PpBedIndex existing(static_cast<size_t>(indexInfo.st_size) / sizeof(IndexEntry));
+        ifstream indexStream(ppIndexFile.c_str(), ios::binary);
+        indexStream.read(reinterpret_cast<char *>(existing.data()),
+                         static_cast<std::streamsize>(existing.size() * sizeof(IndexEntry)));
+        if (!indexStream) {
+            cerr << "Error: Failed to read the preprocessed bed index [" + ppIndexFile + "]." << endl;
+            return false;
+        }
+
+        // The index holds the kept SNPs only
+        const auto keptCount = std::count_if(targetStats.cbegin(), targetStats.cend(),
+                                             [] (const MarkerStats &stats) { return stats.kept; });
+        if (static_cast<size_t>(keptCount) != existing.size()) {
+            cerr << "Error: The index and marker statistics of [" + ppFile + "] disagree on the number of SNPs." << endl;
+            return false;
+        }
+
+        for (const auto &entry : existing)
+            header.basePosition = std::max(header.basePosition, entry.pos + entry.compressedSize);
+        header.baseIndexCount = existing.size();
+
+        cout << "Appending " << data->numSnps << " SNPs to " << existing.size()
+             << " preprocessed SNPs in [" + ppFile + "]" << endl;
     }
 
+    m_index.assign(data->numSnps, {});
+    m_indexWritten.assign(data->numSnps, 0);
+    m_stats.assign(data->numSnps, {});
+    m_position = header.basePosition;
+
+    // Pick up the chunks completed by an interrupted run
+    m_manifest = std::make_unique<ChunkManifest>(ppFile + ".manifest");
+    std::set<size_t> completedChunks;
+    bool resumed = false;
+    if (resume) {
+        std::vector<ChunkManifest::Entry> entries;
+        resumed = m_manifest->load(header, completedChunks, entries);
+        if (resumed) {
+            unsigned long position = m_position;
+            for (const auto &entry : entries) {
+                m_index[entry.snp] = entry.index;
+                m_indexWritten[entry.snp] = 1;
+                position = std::max(position, entry.index.pos + entry.index.compressedSize);
+            }
+            m_position = position;
+
+            cout << "Resuming preprocessing: " << completedChunks.size()
+                 << " chunks already written" << endl;
+        } else {
+            cout << "No preprocessing manifest to resume from, starting from scratch" << endl;
+            completedChunks.clear();
+        }
+    }
+
+    if (!(resumed ? m_manifest->reopen() : m_manifest->create(header))) {
+        m_manifest.reset();
+        return false;
+    }
+
+    // Only a fresh, non-appending run may discard the existing data
+    const int flags = (resumed || append) ? O_WRONLY | O_CREAT : O_WRONLY | O_CREAT | O_TRUNC;
+    m_outputFd = open(ppFile.c_str(), flags, 0644);
+    if (m_outputFd == -1) {
+        cerr << "Error: Unable to open the preprocessed bed file [" + ppFile + "] for writing." << endl;
+        m_manifest.reset();
+        return false;
+    }
+    m_manifest->setDataFile(m_outputFd);
+
+    const auto keptIndividuals = BedDecoder::keptIndividuals(data);
+
+    // The individual-major copy is filled from the same decoded columns
+    m_individualMajor.reset();
+    if (m_writeIndividualMajor && append) {
+        cerr << "Warning: the individual-major layout cannot be appended to, skipping it" << endl;
+    } else if (m_writeIndividualMajor) {
+        IndividualMajorLayout layout;
+        layout.numInds = data->numInds;
+        layout.numSnps = data->numSnps;
+
+        const auto file = individualMajorFile(ppFile);
+        auto writer = std::make_unique<IndividualMajorWriter>();
+        const bool opened = resumed
+                ? writer->reopen(file, layout, type)
+                : writer->create(file, layout, keptIndividuals->size() < data->numInds, type);
+        if (opened)
+            m_individualMajor = std::move(writer);
+        else
+            cerr << "Warning: not writing the individual-major file [" + file + "]" << endl;
+    }
+
+    if (m_graphStats)
+        m_graphStats->beginIteration();
+
     size_t msgId = 0;
-    for (streamsize snp = 0; snp < data->numSnps; snp += chunkSize, ++msgId) {
+    for (streamsize snp = 0; snp < data->numSnps; snp += chunkSize) {
+        if (completedChunks.count(static_cast<size_t>(snp) / chunkSize))
+            continue;
 
         Message msg {
             type,
@@ -220,25 +469,158 @@ void PreprocessGraph::preprocessBedFile(const std::string &dataFile,
             snp,
             chunkSize,
             compress,
-            dataFile,
+            bedFile,
             data,
+            keptIndividuals,
             {chunkSize, nullptr}, // snpData
             {chunkSize, {nullptr, 0}}, // compressedData
         };
 
+        if (m_graphStats)
+            m_graphStats->push(m_statIds.ordering);
         m_ordering->try_put(msg);
+        ++msgId;
     }
 
-    inStream.clear();
-    inStream.close();
-
     // Wait for the graph to complete
     m_graph->wait_for_all();
+    if (m_graphStats)
+        m_graphStats->endIteration();
+
+    // Clean up. The last records become durable while the data file is still open.
+    if (!m_manifest->sync())
+        cerr << "Warning: could not sync " << m_manifest->file() << endl;
+    m_manifest->setDataFile(-1);
+    close(m_outputFd);
+    m_outputFd = -1;
+
+    if (m_individualMajor && !m_individualMajor->close())
+        cerr << "Error: Unable to write the individual-major file for [" + ppFile + "]." << endl;
+    m_individualMajor.reset();
+
+    // The chunks written so far stay on disk with the manifest, for --preprocess-resume
+    if (m_writeFailed) {
+        cerr << "Error: Unable to write the preprocessed bed file [" + ppFile + "]." << endl;
+        m_manifest.reset();
+        return false;
+    }
 
-    // Clean up
-    m_output.reset();
-    if (compress)
-        m_indexOutput.reset();
+    // A SNP is kept if it made it to disk, which also covers markers rejected by the builder
+    size_t keptCount = 0;
+    for (size_t snp = 0; snp < m_stats.size(); ++snp) {
+        m_stats[snp].kept = m_indexWritten[snp];
+        keptCount += m_indexWritten[snp];
+    }
+    cout << "Marker QC kept " << keptCount << " of " << m_stats.size() << " SNPs" << endl;
+
+    // The manifest is only needed until the index and statistics are safely written
+    const bool written = writeMarkerStats(qcFile(ppFile), format, m_stats, append) &&
+            writeIndex(ppIndexFile, append);
+    if (written)
+        m_manifest->remove();
+    m_manifest.reset();
+    if (!written)
+        return false;
+
+    if (append) {
+        cout << "Appended to [" + ppFile + "]. The SNPs in " << fileWithSuffix(dataFile, ".bim")
+             << " must also be appended to " << fileWithSuffix(appendTo, ".bim") << endl;
+    }
 
     cout << "Finished reading PLINK BED file." << endl;
+    return true;
+}
+
+bool PreprocessGraph::preprocessCsvFile(const std::string &csvFile,
+                                        const bool compress,
+                                        const Data *data,
+                                        const size_t chunkSize)
+{
+    m_graph->reset();
+    m_position = 0;
+    m_writeFailed = false;
+    m_manifest.reset();
+    m_individualMajor.reset();
+
+    const auto type = PreprocessDataType::Dense;
+    cout << "Preprocessing csv file: " << csvFile << ", Compress data = " << (compress ? "yes" : "no") << endl;
+    if (!data) {
+        cerr << "Error: Cannot preprocess data with invalid Data*" << endl;
+        return false;
+    }
+    if (chunkSize < 1) {
+        cerr << "Error: chunkSize must be at least 1" << endl;
+        return false;
+    }
+    if (data->numSnps == 0 || data->numInds == 0) {
+        cerr << "Error: No data is retained for analysis." << endl;
+        return false;
+    }
+
+    const auto ppFile = ppFileForType(type, csvFile);
+    const auto ppIndexFile = ppIndexFileForType(type, csvFile);
+
+    auto file = std::make_shared<const CsvFile>(csvFile);
+    if (!file->isMapped())
+        return false;
+
+    // Finding the line starts is a memchr pass; all parsing happens in the workers
+    const auto lineOffsets = std::make_shared<const std::vector<size_t>>(file->lineOffsets());
+    if (lineOffsets->size() != data->numSnps) {
+        cerr << "Error: problem with the CSV file ... has it been changed?" << endl;
+        return false;
+    }
+
+    m_index.assign(data->numSnps, {});
+    m_indexWritten.assign(data->numSnps, 0);
+
+    m_outputFd = open(ppFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_outputFd == -1) {
+        cerr << "Error: Unable to open the preprocessed csv file [" + ppFile + "] for writing." << endl;
+        return false;
+    }
+
+    if (m_graphStats)
+        m_graphStats->beginIteration();
+
+    size_t msgId = 0;
+    for (streamsize snp = 0; snp < data->numSnps; snp += chunkSize, ++msgId) {
+        Message msg {
+            type,
+            msgId,
+            snp,
+            chunkSize,
+            compress,
+            nullptr, // bedFile
+            data,
+            nullptr, // keptIndividuals
+            {chunkSize, nullptr}, // snpData
+            {chunkSize, {nullptr, 0}}, // compressedData
+            file,
+            lineOffsets,
+        };
+
+        if (m_graphStats)
+            m_graphStats->push(m_statIds.ordering);
+        m_ordering->try_put(msg);
+    }
+
+    m_graph->wait_for_all();
+    if (m_graphStats)
+        m_graphStats->endIteration();
+
+    close(m_outputFd);
+    m_outputFd = -1;
+
+    // Without a manifest a partial file cannot be resumed, so do not leave it behind
+    if (m_writeFailed || !writeIndex(ppIndexFile, false)) {
+        cerr << "Error: Unable to preprocess the csv file [" + csvFile + "]." << endl;
+        std::remove(ppFile.c_str());
+        std::remove(ppIndexFile.c_str());
+        return false;
+    }
+
+    cout << "csv file for " << data->numInds << " individuals and " << data->numSnps
+         << " Variables are included from [" + csvFile + "]." << endl;
+    return true;
 }
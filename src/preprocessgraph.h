@@ -1,31 +1,57 @@
 #ifndef PREPROCESSGRAPH_H
 #define PREPROCESSGRAPH_H
 
+#include "chunkmanifest.h"
 #include "common.h"
 #include "compression.h"
 #include "data.hpp"
+#include "graphstats.h"
+#include "individualmajor.h"
 #include "marker.h"
+#include "markerqc.h"
 
 #include "tbb/flow_graph.h"
 #include <Eigen/Eigen>
 
 #include <array>
+#include <atomic>
 #include <memory>
+#include <vector>
 
 using namespace tbb::flow;
 
+class BedFile;
+class CsvFile;
+
 class PreprocessGraph
 {
 public:
     explicit PreprocessGraph(size_t maxParallel);
     ~PreprocessGraph();
 
-    void preprocessBedFile(const std::string &dataFile,
+    bool preprocessBedFile(const std::string &dataFile,
                            const PreprocessDataType type,
+                           const bool compress,
+                           const Data *data,
+                           const size_t chunkSize,
+                           const bool resume = false,
+                           const std::string &appendTo = {});
+
+    // CSV input always produces Dense markers. Resume, append, QC and the
+    // individual-major layout only apply to BED input.
+    bool preprocessCsvFile(const std::string &csvFile,
                            const bool compress,
                            const Data *data,
                            const size_t chunkSize);
 
+    void setQcThresholds(const QcThresholds &thresholds) { m_qcThresholds = thresholds; }
+
+    // Also write the individual-major copy of the genotypes, see IndividualMajorLayout
+    void setWriteIndividualMajor(bool write) { m_writeIndividualMajor = write; }
+
+    // Instrument the nodes; each preprocess call is recorded as one iteration
+    void setStats(GraphStats *stats);
+
 protected:
     struct Message {
         PreprocessDataType type = PreprocessDataType::None;
@@ -34,28 +60,58 @@ protected:
         size_t chunkSize = 0;
         bool compress = false;
 
-        std::string bedFile = "";
+        std::shared_ptr<const BedFile> bedFile = nullptr;
 
         const Data* data = nullptr;
+        std::shared_ptr<const std::vector<unsigned int>> keptIndividuals = nullptr;
 
         using MarkerPtrList = std::vector<MarkerPtr>;
         MarkerPtrList snpData;
 
         using CompressedMarkerList = std::vector<CompressedMarker>;
         CompressedMarkerList compressedSnpData;
+
+        // Set instead of bedFile when preprocessing a CSV file
+        std::shared_ptr<const CsvFile> csvFile = nullptr;
+        std::shared_ptr<const std::vector<size_t>> lineOffsets = nullptr;
     };
 
     size_t m_maxParallel = 1;
     std::unique_ptr<graph> m_graph;
-    std::unique_ptr<function_node<Message, Message>> m_processAndCompressNode;
+    std::unique_ptr<function_node<Message>> m_processAndCompressNode;
     std::unique_ptr<limiter_node<Message>> m_limit;
     std::unique_ptr<sequencer_node<Message>> m_ordering;
-    std::unique_ptr<sequencer_node<Message>> m_ordering2;
-    std::unique_ptr<function_node<Message>> m_writeNode;
 
-    std::unique_ptr<std::ofstream> m_output = nullptr;
-    std::unique_ptr<std::ofstream> m_indexOutput = nullptr;
-    unsigned long m_position = 0;
+    // Workers reserve an extent of the output file for their chunk and write
+    // it with pwrite, so chunks are written in parallel and in any order. The
+    // index is filled by SNP and written once all chunks are done.
+    int m_outputFd = -1;
+    std::atomic<unsigned long> m_position {0};
+    std::atomic<bool> m_writeFailed {false};
+    std::vector<IndexEntry> m_index;
+    std::vector<unsigned char> m_indexWritten;
+
+    // Markers failing QC are dropped before they are written. The statistics
+    // are filled by SNP, like the index, and saved alongside it.
+    QcThresholds m_qcThresholds;
+    std::vector<MarkerStats> m_stats;
+
+    bool m_writeIndividualMajor = false;
+    std::unique_ptr<IndividualMajorWriter> m_individualMajor = nullptr;
+
+    // Records finished chunks so that an interrupted run can be resumed
+    std::unique_ptr<ChunkManifest> m_manifest = nullptr;
+
+    GraphStats *m_graphStats = nullptr;
+    struct StatIds {
+        GraphStats::Id process = 0;
+        GraphStats::Id write = 0;
+        GraphStats::Id ordering = 0; // chunks queued in m_ordering and m_limit
+    } m_statIds;
+
+    void processCsvChunk(Message &msg);
+    void writeChunk(Message &msg);
+    bool writeIndex(const std::string &indexFile, bool append) const;
 };
 
 #endif // PREPROCESSGRAPH_H
@@ -1,13 +1,13 @@
 #include "raggedbayeswkernel.h"
 
 RaggedBayesWKernel::RaggedBayesWKernel(const std::shared_ptr<const RaggedSparseMarker> &marker)
-    : BayesWKernel (marker)
+    : SparseBayesWKernel (marker)
     , rsm(marker.get())
 {
     assert(marker);
 }
 
-void RaggedBayesWKernel::setVi(const std::shared_ptr<VectorXd> &vi)
+void RaggedBayesWKernel::setVi(const std::shared_ptr<const VectorXd> &vi)
 {
     vi_sum = vi->sum();
     vi_2 = (*vi)(rsm->Ztwos).sum();
@@ -60,18 +60,3 @@ VectorXdPtr RaggedBayesWKernel::calculateEpsilonChange(const double beta_old, co
 
     return delta;
 }
-
-double RaggedBayesWKernel::exponent_sum() const
-{
-    return (vi_1 * (1 - 2 * rsm->mean) + 4 * (1-rsm->mean) * vi_2 + vi_sum * rsm->mean * rsm->mean) /(rsm->sd*rsm->sd);
-}
-
-double RaggedBayesWKernel::integrand_adaptive(double s, double alpha, double sqrt_2Ck_sigmab) const
-{
-    const auto mean_sd_ratio = rsm->mean / rsm->sd;
-    const double temp = -alpha *s*sum_failure*sqrt_2Ck_sigmab +
-            vi_sum - exp(alpha*mean_sd_ratio*s*sqrt_2Ck_sigmab) *
-            (vi_0 + vi_1 * exp(-alpha * s*sqrt_2Ck_sigmab/rsm->sd) + vi_2* exp(-2 * alpha * s*sqrt_2Ck_sigmab/rsm->sd))
-            -pow(s,2);
-    return exp(temp);
-}
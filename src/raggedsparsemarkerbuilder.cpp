@@ -40,6 +40,35 @@ void RaggedSparseMarkerBuilder::processAllele(unsigned int individual,
     }
 }
 
+void RaggedSparseMarkerBuilder::processColumn(const GenotypeColumn &column)
+{
+    auto* raggedMarker = dynamic_cast<RaggedSparseMarker*>(m_marker.get());
+    assert(raggedMarker);
+
+    const auto oneCount = raggedMarker->Zones.size();
+    const auto twoCount = raggedMarker->Ztwos.size();
+
+    for (size_t k = 0; k < column.size; ++k) {
+        const int individual = static_cast<int>(column.individuals[k]);
+        switch (column.codes[k]) {
+        case 1:
+            raggedMarker->Zones.emplace_back(individual);
+            break;
+        case 2:
+            raggedMarker->Ztwos.emplace_back(individual);
+            break;
+        case kMissingGenotype:
+            raggedMarker->Zmissing.emplace_back(individual);
+            break;
+        default:
+            break;
+        }
+    }
+
+    raggedMarker->addGenotypeCounts(raggedMarker->Zones.size() - oneCount,
+                                    raggedMarker->Ztwos.size() - twoCount);
+}
+
 void RaggedSparseMarkerBuilder::endColumn()
 {
     auto* raggedMarker = dynamic_cast<RaggedSparseMarker*>(m_marker.get());
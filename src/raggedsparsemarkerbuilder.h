@@ -15,6 +15,8 @@ public:
                        unsigned int allele1,
                        unsigned int allele2) override;
 
+    void processColumn(const GenotypeColumn &column) override;
+
     void endColumn() override;
 };
 
@@ -0,0 +1,50 @@
+#include "samplefile.h"
+
+#include <iostream>
+#include <limits>
+#include <string>
+
+// Converts a binary MCMC sample file to CSV, in the same layout as the CSV
+// sample files written by the analyses. Sparse samples are written as the
+// number of non-zero betas followed by their (index, beta, comp) triplets.
+int main(int argc, const char * argv[])
+{
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <samples.bin> [samples.csv]" << std::endl;
+        return 1;
+    }
+
+    try {
+        SampleFileReader reader(argv[1]);
+
+        std::ofstream outFile;
+        if (argc == 3) {
+            outFile.open(argv[2]);
+            if (!outFile) {
+                std::cerr << "Could not open output file: " << argv[2] << std::endl;
+                return 1;
+            }
+        }
+        std::ostream &out = argc == 3 ? outFile : std::cout;
+        out.precision(reader.format() == SampleFormat::BinaryFloat
+                      ? std::numeric_limits<float>::max_digits10
+                      : std::numeric_limits<double>::max_digits10);
+
+        const auto names = sampleColumnNames(reader.schema());
+        for (size_t i = 0; i < names.size(); ++i)
+            out << (i == 0 ? "" : ",") << names[i];
+        out << "\n";
+
+        Eigen::VectorXd sample;
+        while (reader.readRow(sample))
+            writeCsvSampleRow(out, sample, reader.isSparse() ? &reader.sparse() : nullptr);
+    } catch (const std::string &message) {
+        std::cerr << message << std::endl;
+        return 1;
+    } catch (const char *message) {
+        std::cerr << message << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "samplefile.h"
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr char kMagic[4] = {'B', 'S', 'M', 'P'};
+// Version 2 added sparse fields and the uncompressed size of compressed blocks
+constexpr uint32_t kVersion = 2;
+
+constexpr uint32_t kArrayFlag = 0x1;
+constexpr uint32_t kSparseFlag = 0x2;
+
+template<typename T>
+void writeValue(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream &in, T &value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+template<typename T>
+void appendBytes(std::vector<unsigned char> &block, const T *data, size_t count)
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    block.insert(block.end(), bytes, bytes + count * sizeof(T));
+}
+
+template<typename T>
+void appendValues(std::vector<unsigned char> &block, const double *data, size_t count, T)
+{
+    const size_t offset = block.size();
+    block.resize(offset + count * sizeof(T));
+    T *out = reinterpret_cast<T *>(block.data() + offset);
+    for (size_t i = 0; i < count; ++i)
+        out[i] = static_cast<T>(data[i]);
+}
+
+void appendValues(std::vector<unsigned char> &block, const double *data, size_t count, SampleFormat format)
+{
+    if (format == SampleFormat::BinaryFloat)
+        appendValues(block, data, count, float());
+    else
+        appendBytes(block, data, count);
+}
+
+template<typename T>
+void readValues(const unsigned char *&in, double *out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i, in += sizeof(T)) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        out[i] = static_cast<double>(value);
+    }
+}
+
+void readValues(const unsigned char *&in, double *out, size_t count, uint32_t valueSize)
+{
+    if (valueSize == sizeof(float))
+        readValues<float>(in, out, count);
+    else
+        readValues<double>(in, out, count);
+}
+
+bool isLittleEndian()
+{
+    const uint32_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+uint32_t valueSize(SampleFormat format)
+{
+    return format == SampleFormat::BinaryFloat ? sizeof(float) : sizeof(double);
+}
+
+}
+
+void SparseSample::clear()
+{
+    index.clear();
+    beta.clear();
+    comp.clear();
+}
+
+void SparseSample::push_back(uint32_t i, double b, double c)
+{
+    index.push_back(i);
+    beta.push_back(b);
+    comp.push_back(c);
+}
+
+uint64_t sampleColumnCount(const SampleSchema &schema)
+{
+    uint64_t count = 0;
+    for (const auto &field : schema) {
+        if (!field.sparse)
+            count += field.count;
+    }
+    return count;
+}
+
+bool hasSparseField(const SampleSchema &schema)
+{
+    return std::any_of(schema.cbegin(), schema.cend(), [](const SampleField &field) {
+        return field.sparse;
+    });
+}
+
+std::vector<std::string> sampleColumnNames(const SampleSchema &schema)
+{
+    std::vector<std::string> names;
+    names.reserve(sampleColumnCount(schema) + 1);
+    for (const auto &field : schema) {
+        if (!field.array || field.sparse) {
+            names.push_back(field.name);
+            continue;
+        }
+
+        for (uint64_t i = 0; i < field.count; ++i)
+            names.push_back(field.name + "[" + std::to_string(i + 1) + "]");
+    }
+    return names;
+}
+
+void writeSampleHeader(std::ostream &out, const SampleSchema &schema,
+                       SampleFormat format, bool compress)
+{
+    if (!isLittleEndian())
+        throw("Binary sample files can only be written on little endian hosts");
+
+    out.write(kMagic, sizeof(kMagic));
+    writeValue(out, kVersion);
+    writeValue(out, valueSize(format));
+    writeValue(out, static_cast<uint32_t>(compress));
+    writeValue(out, static_cast<uint32_t>(schema.size()));
+    for (const auto &field : schema) {
+        const uint32_t flags = (field.array ? kArrayFlag : 0) | (field.sparse ? kSparseFlag : 0);
+        writeValue(out, static_cast<uint32_t>(field.name.size()));
+        out.write(field.name.data(), static_cast<std::streamsize>(field.name.size()));
+        writeValue(out, field.count);
+        writeValue(out, flags);
+    }
+}
+
+void writeSampleRow(std::ostream &out, const Eigen::VectorXd &sample,
+                    const SparseSample *sparse,
+                    SampleFormat format, bool compress,
+                    std::vector<unsigned char> &buffer)
+{
+    // Assemble the block, unless it is dense float64 and can be written as is
+    std::vector<unsigned char> block;
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(sample.data());
+    size_t size = static_cast<size_t>(sample.size()) * sizeof(double);
+    if (sparse || format == SampleFormat::BinaryFloat) {
+        appendValues(block, sample.data(), static_cast<size_t>(sample.size()), format);
+        if (sparse) {
+            const uint64_t count = sparse->size();
+            appendBytes(block, &count, 1);
+            appendBytes(block, sparse->index.data(), sparse->size());
+            appendValues(block, sparse->beta.data(), sparse->size(), format);
+            appendValues(block, sparse->comp.data(), sparse->size(), format);
+        }
+        data = block.data();
+        size = block.size();
+    }
+
+    if (!compress) {
+        out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+        return;
+    }
+
+    if (size > std::numeric_limits<unsigned int>::max())
+        throw("Sample block is too large to compress");
+
+    buffer.resize(maxCompressedDataSize<char>(static_cast<unsigned int>(size)));
+    const uint64_t compressedSize = compressData(reinterpret_cast<char *>(const_cast<unsigned char *>(data)),
+                                                 static_cast<unsigned int>(size),
+                                                 buffer.data(), buffer.size());
+    const uint64_t originalSize = size;
+    writeValue(out, compressedSize);
+    writeValue(out, originalSize);
+    out.write(reinterpret_cast<const char *>(buffer.data()),
+              static_cast<std::streamsize>(compressedSize));
+}
+
+void writeCsvSampleRow(std::ostream &out, const Eigen::VectorXd &sample,
+                       const SparseSample *sparse)
+{
+    for (Eigen::Index i = 0; i < sample.size(); ++i)
+        out << (i == 0 ? "" : ", ") << sample[i];
+
+    if (sparse) {
+        out << ", " << sparse->size();
+        for (size_t i = 0; i < sparse->size(); ++i)
+            out << ", " << sparse->index[i] << ", " << sparse->beta[i] << ", " << sparse->comp[i];
+    }
+    out << "\n";
+}
+
+SampleFileReader::SampleFileReader(const std::string &fileName)
+    : m_file(fileName, std::ios::binary)
+{
+    if (!m_file)
+        throw("Could not open sample file: " + fileName);
+
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    if (!m_file.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0
+            || !readValue(m_file, version))
+        throw("Not a binary sample file: " + fileName);
+    if (version != kVersion)
+        throw("Unsupported binary sample file version " + std::to_string(version) + ": " + fileName);
+
+    uint32_t compressed = 0;
+    uint32_t fieldCount = 0;
+    if (!readValue(m_file, m_valueSize) || !readValue(m_file, compressed) || !readValue(m_file, fieldCount))
+        throw("Truncated sample file header: " + fileName);
+
+    m_format = m_valueSize == sizeof(float) ? SampleFormat::BinaryFloat : SampleFormat::Binary;
+    m_compressed = compressed != 0;
+
+    m_schema.reserve(fieldCount);
+    for (uint32_t i = 0; i < fieldCount; ++i) {
+        uint32_t nameLength = 0;
+        if (!readValue(m_file, nameLength))
+            throw("Truncated sample file header: " + fileName);
+
+        std::string name(nameLength, '\0');
+        uint64_t count = 0;
+        uint32_t flags = 0;
+        if (!m_file.read(&name[0], nameLength) || !readValue(m_file, count) || !readValue(m_file, flags))
+            throw("Truncated sample file header: " + fileName);
+
+        if (flags & kArrayFlag)
+            m_schema.emplace_back(name, count, (flags & kSparseFlag) != 0);
+        else
+            m_schema.emplace_back(name);
+    }
+
+    m_columnCount = sampleColumnCount(m_schema);
+    m_sparse = hasSparseField(m_schema);
+    for (const auto &field : m_schema) {
+        if (field.sparse)
+            m_sparseCount += field.count;
+    }
+}
+
+bool SampleFileReader::readRow(Eigen::VectorXd &sample)
+{
+    const size_t denseSize = m_columnCount * m_valueSize;
+
+    if (m_compressed) {
+        uint64_t compressedSize = 0;
+        uint64_t originalSize = 0;
+        if (!readValue(m_file, compressedSize))
+            return false;
+        if (!readValue(m_file, originalSize))
+            throw("Truncated sample block");
+        m_compressedBuffer.resize(compressedSize);
+        m_buffer.resize(originalSize);
+        if (!m_file.read(reinterpret_cast<char *>(m_compressedBuffer.data()),
+                         static_cast<std::streamsize>(compressedSize)))
+            throw("Truncated sample block");
+        if (compressedSize > std::numeric_limits<unsigned int>::max()
+                || originalSize > std::numeric_limits<unsigned int>::max()
+                || extractData(m_compressedBuffer.data(), static_cast<unsigned int>(compressedSize),
+                               m_buffer.data(), static_cast<unsigned int>(m_buffer.size())) != originalSize)
+            throw("Corrupt sample block");
+        if (originalSize < denseSize + (m_sparse ? sizeof(uint64_t) : 0))
+            throw("Corrupt sample block");
+    } else {
+        m_buffer.resize(denseSize + (m_sparse ? sizeof(uint64_t) : 0));
+        if (!m_file.read(reinterpret_cast<char *>(m_buffer.data()),
+                         static_cast<std::streamsize>(m_buffer.size()))) {
+            if (m_file.gcount() == 0)
+                return false;
+            throw("Truncated sample block");
+        }
+
+        if (m_sparse) {
+            uint64_t count = 0;
+            std::memcpy(&count, m_buffer.data() + denseSize, sizeof(count));
+            if (count > m_sparseCount)
+                throw("Corrupt sample block");
+            const size_t tripletsSize = count * (sizeof(uint32_t) + 2 * m_valueSize);
+            m_buffer.resize(m_buffer.size() + tripletsSize);
+            if (!m_file.read(reinterpret_cast<char *>(m_buffer.data() + denseSize + sizeof(uint64_t)),
+                             static_cast<std::streamsize>(tripletsSize)))
+                throw("Truncated sample block");
+        }
+    }
+
+    const unsigned char *in = m_buffer.data();
+    sample.resize(static_cast<Eigen::Index>(m_columnCount));
+    readValues(in, sample.data(), m_columnCount, m_valueSize);
+
+    m_sparseSample.clear();
+    if (m_sparse) {
+        uint64_t count = 0;
+        std::memcpy(&count, in, sizeof(count));
+        in += sizeof(count);
+        const size_t available = m_buffer.size() - denseSize - sizeof(count);
+        if (count > m_sparseCount || count > available / (sizeof(uint32_t) + 2 * m_valueSize))
+            throw("Corrupt sample block");
+
+        m_sparseSample.index.resize(count);
+        m_sparseSample.beta.resize(count);
+        m_sparseSample.comp.resize(count);
+        std::memcpy(m_sparseSample.index.data(), in, count * sizeof(uint32_t));
+        in += count * sizeof(uint32_t);
+        readValues(in, m_sparseSample.beta.data(), count, m_valueSize);
+        readValues(in, m_sparseSample.comp.data(), count, m_valueSize);
+    }
+    return true;
+}
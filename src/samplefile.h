@@ -0,0 +1,100 @@
+#ifndef SAMPLEFILE_H
+#define SAMPLEFILE_H
+
+#include "common.h"
+
+#include <Eigen/Eigen>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary MCMC sample files
+//
+// The header holds the column schema as a list of fields. A field is either a
+// scalar such as mu, an array such as epsilon with one column per element, or
+// a sparse field holding the non-zero (index, beta, comp) triplets of the
+// marker effects.
+//
+// Each sample follows as one block: the dense columns as little endian
+// float64 or float32 values, then, if the schema has a sparse field, the
+// number of triplets as a uint64 followed by their 1-based uint32 indices,
+// betas and components. When compressed, each block is zlib compressed and
+// preceded by its compressed and uncompressed sizes as uint64s.
+struct SampleField {
+    SampleField(const std::string &name) : name(name) {}
+    SampleField(const std::string &name, uint64_t count, bool sparse = false)
+        : name(name), count(count), array(true), sparse(sparse) {}
+
+    std::string name;
+    uint64_t count = 1;
+    bool array = false;
+    bool sparse = false;
+};
+
+using SampleSchema = std::vector<SampleField>;
+
+struct SparseSample {
+    std::vector<uint32_t> index;
+    std::vector<double> beta;
+    std::vector<double> comp;
+
+    size_t size() const { return index.size(); }
+    void clear();
+    void push_back(uint32_t i, double b, double c);
+};
+
+// The number of dense columns
+uint64_t sampleColumnCount(const SampleSchema &schema);
+
+bool hasSparseField(const SampleSchema &schema);
+
+// The CSV column names, e.g. mu, beta[1], beta[2], ... A sparse field is a
+// single column holding the triplet count, followed by the triplets.
+std::vector<std::string> sampleColumnNames(const SampleSchema &schema);
+
+void writeSampleHeader(std::ostream &out, const SampleSchema &schema,
+                       SampleFormat format, bool compress);
+
+void writeSampleRow(std::ostream &out, const Eigen::VectorXd &sample,
+                    const SparseSample *sparse,
+                    SampleFormat format, bool compress,
+                    std::vector<unsigned char> &buffer);
+
+void writeCsvSampleRow(std::ostream &out, const Eigen::VectorXd &sample,
+                       const SparseSample *sparse);
+
+class SampleFileReader
+{
+public:
+    // Throws if the file cannot be opened or is not a sample file
+    explicit SampleFileReader(const std::string &fileName);
+
+    const SampleSchema &schema() const { return m_schema; }
+    uint64_t columnCount() const { return m_columnCount; }
+    SampleFormat format() const { return m_format; }
+    bool isCompressed() const { return m_compressed; }
+    bool isSparse() const { return m_sparse; }
+
+    // Returns false at the end of the file
+    bool readRow(Eigen::VectorXd &sample);
+
+    // The triplets of the last row read, if the file is sparse
+    const SparseSample &sparse() const { return m_sparseSample; }
+
+private:
+    std::ifstream m_file;
+    SampleSchema m_schema;
+    uint64_t m_columnCount = 0;
+    SampleFormat m_format = SampleFormat::Binary;
+    bool m_compressed = false;
+    bool m_sparse = false;
+    uint64_t m_sparseCount = 0; // the most triplets a row can hold
+    uint32_t m_valueSize = sizeof(double);
+    SparseSample m_sparseSample;
+    std::vector<unsigned char> m_compressedBuffer;
+    std::vector<unsigned char> m_buffer;
+};
+
+#endif // SAMPLEFILE_H
@@ -1,118 +1,158 @@
 #include "samplewriter.h"
 #include "data.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 
 using namespace Eigen;
 
 void SampleWriter::open()
 {
-	std::cout << "Opening results file " << m_fileName << std::endl;
-	m_outFile.open(m_fileName);
-
-	m_outFile << "iteration," << "mu,";
-	for (unsigned int i = 0; i < m_markerCount; ++i) {
-		m_outFile << "beta[" << (i+1) << "],";
-	}
-
-	m_outFile << "sigmaE," << "sigmaG,";
-		
-	for (unsigned int i = 0; i < m_markerCount; ++i) {
-		m_outFile << "comp[" << (i+1) << "],";
-	}
-
-	unsigned int i;
-	for (i = 0; i < (m_individualCount - 1); ++i) {
-		m_outFile << "epsilon[" << (i + 1) << "],";
-	}
-
-	m_outFile << "epsilon[" << (i + 1) << "]";
-	m_outFile << std::endl;
-	m_outFile.flush();
+	open({{"iteration"}, {"mu"},
+		  {"beta", m_markerCount},
+		  {"sigmaE"}, {"sigmaG"},
+		  {"comp", m_markerCount},
+		  {"epsilon", m_individualCount}});
 }
 
 void SampleWriter::open_bayesW()
 {
-	std::cout << "Opening results file " << m_fileName << std::endl;
-	m_outFile.open(m_fileName);
-
-	m_outFile << "iteration," << "alpha,"  << "mu,";
-
-	for (unsigned int i = 0; i < m_markerCount; ++i) {
-		m_outFile << "beta[" << (i+1) << "],";
-	}
-
-	for (unsigned int i = 0; i < m_markerCount; ++i) {
-		m_outFile << "comp[" << (i+1) << "],";
-	}
-
-	//    m_outFile << "sigma_b," << "sigmaG";
-	m_outFile << "sigma_b";
-
-	m_outFile << std::endl;
-	m_outFile.flush();
+	open({{"iteration"}, {"alpha"}, {"mu"},
+		  {"beta", m_markerCount},
+		  {"comp", m_markerCount},
+		  {"sigma_b"}});
 }
 
 void SampleWriter::open_bayesW_fixed()
 {
-	std::cout << "Opening results file " << m_fileName << std::endl;
-	m_outFile.open(m_fileName);
-
-	m_outFile << "iteration," << "alpha,"  << "mu,";
-
-	for (unsigned int i = 0; i < m_fixedCount; ++i) {
-		m_outFile << "theta[" << (i+1) << "],";
-	}
-
-	for (unsigned int i = 0; i < m_markerCount; ++i) {
-		m_outFile << "beta[" << (i+1) << "],";
-	}
+	open({{"iteration"}, {"alpha"}, {"mu"},
+		  {"theta", m_fixedCount},
+		  {"beta", m_markerCount},
+		  {"comp", m_markerCount},
+		  {"sigma_b"}});
+}
 
-	for (unsigned int i = 0; i < m_markerCount; ++i) {
-		m_outFile << "comp[" << (i+1) << "],";
-	}
+void SampleWriter::openGroups(int numberGroups)
+{
+    open({{"iteration"}, {"mu"},
+          {"beta", m_markerCount},
+          {"sigmaE"},
+          {"sigmaG", static_cast<uint64_t>(numberGroups)},
+          {"gamma", m_fixedCount},
+          {"comp", m_markerCount},
+          {"acum", m_markerCount},
+          {"epsilon", m_individualCount}});
+}
 
-	//    m_outFile << "sigma_b," << "sigmaG";
-	m_outFile << "sigma_b";
+bool SampleWriter::isSelected(const std::string &name) const
+{
+    if (m_fields.empty() || name == "iteration")
+        return true;
 
-	m_outFile << std::endl;
-	m_outFile.flush();
+    return std::any_of(m_fields.cbegin(), m_fields.cend(), [&name](const std::string &field) {
+        return field == name || (field == "sigma" && name.compare(0, 5, "sigma") == 0);
+    });
 }
 
-void SampleWriter::openGroups(int numberGroups)
+void SampleWriter::open(const SampleSchema &fullSchema)
 {
     std::cout << "Opening results file " << m_fileName << std::endl;
-    m_outFile.open(m_fileName);
 
-    m_outFile << "iteration," << "mu,";
-    for (unsigned int i = 0; i < m_markerCount; ++i) {
-        m_outFile << "beta[" << (i+1) << "],";
+    for (const auto &field : m_fields) {
+        const bool known = field == "sigma" || std::any_of(fullSchema.cbegin(), fullSchema.cend(),
+                                                           [&field](const SampleField &f) {
+            return f.name == field;
+        });
+        if (!known)
+            std::cerr << "Ignoring unknown output field: " << field << std::endl;
     }
 
-    m_outFile << "sigmaE,";
-
-    for(unsigned int i = 0; i < numberGroups; ++i){
-    	    m_outFile << "sigmaG[" << (i+1) << "],";
+    // Work out which columns of the full sample are written
+    const bool sparse = m_sparse && (isSelected("beta") || isSelected("comp"));
+    SampleSchema schema;
+    m_ranges.clear();
+    m_betaOffset = -1;
+    m_compOffset = -1;
+    Eigen::Index from = 0;
+    Eigen::Index to = 0;
+    for (const auto &field : fullSchema) {
+        const auto count = static_cast<Eigen::Index>(field.count);
+        if (sparse && field.array && field.name == "beta") {
+            m_betaOffset = from;
+            m_betaCount = count;
+        } else if (sparse && field.array && field.name == "comp") {
+            m_compOffset = from;
+        } else if (isSelected(field.name)) {
+            if (!m_ranges.empty() && m_ranges.back().from + m_ranges.back().count == from)
+                m_ranges.back().count += count;
+            else
+                m_ranges.push_back({from, to, count});
+            schema.push_back(field);
+            to += count;
+        }
+        from += count;
     }
+    if (m_betaOffset >= 0)
+        schema.emplace_back("nonzero", static_cast<uint64_t>(m_betaCount), true);
 
-    for (unsigned int i = 0; i < m_fixedCount; ++i) {
-		m_outFile << "gamma[" << (i+1) << "],";
+    m_inputSize = from;
+    m_selecting = m_betaOffset >= 0 || to != from;
+    m_selected.resize(to);
+
+    if (m_append) {
+        const auto mode = m_format == SampleFormat::Csv ? std::ios::app : std::ios::app | std::ios::binary;
+        m_outFile.open(m_fileName, mode);
+        return;
     }
 
-    for (unsigned int i = 0; i < m_markerCount; ++i) {
-        m_outFile << "comp[" << (i+1) << "],";
+    if (m_format == SampleFormat::Csv) {
+        m_outFile.open(m_fileName);
+
+        const auto names = sampleColumnNames(schema);
+        for (size_t i = 0; i < names.size(); ++i)
+            m_outFile << (i == 0 ? "" : ",") << names[i];
+        m_outFile << std::endl;
+        m_outFile.flush();
+        return;
     }
 
-    for (unsigned int i = 0; i < m_markerCount; ++i) {
-        m_outFile << "acum[" << (i+1) << "],";
+    m_outFile.open(m_fileName, std::ios::binary);
+    writeSampleHeader(m_outFile, schema, m_format, m_compress);
+    m_outFile.flush();
+}
+
+void SampleWriter::write(const Eigen::VectorXd &sample)
+{
+    if (!m_selecting) {
+        if (m_format == SampleFormat::Csv)
+            Writer::write(sample);
+        else
+            writeSampleRow(m_outFile, sample, nullptr, m_format, m_compress, m_buffer);
+        return;
     }
 
-    unsigned int i;
-    for (i = 0; i < (m_individualCount - 1); ++i) {
-        m_outFile << "epsilon[" << (i + 1) << "],";
+    assert(sample.size() == m_inputSize);
+    for (const auto &range : m_ranges)
+        m_selected.segment(range.to, range.count) = sample.segment(range.from, range.count);
+
+    const SparseSample *sparse = nullptr;
+    if (m_betaOffset >= 0) {
+        m_sparseSample.clear();
+        for (Eigen::Index i = 0; i < m_betaCount; ++i) {
+            const double beta = sample[m_betaOffset + i];
+            if (beta == 0)
+                continue;
+            const double comp = m_compOffset >= 0 ? sample[m_compOffset + i] : 0;
+            m_sparseSample.push_back(static_cast<uint32_t>(i + 1), beta, comp);
+        }
+        sparse = &m_sparseSample;
     }
 
-    m_outFile << "epsilon[" << (i + 1) << "]";
-    m_outFile << std::endl;
-    m_outFile.flush();
+    if (m_format == SampleFormat::Csv) {
+        writeCsvSampleRow(m_outFile, m_selected, sparse);
+        m_outFile.flush();
+    } else {
+        writeSampleRow(m_outFile, m_selected, sparse, m_format, m_compress, m_buffer);
+    }
 }
@@ -3,6 +3,7 @@
 
 #include <Eigen/Eigen>
 #include "writer.h"
+#include "samplefile.h"
 #include <fstream>
 #include <string>
 
@@ -24,10 +25,59 @@ public:
     void open_bayesW();
     void open_bayesW_fixed();
 
+    void setFormat(SampleFormat format) { m_format = format; }
+    SampleFormat format() const { return m_format; }
+
+    void setCompressed(bool compress) { m_compress = compress; }
+    bool isCompressed() const { return m_compress; }
+
+    // Write only the fields named here, plus the iteration. "sigma" selects
+    // every variance. Empty selects every field.
+    void setFields(const std::vector<std::string> &fields) { m_fields = fields; }
+    const std::vector<std::string> &fields() const { return m_fields; }
+
+    // Append to an existing file, without writing the header, when resuming
+    void setAppend(bool append) { m_append = append; }
+    bool isAppend() const { return m_append; }
+
+    // Replace beta and comp with the triplets of the non-zero betas
+    void setSparse(bool sparse) { m_sparse = sparse; }
+    bool isSparse() const { return m_sparse; }
+
+    // sample holds every field of the schema opened; the selected fields are
+    // extracted here, on the writer thread when used with AsyncWriter.
+    void write(const Eigen::VectorXd &sample) override;
+
 private:
+    struct Range {
+        Eigen::Index from = 0;
+        Eigen::Index to = 0;
+        Eigen::Index count = 0;
+    };
+
     unsigned int m_markerCount;
     unsigned int m_individualCount;
     unsigned int m_fixedCount;
+
+    SampleFormat m_format = SampleFormat::Csv;
+    bool m_compress = false;
+    std::vector<unsigned char> m_buffer;
+
+    std::vector<std::string> m_fields;
+    bool m_sparse = false;
+    bool m_append = false;
+
+    bool m_selecting = false;
+    std::vector<Range> m_ranges;
+    Eigen::Index m_inputSize = 0;
+    Eigen::Index m_betaOffset = -1;
+    Eigen::Index m_compOffset = -1;
+    Eigen::Index m_betaCount = 0;
+    Eigen::VectorXd m_selected;
+    SparseSample m_sparseSample;
+
+    bool isSelected(const std::string &name) const;
+    void open(const SampleSchema &schema);
 };
 
 #endif // SAMPLEWRITER_H
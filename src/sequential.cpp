@@ -3,6 +3,7 @@
 #include "analysis.h"
 #include "kernel.h"
 #include "markercache.h"
+#include "tracer.h"
 
 #include <algorithm>
 #include <iostream>
@@ -20,8 +21,22 @@ void Sequential::exec(Analysis *analysis,
         return;
     }
 
-    std::for_each(markerIndices.cbegin(), markerIndices.cend(), [&analysis](unsigned int i) {
+    if (m_stats)
+        m_stats->beginIteration();
+
+    std::for_each(markerIndices.cbegin(), markerIndices.cend(), [this, &analysis](unsigned int i) {
+        GraphStats::Timer timer(m_stats, m_processStat);
+        TraceSpan span("decompress", static_cast<int>(i));
         KernelPtr kernel = analysis->kernelForMarker(markerCache()->marker(i));
+        span.end();
         analysis->processColumn(kernel);
     });
+
+    if (m_stats)
+        m_stats->endIteration();
+}
+
+void Sequential::registerStats()
+{
+    m_processStat = m_stats->addNode("process_column");
 }
@@ -2,6 +2,7 @@
 #define SEQUENTIAL_H
 
 #include "analysisgraph.hpp"
+#include "graphstats.h"
 
 class Sequential : public AnalysisGraph
 {
@@ -11,6 +12,11 @@ public:
               unsigned int numInds,
               unsigned int numSnps,
               const std::vector<unsigned int> &markerIndices) override;
+
+private:
+    GraphStats::Id m_processStat = 0;
+
+    void registerStats() override;
 };
 
 #endif
@@ -6,6 +6,8 @@
  *  Last changes: 22 Feb 2019
  */
 
+#include "eigenbayeswkernel.h"
+#include "packedbayeswkernel.h"
 #include "raggedbayeswkernel.h"
 #include "sparsebayesw.h"
 #include "BayesW_arms.h"
@@ -47,6 +49,13 @@ SparseBayesW::SparseBayesW(const Data *data, const Options *opt, const long memP
 std::unique_ptr<Kernel> SparseBayesW::kernelForMarker(const ConstMarkerPtr &marker) const
 {
     switch (m_opt->preprocessDataType) {
+    case PreprocessDataType::SparseEigen:
+    {
+        const auto eigenSparseMarker = dynamic_pointer_cast<const EigenSparseMarker>(marker);
+        assert(eigenSparseMarker);
+        return std::make_unique<EigenBayesWKernel>(eigenSparseMarker);
+    }
+
     case PreprocessDataType::SparseRagged:
     {
         const auto raggedSparseMarker = dynamic_pointer_cast<const RaggedSparseMarker>(marker);
@@ -54,6 +63,13 @@ std::unique_ptr<Kernel> SparseBayesW::kernelForMarker(const ConstMarkerPtr &mark
         return std::make_unique<RaggedBayesWKernel>(raggedSparseMarker);
     }
 
+    case PreprocessDataType::Packed:
+    {
+        const auto packedMarker = dynamic_pointer_cast<const PackedMarker>(marker);
+        assert(packedMarker);
+        return std::make_unique<PackedBayesWKernel>(packedMarker);
+    }
+
     default:
         std::cerr << "SparseBayesW::kernelForMarker - unsupported type: "
                   << m_opt->preprocessDataType
@@ -66,8 +82,12 @@ std::unique_ptr<Kernel> SparseBayesW::kernelForMarker(const ConstMarkerPtr &mark
 MarkerBuilder *SparseBayesW::markerBuilder() const
 {
     switch (m_opt->preprocessDataType) {
+    case PreprocessDataType::SparseEigen:
+        // Fall through
     case PreprocessDataType::SparseRagged:
-        return builderForType(PreprocessDataType::SparseRagged);
+        // Fall through
+    case PreprocessDataType::Packed:
+        return builderForType(m_opt->preprocessDataType);
 
     default:
         std::cerr << "SparseBayesW::markerBuilder - unsupported type: "
@@ -78,24 +98,24 @@ MarkerBuilder *SparseBayesW::markerBuilder() const
     return nullptr;
 }
 
-int SparseBayesW::estimateBeta(const BayesWKernel *kernel, const std::shared_ptr<VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params, double *convex, int npoint,
+int SparseBayesW::estimateBeta(const BayesWKernel *kernel, const std::shared_ptr<const VectorXd> &epsilon, double *xinit, int ninit, double *xl, double *xr, const beta_params params, double *convex, int npoint,
                                int dometrop, double *xprev, double *xsamp, int nsamp, double *qcent,
                                double *xcent, int ncent, int *neval)
  {
     (void) epsilon; // Unused
 
-    const auto* raggedKernel = dynamic_cast<const RaggedBayesWKernel*>(kernel);
-    assert(raggedKernel);
+    const auto* sparseKernel = dynamic_cast<const SparseBayesWKernel*>(kernel);
+    assert(sparseKernel);
 
-    const auto* raggedMarker = dynamic_cast<const RaggedSparseMarker*>(kernel->marker.get());
-    assert(raggedMarker);
+    const auto* sparseMarker = dynamic_cast<const SparseMarker*>(kernel->marker.get());
+    assert(sparseMarker);
 
     sparse_beta_params sparse_params {params};
-    sparse_params.mean_sd_ratio = raggedMarker->mean / raggedMarker->sd;
-    sparse_params.sd = raggedMarker->sd;
-    sparse_params.vi_0 = raggedKernel->vi_0;
-    sparse_params.vi_1 = raggedKernel->vi_1;
-    sparse_params.vi_2 = raggedKernel->vi_2;
+    sparse_params.mean_sd_ratio = sparseMarker->mean / sparseMarker->sd;
+    sparse_params.sd = sparseMarker->sd;
+    sparse_params.vi_0 = sparseKernel->vi_0;
+    sparse_params.vi_1 = sparseKernel->vi_1;
+    sparse_params.vi_2 = sparseKernel->vi_2;
 
      return arms(xinit, ninit, xl, xr, beta_dens, &sparse_params, convex,
                  npoint, dometrop, xprev, xsamp, nsamp, qcent, xcent, ncent, neval);
@@ -0,0 +1,51 @@
+#include "sparsebayeswkernel.h"
+
+SparseBayesWKernel::SparseBayesWKernel(const std::shared_ptr<const SparseMarker> &marker)
+    : BayesWKernel(marker)
+    , sm(marker.get())
+{
+    assert(sm);
+}
+
+void SparseBayesWKernel::setViExcluding(const std::shared_ptr<const VectorXd> &vi, double alpha, double beta_old,
+                                        std::shared_ptr<VectorXd> &)
+{
+    // Only the group sums are kept, so no copy of vi is needed
+    setVi(vi);
+    if (beta_old == 0.0)
+        return;
+
+    // Each genotype group shares one residual update, so removing beta_old
+    // only rescales the group sums.
+    const double scale = alpha * beta_old / sm->sd;
+    vi_0 *= exp(-scale * sm->mean);
+    vi_1 *= exp(scale * (1 - sm->mean));
+    vi_2 *= exp(scale * (2 - sm->mean));
+    vi_sum = vi_0 + vi_1 + vi_2 + vi_missing;
+}
+
+double SparseBayesWKernel::exponent_sum() const
+{
+    return (vi_1 * (1 - 2 * sm->mean) + 4 * (1-sm->mean) * vi_2 + (vi_sum - vi_missing) * sm->mean * sm->mean) /(sm->sd*sm->sd);
+}
+
+double SparseBayesWKernel::integrand_adaptive(double s, double alpha, double sqrt_2Ck_sigmab) const
+{
+    const auto mean_sd_ratio = sm->mean / sm->sd;
+    const double temp = -alpha *s*sum_failure*sqrt_2Ck_sigmab +
+            vi_sum - vi_missing - exp(alpha*mean_sd_ratio*s*sqrt_2Ck_sigmab) *
+            (vi_0 + vi_1 * exp(-alpha * s*sqrt_2Ck_sigmab/sm->sd) + vi_2* exp(-2 * alpha * s*sqrt_2Ck_sigmab/sm->sd))
+            -pow(s,2);
+    return exp(temp);
+}
+
+VectorXd SparseBayesWKernel::integrand_adaptive(const VectorXd &s, double alpha, const VectorXd &sqrt_2Ck_sigmab) const
+{
+    assert(s.size() == sqrt_2Ck_sigmab.size());
+
+    const ArrayXd t = alpha * s.array() * sqrt_2Ck_sigmab.array();
+    const ArrayXd groups = vi_0 + vi_1 * (-t / sm->sd).exp() + vi_2 * (-2 * t / sm->sd).exp();
+
+    return (-sum_failure * t + vi_sum - vi_missing
+            - (t * (sm->mean / sm->sd)).exp() * groups - s.array().square()).exp();
+}
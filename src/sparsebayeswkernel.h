@@ -0,0 +1,33 @@
+#ifndef SPARSEBAYESWKERNEL_H
+#define SPARSEBAYESWKERNEL_H
+
+#include "bayeswkernel.h"
+#include "sparsemarker.h"
+
+// BayesW maths shared by the sparse marker types. Individuals are grouped by
+// genotype, so only the sums of vi over each group are needed.
+struct SparseBayesWKernel : public BayesWKernel
+{
+    explicit SparseBayesWKernel(const std::shared_ptr<const SparseMarker> &marker);
+
+    double vi_sum = 0;
+    double vi_2 = 0;
+    double vi_1 = 0;
+    double vi_0 = 0;
+    double vi_missing = 0; // individuals whose standardised genotype is 0
+
+    void setViExcluding(const std::shared_ptr<const VectorXd> &vi, double alpha, double beta_old,
+                        std::shared_ptr<VectorXd> &scratch) override;
+
+    double exponent_sum() const override;
+    using BayesWKernel::integrand_adaptive;
+    double integrand_adaptive(double s, double alpha, double sqrt_2Ck_sigmab) const override;
+    // Each node only needs the group sums, so all of them are evaluated as
+    // one array expression rather than a sweep over the individuals.
+    VectorXd integrand_adaptive(const VectorXd &s, double alpha, const VectorXd &sqrt_2Ck_sigmab) const override;
+
+protected:
+    const SparseMarker *sm = nullptr;
+};
+
+#endif // SPARSEBAYESWKERNEL_H
@@ -18,6 +18,14 @@ void SparseMarker::updateStatistics(unsigned int allele1, unsigned int allele2)
     }
 }
 
+void SparseMarker::addGenotypeCounts(double oneCount, double twoCount)
+{
+    const double sum = oneCount + 2 * twoCount;
+    mean += sum;
+    sqrdZ += oneCount + 4 * twoCount;
+    Zsum += sum;
+}
+
 std::streamsize SparseMarker::size() const
 {
     return sizeof(double) * 4;
@@ -11,6 +11,8 @@ struct SparseMarker : public Marker
     double Zsum = 0;
 
     virtual void updateStatistics(unsigned int allele1, unsigned int allele2);
+    // As updateStatistics, for oneCount heterozygous and twoCount homozygous genotypes
+    void addGenotypeCounts(double oneCount, double twoCount);
 
     std::streamsize size() const override;
     void read(std::istream *inStream) override;
@@ -0,0 +1,112 @@
+#include "tracer.h"
+#include "atomicfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+Tracer &tracer()
+{
+    static Tracer instance;
+    return instance;
+}
+
+int64_t Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::configure(unsigned int first, unsigned int last, const std::string &file,
+                       size_t eventsPerThread)
+{
+    m_first = first;
+    m_last = last;
+    m_file = file;
+    m_eventsPerThread = std::max<size_t>(eventsPerThread, 1);
+    m_epoch = now();
+}
+
+void Tracer::setIteration(unsigned int iteration)
+{
+    m_iteration = iteration;
+    const bool active = enabled() && iteration >= m_first && iteration <= m_last;
+    m_active.store(active, std::memory_order_relaxed);
+
+    if (active)
+        m_pending = true;
+    else if (m_pending && iteration > m_last)
+        finish();
+}
+
+void Tracer::finish()
+{
+    m_active.store(false, std::memory_order_relaxed);
+    if (!m_pending)
+        return;
+
+    m_pending = false;
+    if (write(m_file))
+        std::cout << "Wrote the trace of iterations " << m_first << "-" << m_last
+                  << " to " << m_file << std::endl;
+
+    // Nothing more will be recorded, so release the buffers
+    m_buffers.clear();
+}
+
+void Tracer::record(const char *name, int64_t start, int marker, unsigned int iteration)
+{
+    auto &buffer = m_buffers.local();
+    if (buffer.events.empty())
+        buffer.events.resize(m_eventsPerThread);
+
+    buffer.events[buffer.next] = {name, start, now() - start, marker, iteration};
+    if (++buffer.next == buffer.events.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+bool Tracer::write(const std::string &fileName) const
+{
+    const bool written = writeFileAtomically(fileName, [this] (std::ostream &out) {
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+        bool first = true;
+        for (const auto &buffer : m_buffers) {
+            if (buffer.wrapped) {
+                std::cerr << "Warning: the trace buffer of thread " << buffer.thread
+                          << " overflowed, its oldest events were dropped" << std::endl;
+            }
+
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.thread
+                << ", \"args\": {\"name\": \"thread " << buffer.thread << "\"}}";
+
+            // Oldest first
+            const size_t count = buffer.wrapped ? buffer.events.size() : buffer.next;
+            const size_t begin = buffer.wrapped ? buffer.next : 0;
+            for (size_t i = 0; i < count; ++i) {
+                const auto &event = buffer.events[(begin + i) % buffer.events.size()];
+                out << ",\n{\"name\": \"" << event.name
+                    << "\", \"cat\": \"" << (event.marker < 0 ? "iteration" : "marker")
+                    << "\", \"ph\": \"X\", \"ts\": " << static_cast<double>(event.start - m_epoch) / 1e3
+                    << ", \"dur\": " << static_cast<double>(event.duration) / 1e3
+                    << ", \"pid\": 1, \"tid\": " << buffer.thread
+                    << ", \"args\": {\"iteration\": " << event.iteration;
+                if (event.marker >= 0)
+                    out << ", \"marker\": " << event.marker;
+                out << "}}";
+            }
+        }
+
+        out << "\n]}\n";
+    });
+
+    if (!written)
+        std::cerr << "Could not write trace to " << fileName << std::endl;
+    return written;
+}
@@ -0,0 +1,115 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "tbb/enumerable_thread_specific.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Records spans for a window of Gibbs iterations and writes them in the
+// Chrome trace event format, which chrome://tracing and Perfetto load.
+//
+// Each thread appends to its own ring buffer, so recording takes no lock.
+// Outside of the window a span costs one relaxed load.
+class Tracer
+{
+public:
+    // Trace iterations first to last inclusive and write them to file once
+    // the window is over. eventsPerThread bounds the memory of each ring
+    // buffer; when a buffer is full its oldest events are dropped.
+    void configure(unsigned int first, unsigned int last, const std::string &file,
+                   size_t eventsPerThread = 1 << 18);
+
+    bool enabled() const { return !m_file.empty(); }
+    bool active() const { return m_active.load(std::memory_order_relaxed); }
+
+    // Called by the sampler at the start of every iteration, while no
+    // spans are being recorded.
+    void setIteration(unsigned int iteration);
+
+    // Writes the trace if the window was entered but not yet written,
+    // e.g. when the run ends inside the window.
+    void finish();
+
+    bool write(const std::string &fileName) const;
+
+private:
+    friend class TraceSpan;
+
+    struct Event {
+        const char *name = nullptr;
+        int64_t start = 0; // ns since m_epoch
+        int64_t duration = 0;
+        int marker = -1;
+        unsigned int iteration = 0;
+    };
+
+    struct Buffer {
+        int thread = 0;
+        std::vector<Event> events;
+        size_t next = 0;
+        bool wrapped = false;
+    };
+
+    std::string m_file;
+    unsigned int m_first = 0;
+    unsigned int m_last = 0;
+    size_t m_eventsPerThread = 0;
+
+    std::atomic<bool> m_active {false};
+    unsigned int m_iteration = 0;
+    bool m_pending = false;
+
+    int64_t m_epoch = 0;
+    std::atomic<int> m_threadCount {0};
+    tbb::enumerable_thread_specific<Buffer> m_buffers {[this] () {
+        Buffer buffer;
+        buffer.thread = m_threadCount++;
+        return buffer;
+    }};
+
+    static int64_t now();
+    void record(const char *name, int64_t start, int marker, unsigned int iteration);
+};
+
+// The process wide tracer, configured from --trace-iterations
+Tracer &tracer();
+
+// Records the time from construction to end() or destruction. name must be
+// a string literal. marker is -1 for spans that are not per marker.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, int marker = -1)
+        : m_name(tracer().active() ? name : nullptr)
+        , m_marker(marker)
+    {
+        if (m_name) {
+            m_start = Tracer::now();
+            m_iteration = tracer().m_iteration;
+        }
+    }
+
+    ~TraceSpan() { end(); }
+
+    void end()
+    {
+        if (m_name) {
+            tracer().record(m_name, m_start, m_marker, m_iteration);
+            m_name = nullptr;
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *m_name;
+    int m_marker;
+    int64_t m_start = 0;
+    unsigned int m_iteration = 0;
+};
+
+#endif // TRACER_H
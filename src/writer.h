@@ -9,14 +9,15 @@ class Writer
 {
  public:
   Writer();
-  ~Writer();
+  virtual ~Writer();
 
   void setFileName(const std::string &fileName) {m_fileName = fileName;}
   std::string fileName() const { return m_fileName;}
 
   virtual void open()=0;
-  void write(const Eigen::VectorXd &message);
+  virtual void write(const Eigen::VectorXd &message);
   void close();
+  void flush() { m_outFile.flush(); }
 
  protected:
   std::string m_fileName;
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include "arswarmstartcache.h"
+
+namespace {
+constexpr size_t kSlotBytes = 64; // Comfortably more than one Slot
+}
+
+TEST(ArsWarmStartCacheTest, DisabledWithoutStorage) {
+    ArsWarmStartCache cache;
+    cache.reset(10, 0);
+    ASSERT_FALSE(cache.enabled());
+
+    const double xcent[] = {-0.2, -0.1, 0.1, 0.2};
+    cache.store(3, xcent);
+
+    double xinit[4];
+    ASSERT_FALSE(cache.fetch(3, -1.0, 1.0, xinit));
+}
+
+TEST(ArsWarmStartCacheTest, FetchReturnsStoredCentiles) {
+    ArsWarmStartCache cache;
+    cache.reset(10, 10 * kSlotBytes);
+    ASSERT_EQ(10, cache.slotCount());
+
+    double xinit[4];
+    ASSERT_FALSE(cache.fetch(3, -1.0, 1.0, xinit));
+
+    const double xcent[] = {-0.2, -0.1, 0.1, 0.2};
+    cache.store(3, xcent);
+
+    ASSERT_TRUE(cache.fetch(3, -1.0, 1.0, xinit));
+    for (int i = 0; i < ArsWarmStartCache::PointCount; ++i)
+        ASSERT_DOUBLE_EQ(xcent[i], xinit[i]);
+
+    // Other markers are still cold
+    ASSERT_FALSE(cache.fetch(4, -1.0, 1.0, xinit));
+
+    cache.clear();
+    ASSERT_FALSE(cache.fetch(3, -1.0, 1.0, xinit));
+}
+
+TEST(ArsWarmStartCacheTest, RejectsEntriesOfMarkersSharingASlot) {
+    ArsWarmStartCache cache;
+    cache.reset(10, 4 * kSlotBytes);
+    ASSERT_LT(cache.slotCount(), 10u);
+
+    const size_t slots = cache.slotCount();
+    const double first[] = {-0.2, -0.1, 0.1, 0.2};
+    const double second[] = {-0.4, -0.3, 0.3, 0.4};
+    cache.store(1, first);
+    cache.store(static_cast<unsigned int>(1 + slots), second);
+
+    // The second marker evicted the first one from their shared slot
+    double xinit[4];
+    ASSERT_FALSE(cache.fetch(1, -1.0, 1.0, xinit));
+    ASSERT_TRUE(cache.fetch(static_cast<unsigned int>(1 + slots), -1.0, 1.0, xinit));
+    ASSERT_DOUBLE_EQ(second[0], xinit[0]);
+}
+
+TEST(ArsWarmStartCacheTest, RejectsCentilesOutsideTheBounds) {
+    ArsWarmStartCache cache;
+    cache.reset(1, kSlotBytes);
+
+    const double xcent[] = {-0.2, -0.1, 0.1, 0.2};
+    cache.store(0, xcent);
+
+    double xinit[4];
+    ASSERT_TRUE(cache.fetch(0, -0.3, 0.3, xinit));
+
+    // The bounds have shrunk since the centiles were stored
+    ASSERT_FALSE(cache.fetch(0, -0.15, 0.3, xinit));
+    ASSERT_FALSE(cache.fetch(0, -0.3, 0.2, xinit));
+}
+
+TEST(ArsWarmStartCacheTest, RejectsUnorderedCentiles) {
+    ArsWarmStartCache cache;
+    cache.reset(2, 2 * kSlotBytes);
+
+    const double unordered[] = {-0.2, 0.1, -0.1, 0.2};
+    cache.store(0, unordered);
+
+    const double repeated[] = {-0.2, -0.1, -0.1, 0.2};
+    cache.store(1, repeated);
+
+    double xinit[4];
+    ASSERT_FALSE(cache.fetch(0, -1.0, 1.0, xinit));
+    ASSERT_FALSE(cache.fetch(1, -1.0, 1.0, xinit));
+}
+
+TEST(ArsWarmStartCacheTest, StateRoundTrip) {
+    ArsWarmStartCache cache;
+    cache.reset(4, 4 * kSlotBytes);
+
+    const double xcent[] = {-0.2, -0.1, 0.1, 0.2};
+    cache.store(2, xcent);
+
+    ArsWarmStartCache restored;
+    restored.reset(4, 4 * kSlotBytes);
+    ASSERT_TRUE(restored.setState(cache.state()));
+
+    double xinit[4];
+    ASSERT_TRUE(restored.fetch(2, -1.0, 1.0, xinit));
+    ASSERT_DOUBLE_EQ(xcent[3], xinit[3]);
+
+    // A cache of a different size cannot take the state
+    ArsWarmStartCache smaller;
+    smaller.reset(2, 2 * kSlotBytes);
+    ASSERT_FALSE(smaller.setState(cache.state()));
+}
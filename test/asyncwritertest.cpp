@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include "asyncwriter.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Keeps the samples and the threads which wrote them instead of writing a file
+class RecordingWriter : public Writer
+{
+public:
+    explicit RecordingWriter(std::chrono::milliseconds delay = {}, size_t failAt = 0)
+        : m_delay(delay)
+        , m_failAt(failAt)
+    {}
+
+    void open() override {}
+
+    void write(const Eigen::VectorXd &sample) override
+    {
+        std::this_thread::sleep_for(m_delay);
+        if (m_failAt && samples.size() + 1 == m_failAt)
+            throw std::string("disk full");
+        samples.push_back(sample);
+        threads.push_back(std::this_thread::get_id());
+    }
+
+    std::vector<Eigen::VectorXd> samples;
+    std::vector<std::thread::id> threads;
+
+private:
+    std::chrono::milliseconds m_delay;
+    size_t m_failAt; // 1-based sample that fails, 0 for none
+};
+
+Eigen::VectorXd makeSample(int iteration)
+{
+    return Eigen::VectorXd::Constant(3, iteration);
+}
+
+}
+
+TEST(AsyncWriterTest, WritesInlineWithoutAQueue) {
+    RecordingWriter writer;
+    AsyncWriter asyncWriter(&writer, 0);
+
+    Eigen::VectorXd sample = makeSample(1);
+    asyncWriter.write(sample);
+
+    // Written before write() returns, on this thread, and left untouched
+    ASSERT_EQ(1u, writer.samples.size());
+    ASSERT_EQ(std::this_thread::get_id(), writer.threads.front());
+    ASSERT_EQ(makeSample(1), sample);
+}
+
+TEST(AsyncWriterTest, WritesEverySampleInOrder) {
+    // A slow writer keeps the queue full, so write() has to wait for room
+    RecordingWriter writer(std::chrono::milliseconds(2));
+    const int count = 20;
+    {
+        AsyncWriter asyncWriter(&writer, 2);
+        Eigen::VectorXd sample(3);
+        for (int iteration = 0; iteration < count; ++iteration) {
+            sample = makeSample(iteration);
+            asyncWriter.write(sample);
+
+            // The caller gets a buffer of the same size to fill again
+            ASSERT_EQ(3, sample.size());
+        }
+
+        asyncWriter.flush();
+        ASSERT_EQ(static_cast<size_t>(count), writer.samples.size());
+    }
+
+    ASSERT_EQ(static_cast<size_t>(count), writer.samples.size());
+    for (int iteration = 0; iteration < count; ++iteration) {
+        ASSERT_EQ(makeSample(iteration), writer.samples[iteration]) << "sample " << iteration;
+        ASSERT_NE(std::this_thread::get_id(), writer.threads[iteration]);
+    }
+}
+
+TEST(AsyncWriterTest, CloseWritesQueuedSamples) {
+    RecordingWriter writer(std::chrono::milliseconds(5));
+    AsyncWriter asyncWriter(&writer, 4);
+    Eigen::VectorXd sample(3);
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        sample = makeSample(iteration);
+        asyncWriter.write(sample);
+    }
+
+    asyncWriter.close();
+    ASSERT_EQ(4u, writer.samples.size());
+    ASSERT_EQ(makeSample(3), writer.samples.back());
+}
+
+TEST(AsyncWriterTest, RethrowsWriterErrorsOnTheCaller) {
+    RecordingWriter writer(std::chrono::milliseconds(1), 3);
+    AsyncWriter asyncWriter(&writer, 2);
+    Eigen::VectorXd sample(3);
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        sample = makeSample(iteration);
+        try {
+            asyncWriter.write(sample);
+        } catch (const std::string &) {
+            // The failure may already have been seen
+            break;
+        }
+    }
+
+    ASSERT_THROW(asyncWriter.flush(), std::string);
+    ASSERT_EQ(2u, writer.samples.size());
+
+    // Every later call reports the failure too, and nothing more is written
+    sample = makeSample(5);
+    ASSERT_THROW(asyncWriter.write(sample), std::string);
+    ASSERT_THROW(asyncWriter.close(), std::string);
+    ASSERT_EQ(2u, writer.samples.size());
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include "densebayeswkernel.h"
+#include "eigenbayeswkernel.h"
+#include "markerbuilder.h"
+#include "packedbayeswkernel.h"
+#include "raggedbayeswkernel.h"
+
+#include <numeric>
+#include <random>
+
+namespace {
+
+constexpr double kEuMasc = 0.577215664901532;
+
+std::unique_ptr<BayesWKernel> buildKernel(PreprocessDataType type, unsigned int numInds)
+{
+    std::mt19937 engine(1);
+    std::binomial_distribution<int> alleleCount(2, 0.3);
+    std::bernoulli_distribution missing(0.02);
+
+    std::vector<unsigned char> codes(numInds);
+    for (auto &code : codes)
+        code = missing(engine) ? MarkerBuilder::kMissingGenotype
+                               : static_cast<unsigned char>(alleleCount(engine));
+
+    std::vector<unsigned int> individuals(numInds);
+    std::iota(individuals.begin(), individuals.end(), 0);
+
+    std::unique_ptr<MarkerBuilder> builder{builderForType(type)};
+    builder->initialise(0, numInds);
+    builder->processColumn({codes.data(), individuals.data(), numInds});
+    builder->endColumn();
+    const std::shared_ptr<const Marker> marker = builder->build();
+
+    switch (type) {
+    case PreprocessDataType::Dense:
+        return std::make_unique<DenseBayesWKernel>(std::dynamic_pointer_cast<const DenseMarker>(marker));
+    case PreprocessDataType::SparseEigen:
+        return std::make_unique<EigenBayesWKernel>(std::dynamic_pointer_cast<const EigenSparseMarker>(marker));
+    case PreprocessDataType::SparseRagged:
+        return std::make_unique<RaggedBayesWKernel>(std::dynamic_pointer_cast<const RaggedSparseMarker>(marker));
+    case PreprocessDataType::Packed:
+        return std::make_unique<PackedBayesWKernel>(std::dynamic_pointer_cast<const PackedMarker>(marker));
+    default:
+        return {};
+    }
+}
+
+}
+
+class BayesWKernelTest : public ::testing::TestWithParam<PreprocessDataType> {};
+
+TEST_P(BayesWKernelTest, BatchedIntegrandMatchesScalar) {
+    const unsigned int numInds = 1000;
+    auto kernel = buildKernel(GetParam(), numInds);
+    ASSERT_TRUE(kernel);
+
+    std::mt19937 engine(2);
+    std::normal_distribution<double> normal(0, 0.1);
+    std::bernoulli_distribution failed(0.3);
+
+    const double alpha = 1.5;
+    auto vi = std::make_shared<VectorXd>(numInds);
+    VectorXd failure(numInds);
+    for (unsigned int i = 0; i < numInds; ++i) {
+        (*vi)(i) = std::exp(alpha * normal(engine));
+        failure(i) = failed(engine) ? 1 : 0;
+    }
+
+    kernel->setVi(vi);
+    kernel->calculateSumFailure(failure);
+
+    // Nodes of two mixture classes
+    VectorXd s(8);
+    s << -2.0, -0.8, 0.8, 2.0, -1.5, -0.3, 0.3, 1.5;
+    VectorXd sqrt_2Ck_sigmab(8);
+    sqrt_2Ck_sigmab << 0.01, 0.01, 0.01, 0.01, 0.03, 0.03, 0.03, 0.03;
+
+    const VectorXd batched = kernel->integrand_adaptive(s, alpha, sqrt_2Ck_sigmab);
+    ASSERT_EQ(s.size(), batched.size());
+    for (Index i = 0; i < s.size(); ++i) {
+        const double scalar = kernel->integrand_adaptive(s(i), alpha, sqrt_2Ck_sigmab(i));
+        ASSERT_NEAR(scalar, batched(i), 1e-9 * std::abs(scalar)) << "node " << i;
+    }
+}
+
+TEST_P(BayesWKernelTest, ViExcludingRemovesBetaOld) {
+    const unsigned int numInds = 1000;
+    auto kernel = buildKernel(GetParam(), numInds);
+    ASSERT_TRUE(kernel);
+
+    std::mt19937 engine(3);
+    std::normal_distribution<double> normal(0, 0.1);
+
+    const double alpha = 1.5;
+    const double betaOld = 0.05;
+    VectorXd epsilon(numInds);
+    for (unsigned int i = 0; i < numInds; ++i)
+        epsilon(i) = normal(engine);
+
+    // vi of the residuals with and without the effect of beta_old
+    const VectorXd excluded = epsilon + *kernel->calculateResidualUpdate(betaOld);
+    auto vi = std::make_shared<VectorXd>((alpha * epsilon.array() - kEuMasc).exp());
+    auto viExcluded = std::make_shared<VectorXd>((alpha * excluded.array() - kEuMasc).exp());
+
+    kernel->setVi(viExcluded);
+    const double expected = kernel->integrand_adaptive(0.8, alpha, 0.02);
+    const double expectedExponentSum = kernel->exponent_sum();
+
+    std::shared_ptr<VectorXd> scratch;
+    kernel->setViExcluding(vi, alpha, betaOld, scratch);
+    ASSERT_NEAR(expected, kernel->integrand_adaptive(0.8, alpha, 0.02), 1e-9 * expected);
+    ASSERT_NEAR(expectedExponentSum, kernel->exponent_sum(), 1e-9 * std::abs(expectedExponentSum));
+
+    // Once released, the scratch buffer is reused by the next marker
+    kernel->releaseVi();
+    const auto *buffer = scratch.get();
+    kernel->setViExcluding(vi, alpha, betaOld, scratch);
+    ASSERT_EQ(buffer, scratch.get());
+}
+
+INSTANTIATE_TEST_SUITE_P(BayesWKernels,
+                         BayesWKernelTest,
+                         ::testing::ValuesIn({PreprocessDataType::Dense,
+                                              PreprocessDataType::SparseEigen,
+                                              PreprocessDataType::SparseRagged,
+                                              PreprocessDataType::Packed}));
@@ -1,8 +1,13 @@
 #include <gtest/gtest.h>
 #include <filesystem>
+#include <numeric>
 
 #include "analysisrunner.h"
 #include "common.h"
+#include "data.hpp"
+#include "densebayesw.h"
+#include "kernel.h"
+#include "markerbuilder.h"
 #include "options.hpp"
 
 namespace fs = std::filesystem;
@@ -86,6 +91,103 @@ INSTANTIATE_TEST_SUITE_P(AnalysisSmokeTests,
                              ::testing::ValuesIn({AnalysisType::Gauss,
                                                   AnalysisType::AsyncGauss}),
                              ::testing::ValuesIn({PreprocessDataType::Dense,
-                                                  PreprocessDataType::SparseRagged}),
+                                                  PreprocessDataType::SparseEigen,
+                                                  PreprocessDataType::SparseRagged,
+                                                  PreprocessDataType::Packed}),
                              ::testing::Bool(), // compress
                              ::testing::Bool())); // useMarkerCache
+
+TEST_F(BayesWBaseTest, InvalidQuadPointsFailTheAnalysis) {
+    const std::string testDataDir(GAUSS_TEST_DATA);
+    options.dataFile = testDataDir + "data.bed";
+    options.inputType = InputType::BED;
+    options.failureFile = testDataDir + "data.fail";
+    options.S = MatrixXd(1, 2);
+    options.S << 0.01, 0.1;
+    options.phenotypeFile = testDataDir + "data.phen";
+    options.preprocessDataType = PreprocessDataType::Dense;
+    options.chainLength = 1;
+
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    options.analysisType = AnalysisType::Gauss;
+    options.quad_points = "4";
+    ASSERT_FALSE(AnalysisRunner::run(options));
+}
+
+namespace {
+
+constexpr double kEuMasc = 0.577215664901532;
+
+// Exposes the residual epochs published by updateGlobal
+class EpochTestAnalysis : public DenseBayesW
+{
+public:
+    using DenseBayesW::DenseBayesW;
+
+    void setResiduals(const VectorXd &epsilon, double alpha)
+    {
+        m_alpha = alpha;
+        m_epsilon = std::make_shared<VectorXd>(epsilon);
+        m_vi = std::make_shared<VectorXd>((alpha * epsilon.array() - kEuMasc).exp());
+    }
+
+    std::shared_ptr<const VectorXd> epsilon() const { return m_epsilon; }
+    std::shared_ptr<const VectorXd> vi() const { return m_vi; }
+    size_t spareEpochCount() const { return m_spareEpochs.size(); }
+};
+
+}
+
+TEST(BayesWEpochTest, UpdatesLeavePinnedEpochsIntact) {
+    Options options;
+    options.S = MatrixXd(1, 2);
+    options.S << 0.01, 0.1;
+    Data data;
+    EpochTestAnalysis analysis(&data, &options, 4096);
+
+    const Index numInds = 100;
+    const double alpha = 1.5;
+    const VectorXd initial = VectorXd::LinSpaced(numInds, -1.0, 1.0);
+    analysis.setResiduals(initial, alpha);
+
+    std::vector<unsigned char> codes(numInds, 1);
+    std::vector<unsigned int> individuals(numInds);
+    std::iota(individuals.begin(), individuals.end(), 0);
+    std::unique_ptr<MarkerBuilder> builder{builderForType(PreprocessDataType::Dense)};
+    builder->initialise(0, numInds);
+    builder->processColumn({codes.data(), individuals.data(), static_cast<size_t>(numInds)});
+    builder->endColumn();
+    const std::shared_ptr<const Marker> marker = builder->build();
+    const KernelPtr kernel = analysis.kernelForMarker(marker);
+
+    auto update = [&](double step) {
+        auto result = std::make_shared<AsyncResult>();
+        result->deltaEpsilon = std::make_unique<VectorXd>(VectorXd::Constant(numInds, step));
+        analysis.updateGlobal(kernel, result);
+    };
+
+    // A worker pins the current epoch while two updates are published
+    auto pinnedEpsilon = analysis.epsilon();
+    auto pinnedVi = analysis.vi();
+    const VectorXd expectedVi = *pinnedVi;
+    update(0.1);
+    update(0.2);
+
+    ASSERT_TRUE((pinnedEpsilon->array() == initial.array()).all());
+    ASSERT_TRUE((pinnedVi->array() == expectedVi.array()).all());
+
+    const VectorXd expected = initial.array() + 0.3;
+    ASSERT_TRUE(analysis.epsilon()->isApprox(expected));
+    ASSERT_TRUE(analysis.vi()->isApprox(VectorXd((alpha * expected.array() - kEuMasc).exp())));
+
+    // Released epochs are recycled instead of new ones being allocated
+    pinnedEpsilon.reset();
+    pinnedVi.reset();
+    const auto spareCount = analysis.spareEpochCount();
+    for (int i = 0; i < 10; ++i)
+        update(0.01);
+
+    ASSERT_EQ(spareCount, analysis.spareEpochCount());
+    ASSERT_TRUE(analysis.epsilon()->isApprox(VectorXd(expected.array() + 0.1)));
+}
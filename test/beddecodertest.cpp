@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include "beddecoder.h"
+
+#include <bitset>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Genotype {
+    unsigned int individual;
+    unsigned char code;
+};
+
+// The per-bit decoder processAndCompress used before BedDecoder, with
+// processAllele's (allele1, allele2) pairs turned into BedDecoder codes
+std::vector<Genotype> bitTwiddlingDecode(const unsigned char *column,
+                                         unsigned int numInds,
+                                         const std::vector<bool> &kept)
+{
+    std::vector<Genotype> genotypes;
+    for (unsigned int i = 0; i < numInds;) {
+        std::bitset<8> b = *column++;
+        unsigned int k = 0;
+
+        while (k < 7 && i < numInds) {
+            if (!kept[i]) {
+                k += 2;
+            } else {
+                const unsigned int allele1 = (!b[k++]);
+                const unsigned int allele2 = (!b[k++]);
+
+                const bool missing = allele1 == 0 && allele2 == 1;
+                genotypes.push_back({i, missing ? MarkerBuilder::kMissingGenotype
+                                                : static_cast<unsigned char>(allele1 + allele2)});
+            }
+            i++;
+        }
+    }
+    return genotypes;
+}
+
+void compareDecoders(unsigned int numInds, const std::vector<bool> &kept, std::mt19937 &engine)
+{
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<unsigned char> column(BedDecoder::columnSize(numInds));
+    for (auto &b : column)
+        b = static_cast<unsigned char>(byte(engine));
+
+    auto keptList = std::make_shared<BedDecoder::IndividualList>();
+    for (unsigned int i = 0; i < numInds; ++i) {
+        if (kept[i])
+            keptList->push_back(i);
+    }
+
+    BedDecoder decoder(numInds, keptList);
+    const GenotypeColumn decoded = decoder.decode(column.data());
+    const auto expected = bitTwiddlingDecode(column.data(), numInds, kept);
+
+    ASSERT_EQ(expected.size(), decoded.size) << numInds << " individuals";
+    for (size_t k = 0; k < expected.size(); ++k) {
+        ASSERT_EQ(expected[k].individual, decoded.individuals[k]) << numInds << " individuals, genotype " << k;
+        ASSERT_EQ(expected[k].code, decoded.codes[k]) << numInds << " individuals, genotype " << k;
+    }
+}
+
+}
+
+TEST(BedDecoderTest, EveryByteMatchesBitTwiddlingDecoder) {
+    const unsigned int numInds = 4 * 256;
+    std::vector<unsigned char> column(BedDecoder::columnSize(numInds));
+    std::iota(column.begin(), column.end(), 0);
+
+    const std::vector<bool> kept(numInds, true);
+    auto keptList = std::make_shared<BedDecoder::IndividualList>(numInds);
+    std::iota(keptList->begin(), keptList->end(), 0);
+
+    BedDecoder decoder(numInds, keptList);
+    const GenotypeColumn decoded = decoder.decode(column.data());
+    const auto expected = bitTwiddlingDecode(column.data(), numInds, kept);
+
+    ASSERT_EQ(expected.size(), decoded.size);
+    for (size_t k = 0; k < expected.size(); ++k)
+        ASSERT_EQ(expected[k].code, decoded.codes[k]) << "byte " << k / 4 << ", genotype " << k % 4;
+}
+
+TEST(BedDecoderTest, AllKeptMatchesBitTwiddlingDecoder) {
+    std::mt19937 engine(1);
+    // Column sizes with each possible number of padding genotypes
+    for (unsigned int numInds : {1u, 2u, 3u, 4u, 5u, 6u, 7u, 8u, 1000u, 1001u, 1002u, 1003u})
+        compareDecoders(numInds, std::vector<bool>(numInds, true), engine);
+}
+
+TEST(BedDecoderTest, DroppedIndividualsMatchBitTwiddlingDecoder) {
+    std::mt19937 engine(2);
+    std::bernoulli_distribution keep(0.8);
+    for (unsigned int numInds : {1u, 2u, 3u, 4u, 5u, 6u, 7u, 8u, 1000u, 1001u, 1002u, 1003u}) {
+        std::vector<bool> kept(numInds);
+        for (unsigned int i = 0; i < numInds; ++i)
+            kept[i] = keep(engine);
+        compareDecoders(numInds, kept, engine);
+    }
+
+    // No individual kept at all
+    compareDecoders(9, std::vector<bool>(9, false), engine);
+}
+
+TEST(BedDecoderTest, DecoderIsReusable) {
+    std::mt19937 engine(3);
+    std::bernoulli_distribution keep(0.5);
+    const unsigned int numInds = 101;
+
+    std::vector<bool> kept(numInds);
+    auto keptList = std::make_shared<BedDecoder::IndividualList>();
+    for (unsigned int i = 0; i < numInds; ++i) {
+        kept[i] = keep(engine);
+        if (kept[i])
+            keptList->push_back(i);
+    }
+
+    std::uniform_int_distribution<int> byte(0, 255);
+    BedDecoder decoder(numInds, keptList);
+    for (int column = 0; column < 5; ++column) {
+        std::vector<unsigned char> bytes(BedDecoder::columnSize(numInds));
+        for (auto &b : bytes)
+            b = static_cast<unsigned char>(byte(engine));
+
+        const GenotypeColumn decoded = decoder.decode(bytes.data());
+        const auto expected = bitTwiddlingDecode(bytes.data(), numInds, kept);
+        ASSERT_EQ(expected.size(), decoded.size);
+        for (size_t k = 0; k < expected.size(); ++k)
+            ASSERT_EQ(expected[k].code, decoded.codes[k]) << "column " << column << ", genotype " << k;
+    }
+}
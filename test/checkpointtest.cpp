@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include "analysisrunner.h"
+#include "checkpoint.h"
+#include "options.hpp"
+#include "testfiles.h"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "checkpoint";
+
+size_t lineCount(const std::string &file)
+{
+    const auto bytes = readFile(file);
+    return static_cast<size_t>(std::count(bytes.cbegin(), bytes.cend(), '\n'));
+}
+
+// Runs chainLength iterations in one go, and again stopping after half of
+// them with a checkpoint and resuming from it. Both must give the same samples.
+void expectResumeMatchesFullRun(Options options, const std::string &name)
+{
+    const unsigned int chainLength = 6;
+    options.chainLength = chainLength;
+    options.burnin = 0;
+    options.thin = 1;
+    options.seed = 4321;
+    options.sampleFormat = SampleFormat::Binary;
+
+    options.mcmcSampleFile = resultsFile(kResults, name + "_full.bin");
+    options.summaryFile = resultsFile(kResults, name + "_full.summary");
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    options.mcmcSampleFile = resultsFile(kResults, name + "_resumed.bin");
+    options.summaryFile = resultsFile(kResults, name + "_resumed.summary");
+    options.checkpointFile = resultsFile(kResults, name + ".checkpoint");
+    options.checkpointInterval = chainLength / 2;
+    options.chainLength = chainLength / 2;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+    ASSERT_TRUE(fs::exists(options.checkpointFile));
+    ASSERT_FALSE(fs::exists(options.checkpointFile + ".tmp"));
+
+    options.chainLength = chainLength;
+    options.resume = true;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    const auto expected = readFile(resultsFile(kResults, name + "_full.bin"));
+    ASSERT_FALSE(expected.empty());
+    ASSERT_TRUE(expected == readFile(options.mcmcSampleFile));
+    ASSERT_TRUE(readFile(resultsFile(kResults, name + "_full.summary")) == readFile(options.summaryFile));
+}
+
+}
+
+TEST(CheckpointTest, RecordsRoundTrip) {
+    Checkpoint checkpoint;
+    checkpoint.set("value", 1.25);
+    checkpoint.set("vector", Eigen::VectorXd::LinSpaced(4, 0, 3).eval());
+    checkpoint.set("indices", std::vector<unsigned int>{3, 1, 2});
+    checkpoint.set("bytes", std::string("state\0more", 10));
+
+    const auto file = resultsFile(kResults, "records.checkpoint");
+    ASSERT_TRUE(checkpoint.write(file));
+    ASSERT_FALSE(fs::exists(file + ".tmp"));
+
+    Checkpoint read;
+    ASSERT_TRUE(read.read(file));
+    double value = 0;
+    ASSERT_TRUE(read.get("value", value));
+    ASSERT_EQ(1.25, value);
+    Eigen::VectorXd vector;
+    ASSERT_TRUE(read.get("vector", vector));
+    ASSERT_EQ(Eigen::VectorXd::LinSpaced(4, 0, 3), vector);
+    std::vector<unsigned int> indices;
+    ASSERT_TRUE(read.get("indices", indices));
+    ASSERT_EQ((std::vector<unsigned int>{3, 1, 2}), indices);
+    std::string bytes;
+    ASSERT_TRUE(read.get("bytes", bytes));
+    ASSERT_EQ(std::string("state\0more", 10), bytes);
+
+    // Missing records and records of another type are rejected
+    ASSERT_FALSE(read.get("missing", value));
+    ASSERT_FALSE(read.get("vector", value));
+}
+
+TEST(CheckpointTest, BayesRResumeMatchesFullRun) {
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = copyGaussBedFiles(resultsDirectory(kResults));
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.compress = true;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    options.analysisType = AnalysisType::PpBayes;
+    options.iterLog = true;
+    options.iterLogFile = resultsFile(kResults, "bayesr_iterations.csv");
+    expectResumeMatchesFullRun(options, "bayesr");
+
+    // The resumed run appends to the iteration log: a header and a line per iteration
+    ASSERT_EQ(1u + 6u, lineCount(options.iterLogFile));
+}
+
+TEST(CheckpointTest, BayesWResumeMatchesFullRun) {
+    const std::string testDataDir(GAUSS_TEST_DATA);
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = testDataDir + "data.bed";
+    options.inputType = InputType::BED;
+    options.failureFile = testDataDir + "data.fail";
+    options.phenotypeFile = testDataDir + "data.phen";
+    options.quad_points = "7";
+    options.S = MatrixXd(1, 2);
+    options.S << 0.01, 0.1;
+    options.compress = true;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    options.analysisType = AnalysisType::Gauss;
+    expectResumeMatchesFullRun(options, "bayesw");
+}
@@ -0,0 +1,308 @@
+#include <gtest/gtest.h>
+
+#include "analysisrunner.h"
+#include "chunkmanifest.h"
+#include "common.h"
+#include "data.hpp"
+#include "markerqc.h"
+#include "options.hpp"
+#include "preprocessgraph.h"
+#include "testfiles.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "chunkmanifest";
+
+ChunkManifest::Header makeHeader()
+{
+    ChunkManifest::Header header;
+    header.type = static_cast<unsigned int>(PreprocessDataType::Dense);
+    header.compress = 1;
+    header.numSnps = 30;
+    header.numInds = 100;
+    header.chunkSize = 10;
+    return header;
+}
+
+std::vector<ChunkManifest::Entry> chunkEntries(unsigned long firstSnp)
+{
+    std::vector<ChunkManifest::Entry> entries;
+    for (unsigned long snp = firstSnp; snp < firstSnp + 10; ++snp)
+        entries.push_back({snp, {snp * 50, 50, 100}});
+    return entries;
+}
+
+Options preprocessOptions(const std::string &dataFile)
+{
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = dataFile;
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.preprocessDataType = PreprocessDataType::Dense;
+    options.compress = true;
+    options.preprocessChunks = 1000;
+    options.numThread = 2;
+    return options;
+}
+
+std::vector<IndexEntry> readIndex(const std::string &file)
+{
+    const auto bytes = readFile(file);
+    std::vector<IndexEntry> index(bytes.size() / sizeof(IndexEntry));
+    std::memcpy(index.data(), bytes.data(), index.size() * sizeof(IndexEntry));
+    return index;
+}
+
+}
+
+TEST(ChunkManifestTest, LoadsRecordedChunks) {
+    const auto file = resultsFile(kResults, "records.manifest");
+    const auto header = makeHeader();
+    {
+        ChunkManifest manifest(file);
+        ASSERT_TRUE(manifest.create(header));
+        ASSERT_TRUE(manifest.record(0, chunkEntries(0)));
+        ASSERT_TRUE(manifest.record(2, chunkEntries(20)));
+
+        // Synced records are visible while the manifest is still open
+        ASSERT_TRUE(manifest.sync());
+        std::set<size_t> syncedChunks;
+        std::vector<ChunkManifest::Entry> syncedEntries;
+        ASSERT_TRUE(ChunkManifest(file).load(header, syncedChunks, syncedEntries));
+        ASSERT_EQ((std::set<size_t>{0, 2}), syncedChunks);
+    }
+
+    ChunkManifest manifest(file);
+    std::set<size_t> completedChunks;
+    std::vector<ChunkManifest::Entry> entries;
+    ASSERT_TRUE(manifest.load(header, completedChunks, entries));
+    ASSERT_EQ((std::set<size_t>{0, 2}), completedChunks);
+    ASSERT_EQ(20u, entries.size());
+    ASSERT_EQ(20u, entries[10].snp);
+    ASSERT_EQ(1000u, entries[10].index.pos);
+    ASSERT_EQ(50u, entries[10].index.compressedSize);
+    ASSERT_EQ(100u, entries[10].index.originalSize);
+
+    manifest.remove();
+    ASSERT_FALSE(fs::exists(file));
+}
+
+TEST(ChunkManifestTest, RejectsOtherRuns) {
+    const auto file = resultsFile(kResults, "other.manifest");
+    const auto header = makeHeader();
+    {
+        ChunkManifest manifest(file);
+        ASSERT_TRUE(manifest.create(header));
+        ASSERT_TRUE(manifest.record(0, chunkEntries(0)));
+    }
+
+    std::set<size_t> completedChunks;
+    std::vector<ChunkManifest::Entry> entries;
+
+    auto otherChunkSize = header;
+    otherChunkSize.chunkSize = 5;
+    ASSERT_FALSE(ChunkManifest(file).load(otherChunkSize, completedChunks, entries));
+
+    // An append run must not pick up a manifest of a plain run
+    auto appending = header;
+    appending.basePosition = 4096;
+    appending.baseIndexCount = 30;
+    ASSERT_FALSE(ChunkManifest(file).load(appending, completedChunks, entries));
+
+    ASSERT_FALSE(ChunkManifest(file + ".missing").load(header, completedChunks, entries));
+    ASSERT_TRUE(completedChunks.empty());
+    ASSERT_TRUE(entries.empty());
+}
+
+TEST(ChunkManifestTest, ResumeDropsPartialRecordAndAppends) {
+    const auto file = resultsFile(kResults, "partial.manifest");
+    const auto header = makeHeader();
+    {
+        ChunkManifest manifest(file);
+        ASSERT_TRUE(manifest.create(header));
+        ASSERT_TRUE(manifest.record(1, chunkEntries(10)));
+    }
+
+    // A run killed while recording chunk 0
+    const auto completeSize = fs::file_size(file);
+    {
+        std::ofstream output(file.c_str(), std::ios::binary | std::ios::app);
+        const unsigned long partial[] = {0, 10, 0, 0};
+        output.write(reinterpret_cast<const char *>(partial), sizeof(partial));
+    }
+
+    {
+        ChunkManifest manifest(file);
+        std::set<size_t> completedChunks;
+        std::vector<ChunkManifest::Entry> entries;
+        ASSERT_TRUE(manifest.load(header, completedChunks, entries));
+        ASSERT_EQ((std::set<size_t>{1}), completedChunks);
+        ASSERT_EQ(10u, entries.size());
+
+        ASSERT_TRUE(manifest.reopen());
+        ASSERT_EQ(completeSize, fs::file_size(file));
+        ASSERT_TRUE(manifest.record(0, chunkEntries(0)));
+    }
+
+    ChunkManifest manifest(file);
+    std::set<size_t> completedChunks;
+    std::vector<ChunkManifest::Entry> entries;
+    ASSERT_TRUE(manifest.load(header, completedChunks, entries));
+    ASSERT_EQ((std::set<size_t>{0, 1}), completedChunks);
+    ASSERT_EQ(20u, entries.size());
+    ASSERT_EQ(0u, entries[10].snp);
+    ASSERT_EQ(10u, entries[0].snp);
+    manifest.remove();
+}
+
+TEST(ChunkManifestTest, ResumedPreprocessingMatchesFullRun) {
+    const auto dataFile = copyGaussBedFiles(resultsDirectory(kResults));
+
+    Data data;
+    data.readFamFile(fileWithSuffix(dataFile, ".fam"));
+    data.readBimFile(fileWithSuffix(dataFile, ".bim"));
+
+    const auto type = PreprocessDataType::Dense;
+    const size_t chunkSize = 1000;
+    const auto ppFile = ppFileForType(type, dataFile);
+    const auto ppIndexFile = ppIndexFileForType(type, dataFile);
+
+    PreprocessGraph graph(2);
+    ASSERT_TRUE(graph.preprocessBedFile(dataFile, type, true, &data, chunkSize));
+    ASSERT_FALSE(fs::exists(ppFile + ".manifest"));
+
+    const auto fullData = readFile(ppFile);
+    const auto fullIndex = readIndex(ppIndexFile);
+    ASSERT_EQ(data.numSnps, fullIndex.size());
+
+    // Pretend that only chunks 0 and 2 made it to disk before the run died
+    ChunkManifest::Header header;
+    header.type = static_cast<unsigned int>(type);
+    header.compress = 1;
+    header.numSnps = data.numSnps;
+    header.numInds = data.numInds;
+    header.chunkSize = chunkSize;
+    {
+        ChunkManifest manifest(ppFile + ".manifest");
+        ASSERT_TRUE(manifest.create(header));
+        for (size_t chunk : {0, 2}) {
+            std::vector<ChunkManifest::Entry> entries;
+            for (size_t snp = chunk * chunkSize; snp < (chunk + 1) * chunkSize; ++snp)
+                entries.push_back({snp, fullIndex[snp]});
+            ASSERT_TRUE(manifest.record(chunk, entries));
+        }
+    }
+    fs::remove(ppIndexFile);
+
+    ASSERT_TRUE(graph.preprocessBedFile(dataFile, type, true, &data, chunkSize, true));
+    ASSERT_FALSE(fs::exists(ppFile + ".manifest"));
+
+    const auto resumedData = readFile(ppFile);
+    const auto resumedIndex = readIndex(ppIndexFile);
+    ASSERT_EQ(fullIndex.size(), resumedIndex.size());
+    for (size_t snp = 0; snp < fullIndex.size(); ++snp) {
+        const auto &expected = fullIndex[snp];
+        const auto &actual = resumedIndex[snp];
+        ASSERT_EQ(expected.compressedSize, actual.compressedSize) << "SNP " << snp;
+        ASSERT_EQ(expected.originalSize, actual.originalSize) << "SNP " << snp;
+
+        // The recorded chunks are not written again
+        const size_t chunk = snp / chunkSize;
+        if (chunk == 0 || chunk == 2)
+            ASSERT_EQ(expected.pos, actual.pos) << "SNP " << snp;
+
+        ASSERT_LE(actual.pos + actual.compressedSize, resumedData.size()) << "SNP " << snp;
+        ASSERT_TRUE(std::equal(fullData.begin() + static_cast<std::ptrdiff_t>(expected.pos),
+                               fullData.begin() + static_cast<std::ptrdiff_t>(expected.pos + expected.compressedSize),
+                               resumedData.begin() + static_cast<std::ptrdiff_t>(actual.pos)))
+                << "SNP " << snp;
+    }
+}
+
+TEST(ChunkManifestTest, AppendMatchesSingleRun) {
+    const auto directory = resultsDirectory(kResults);
+    const auto type = PreprocessDataType::Dense;
+
+    Data reference;
+    reference.readFamFile(gaussDataFile(".fam"));
+    reference.readBimFile(gaussDataFile(".bim"));
+    const unsigned int numSnps = reference.numSnps;
+    const unsigned int split = 4000;
+
+    const auto single = copyGaussBedFiles(directory);
+    ASSERT_TRUE(AnalysisRunner::run(preprocessOptions(single)));
+
+    const auto target = directory + "/target";
+    const auto appended = directory + "/appended";
+    writeGaussShard(target, 0, split, reference.numInds);
+    writeGaussShard(appended, split, numSnps, reference.numInds);
+    ASSERT_TRUE(AnalysisRunner::run(preprocessOptions(target + ".bed")));
+
+    const auto ppFile = ppFileForType(type, target + ".bed");
+    const auto ppIndexFile = ppIndexFileForType(type, target + ".bed");
+    const auto targetData = readFile(ppFile);
+    const auto targetIndex = readFile(ppIndexFile);
+    const auto targetStats = readFile(qcFile(ppFile));
+
+    // Shards written another way, or for other individuals, are refused and
+    // leave the target untouched
+    auto appendOptions = preprocessOptions(appended + ".bed");
+    appendOptions.preprocessAppendTo = target + ".bed";
+
+    auto uncompressed = appendOptions;
+    uncompressed.compress = false;
+    ASSERT_FALSE(AnalysisRunner::run(uncompressed));
+
+    const auto reordered = directory + "/reordered";
+    writeGaussShard(reordered, split, numSnps, reference.numInds);
+    auto famLines = readLines(gaussDataFile(".fam"));
+    std::swap(famLines[0], famLines[1]);
+    {
+        std::ofstream fam((reordered + ".fam").c_str());
+        for (const auto &line : famLines)
+            fam << line << '\n';
+    }
+    auto otherIndividuals = appendOptions;
+    otherIndividuals.dataFile = reordered + ".bed";
+    ASSERT_FALSE(AnalysisRunner::run(otherIndividuals));
+
+    ASSERT_TRUE(targetData == readFile(ppFile));
+    ASSERT_TRUE(targetIndex == readFile(ppIndexFile));
+    ASSERT_TRUE(targetStats == readFile(qcFile(ppFile)));
+
+    ASSERT_TRUE(AnalysisRunner::run(appendOptions));
+
+    // The appended files hold every marker of the single run
+    const auto singleData = readFile(ppFileForType(type, single));
+    const auto singleIndex = readIndex(ppIndexFileForType(type, single));
+    const auto appendedData = readFile(ppFile);
+    const auto appendedIndex = readIndex(ppIndexFile);
+    ASSERT_EQ(singleIndex.size(), appendedIndex.size());
+    for (size_t snp = 0; snp < singleIndex.size(); ++snp) {
+        const auto &expected = singleIndex[snp];
+        const auto &actual = appendedIndex[snp];
+        ASSERT_EQ(expected.compressedSize, actual.compressedSize) << "SNP " << snp;
+        ASSERT_EQ(expected.originalSize, actual.originalSize) << "SNP " << snp;
+        ASSERT_LE(actual.pos + actual.compressedSize, appendedData.size()) << "SNP " << snp;
+        ASSERT_TRUE(std::equal(singleData.begin() + static_cast<std::ptrdiff_t>(expected.pos),
+                               singleData.begin() + static_cast<std::ptrdiff_t>(expected.pos + expected.compressedSize),
+                               appendedData.begin() + static_cast<std::ptrdiff_t>(actual.pos)))
+                << "SNP " << snp;
+    }
+
+    std::vector<MarkerStats> stats;
+    PreprocessedFormat format;
+    ASSERT_TRUE(readMarkerStats(qcFile(ppFile), stats, &format));
+    ASSERT_EQ(numSnps, stats.size());
+    ASSERT_EQ(static_cast<unsigned int>(type), format.type);
+    ASSERT_EQ(1u, format.compress);
+    ASSERT_EQ(reference.numInds, format.numInds);
+}
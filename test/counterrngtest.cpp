@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "counterrng.h"
+
+namespace {
+
+struct KnownAnswer {
+    CounterRng::Block counter;
+    CounterRng::Key key;
+    CounterRng::Block expected;
+};
+
+// The Philox4x32-10 vectors of the Random123 known answer tests
+const KnownAnswer kKnownAnswers[] = {
+    {{0x00000000, 0x00000000, 0x00000000, 0x00000000},
+     {0x00000000, 0x00000000},
+     {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+    {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+     {0xffffffff, 0xffffffff},
+     {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+    {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+     {0xa4093822, 0x299f31d0},
+     {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+};
+
+}
+
+TEST(CounterRngTest, PhiloxMatchesKnownAnswers) {
+    for (const auto &answer : kKnownAnswers)
+        ASSERT_EQ(answer.expected, CounterRng::philox(answer.counter, answer.key));
+}
+
+TEST(CounterRngTest, StreamsAreReproducible) {
+    const CounterRng rng(42);
+    auto first = rng.stream(3, 7);
+    auto second = rng.stream(3, 7);
+    for (int draw = 0; draw < 10; ++draw) {
+        const double value = first.unif();
+        ASSERT_GE(value, 0.0);
+        ASSERT_LT(value, 1.0);
+        ASSERT_EQ(value, second.unif());
+    }
+}
+
+TEST(CounterRngTest, StreamsDifferByEveryInput) {
+    const CounterRng rng(42);
+    const double reference = rng.stream(3, 7, 0).unif();
+    ASSERT_NE(reference, CounterRng(43).stream(3, 7, 0).unif());
+    ASSERT_NE(reference, rng.stream(4, 7, 0).unif());
+    ASSERT_NE(reference, rng.stream(3, 8, 0).unif());
+    ASSERT_NE(reference, rng.stream(3, 7, 1).unif());
+}
+
+TEST(CounterRngTest, NormalDrawsAreStandard) {
+    const CounterRng rng(1);
+    auto stream = rng.stream(0, 0);
+    const int count = 100000;
+    double sum = 0;
+    double sumSquares = 0;
+    for (int draw = 0; draw < count; ++draw) {
+        const double value = stream.norm();
+        sum += value;
+        sumSquares += value * value;
+    }
+
+    // About six standard errors either way
+    const double mean = sum / count;
+    ASSERT_NEAR(0.0, mean, 0.02);
+    ASSERT_NEAR(1.0, sumSquares / count - mean * mean, 0.03);
+}
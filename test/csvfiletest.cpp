@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "csvfile.h"
+#include "data.hpp"
+#include "preprocessgraph.h"
+#include "testfiles.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string writeCsv(const std::string &name, const std::string &contents)
+{
+    const auto file = resultsFile("csvfile", name);
+    std::ofstream output(file.c_str(), std::ios::binary);
+    output << contents;
+    return file;
+}
+
+}
+
+TEST(CsvFileTest, ParsesLines) {
+    const auto file = writeCsv("valid.csv",
+                               "1,-2.5,3e-2\n"
+                               "\n"
+                               " 0.25 ,\t+4, -1E3\r\n"
+                               "\r\n"
+                               "7,8,9");
+
+    const CsvFile csv(file);
+    ASSERT_TRUE(csv.isMapped());
+    ASSERT_EQ(3u, csv.columnCount());
+
+    // Blank lines are skipped and the last line needs no newline
+    const auto offsets = csv.lineOffsets();
+    ASSERT_EQ(3u, offsets.size());
+
+    double values[3];
+    ASSERT_TRUE(csv.parseLine(offsets[0], values, 3));
+    ASSERT_DOUBLE_EQ(1, values[0]);
+    ASSERT_DOUBLE_EQ(-2.5, values[1]);
+    ASSERT_DOUBLE_EQ(0.03, values[2]);
+
+    ASSERT_TRUE(csv.parseLine(offsets[1], values, 3));
+    ASSERT_DOUBLE_EQ(0.25, values[0]);
+    ASSERT_DOUBLE_EQ(4, values[1]);
+    ASSERT_DOUBLE_EQ(-1000, values[2]);
+
+    ASSERT_TRUE(csv.parseLine(offsets[2], values, 3));
+    ASSERT_DOUBLE_EQ(9, values[2]);
+}
+
+TEST(CsvFileTest, RejectsMalformedLines) {
+    const auto file = writeCsv("malformed.csv",
+                               "1,2,3\n"
+                               "1,,3\n"
+                               "1,2\n"
+                               "1,2,3,4\n"
+                               "1,x,3\n"
+                               "1,2,3,\n"
+                               "1;2;3\n");
+
+    const CsvFile csv(file);
+    const auto offsets = csv.lineOffsets();
+    ASSERT_EQ(7u, offsets.size());
+
+    double values[3];
+    ASSERT_TRUE(csv.parseLine(offsets[0], values, 3));
+    for (size_t line = 1; line < offsets.size(); ++line)
+        ASSERT_FALSE(csv.parseLine(offsets[line], values, 3)) << "line " << line + 1;
+
+    ASSERT_FALSE(csv.parseLine(fs::file_size(file), values, 3));
+}
+
+TEST(CsvFileTest, MissingFileIsNotMapped) {
+    const CsvFile csv(resultsFile("csvfile", "missing.csv"));
+    ASSERT_FALSE(csv.isMapped());
+    ASSERT_EQ(0u, csv.columnCount());
+}
+
+TEST(CsvFileTest, PreprocessRejectsMalformedFile) {
+    const auto valid = writeCsv("preprocess.csv", "1,0,2,1\n0,0,1,2\n2,1,0,0\n");
+    const auto malformed = writeCsv("preprocess_bad.csv", "1,0,2,1\n0,0,1\n2,1,0,0\n");
+    const auto type = PreprocessDataType::Dense;
+
+    PreprocessGraph graph(2);
+    {
+        Data data;
+        data.readCSVFile(valid);
+        ASSERT_TRUE(graph.preprocessCsvFile(valid, true, &data, 1));
+        ASSERT_TRUE(fs::exists(ppFileForType(type, valid)));
+        ASSERT_EQ(3 * sizeof(IndexEntry), fs::file_size(ppIndexFileForType(type, valid)));
+    }
+
+    // A parse error fails the run and leaves no partial output behind
+    Data data;
+    data.readCSVFile(malformed);
+    ASSERT_FALSE(graph.preprocessCsvFile(malformed, true, &data, 1));
+    ASSERT_FALSE(fs::exists(ppFileForType(type, malformed)));
+    ASSERT_FALSE(fs::exists(ppIndexFileForType(type, malformed)));
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include "analysisrunner.h"
+#include "common.h"
+#include "data.hpp"
+#include "options.hpp"
+#include "testfiles.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "dataset";
+
+void writeFile(const std::string &file, const std::string &contents)
+{
+    std::ofstream output(file.c_str(), std::ios::binary);
+    output << contents;
+}
+
+Options preprocessOptions(const std::string &dataFile)
+{
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = dataFile;
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.preprocessDataType = PreprocessDataType::Dense;
+    options.compress = true;
+    options.preprocessChunks = 1000;
+    options.numThread = 2;
+    return options;
+}
+
+}
+
+TEST(DatasetTest, ReadsManifest) {
+    const auto manifest = resultsFile(kResults, "genome.dataset");
+    writeFile(manifest,
+              "# One shard per chromosome\n"
+              "chr1.bed\n"
+              "\n"
+              "  shards/chr2.bed\t\r\n"
+              "/data/chr3.bed\n");
+
+    const auto shards = readDatasetManifest(manifest);
+    ASSERT_EQ(3u, shards.size());
+    ASSERT_EQ(resultsFile(kResults, "chr1.bed"), shards[0]);
+    ASSERT_EQ(resultsFile(kResults, "shards/chr2.bed"), shards[1]);
+    ASSERT_EQ("/data/chr3.bed", shards[2]);
+}
+
+TEST(DatasetTest, RejectsEmptyManifest) {
+    const auto manifest = resultsFile(kResults, "empty.dataset");
+    writeFile(manifest, "# Nothing here\n\n");
+    ASSERT_THROW(readDatasetManifest(manifest), std::string);
+    ASSERT_THROW(readDatasetManifest(manifest + ".missing"), std::string);
+}
+
+TEST(DatasetTest, ShardsMatchSingleFile) {
+    const auto directory = resultsDirectory(kResults);
+
+    Data reference;
+    reference.readFamFile(gaussDataFile(".fam"));
+    reference.readBimFile(gaussDataFile(".bim"));
+    const unsigned int numSnps = reference.numSnps;
+    const unsigned int split = 3000;
+    ASSERT_LT(split, numSnps);
+
+    // The whole data set, and the same SNPs split into two shards
+    const auto single = copyGaussBedFiles(directory);
+    fs::create_directories(directory + "/shards");
+    writeGaussShard(directory + "/first", 0, split, reference.numInds);
+    writeGaussShard(directory + "/shards/second", split, numSnps, reference.numInds);
+
+    const auto manifest = directory + "/split.dataset";
+    writeFile(manifest, "first.bed\n" + directory + "/shards/second.bed\n");
+
+    ASSERT_TRUE(AnalysisRunner::run(preprocessOptions(single)));
+    auto datasetOptions = preprocessOptions({});
+    datasetOptions.datasetFile = manifest;
+    ASSERT_TRUE(AnalysisRunner::run(datasetOptions));
+
+    const auto type = PreprocessDataType::Dense;
+    Data data;
+    data.readFamFile(fileWithSuffix(single, ".fam"));
+    data.readBimFile(fileWithSuffix(single, ".bim"));
+    data.mapCompressedPreprocessBedFile(ppFileForType(type, single),
+                                        ppIndexFileForType(type, single));
+
+    const auto shards = readDatasetManifest(manifest);
+    Data sharded;
+    sharded.readFamFile(fileWithSuffix(shards.front(), ".fam"));
+    sharded.readBimFiles({fileWithSuffix(shards[0], ".bim"), fileWithSuffix(shards[1], ".bim")});
+    ASSERT_EQ((std::vector<unsigned int>{split, numSnps - split}), sharded.bimSnpCounts);
+    ASSERT_EQ(numSnps, sharded.numSnps);
+
+    sharded.mapCompressedPreprocessedShards({ppFileForType(type, shards[0]), ppFileForType(type, shards[1])},
+                                            {ppIndexFileForType(type, shards[0]), ppIndexFileForType(type, shards[1])});
+    ASSERT_EQ(data.ppbedIndex.size(), sharded.ppbedIndex.size());
+
+    // Every marker reads back the same through the combined mapping
+    const auto *singleBytes = reinterpret_cast<const unsigned char *>(data.ppBedMap);
+    const auto *shardedBytes = reinterpret_cast<const unsigned char *>(sharded.ppBedMap);
+    for (unsigned int snp = 0; snp < numSnps; ++snp) {
+        ASSERT_EQ(data.snpInfoVec[snp]->ID, sharded.snpInfoVec[snp]->ID) << "SNP " << snp;
+
+        const auto &expected = data.ppbedIndex[snp];
+        const auto &actual = sharded.ppbedIndex[snp];
+        ASSERT_EQ(expected.compressedSize, actual.compressedSize) << "SNP " << snp;
+        ASSERT_EQ(expected.originalSize, actual.originalSize) << "SNP " << snp;
+        ASSERT_TRUE(std::equal(singleBytes + expected.pos,
+                               singleBytes + expected.pos + expected.compressedSize,
+                               shardedBytes + actual.pos)) << "SNP " << snp;
+    }
+
+    data.unmapCompressedPreprocessedBedFile();
+    sharded.unmapCompressedPreprocessedBedFile();
+}
+
+TEST(DatasetTest, RejectsShardsOfOtherIndividuals) {
+    const auto directory = resultsDirectory(kResults);
+    Data reference;
+    reference.readFamFile(gaussDataFile(".fam"));
+
+    // The second shard lists the same individuals in another order
+    writeGaussShard(directory + "/matching", 0, 100, reference.numInds);
+    writeGaussShard(directory + "/reordered", 100, 200, reference.numInds);
+    auto famLines = readLines(gaussDataFile(".fam"));
+    std::swap(famLines[0], famLines[1]);
+    std::string fam;
+    for (const auto &line : famLines)
+        fam += line + '\n';
+    writeFile(directory + "/reordered.fam", fam);
+
+    const auto manifest = resultsFile(kResults, "reordered.dataset");
+    writeFile(manifest, "matching.bed\nreordered.bed\n");
+
+    auto options = preprocessOptions({});
+    options.datasetFile = manifest;
+    ASSERT_THROW(AnalysisRunner::run(options), std::string);
+
+    options.analysisType = AnalysisType::PpBayes;
+    ASSERT_THROW(AnalysisRunner::run(options), std::string);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "analysisgraph.hpp"
+#include "analysisrunner.h"
+#include "common.h"
+#include "data.hpp"
+#include "DenseBayesRRmz.hpp"
+#include "densebayesw.h"
+#include "options.hpp"
+#include "testfiles.h"
+
+#include <unistd.h>
+
+namespace {
+
+VectorXd residuals(const VectorXd &epsilon) { return epsilon; }
+VectorXd residuals(const std::shared_ptr<VectorXd> &epsilon) { return *epsilon; }
+
+// Exposes the state left behind by a chain
+template<typename Analysis>
+class StateProbe : public Analysis
+{
+public:
+    using Analysis::Analysis;
+
+    VectorXd beta() const { return this->m_beta; }
+    VectorXd epsilon() const { return residuals(this->m_epsilon); }
+};
+
+Options asyncOptions(AnalysisType analysisType, const std::string &sampleFile)
+{
+    Options options;
+    options.analysisType = analysisType;
+    options.inputType = InputType::BED;
+    options.preprocessDataType = PreprocessDataType::Dense;
+    options.compress = true;
+    options.chainLength = 5;
+    options.burnin = 0;
+    options.thin = 1;
+    options.seed = 1234;
+    options.deterministicAsync = true;
+    options.decompressionTokens = 8;
+    options.analysisTokens = 4;
+    options.mcmcSampleFile = resultsFile("deterministicasync", sampleFile);
+    return options;
+}
+
+template<typename Analysis, typename... Args>
+void runTwiceAndCompare(const Data *data, const Options *options, Args... args)
+{
+    StateProbe<Analysis> first(data, options, args...);
+    ASSERT_EQ(0, first.runGibbs(AnalysisRunner::makeAnalysisGraph(*options).get()));
+
+    StateProbe<Analysis> second(data, options, args...);
+    ASSERT_EQ(0, second.runGibbs(AnalysisRunner::makeAnalysisGraph(*options).get()));
+
+    // Bit for bit, not merely close
+    ASSERT_FALSE(first.beta().isZero());
+    ASSERT_TRUE(first.beta() == second.beta());
+    ASSERT_TRUE(first.epsilon() == second.epsilon());
+}
+
+}
+
+TEST(DeterministicAsyncTest, BayesRRunsRepeat) {
+    auto options = asyncOptions(AnalysisType::Preprocess, "bayesr.csv");
+    options.dataFile = copyGaussBedFiles(resultsDirectory("deterministicasync"));
+    options.phenotypeFile = gaussDataFile(".phen");
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    Data data;
+    data.readFamFile(fileWithSuffix(options.dataFile, ".fam"));
+    data.readBimFile(fileWithSuffix(options.dataFile, ".bim"));
+    data.readPhenotypeFile(options.phenotypeFile);
+    data.mapCompressedPreprocessBedFile(ppFileForType(options.preprocessDataType, options.dataFile),
+                                        ppIndexFileForType(options.preprocessDataType, options.dataFile));
+
+    options.analysisType = AnalysisType::AsyncPpBayes;
+    runTwiceAndCompare<DenseBayesRRmz>(&data, &options);
+
+    data.unmapCompressedPreprocessedBedFile();
+}
+
+TEST(DeterministicAsyncTest, BayesWRunsRepeat) {
+    const std::string testDataDir(GAUSS_TEST_DATA);
+    auto options = asyncOptions(AnalysisType::Preprocess, "bayesw.csv");
+    options.dataFile = testDataDir + "data.bed";
+    options.failureFile = testDataDir + "data.fail";
+    options.phenotypeFile = testDataDir + "data.phen";
+    options.quad_points = "7";
+    options.S = MatrixXd(1, 2);
+    options.S << 0.01, 0.1;
+
+    // Warm starts carry envelopes from one iteration to the next
+    options.arsWarmStart = true;
+    options.arsCacheSize = 1;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    Data data;
+    data.readFamFile(fileWithSuffix(options.dataFile, ".fam"));
+    data.readBimFile(fileWithSuffix(options.dataFile, ".bim"));
+    data.readPhenotypeFile(options.phenotypeFile);
+    data.readFailureFile(options.failureFile);
+    data.mapCompressedPreprocessBedFile(ppFileForType(options.preprocessDataType, options.dataFile),
+                                        ppIndexFileForType(options.preprocessDataType, options.dataFile));
+
+    options.analysisType = AnalysisType::AsyncGauss;
+    runTwiceAndCompare<DenseBayesW>(&data, &options, sysconf(_SC_PAGE_SIZE));
+
+    data.unmapCompressedPreprocessedBedFile();
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include "distributions_boost.hpp"
+
+TEST(DistributionsBoostTest, FillUniformMatchesScalarDraws) {
+    Distributions_boost bulk(17);
+    Distributions_boost scalar(17);
+
+    Eigen::VectorXd values(25);
+    bulk.fill_uniform(values);
+    for (Eigen::Index i = 0; i < values.size(); ++i) {
+        ASSERT_GE(values[i], 0.0);
+        ASSERT_LT(values[i], 1.0);
+        ASSERT_EQ(scalar.unif_rng(), values[i]) << "draw " << i;
+    }
+
+    // Both engines are left in the same state
+    ASSERT_EQ(scalar.unif_rng(), bulk.unif_rng());
+}
+
+TEST(DistributionsBoostTest, DirichletMatchesScalarDraws) {
+    const Eigen::VectorXd alpha = (Eigen::VectorXd(4) << 0.5, 1.0, 3.0, 10.0).finished();
+
+    // One gamma draw per component, normalised
+    Distributions_boost scalar(5);
+    Eigen::VectorXd expected(alpha.size());
+    for (Eigen::Index i = 0; i < alpha.size(); ++i)
+        expected[i] = scalar.rgamma(alpha[i], 1.0);
+    expected /= expected.sum();
+
+    Distributions_boost allocating(5);
+    ASSERT_TRUE(expected == allocating.dirichlet_rng(alpha));
+
+    Distributions_boost output(5);
+    Eigen::VectorXd draw(alpha.size());
+    output.dirichlet_rng(alpha, draw);
+    ASSERT_TRUE(expected == draw);
+}
+
+TEST(DistributionsBoostTest, DirichletOutputSumsToOne) {
+    Distributions_boost dist(3);
+    const Eigen::VectorXd alpha = (Eigen::VectorXd(3) << 1.0, 2.0, 0.1).finished();
+
+    // The same output vector is reused for every draw
+    Eigen::VectorXd draw(alpha.size());
+    for (int i = 0; i < 100; ++i) {
+        dist.dirichlet_rng(alpha, draw);
+        ASSERT_NEAR(1.0, draw.sum(), 1e-12) << "draw " << i;
+        ASSERT_TRUE((draw.array() >= 0).all()) << "draw " << i;
+    }
+}
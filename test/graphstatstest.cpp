@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include "analysisrunner.h"
+#include "graphstats.h"
+#include "options.hpp"
+#include "testfiles.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "graphstats";
+
+}
+
+TEST(GraphStatsTest, RegistersEachNameOnce) {
+    GraphStats stats("TestGraph");
+    const auto node = stats.addNode("node");
+    const auto queue = stats.addQueue("queue");
+    ASSERT_NE(node, queue);
+    ASSERT_EQ(node, stats.addNode("node"));
+    ASSERT_EQ(queue, stats.addQueue("queue"));
+    ASSERT_GT(stats.ticksPerSecond(), 0.0);
+}
+
+TEST(GraphStatsTest, WritesMetricsPerIteration) {
+    GraphStats stats("TestGraph");
+    const auto node = stats.addNode("work_node");
+    const auto queue = stats.addQueue("work_queue");
+    const auto wait = stats.addWait("work_lock");
+
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        stats.beginIteration();
+        for (int call = 0; call <= iteration; ++call) {
+            GraphStats::Timer timer(&stats, node);
+        }
+
+        // Depths 1 and 2, then back to empty
+        stats.push(queue);
+        stats.push(queue);
+        stats.pop(queue);
+        stats.pop(queue);
+
+        stats.record(wait, 0);
+        stats.endIteration();
+    }
+    ASSERT_EQ(3u, stats.iterationCount());
+
+    // A null stats pointer is allowed and records nothing
+    {
+        GraphStats::Timer timer(nullptr, node);
+    }
+
+    const auto file = resultsFile(kResults, "metrics.json");
+    ASSERT_TRUE(stats.write(file));
+    ASSERT_FALSE(fs::exists(file + ".tmp"));
+
+    const auto json = readFile(file);
+    ASSERT_NE(std::string::npos, json.find("\"graph\": \"TestGraph\"")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"iterations\": 3")) << json;
+    ASSERT_NE(std::string::npos, json.find("{\"name\": \"work_node\", \"kind\": \"node\", \"calls\": 6,")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"calls\": [1, 2, 3]")) << json;
+    ASSERT_NE(std::string::npos, json.find("{\"name\": \"work_queue\", \"kind\": \"queue\", \"samples\": 6, \"mean_depth\": 1.5, \"max_depth\": 2,")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"max_depth\": [2, 2, 2]")) << json;
+    ASSERT_NE(std::string::npos, json.find("{\"name\": \"work_lock\", \"kind\": \"wait\", \"count\": 3,")) << json;
+}
+
+TEST(GraphStatsTest, WrittenByAnalysis) {
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = copyGaussBedFiles(resultsDirectory(kResults));
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.compress = true;
+    options.graphStatsFile = resultsFile(kResults, "preprocess.json");
+    ASSERT_TRUE(AnalysisRunner::run(options));
+    ASSERT_NE(std::string::npos, readFile(options.graphStatsFile).find("\"graph\": \"PreprocessGraph\""));
+
+    options.analysisType = AnalysisType::AsyncPpBayes;
+    options.chainLength = 3;
+    options.burnin = 0;
+    options.thin = 1;
+    options.mcmcSampleFile = resultsFile(kResults, "async.csv");
+    options.graphStatsFile = resultsFile(kResults, "async.json");
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    const auto json = readFile(options.graphStatsFile);
+    ASSERT_NE(std::string::npos, json.find("\"graph\": \"ParallelGraph\"")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"iterations\": 3")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"name\": \"analysis_node\"")) << json;
+}
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include "analysisrunner.h"
+#include "common.h"
+#include "data.hpp"
+#include "densebayesrkernel.h"
+#include "eigenbayesrkernel.h"
+#include "individualmajor.h"
+#include "markerqc.h"
+#include "options.hpp"
+#include "packedbayesrkernel.h"
+#include "raggedbayesrkernel.h"
+#include "testfiles.h"
+
+#include <numeric>
+#include <random>
+
+namespace {
+
+const std::string kResults = "individualmajor";
+
+std::unique_ptr<BayesRKernel> kernelForMarker(PreprocessDataType type,
+                                              const std::shared_ptr<const Marker> &marker,
+                                              const VectorXd &ones)
+{
+    switch (type) {
+    case PreprocessDataType::Dense:
+        return std::make_unique<DenseRKernel>(std::dynamic_pointer_cast<const DenseMarker>(marker));
+    case PreprocessDataType::SparseEigen: {
+        auto kernel = std::make_unique<EigenBayesRKernel>(std::dynamic_pointer_cast<const EigenSparseMarker>(marker));
+        kernel->ones = &ones;
+        return kernel;
+    }
+    case PreprocessDataType::SparseRagged:
+        return std::make_unique<RaggedBayesRKernel>(std::dynamic_pointer_cast<const RaggedSparseMarker>(marker));
+    case PreprocessDataType::Packed:
+        return std::make_unique<PackedBayesRKernel>(std::dynamic_pointer_cast<const PackedMarker>(marker));
+    default:
+        return {};
+    }
+}
+
+// X * beta from the SNP-major markers, the way BayesRBase::geneticValues adds it up
+VectorXd snpMajorProduct(const Data &data, PreprocessDataType type, const VectorXd &beta)
+{
+    VectorXd result = VectorXd::Zero(data.numInds);
+    const VectorXd ones = VectorXd::Ones(data.numInds);
+    auto *ppData = reinterpret_cast<unsigned char *>(data.ppBedMap);
+    for (unsigned int snp = 0; snp < data.numSnps; ++snp) {
+        if (beta(snp) == 0)
+            continue;
+
+        std::unique_ptr<MarkerBuilder> builder{builderForType(type)};
+        builder->initialise(snp, data.numInds);
+        builder->decompress(ppData, data.ppbedIndex[snp]);
+        const std::shared_ptr<const Marker> marker = builder->build();
+
+        auto kernel = kernelForMarker(type, marker, ones);
+        result += *kernel->calculateEpsilonChange(beta(snp), 0);
+    }
+    return result;
+}
+
+}
+
+class IndividualMajorTest : public ::testing::TestWithParam<PreprocessDataType> {};
+
+TEST_P(IndividualMajorTest, MultiplyMatchesSnpMajorMarkers) {
+    const auto type = GetParam();
+    const auto dataFile = copyGaussBedFiles(resultsDirectory(kResults));
+
+    // Drop some SNPs by QC, so the analysed SNPs are a subset of those in the file
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = dataFile;
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.preprocessDataType = type;
+    options.compress = true;
+    options.preprocessChunks = 1000;
+    options.preprocessIndividualMajor = true;
+    options.qcMinMaf = 0.05;
+    options.numThread = 2;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    const auto ppFile = ppFileForType(type, dataFile);
+    Data data;
+    data.readFamFile(fileWithSuffix(dataFile, ".fam"));
+    data.readBimFile(fileWithSuffix(dataFile, ".bim"));
+    const unsigned int fileSnps = data.numSnps;
+
+    std::vector<MarkerStats> stats;
+    ASSERT_TRUE(readMarkerStats(qcFile(ppFile), stats));
+    std::vector<unsigned char> kept;
+    for (const auto &record : stats)
+        kept.push_back(record.kept);
+    data.excludeSnps(kept);
+    ASSERT_LT(data.numSnps, fileSnps);
+    ASSERT_EQ(data.numSnps, data.bimIndices.size());
+    data.mapCompressedPreprocessBedFile(ppFile, ppIndexFileForType(type, dataFile));
+
+    IndividualMajorFile individualMajor;
+    ASSERT_TRUE(individualMajor.open(individualMajorFile(ppFile)));
+    ASSERT_EQ(fileSnps, individualMajor.layout().numSnps);
+    ASSERT_EQ(data.numInds, individualMajor.layout().numInds);
+
+    std::mt19937 engine(1);
+    std::normal_distribution<double> normal(0, 0.01);
+    VectorXd beta(data.numSnps);
+    for (unsigned int snp = 0; snp < data.numSnps; ++snp)
+        beta(snp) = snp % 3 == 0 ? 0 : normal(engine);
+
+    const VectorXd expected = snpMajorProduct(data, type, beta);
+    const VectorXd actual = individualMajor.multiply(beta, data.bimIndices);
+    ASSERT_EQ(expected.size(), actual.size());
+    ASSERT_LT((expected - actual).lpNorm<Infinity>(), 1e-9 * expected.lpNorm<Infinity>());
+
+    // Effects of a SNP the file does not hold are rejected
+    std::vector<unsigned int> outOfRange = data.bimIndices;
+    outOfRange.back() = fileSnps;
+    ASSERT_TRUE(individualMajor.multiply(beta, outOfRange).isZero());
+
+    data.unmapCompressedPreprocessedBedFile();
+}
+
+TEST_P(IndividualMajorTest, StandardisesMissingGenotypesLikeTheBuilder) {
+    const auto type = GetParam();
+    // Blocks of 64 individuals, the last one partly filled
+    IndividualMajorLayout layout;
+    layout.numInds = 150;
+    layout.numSnps = 3;
+    layout.blockSize = 64;
+
+    std::mt19937 engine(2);
+    std::binomial_distribution<int> alleleCount(2, 0.3);
+    std::bernoulli_distribution missing(0.1);
+    std::vector<unsigned int> individuals(layout.numInds);
+    std::iota(individuals.begin(), individuals.end(), 0);
+
+    const auto file = resultsFile(kResults, "missing.indmajor");
+    IndividualMajorWriter writer;
+    ASSERT_TRUE(writer.create(file, layout, false, type));
+
+    const VectorXd ones = VectorXd::Ones(layout.numInds);
+    const VectorXd beta = (VectorXd(3) << 0.5, 0, -0.25).finished();
+    VectorXd expected = VectorXd::Zero(layout.numInds);
+    for (unsigned int snp = 0; snp < layout.numSnps; ++snp) {
+        std::vector<unsigned char> codes(layout.numInds);
+        for (auto &code : codes)
+            code = missing(engine) ? MarkerBuilder::kMissingGenotype
+                                   : static_cast<unsigned char>(alleleCount(engine));
+        const GenotypeColumn column {codes.data(), individuals.data(), codes.size()};
+        writer.writeColumn(snp, column);
+
+        std::unique_ptr<MarkerBuilder> builder{builderForType(type)};
+        builder->initialise(snp, layout.numInds);
+        builder->processColumn(column);
+        builder->endColumn();
+        const std::shared_ptr<const Marker> marker = builder->build();
+        expected += *kernelForMarker(type, marker, ones)->calculateEpsilonChange(beta(snp), 0);
+    }
+    ASSERT_TRUE(writer.close());
+
+    IndividualMajorFile individualMajor;
+    ASSERT_TRUE(individualMajor.open(file));
+    const VectorXd actual = individualMajor.multiply(beta, {0, 1, 2});
+    ASSERT_LT((expected - actual).lpNorm<Infinity>(), 1e-9 * expected.lpNorm<Infinity>());
+}
+
+INSTANTIATE_TEST_SUITE_P(IndividualMajor,
+                         IndividualMajorTest,
+                         ::testing::ValuesIn({PreprocessDataType::Dense,
+                                              PreprocessDataType::SparseEigen,
+                                              PreprocessDataType::SparseRagged,
+                                              PreprocessDataType::Packed}));
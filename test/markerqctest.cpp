@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "markerqc.h"
+#include "testfiles.h"
+
+#include <numeric>
+#include <vector>
+
+namespace {
+
+struct HweCase {
+    unsigned int hets;
+    unsigned int hom1;
+    unsigned int hom2;
+    double pValue;
+};
+
+// Summed exactly over every heterozygote count with rational arithmetic
+const HweCase kHweCases[] = {
+    {57, 14, 29, 0.15068007651576143},
+    {10, 45, 45, 2.1260317926714968e-17},
+    {50, 25, 25, 1.0},
+    {0, 50, 50, 1.114224180581451e-30},
+    {500, 250, 250, 1.0},
+    {100, 850, 50, 5.293943742559522e-29},
+    {3, 95, 2, 0.002650896026403003},
+    {20, 5, 75, 0.040924969144731385},
+    {1200, 300, 500, 1.7704122585195242e-21},
+    {1, 0, 0, 1.0},
+    {0, 10, 0, 1.0},
+    {0, 0, 0, 1.0},
+};
+
+}
+
+TEST(MarkerQcTest, HweExactPValueMatchesReference) {
+    for (const auto &c : kHweCases) {
+        const double pValue = hweExactPValue(c.hets, c.hom1, c.hom2);
+        EXPECT_NEAR(c.pValue, pValue, 1e-9 * c.pValue)
+                << c.hets << " hets, " << c.hom1 << " and " << c.hom2 << " homozygotes";
+
+        // Which homozygote is called the first allele does not matter
+        EXPECT_NEAR(pValue, hweExactPValue(c.hets, c.hom2, c.hom1), 1e-12 * pValue);
+    }
+}
+
+TEST(MarkerQcTest, ComputesMarkerStats) {
+    // 3 individuals with 0 alleles, 4 with 1, 1 with 2 and 2 missing
+    std::vector<unsigned char> codes = {0, 1, 1, 0, 2, MarkerBuilder::kMissingGenotype, 1, 0, 1,
+                                        MarkerBuilder::kMissingGenotype};
+    std::vector<unsigned int> individuals(codes.size());
+    std::iota(individuals.begin(), individuals.end(), 0);
+
+    const auto stats = computeMarkerStats({codes.data(), individuals.data(), codes.size()});
+    ASSERT_TRUE(stats.computed);
+    ASSERT_EQ(3u, stats.counts[0]);
+    ASSERT_EQ(4u, stats.counts[1]);
+    ASSERT_EQ(1u, stats.counts[2]);
+    ASSERT_EQ(2u, stats.counts[MarkerBuilder::kMissingGenotype]);
+    ASSERT_FLOAT_EQ(6.0f / 16.0f, stats.maf);
+    ASSERT_FLOAT_EQ(0.2f, stats.missingRate);
+    ASSERT_DOUBLE_EQ(hweExactPValue(4, 3, 1), stats.hwePValue);
+}
+
+TEST(MarkerQcTest, ThresholdsRejectFailingMarkers) {
+    MarkerStats stats;
+    stats.maf = 0.05f;
+    stats.missingRate = 0.02f;
+    stats.hwePValue = 1e-4;
+
+    QcThresholds thresholds;
+    ASSERT_TRUE(thresholds.passes(stats));
+
+    thresholds.minMaf = 0.1;
+    ASSERT_FALSE(thresholds.passes(stats));
+
+    thresholds = {};
+    thresholds.maxMissingRate = 0.01;
+    ASSERT_FALSE(thresholds.passes(stats));
+
+    thresholds = {};
+    thresholds.minHwePValue = 1e-3;
+    ASSERT_FALSE(thresholds.passes(stats));
+
+    // Monomorphic markers always fail
+    stats.maf = 0;
+    ASSERT_FALSE(QcThresholds().passes(stats));
+}
+
+TEST(MarkerQcTest, StatsRoundTrip) {
+    const auto file = resultsFile("markerqc", "stats.qc");
+
+    std::vector<MarkerStats> stats(2);
+    stats[0].counts[1] = 7;
+    stats[0].maf = 0.25f;
+    stats[0].hwePValue = 0.5;
+    stats[0].computed = true;
+    stats[0].kept = true;
+    stats[1].missingRate = 0.5f;
+    stats[1].computed = true;
+    PreprocessedFormat format;
+    format.type = 2;
+    format.compress = 1;
+    format.numInds = 11;
+    ASSERT_TRUE(writeMarkerStats(file, format, stats, false));
+
+    // Appending adds the new SNPs after the existing records
+    ASSERT_TRUE(writeMarkerStats(file, PreprocessedFormat(), {stats[0]}, true));
+
+    std::vector<MarkerStats> read;
+    PreprocessedFormat readFormat;
+    ASSERT_TRUE(readMarkerStats(file, read, &readFormat));
+    ASSERT_TRUE(format == readFormat);
+    ASSERT_EQ(3u, read.size());
+    ASSERT_EQ(7u, read[0].counts[1]);
+    ASSERT_FLOAT_EQ(0.25f, read[0].maf);
+    ASSERT_DOUBLE_EQ(0.5, read[0].hwePValue);
+    ASSERT_TRUE(read[0].kept);
+    ASSERT_FLOAT_EQ(0.5f, read[1].missingRate);
+    ASSERT_TRUE(read[1].computed);
+    ASSERT_FALSE(read[1].kept);
+    ASSERT_EQ(7u, read[2].counts[1]);
+}
@@ -174,6 +174,14 @@ TEST(OptionsTest, PreprocessDataType) {
         ASSERT_EQ(PreprocessDataType::SparseRagged, options.preprocessDataType);
     }
 
+    {
+        // Packed
+        const char *argv[] = {"test", "--sparse-data", "packed"};
+
+        options.inputOptions(3, argv);
+        ASSERT_EQ(PreprocessDataType::Packed, options.preprocessDataType);
+    }
+
     {
         // None
         const char *argv[] = {"test", "--sparse-data", "foo"};
@@ -182,3 +190,18 @@ TEST(OptionsTest, PreprocessDataType) {
         ASSERT_EQ(PreprocessDataType::None, options.preprocessDataType);
     }
 }
+
+TEST(OptionsTest, SampleFormat) {
+    Options options;
+    ASSERT_EQ(SampleFormat::Csv, options.sampleFormat);
+    ASSERT_FALSE(options.sampleCompress);
+
+    const char *argv[] = {"test", "--sample-format", "binary32", "--sample-compress"};
+
+    options.inputOptions(4, argv);
+    ASSERT_EQ(SampleFormat::BinaryFloat, options.sampleFormat);
+    ASSERT_TRUE(options.sampleCompress);
+
+    const char *unknown[] = {"test", "--sample-format", "parquet"};
+    ASSERT_THROW(options.inputOptions(3, unknown), std::string);
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include "checkpoint.h"
+#include "posteriorsummary.h"
+#include "testfiles.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const unsigned int kMarkerCount = 6;
+const std::vector<std::string> kParameters = {"mu", "sigmaE"};
+
+struct Samples {
+    std::vector<Eigen::VectorXd> beta;
+    std::vector<Eigen::VectorXd> parameters;
+};
+
+// Betas are zero half of the time, and the parameters sit far from zero so
+// that a one pass sum of squares would lose precision
+Samples makeSamples(unsigned int count)
+{
+    std::mt19937 engine(7);
+    std::normal_distribution<double> normal(0, 1);
+    std::bernoulli_distribution included(0.5);
+
+    Samples samples;
+    for (unsigned int sample = 0; sample < count; ++sample) {
+        Eigen::VectorXd beta(kMarkerCount);
+        for (unsigned int marker = 0; marker < kMarkerCount; ++marker)
+            beta[marker] = included(engine) ? 0.01 * (marker + 1) * normal(engine) : 0;
+        samples.beta.push_back(beta);
+
+        Eigen::VectorXd parameters(2);
+        parameters << 1e6 + normal(engine), 0.5 + 0.01 * normal(engine);
+        samples.parameters.push_back(parameters);
+    }
+    return samples;
+}
+
+void twoPass(const std::vector<Eigen::VectorXd> &values, Eigen::VectorXd &mean, Eigen::VectorXd &sd)
+{
+    mean = Eigen::VectorXd::Zero(values.front().size());
+    for (const auto &value : values)
+        mean += value;
+    mean /= static_cast<double>(values.size());
+
+    Eigen::VectorXd sumSquares = Eigen::VectorXd::Zero(mean.size());
+    for (const auto &value : values)
+        sumSquares.array() += (value - mean).array().square();
+    sd = (sumSquares / static_cast<double>(values.size() - 1)).cwiseSqrt();
+}
+
+void expectNear(const Eigen::VectorXd &expected, const Eigen::VectorXd &actual, double tolerance)
+{
+    ASSERT_EQ(expected.size(), actual.size());
+    for (Eigen::Index i = 0; i < expected.size(); ++i)
+        EXPECT_NEAR(expected[i], actual[i], tolerance * std::max(1.0, std::abs(expected[i]))) << "element " << i;
+}
+
+}
+
+TEST(PosteriorSummaryTest, MatchesTwoPassStatistics) {
+    const auto samples = makeSamples(1000);
+    PosteriorSummary summary(kParameters, kMarkerCount);
+    for (size_t i = 0; i < samples.beta.size(); ++i)
+        summary.update(samples.beta[i], samples.parameters[i]);
+    ASSERT_EQ(1000u, summary.sampleCount());
+
+    Eigen::VectorXd mean, sd;
+    twoPass(samples.beta, mean, sd);
+    expectNear(mean, summary.betaMean(), 1e-12);
+    expectNear(sd, summary.betaSd(), 1e-12);
+
+    twoPass(samples.parameters, mean, sd);
+    expectNear(mean, summary.parameterMean(), 1e-12);
+    expectNear(sd, summary.parameterSd(), 1e-10);
+
+    Eigen::VectorXd inclusions = Eigen::VectorXd::Zero(kMarkerCount);
+    for (const auto &beta : samples.beta)
+        inclusions.array() += (beta.array() != 0).cast<double>();
+    expectNear(inclusions / 1000.0, summary.inclusionProbability(), 1e-15);
+}
+
+TEST(PosteriorSummaryTest, SdNeedsTwoSamples) {
+    PosteriorSummary summary(kParameters, kMarkerCount);
+    ASSERT_TRUE(summary.inclusionProbability().isZero());
+
+    const auto samples = makeSamples(1);
+    summary.update(samples.beta.front(), samples.parameters.front());
+    ASSERT_TRUE(std::isnan(summary.betaSd()[0]));
+    ASSERT_TRUE(std::isnan(summary.parameterSd()[0]));
+}
+
+TEST(PosteriorSummaryTest, RestoredSummaryContinues) {
+    const auto samples = makeSamples(20);
+    PosteriorSummary full(kParameters, kMarkerCount);
+    PosteriorSummary first(kParameters, kMarkerCount);
+    for (size_t i = 0; i < samples.beta.size(); ++i) {
+        full.update(samples.beta[i], samples.parameters[i]);
+        if (i < 10)
+            first.update(samples.beta[i], samples.parameters[i]);
+    }
+
+    Checkpoint checkpoint;
+    first.save(checkpoint);
+    PosteriorSummary resumed(kParameters, kMarkerCount);
+    ASSERT_TRUE(resumed.restore(checkpoint));
+    for (size_t i = 10; i < samples.beta.size(); ++i)
+        resumed.update(samples.beta[i], samples.parameters[i]);
+
+    ASSERT_EQ(full.sampleCount(), resumed.sampleCount());
+    ASSERT_TRUE(full.betaMean() == resumed.betaMean());
+    ASSERT_TRUE(full.betaSd() == resumed.betaSd());
+    ASSERT_TRUE(full.parameterSd() == resumed.parameterSd());
+
+    // A summary of another model does not take the state
+    PosteriorSummary other(kParameters, kMarkerCount + 1);
+    ASSERT_FALSE(other.restore(checkpoint));
+}
+
+TEST(PosteriorSummaryTest, WritesOneRowPerValue) {
+    const auto file = resultsFile("posteriorsummary", "out.summary");
+
+    const auto samples = makeSamples(3);
+    PosteriorSummary summary(kParameters, kMarkerCount);
+    for (size_t i = 0; i < samples.beta.size(); ++i)
+        summary.update(samples.beta[i], samples.parameters[i]);
+    ASSERT_TRUE(summary.write(file));
+    ASSERT_FALSE(fs::exists(file + ".tmp"));
+
+    std::ifstream input(file.c_str());
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(input, line);)
+        lines.push_back(line);
+    ASSERT_EQ(2 + kParameters.size() + kMarkerCount, lines.size());
+    ASSERT_EQ("# samples: 3", lines[0]);
+    ASSERT_EQ("name,mean,sd,pip", lines[1]);
+    ASSERT_EQ(0u, lines[2].find("mu,"));
+    ASSERT_EQ(0u, lines[4].find("beta[1],"));
+    ASSERT_EQ(0u, lines.back().find("beta[6],"));
+}
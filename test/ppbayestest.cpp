@@ -49,7 +49,8 @@ INSTANTIATE_TEST_SUITE_P(PreprocessTests,
                          ::testing::Combine(
                              ::testing::ValuesIn({PreprocessDataType::Dense,
                                                   PreprocessDataType::SparseEigen,
-                                                  PreprocessDataType::SparseRagged}),
+                                                  PreprocessDataType::SparseRagged,
+                                                  PreprocessDataType::Packed}),
                              ::testing::Bool()));
 
 class PreprocessCsvDense : public ::testing::TestWithParam<bool> {};
@@ -110,7 +111,8 @@ TEST_P(PreprocessCsvSparse, ExpectingFailureForSparseDataTypes) {
 INSTANTIATE_TEST_SUITE_P(PreprocessTests,
                          PreprocessCsvSparse,
                          ::testing::ValuesIn({PreprocessDataType::SparseEigen,
-                                              PreprocessDataType::SparseRagged}));
+                                              PreprocessDataType::SparseRagged,
+                                              PreprocessDataType::Packed}));
 
 class PpBayesBase : public ::testing::Test {
 protected:
@@ -188,7 +190,8 @@ INSTANTIATE_TEST_SUITE_P(AnalysisSmokeTests,
                                                   AnalysisType::AsyncPpBayes}),
                              ::testing::ValuesIn({PreprocessDataType::Dense,
                                                   PreprocessDataType::SparseEigen,
-                                                  PreprocessDataType::SparseRagged}),
+                                                  PreprocessDataType::SparseRagged,
+                                                  PreprocessDataType::Packed}),
                              ::testing::Bool(), // compress
                              ::testing::Bool())); // useMarkerCache
 
@@ -233,7 +236,8 @@ INSTANTIATE_TEST_SUITE_P(PpBayesBedGroups,
                                                   AnalysisType::AsyncPpBayes}),
                              ::testing::ValuesIn({PreprocessDataType::Dense,
                                                   PreprocessDataType::SparseEigen,
-                                                  PreprocessDataType::SparseRagged}),
+                                                  PreprocessDataType::SparseRagged,
+                                                  PreprocessDataType::Packed}),
                              ::testing::Bool(), // compress
                              ::testing::Bool())); // useMarkerCache
 
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include "analysisgraph.hpp"
+#include "analysisrunner.h"
+#include "common.h"
+#include "data.hpp"
+#include "DenseBayesRRmz.hpp"
+#include "individualmajor.h"
+#include "markerqc.h"
+#include "options.hpp"
+#include "SparseBayesRRG.hpp"
+#include "testfiles.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "residualresync";
+
+// Exposes the residuals the sampler carries and those recomputed from the model
+template<typename Analysis>
+class ResidualsProbe : public Analysis
+{
+public:
+    using Analysis::Analysis;
+
+    bool usesIndividualMajor() const { return this->m_individualMajor.isOpen(); }
+
+    VectorXd residuals() const { return this->m_epsilon; }
+
+    VectorXd exactResiduals()
+    {
+        VectorXd exact = this->m_y - this->geneticValues();
+        exact.array() -= this->m_mu;
+        return exact;
+    }
+};
+
+template<typename Analysis>
+void runAndCompare(const Data *data, const Options *options, bool individualMajor)
+{
+    ResidualsProbe<Analysis> analysis(data, options);
+    const auto graph = AnalysisRunner::makeAnalysisGraph(*options);
+    ASSERT_EQ(0, analysis.runGibbs(graph.get()));
+    ASSERT_EQ(individualMajor, analysis.usesIndividualMajor());
+
+    const VectorXd residuals = analysis.residuals();
+    const VectorXd exact = analysis.exactResiduals();
+    ASSERT_EQ(residuals.size(), exact.size());
+    ASSERT_LT((residuals - exact).lpNorm<Infinity>(), 1e-8 * residuals.lpNorm<Infinity>());
+}
+
+}
+
+class ResidualResyncTest : public ::testing::TestWithParam<std::tuple<PreprocessDataType, bool>> {};
+
+TEST_P(ResidualResyncTest, GeneticValuesMatchResiduals) {
+    const auto type = std::get<0>(GetParam());
+    const bool individualMajor = std::get<1>(GetParam());
+
+    const auto dataFile = copyGaussBedFiles(resultsDirectory(kResults));
+
+    // Drop some SNPs by QC, so the analysed SNPs are a subset of those in the file
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = dataFile;
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.preprocessDataType = type;
+    options.compress = true;
+    options.preprocessIndividualMajor = individualMajor;
+    options.qcMinMaf = 0.05;
+    options.numThread = 2;
+
+    const auto ppFile = ppFileForType(type, dataFile);
+    std::error_code ec;
+    fs::remove(individualMajorFile(ppFile), ec);
+    ASSERT_TRUE(AnalysisRunner::run(options));
+    ASSERT_EQ(individualMajor, fs::exists(individualMajorFile(ppFile)));
+
+    Data data;
+    data.readFamFile(fileWithSuffix(dataFile, ".fam"));
+    data.readBimFile(fileWithSuffix(dataFile, ".bim"));
+    data.readPhenotypeFile(options.phenotypeFile);
+
+    std::vector<MarkerStats> stats;
+    ASSERT_TRUE(readMarkerStats(qcFile(ppFile), stats));
+    std::vector<unsigned char> kept;
+    for (const auto &record : stats)
+        kept.push_back(record.kept);
+    data.excludeSnps(kept);
+    data.mapCompressedPreprocessBedFile(ppFile, ppIndexFileForType(type, dataFile));
+
+    // No resync falls within the chain, so the residuals are only ever updated incrementally
+    options.analysisType = AnalysisType::PpBayes;
+    options.chainLength = 5;
+    options.burnin = 0;
+    options.thin = 1;
+    options.residualResyncInterval = options.chainLength + 1;
+    options.mcmcSampleFile = resultsFile(kResults, "residualresync.csv");
+
+    if (type == PreprocessDataType::Dense)
+        runAndCompare<DenseBayesRRmz>(&data, &options, individualMajor);
+    else
+        runAndCompare<SparseBayesRRG>(&data, &options, individualMajor);
+
+    data.unmapCompressedPreprocessedBedFile();
+}
+
+INSTANTIATE_TEST_SUITE_P(ResidualResync,
+                         ResidualResyncTest,
+                         ::testing::Combine(
+                             ::testing::ValuesIn({PreprocessDataType::Dense,
+                                                  PreprocessDataType::SparseRagged}),
+                             ::testing::Bool())); // individualMajor
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+
+#include "samplefile.h"
+#include "samplewriter.h"
+#include "testfiles.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "samplefile";
+
+const SampleSchema kSchema = {SampleField("iteration"), SampleField("mu"), SampleField("beta", 3)};
+
+std::vector<Eigen::VectorXd> makeSamples()
+{
+    std::vector<Eigen::VectorXd> samples;
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        Eigen::VectorXd sample(5);
+        sample << iteration, 0.1 * iteration - 1.0 / 3.0, 1e-7 * iteration, -2.5, 1.0 / (iteration + 7);
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+void writeSamples(const std::string &file, SampleFormat format, bool compress,
+                  const std::vector<Eigen::VectorXd> &samples)
+{
+    std::ofstream out(file.c_str(), std::ios::binary);
+    writeSampleHeader(out, kSchema, format, compress);
+    std::vector<unsigned char> buffer;
+    for (const auto &sample : samples)
+        writeSampleRow(out, sample, nullptr, format, compress, buffer);
+}
+
+}
+
+class SampleFileTest : public ::testing::TestWithParam<std::tuple<SampleFormat, bool>> {};
+
+TEST_P(SampleFileTest, RoundTrip) {
+    const auto format = std::get<0>(GetParam());
+    const bool compress = std::get<1>(GetParam());
+    const auto file = resultsFile(kResults, "roundtrip.bin");
+    const auto samples = makeSamples();
+    writeSamples(file, format, compress, samples);
+
+    SampleFileReader reader(file);
+    ASSERT_EQ(format, reader.format());
+    ASSERT_EQ(compress, reader.isCompressed());
+    ASSERT_FALSE(reader.isSparse());
+    ASSERT_EQ(5u, reader.columnCount());
+    ASSERT_EQ(3u, reader.schema().size());
+    ASSERT_EQ("beta", reader.schema()[2].name);
+    ASSERT_EQ(3u, reader.schema()[2].count);
+    ASSERT_TRUE(reader.schema()[2].array);
+
+    Eigen::VectorXd sample;
+    for (const auto &expected : samples) {
+        ASSERT_TRUE(reader.readRow(sample));
+        ASSERT_EQ(expected.size(), sample.size());
+        for (Eigen::Index i = 0; i < sample.size(); ++i) {
+            // float32 files hold the values rounded to float
+            const double value = format == SampleFormat::BinaryFloat
+                    ? static_cast<double>(static_cast<float>(expected[i]))
+                    : expected[i];
+            ASSERT_EQ(value, sample[i]) << "column " << i;
+        }
+    }
+    ASSERT_FALSE(reader.readRow(sample));
+}
+
+INSTANTIATE_TEST_SUITE_P(SampleFile,
+                         SampleFileTest,
+                         ::testing::Combine(
+                             ::testing::ValuesIn({SampleFormat::Binary,
+                                                  SampleFormat::BinaryFloat}),
+                             ::testing::Bool())); // compress
+
+TEST(SampleFileReaderTest, RejectsCorruptBlocks) {
+    const auto file = resultsFile(kResults, "corrupt.bin");
+    writeSamples(file, SampleFormat::Binary, true, makeSamples());
+
+    // Flip the last byte of the final compressed block
+    auto bytes = readFile(file);
+    bytes.back() = static_cast<char>(~bytes.back());
+    {
+        std::ofstream output(file.c_str(), std::ios::binary);
+        output.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    SampleFileReader reader(file);
+    Eigen::VectorXd sample;
+    for (int row = 0; row < 3; ++row)
+        ASSERT_TRUE(reader.readRow(sample));
+    ASSERT_THROW(reader.readRow(sample), const char *);
+}
+
+TEST(SampleFileReaderTest, RejectsOtherFiles) {
+    const auto file = resultsFile(kResults, "notsamples.bin");
+    {
+        std::ofstream output(file.c_str(), std::ios::binary);
+        output << "iteration, mu\n";
+    }
+    ASSERT_THROW(SampleFileReader reader(file), std::string);
+    ASSERT_THROW(SampleFileReader reader(file + ".missing"), std::string);
+}
+
+class SparseSampleFileTest : public ::testing::TestWithParam<std::tuple<SampleFormat, bool>> {};
+
+TEST_P(SparseSampleFileTest, SelectedFieldsRoundTrip) {
+    const auto format = std::get<0>(GetParam());
+    const bool compress = std::get<1>(GetParam());
+    const auto file = resultsFile(kResults, "sparse.bin");
+
+    // iteration, mu, beta[4], sigmaE, sigmaG, comp[4], epsilon[2]
+    std::vector<Eigen::VectorXd> samples;
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        Eigen::VectorXd sample(14);
+        sample << iteration, 0.5,
+                0, 0.25 * iteration, 0, -0.125,
+                1.5, 2.5 + iteration,
+                0, iteration > 0 ? 2 : 0, 0, 1,
+                0.75, -0.75;
+        samples.push_back(sample);
+    }
+
+    {
+        SampleWriter writer;
+        writer.setFileName(file);
+        writer.setMarkerCount(4);
+        writer.setIndividualCount(2);
+        writer.setFormat(format);
+        writer.setCompressed(compress);
+        writer.setFields({"beta", "comp", "sigma"});
+        writer.setSparse(true);
+        writer.open();
+        for (const auto &sample : samples)
+            writer.write(sample);
+        writer.close();
+    }
+
+    SampleFileReader reader(file);
+    ASSERT_TRUE(reader.isSparse());
+    ASSERT_EQ(compress, reader.isCompressed());
+
+    // Only the iteration and the variances are dense; mu and epsilon are dropped
+    const auto &schema = reader.schema();
+    ASSERT_EQ(4u, schema.size());
+    ASSERT_EQ("iteration", schema[0].name);
+    ASSERT_EQ("sigmaE", schema[1].name);
+    ASSERT_EQ("sigmaG", schema[2].name);
+    ASSERT_EQ("nonzero", schema[3].name);
+    ASSERT_TRUE(schema[3].sparse);
+    ASSERT_EQ(4u, schema[3].count);
+    ASSERT_EQ(3u, reader.columnCount());
+
+    Eigen::VectorXd sample;
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        ASSERT_TRUE(reader.readRow(sample));
+        ASSERT_EQ(static_cast<double>(iteration), sample[0]);
+        ASSERT_EQ(1.5, sample[1]);
+        ASSERT_EQ(2.5 + iteration, sample[2]);
+
+        // The non-zero betas by 1-based index, with their components
+        const auto &sparse = reader.sparse();
+        const std::vector<uint32_t> index = iteration == 0 ? std::vector<uint32_t>{4}
+                                                           : std::vector<uint32_t>{2, 4};
+        ASSERT_EQ(index, sparse.index);
+        ASSERT_EQ(-0.125, sparse.beta.back());
+        ASSERT_EQ(1.0, sparse.comp.back());
+        if (iteration > 0) {
+            ASSERT_EQ(0.25 * iteration, sparse.beta.front());
+            ASSERT_EQ(2.0, sparse.comp.front());
+        }
+    }
+    ASSERT_FALSE(reader.readRow(sample));
+}
+
+INSTANTIATE_TEST_SUITE_P(SampleFile,
+                         SparseSampleFileTest,
+                         ::testing::Combine(
+                             ::testing::ValuesIn({SampleFormat::Binary,
+                                                  SampleFormat::BinaryFloat}),
+                             ::testing::Bool())); // compress
+
+TEST(SampleFileReaderTest, RejectsImpossibleTripletCounts) {
+    const auto file = resultsFile(kResults, "triplets.bin");
+    {
+        SampleWriter writer;
+        writer.setFileName(file);
+        writer.setMarkerCount(4);
+        writer.setIndividualCount(2);
+        writer.setFormat(SampleFormat::Binary);
+        writer.setCompressed(false);
+        writer.setFields({"beta", "comp", "sigma"});
+        writer.setSparse(true);
+        writer.open();
+
+        // iteration, mu, beta[4], sigmaE, sigmaG, comp[4], epsilon[2]
+        Eigen::VectorXd sample(14);
+        sample << 0, 0.5, 0, 0.25, 0, 0, 1.5, 2.5, 0, 2, 0, 0, 0.75, -0.75;
+        writer.write(sample);
+        writer.close();
+    }
+
+    // The row ends with the triplet count and a single triplet. Claim far more
+    // triplets than there are markers.
+    {
+        const auto tripletSize = sizeof(uint32_t) + 2 * sizeof(double);
+        std::fstream stream(file.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+        stream.seekp(static_cast<std::streamoff>(fs::file_size(file) - tripletSize - sizeof(uint64_t)));
+        const uint64_t count = uint64_t(1) << 60;
+        stream.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    }
+
+    SampleFileReader reader(file);
+    Eigen::VectorXd sample;
+    ASSERT_THROW(reader.readRow(sample), const char *);
+}
+
+TEST(SampleFileReaderTest, RejectsUnsupportedVersions) {
+    const auto file = resultsFile(kResults, "version1.bin");
+    writeSamples(file, SampleFormat::Binary, false, makeSamples());
+
+    // The version follows the four byte magic
+    {
+        std::fstream stream(file.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+        stream.seekp(4);
+        const uint32_t version = 1;
+        stream.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    }
+
+    try {
+        SampleFileReader reader(file);
+        FAIL() << "unsupported version was accepted";
+    } catch (const std::string &message) {
+        ASSERT_NE(std::string::npos, message.find("Unsupported binary sample file version 1")) << message;
+    }
+}
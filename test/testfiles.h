@@ -0,0 +1,78 @@
+#ifndef TESTFILES_H
+#define TESTFILES_H
+
+#include "beddecoder.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Each test writes its files to a directory of its own below TEST_RESULTS
+inline std::string resultsDirectory(const std::string &directory)
+{
+    const auto path = std::filesystem::path(TEST_RESULTS) / directory;
+    std::error_code ec;
+    std::filesystem::create_directories(path, ec);
+    return path.string();
+}
+
+inline std::string resultsFile(const std::string &directory, const std::string &name)
+{
+    return (std::filesystem::path(resultsDirectory(directory)) / name).string();
+}
+
+inline std::string readFile(const std::string &file)
+{
+    std::ifstream input(file.c_str(), std::ios::binary);
+    return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+}
+
+inline std::vector<std::string> readLines(const std::string &file)
+{
+    std::ifstream input(file.c_str());
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(input, line);)
+        lines.push_back(line);
+    return lines;
+}
+
+// The BED data set which ships with the repository: 1000 individuals and
+// 11054 SNPs, with phenotypes and failure times.
+inline std::string gaussDataFile(const std::string &suffix)
+{
+    return std::string(GAUSS_TEST_DATA) + "data" + suffix;
+}
+
+// Copies the BED file set of the GAUSS data to directory, so that preprocessing
+// writes there instead of into the source tree. Returns the copied .bed file.
+inline std::string copyGaussBedFiles(const std::string &directory)
+{
+    const auto target = (std::filesystem::path(directory) / "data").string();
+    for (const auto &suffix : {".bed", ".bim", ".fam"})
+        std::filesystem::copy_file(gaussDataFile(suffix), target + suffix,
+                                   std::filesystem::copy_options::overwrite_existing);
+    return target + ".bed";
+}
+
+// Writes the SNPs [first, last) of the GAUSS data as a BED file set of its own,
+// named shard with the .bed, .bim and .fam suffixes
+inline void writeGaussShard(const std::string &shard, unsigned int first, unsigned int last, unsigned int numInds)
+{
+    std::filesystem::copy_file(gaussDataFile(".fam"), shard + ".fam",
+                               std::filesystem::copy_options::overwrite_existing);
+
+    const auto bimLines = readLines(gaussDataFile(".bim"));
+    std::ofstream bim((shard + ".bim").c_str());
+    for (unsigned int snp = first; snp < last; ++snp)
+        bim << bimLines[snp] << '\n';
+
+    const auto bed = readFile(gaussDataFile(".bed"));
+    const auto columnSize = static_cast<std::ptrdiff_t>(BedDecoder::columnSize(numInds));
+    std::ofstream output((shard + ".bed").c_str(), std::ios::binary);
+    output.write(bed.data(), 3);
+    output.write(bed.data() + 3 + first * columnSize, (last - first) * columnSize);
+}
+
+#endif // TESTFILES_H
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include "analysisrunner.h"
+#include "options.hpp"
+#include "testfiles.h"
+#include "tracer.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kResults = "tracer";
+
+size_t occurrences(const std::string &text, const std::string &pattern)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        ++count;
+    return count;
+}
+
+}
+
+// The tracer is process wide, so turn it off again for the tests that follow
+class TracerTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        tracer().configure(0, 0, std::string());
+    }
+};
+
+TEST_F(TracerTest, RecordsOnlyTheWindow) {
+    const auto file = resultsFile(kResults, "window.json");
+    fs::remove(file);
+    tracer().configure(1, 2, file);
+    ASSERT_TRUE(tracer().enabled());
+
+    for (unsigned int iteration = 0; iteration < 4; ++iteration) {
+        tracer().setIteration(iteration);
+        ASSERT_EQ(iteration >= 1 && iteration <= 2, tracer().active());
+
+        TraceSpan span("step");
+        TraceSpan markerSpan("marker_step", static_cast<int>(10 + iteration));
+    }
+
+    // Written as soon as the window is over
+    ASSERT_FALSE(tracer().active());
+    ASSERT_TRUE(fs::exists(file));
+    ASSERT_FALSE(fs::exists(file + ".tmp"));
+
+    const auto json = readFile(file);
+    ASSERT_EQ(0u, json.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["));
+    ASSERT_EQ(2u, occurrences(json, "\"name\": \"step\", \"cat\": \"iteration\", \"ph\": \"X\"")) << json;
+    ASSERT_EQ(2u, occurrences(json, "\"name\": \"marker_step\", \"cat\": \"marker\", \"ph\": \"X\"")) << json;
+    ASSERT_EQ(2u, occurrences(json, "\"iteration\": 1")) << json;
+    ASSERT_EQ(0u, occurrences(json, "\"iteration\": 0")) << json;
+    ASSERT_EQ(0u, occurrences(json, "\"iteration\": 3")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"iteration\": 2, \"marker\": 12}")) << json;
+
+    // Finishing again does not write the trace a second time
+    fs::remove(file);
+    tracer().finish();
+    ASSERT_FALSE(fs::exists(file));
+}
+
+TEST_F(TracerTest, KeepsNewestEventsOnOverflow) {
+    const auto file = resultsFile(kResults, "overflow.json");
+    tracer().configure(0, 0, file, 3);
+
+    tracer().setIteration(0);
+    for (int marker = 0; marker < 5; ++marker)
+        TraceSpan span("sample", marker);
+
+    // The run ends inside the window
+    tracer().finish();
+
+    const auto json = readFile(file);
+    ASSERT_EQ(3u, occurrences(json, "\"name\": \"sample\"")) << json;
+    ASSERT_EQ(std::string::npos, json.find("\"marker\": 1}")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"marker\": 2}")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"marker\": 4}")) << json;
+}
+
+TEST_F(TracerTest, WrittenByAnalysis) {
+    Options options;
+    options.analysisType = AnalysisType::Preprocess;
+    options.dataFile = copyGaussBedFiles(resultsDirectory(kResults));
+    options.inputType = InputType::BED;
+    options.phenotypeFile = gaussDataFile(".phen");
+    options.compress = true;
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    options.analysisType = AnalysisType::PpBayes;
+    options.chainLength = 4;
+    options.burnin = 0;
+    options.thin = 1;
+    options.mcmcSampleFile = resultsFile(kResults, "bayesr.csv");
+    options.traceFirstIteration = 1;
+    options.traceLastIteration = 2;
+    options.traceFile = resultsFile(kResults, "bayesr.json");
+    ASSERT_TRUE(AnalysisRunner::run(options));
+
+    const auto json = readFile(options.traceFile);
+    ASSERT_EQ(2u, occurrences(json, "\"name\": \"iteration\"")) << json;
+    ASSERT_NE(std::string::npos, json.find("\"name\": \"sampleBeta\"")) << json;
+    ASSERT_EQ(0u, occurrences(json, "\"iteration\": 0")) << json;
+    ASSERT_EQ(0u, occurrences(json, "\"iteration\": 3")) << json;
+}